@@ -164,6 +164,28 @@
 /*	may require a lot of memory on systems that handle connections
 /*	from many remote clients.  To reduce memory usage, reduce
 /*	the time unit over which state is kept.
+/* SHARED COUNTERS
+/* .ad
+/* .fi
+/*	The features described in this section are available with
+/*	Postfix 3.2 and later.
+/*
+/*	With \fBanvil_shared_counters_enable = yes\fR, the
+/*	\fBanvil\fR(8) server maintains a table in the file
+/*	\fB$data_directory/anvil_counters\fR that \fBsmtpd\fR(8)
+/*	processes map into memory, and update without a request to
+/*	the \fBanvil\fR(8) server. The \fBanvil\fR(8) server
+/*	periodically updates a time stamp in that table, removes
+/*	expired information, and drops the connections of server
+/*	processes that terminated without disconnecting. The peak
+/*	usage in the table is logged together with the peak usage
+/*	that the \fBanvil\fR(8) server measures itself.
+/*
+/*	While the time stamp is out of date, or when the table has
+/*	no room for a client, \fBsmtpd\fR(8) processes send their
+/*	requests to the \fBanvil\fR(8) server as usual. With shared
+/*	counters, the \fBanvil\fR(8) server does not terminate
+/*	when it is idle.
 /* DIAGNOSTICS
 /*	Problems and transactions are logged to \fBsyslogd\fR(8).
 /*
@@ -207,6 +229,18 @@
 /* .IP "\fBanvil_status_update_time (600s)\fR"
 /*	How frequently the \fBanvil\fR(8) connection and rate limiting server
 /*	logs peak usage information.
+/* .PP
+/*	Available in Postfix version 3.2 and later:
+/* .IP "\fBanvil_shared_counters_enable (no)\fR"
+/*	Maintain connection counts and rates in a shared-memory table
+/*	that \fBsmtpd\fR(8) processes update without a request to the
+/*	\fBanvil\fR(8) server.
+/* .IP "\fBanvil_shared_counters_size (10000)\fR"
+/*	The number of (service, client) entries in the shared-memory
+/*	table.
+/* .IP "\fBdata_directory (see 'postconf -d' output)\fR"
+/*	The directory with Postfix-writable data files (for example:
+/*	caches, pseudo-random numbers).
 /* .IP "\fBconfig_directory (see 'postconf -d' output)\fR"
 /*	The default location of the Postfix main.cf and master.cf
 /*	configuration files.
@@ -273,9 +307,10 @@
 
 #include <msg.h>
 #include <mymalloc.h>
-#include <htable.h>
+#include <ohtable.h>
 #include <stringops.h>
 #include <events.h>
+#include <set_eugid.h>
 
 /* Global library. */
 
@@ -284,6 +319,7 @@
 #include <mail_version.h>
 #include <mail_proto.h>
 #include <anvil_clnt.h>
+#include <anvil_shm.h>
 
 /* Server skeleton. */
 
@@ -300,7 +336,8 @@ int     var_anvil_stat_time;
  /*
   * Global dynamic state.
   */
-static HTABLE *anvil_remote_map;	/* indexed by service+ remote client */
+static OHTABLE *anvil_remote_map;	/* indexed by service+ remote client */
+static ANVIL_SHM *anvil_shm;		/* shared counters, or null */
 
  /*
   * Remote connection state, one instance for each (service, client) pair.
@@ -489,6 +526,14 @@ static time_t max_cache_time;		/* time of peak size */
 	_max.when = event_time(); \
     } while (0)
 
+#define ANVIL_MAX_MERGE(_max, _peak) \
+    do { \
+	if ((_peak).value > _max.value) { \
+	    ANVIL_MAX_UPDATE(_max, (_peak).value, (_peak).ident); \
+	    _max.when = (_peak).when; \
+	} \
+    } while (0)
+
 #define ANVIL_MAX_RATE_REPORT(_max, _name) \
     do { \
 	if (_max.value > 0) { \
@@ -528,8 +573,8 @@ static void anvil_remote_expire(int unused_event, void *context)
 	msg_panic("%s: bad connection count: %d",
 		  myname, anvil_remote->count);
 
-    htable_delete(anvil_remote_map, anvil_remote->ident,
-		  (void (*) (void *)) 0);
+    ohtable_delete(anvil_remote_map, anvil_remote->ident,
+		   (void (*) (void *)) 0);
     ANVIL_REMOTE_FREE(anvil_remote);
 
     if (msg_verbose)
@@ -553,7 +598,7 @@ static void anvil_remote_lookup(VSTREAM *client_stream, const char *ident)
      * Look up remote client information.
      */
     if ((anvil_remote =
-	 (ANVIL_REMOTE *) htable_find(anvil_remote_map, ident)) == 0) {
+	 (ANVIL_REMOTE *) ohtable_find(anvil_remote_map, ident)) == 0) {
 	attr_print_plain(client_stream, ATTR_FLAG_NONE,
 			 SEND_ATTR_INT(ANVIL_ATTR_STATUS, ANVIL_STAT_OK),
 			 SEND_ATTR_INT(ANVIL_ATTR_COUNT, 0),
@@ -603,10 +648,10 @@ static ANVIL_REMOTE *anvil_remote_conn_update(VSTREAM *client_stream, const char
      * a quicker response to tresspassers.
      */
     if ((anvil_remote =
-	 (ANVIL_REMOTE *) htable_find(anvil_remote_map, ident)) == 0) {
+	 (ANVIL_REMOTE *) ohtable_find(anvil_remote_map, ident)) == 0) {
 	anvil_remote = (ANVIL_REMOTE *) mymalloc(sizeof(*anvil_remote));
 	ANVIL_REMOTE_FIRST_CONN(anvil_remote, ident);
-	htable_enter(anvil_remote_map, ident, (void *) anvil_remote);
+	ohtable_enter(anvil_remote_map, ident, (void *) anvil_remote);
 	if (max_cache_size < anvil_remote_map->used) {
 	    max_cache_size = anvil_remote_map->used;
 	    max_cache_time = event_time();
@@ -673,7 +718,7 @@ static void anvil_remote_mail(VSTREAM *client_stream, const char *ident)
      * Be prepared for "postfix reload" after "connect".
      */
     if ((anvil_remote =
-	 (ANVIL_REMOTE *) htable_find(anvil_remote_map, ident)) == 0)
+	 (ANVIL_REMOTE *) ohtable_find(anvil_remote_map, ident)) == 0)
 	anvil_remote = anvil_remote_conn_update(client_stream, ident);
 
     /*
@@ -702,7 +747,7 @@ static void anvil_remote_rcpt(VSTREAM *client_stream, const char *ident)
      * Be prepared for "postfix reload" after "connect".
      */
     if ((anvil_remote =
-	 (ANVIL_REMOTE *) htable_find(anvil_remote_map, ident)) == 0)
+	 (ANVIL_REMOTE *) ohtable_find(anvil_remote_map, ident)) == 0)
 	anvil_remote = anvil_remote_conn_update(client_stream, ident);
 
     /*
@@ -731,7 +776,7 @@ static void anvil_remote_auth(VSTREAM *client_stream, const char *ident)
      * Be prepared for "postfix reload" after "connect".
      */
     if ((anvil_remote =
-	 (ANVIL_REMOTE *) htable_find(anvil_remote_map, ident)) == 0)
+	 (ANVIL_REMOTE *) ohtable_find(anvil_remote_map, ident)) == 0)
 	anvil_remote = anvil_remote_conn_update(client_stream, ident);
 
     /*
@@ -760,7 +805,7 @@ static void anvil_remote_newtls(VSTREAM *client_stream, const char *ident)
      * Be prepared for "postfix reload" after "connect".
      */
     if ((anvil_remote =
-	 (ANVIL_REMOTE *) htable_find(anvil_remote_map, ident)) == 0)
+	 (ANVIL_REMOTE *) ohtable_find(anvil_remote_map, ident)) == 0)
 	anvil_remote = anvil_remote_conn_update(client_stream, ident);
 
     /*
@@ -790,7 +835,7 @@ static void anvil_remote_newtls_stat(VSTREAM *client_stream, const char *ident)
      * Be prepared for "postfix reload" after "connect".
      */
     if ((anvil_remote =
-	 (ANVIL_REMOTE *) htable_find(anvil_remote_map, ident)) == 0) {
+	 (ANVIL_REMOTE *) ohtable_find(anvil_remote_map, ident)) == 0) {
 	rate = 0;
     }
 
@@ -832,7 +877,7 @@ static void anvil_remote_disconnect(VSTREAM *client_stream, const char *ident)
      */
     if ((anvil_local = (ANVIL_LOCAL *) vstream_context(client_stream)) != 0
 	&& (anvil_remote =
-	    (ANVIL_REMOTE *) htable_find(anvil_remote_map, ident)) != 0
+	    (ANVIL_REMOTE *) ohtable_find(anvil_remote_map, ident)) != 0
 	&& ANVIL_LOCAL_REMOTE_LINKED(anvil_local, anvil_remote)) {
 	ANVIL_REMOTE_DROP_ONE(anvil_remote);
 	ANVIL_LOCAL_DROP_ONE(anvil_local, anvil_remote);
@@ -882,6 +927,24 @@ static void anvil_service_done(VSTREAM *client_stream, char *unused_service,
 
 static void anvil_status_dump(char *unused_name, char **unused_argv)
 {
+    ANVIL_SHM_PEAK peaks[ANVIL_SHM_PEAK_COUNT];
+
+    /*
+     * Include the peak usage in the shared counters.
+     */
+    if (anvil_shm) {
+	anvil_shm_peaks(anvil_shm, peaks);
+	ANVIL_MAX_MERGE(max_conn_rate, peaks[ANVIL_SHM_PEAK_CONN_RATE]);
+	ANVIL_MAX_MERGE(max_conn_count, peaks[ANVIL_SHM_PEAK_CONN_COUNT]);
+	ANVIL_MAX_MERGE(max_mail_rate, peaks[ANVIL_SHM_PEAK_MAIL_RATE]);
+	ANVIL_MAX_MERGE(max_rcpt_rate, peaks[ANVIL_SHM_PEAK_RCPT_RATE]);
+	ANVIL_MAX_MERGE(max_ntls_rate, peaks[ANVIL_SHM_PEAK_NTLS_RATE]);
+	ANVIL_MAX_MERGE(max_auth_rate, peaks[ANVIL_SHM_PEAK_AUTH_RATE]);
+	if (peaks[ANVIL_SHM_PEAK_CACHE_SIZE].value > max_cache_size) {
+	    max_cache_size = peaks[ANVIL_SHM_PEAK_CACHE_SIZE].value;
+	    max_cache_time = peaks[ANVIL_SHM_PEAK_CACHE_SIZE].when;
+	}
+    }
     ANVIL_MAX_RATE_REPORT(max_conn_rate, "connection");
     ANVIL_MAX_COUNT_REPORT(max_conn_count, "connection");
     ANVIL_MAX_RATE_REPORT(max_mail_rate, "message");
@@ -904,6 +967,25 @@ static void anvil_status_update(int unused_event, void *context)
     event_request_timer(anvil_status_update, context, var_anvil_stat_time);
 }
 
+/* anvil_shm_event - maintain shared counters periodically */
+
+static void anvil_shm_event(int unused_event, void *context)
+{
+    anvil_shm_maintain(anvil_shm, var_anvil_time_unit);
+    event_request_timer(anvil_shm_event, context, ANVIL_SHM_TICK);
+}
+
+/* anvil_exit - log extreme usage, stop shared counter maintenance */
+
+static void anvil_exit(char *unused_name, char **unused_argv)
+{
+    anvil_status_dump((char *) 0, (char **) 0);
+    if (anvil_shm) {
+	anvil_shm_close(anvil_shm);
+	anvil_shm = 0;
+    }
+}
+
 /* anvil_service - perform service for client */
 
 static void anvil_service(VSTREAM *client_stream, char *unused_service, char **argv)
@@ -972,6 +1054,26 @@ static void anvil_service(VSTREAM *client_stream, char *unused_service, char **a
 	msg_info("--- end request ---");
 }
 
+/* pre_jail_init - pre-jail initialization */
+
+static void pre_jail_init(char *unused_name, char **unused_argv)
+{
+    char   *path;
+
+    /*
+     * Open the shared counters before going to jail. Don't create a
+     * root-owned file.
+     */
+    if (var_anvil_shm_enable) {
+	path = concatenate(var_data_dir, "/", ANVIL_SHM_FILE, (char *) 0);
+	SAVE_AND_SET_EUGID(var_owner_uid, var_owner_gid);
+	anvil_shm = anvil_shm_open(path, var_anvil_shm_size,
+				   ANVIL_SHM_FLAG_OWNER);
+	RESTORE_SAVED_EUGID();
+	myfree(path);
+    }
+}
+
 /* post_jail_init - post-jail initialization */
 
 static void post_jail_init(char *unused_name, char **unused_argv)
@@ -985,7 +1087,7 @@ static void post_jail_init(char *unused_name, char **unused_argv)
     /*
      * Initial client state tables.
      */
-    anvil_remote_map = htable_create(1000);
+    anvil_remote_map = ohtable_create(1000);
 
     /*
      * Do not limit the number of client requests.
@@ -997,6 +1099,15 @@ static void post_jail_init(char *unused_name, char **unused_argv)
      */
     if (var_idle_limit < var_anvil_time_unit)
 	var_idle_limit = var_anvil_time_unit;
+
+    /*
+     * Start maintaining the shared counters. SMTP server processes that use
+     * them don't talk to us, so don't exit when idle.
+     */
+    if (anvil_shm) {
+	anvil_shm_event(0, (void *) 0);
+	var_idle_limit = 0;
+    }
 }
 
 MAIL_VERSION_STAMP_DECLARE;
@@ -1018,9 +1129,10 @@ int     main(int argc, char **argv)
 
     multi_server_main(argc, argv, anvil_service,
 		      CA_MAIL_SERVER_TIME_TABLE(time_table),
+		      CA_MAIL_SERVER_PRE_INIT(pre_jail_init),
 		      CA_MAIL_SERVER_POST_INIT(post_jail_init),
 		      CA_MAIL_SERVER_SOLITARY,
 		      CA_MAIL_SERVER_PRE_DISCONN(anvil_service_done),
-		      CA_MAIL_SERVER_EXIT(anvil_status_dump),
+		      CA_MAIL_SERVER_EXIT(anvil_exit),
 		      0);
 }
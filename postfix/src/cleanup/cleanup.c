@@ -195,6 +195,16 @@
 /*	Optional list of \fIname=value\fR pairs that specify default
 /*	values for arbitrary macros that Postfix may send to Milter
 /*	applications.
+/* .PP
+/*	Available in Postfix version 3.2 and later:
+/* .IP "\fBmilter_body_pipeline_limit (1)\fR"
+/*	The maximal number of message body chunks that the Postfix
+/*	MTA sends to a Milter (mail filter) application before it
+/*	waits for a response.
+/* .IP "\fBmilter_parallel_events (no)\fR"
+/*	Send each SMTP command event to all Milter (mail filter)
+/*	applications that don't modify messages, before waiting for
+/*	their responses.
 /* MIME PROCESSING CONTROLS
 /* .ad
 /* .fi
@@ -393,6 +403,15 @@
 /*	Available in Postfix version 2.1 and later:
 /* .IP "\fBenable_original_recipient (yes)\fR"
 /*	Enable support for the X-Original-To message header.
+/* .PP
+/*	Available in Postfix version 3.2 and later:
+/* .IP "\fBcleanup_group_commit_enable (no)\fR"
+/*	Share the cost of making queue files durable with other
+/*	cleanup(8) processes, by synchronizing the queue file system
+/*	once for all queue files that are waiting.
+/* .IP "\fBdata_directory (see 'postconf -d' output)\fR"
+/*	The directory with Postfix-writable data files (for example:
+/*	caches, pseudo-random numbers).
 /* FILES
 /*	/etc/postfix/canonical*, canonical mapping table
 /*	/etc/postfix/virtual*, virtual mapping table
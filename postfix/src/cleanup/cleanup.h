@@ -20,6 +20,7 @@
 #include <vstream.h>
 #include <argv.h>
 #include <nvtable.h>
+#include <arena.h>
 
  /*
   * Global library.
@@ -28,6 +29,7 @@
 #include <tok822.h>
 #include <been_here.h>
 #include <mail_stream.h>
+#include <rec_batch.h>
 #include <mail_conf.h>
 #include <mime_state.h>
 #include <string_list.h>
@@ -51,6 +53,7 @@ typedef struct CLEANUP_STATE {
     VSTRING *stripped_buf;		/* character stripped input */
     VSTREAM *src;			/* current input stream */
     VSTREAM *dst;			/* current output stream */
+    REC_BATCH *batch;			/* batched output, or null */
     MAIL_STREAM *handle;		/* mail stream handle */
     char   *queue_name;			/* queue name */
     char   *queue_id;			/* queue file basename */
@@ -131,6 +134,8 @@ typedef struct CLEANUP_STATE {
      * Internationalization.
      */
     int     smtputf8;			/* what support is desired */
+    ARENA  *arena;			/* per-message strings */
+    long    malloc_calls;		/* allocator calls before message */
 } CLEANUP_STATE;
 
  /*
@@ -231,6 +236,8 @@ extern void cleanup_out(CLEANUP_STATE *, int, const char *, ssize_t);
 extern void cleanup_out_string(CLEANUP_STATE *, int, const char *);
 extern void PRINTFLIKE(3, 4) cleanup_out_format(CLEANUP_STATE *, int, const char *,...);
 extern void cleanup_out_header(CLEANUP_STATE *, VSTRING *);
+extern void cleanup_out_batch_start(CLEANUP_STATE *);
+extern void cleanup_out_batch_flush(CLEANUP_STATE *);
 
 #define CLEANUP_OUT_BUF(s, t, b) \
 	cleanup_out((s), (t), vstring_str((b)), VSTRING_LEN((b)))
@@ -106,11 +106,14 @@
 off_t   cleanup_addr_sender(CLEANUP_STATE *state, const char *buf)
 {
     const char myname[] = "cleanup_addr_sender";
-    VSTRING *clean_addr = vstring_alloc(100);
+    static VSTRING *clean_addr;
     off_t   after_sender_offs = 0;
     const char *bcc;
     size_t  len;
 
+    if (clean_addr == 0)
+	clean_addr = vstring_alloc(100);
+
     /*
      * Note: an unqualified envelope address is for all practical purposes
      * equivalent to a fully qualified local address, both for delivery and
@@ -150,9 +153,8 @@ off_t   cleanup_addr_sender(CLEANUP_STATE *state, const char *buf)
 	    state->smtputf8 |= SMTPUTF8_FLAG_REQUESTED;
     }
     CLEANUP_OUT_BUF(state, REC_TYPE_FROM, clean_addr);
-    if (state->sender)				/* XXX Can't happen */
-	myfree(state->sender);
-    state->sender = mystrdup(STR(clean_addr));	/* Used by Milter client */
+    /* Used by Milter client. */
+    state->sender = arena_strdup(state->arena, STR(clean_addr));
     /* Fix 20160310: Moved from cleanup_envelope.c. */
     if (state->milters || cleanup_milters) {
 	/* Make room to replace sender. */
@@ -175,7 +177,6 @@ off_t   cleanup_addr_sender(CLEANUP_STATE *state, const char *buf)
 	    state->errs |= CLEANUP_STAT_WRITE;
 	}
     }
-    vstring_free(clean_addr);
     return after_sender_offs;
 }
 
@@ -183,9 +184,12 @@ off_t   cleanup_addr_sender(CLEANUP_STATE *state, const char *buf)
 
 void    cleanup_addr_recipient(CLEANUP_STATE *state, const char *buf)
 {
-    VSTRING *clean_addr = vstring_alloc(100);
+    static VSTRING *clean_addr;
     const char *bcc;
 
+    if (clean_addr == 0)
+	clean_addr = vstring_alloc(100);
+
     /*
      * Note: an unqualified envelope address is for all practical purposes
      * equivalent to a fully qualified local address, both for delivery and
@@ -238,7 +242,6 @@ void    cleanup_addr_recipient(CLEANUP_STATE *state, const char *buf)
 	    state->errs |= CLEANUP_STAT_WRITE;
 	}
     }
-    vstring_free(clean_addr);
 }
 
 /* cleanup_addr_bcc_dsn - process automatic BCC recipient */
@@ -246,7 +249,10 @@ void    cleanup_addr_recipient(CLEANUP_STATE *state, const char *buf)
 void    cleanup_addr_bcc_dsn(CLEANUP_STATE *state, const char *bcc,
 			             const char *dsn_orcpt, int dsn_notify)
 {
-    VSTRING *clean_addr = vstring_alloc(100);
+    static VSTRING *clean_addr;
+
+    if (clean_addr == 0)
+	clean_addr = vstring_alloc(100);
 
     /*
      * Note: BCC addresses are supplied locally, and must be rewritten in the
@@ -275,5 +281,4 @@ void    cleanup_addr_bcc_dsn(CLEANUP_STATE *state, const char *bcc,
     }
     cleanup_out_recipient(state, dsn_orcpt, dsn_notify,
 			  STR(clean_addr), STR(clean_addr));
-    vstring_free(clean_addr);
 }
@@ -253,6 +253,12 @@ static void cleanup_envelope_process(CLEANUP_STATE *state, int type,
 						 + var_delay_warn_time));
 	}
 	state->flags |= CLEANUP_FLAG_INRCPT;
+
+	/*
+	 * Recipient records come in large numbers. Write them in batches
+	 * until the end of the initial envelope.
+	 */
+	cleanup_out_batch_start(state);
     }
 
     /*
@@ -329,6 +335,7 @@ static void cleanup_envelope_process(CLEANUP_STATE *state, int type,
     if (type == REC_TYPE_MESG) {
 	state->action = cleanup_message;
 	if (state->flags & CLEANUP_FLAG_INRCPT) {
+	    cleanup_out_batch_flush(state);
 	    if (state->milters || cleanup_milters) {
 		/* Make room to append recipient. */
 		if ((state->append_rcpt_pt_offset = vstream_ftell(state->dst)) < 0)
@@ -374,7 +381,7 @@ static void cleanup_envelope_process(CLEANUP_STATE *state, int type,
     if (type == REC_TYPE_FULL) {
 	/* First instance wins. */
 	if (state->fullname == 0) {
-	    state->fullname = mystrdup(buf);
+	    state->fullname = arena_strdup(state->arena, buf);
 	    cleanup_out(state, type, buf, len);
 	}
 	return;
@@ -419,7 +426,7 @@ static void cleanup_envelope_process(CLEANUP_STATE *state, int type,
 	    state->errs |= CLEANUP_STAT_BAD;
 	    return;
 	}
-	state->dsn_envid = mystrdup(mapped_buf);
+	state->dsn_envid = arena_strdup(state->arena, mapped_buf);
 	cleanup_out(state, type, buf, len);
 	return;
     }
@@ -460,7 +467,7 @@ static void cleanup_envelope_process(CLEANUP_STATE *state, int type,
 		msg_warn("%s: ignoring bad VERP request: \"%.100s\"",
 			 state->queue_id, buf);
 	    } else {
-		state->verp_delims = mystrdup(buf);
+		state->verp_delims = arena_strdup(state->arena, buf);
 		cleanup_out(state, type, buf, len);
 	    }
 	}
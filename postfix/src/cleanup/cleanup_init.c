@@ -83,13 +83,16 @@
 #include <sys_defs.h>
 #include <signal.h>
 #include <string.h>
+#include <unistd.h>
 
 /* Utility library. */
 
 #include <msg.h>
+#include <mymalloc.h>
 #include <iostuff.h>
 #include <name_mask.h>
 #include <stringops.h>
+#include <set_eugid.h>
 
 /* Global library. */
 
@@ -98,6 +101,7 @@
 #include <mail_version.h>		/* milter_macro_v */
 #include <ext_prop.h>
 #include <flush_clnt.h>
+#include <group_sync.h>
 
 /* Application-specific. */
 
@@ -153,6 +157,8 @@ int     var_verp_bounce_off;		/* don't verp the bounces */
 int     var_milt_conn_time;		/* milter connect/handshake timeout */
 int     var_milt_cmd_time;		/* milter command timeout */
 int     var_milt_msg_time;		/* milter content timeout */
+int     var_milt_body_limit;		/* milter body chunks in flight */
+bool    var_milt_parallel;		/* parallel milter events */
 char   *var_milt_protocol;		/* Sendmail 8 milter protocol */
 char   *var_milt_def_action;		/* default milter action */
 char   *var_milt_daemon_name;		/* {daemon_name} macro value */
@@ -171,6 +177,7 @@ char   *var_milt_macro_deflts;		/* default macro settings */
 int     var_auto_8bit_enc_hdr;		/* auto-detect 8bit encoding header */
 int     var_always_add_hdrs;		/* always add missing headers */
 int     var_virt_addrlen_limit;		/* stop exponential growth */
+bool    var_cleanup_group_commit;	/* share queue file fsync() */
 
 const CONFIG_INT_TABLE cleanup_int_table[] = {
     VAR_HOPCOUNT_LIMIT, DEF_HOPCOUNT_LIMIT, &var_hopcount_limit, 1, 0,
@@ -180,6 +187,7 @@ const CONFIG_INT_TABLE cleanup_int_table[] = {
     VAR_VIRT_EXPAN_LIMIT, DEF_VIRT_EXPAN_LIMIT, &var_virt_expan_limit, 1, 0,
     VAR_VIRT_ADDRLEN_LIMIT, DEF_VIRT_ADDRLEN_LIMIT, &var_virt_addrlen_limit, 1, 0,
     VAR_BODY_CHECK_LEN, DEF_BODY_CHECK_LEN, &var_body_check_len, 0, 0,
+    VAR_MILT_BODY_LIMIT, DEF_MILT_BODY_LIMIT, &var_milt_body_limit, 1, 0,
     0,
 };
 
@@ -188,6 +196,8 @@ const CONFIG_BOOL_TABLE cleanup_bool_table[] = {
     VAR_VERP_BOUNCE_OFF, DEF_VERP_BOUNCE_OFF, &var_verp_bounce_off,
     VAR_AUTO_8BIT_ENC_HDR, DEF_AUTO_8BIT_ENC_HDR, &var_auto_8bit_enc_hdr,
     VAR_ALWAYS_ADD_HDRS, DEF_ALWAYS_ADD_HDRS, &var_always_add_hdrs,
+    VAR_CLEANUP_GROUP_COMMIT, DEF_CLEANUP_GROUP_COMMIT, &var_cleanup_group_commit,
+    VAR_MILT_PARALLEL, DEF_MILT_PARALLEL, &var_milt_parallel,
     0,
 };
 
@@ -408,6 +418,8 @@ void    cleanup_pre_jail(char *unused_name, char **unused_argv)
 					var_milt_conn_time,
 					var_milt_cmd_time,
 					var_milt_msg_time,
+					var_milt_body_limit,
+					var_milt_parallel,
 					var_milt_protocol,
 					var_milt_def_action,
 					var_milt_conn_macros,
@@ -420,6 +432,27 @@ void    cleanup_pre_jail(char *unused_name, char **unused_argv)
 					var_milt_unk_macros,
 					var_milt_macro_deflts);
 
+    /*
+     * Optionally, share the cost of queue file fsync() calls with other
+     * cleanup processes. The shared state is not accessible after entering
+     * the chroot jail. Don't create a root-owned file.
+     */
+    if (var_cleanup_group_commit) {
+	GROUP_SYNC *gs;
+	char   *path;
+
+	path = concatenate(var_data_dir, "/", GROUP_SYNC_FILE, (char *) 0);
+	if (getuid() == 0) {
+	    SAVE_AND_SET_EUGID(var_owner_uid, var_owner_gid);
+	    gs = group_sync_open(path);
+	    RESTORE_SAVED_EUGID();
+	} else {
+	    gs = group_sync_open(path);
+	}
+	myfree(path);
+	if (gs != 0)
+	    mail_stream_group_sync(gs);
+    }
     flush_init();
 }
 
@@ -2429,8 +2429,8 @@ int     main(int unused_argc, char **argv)
     int     istty = isatty(vstream_fileno(VSTREAM_IN));
     CLEANUP_STATE *state = cleanup_state_alloc((VSTREAM *) 0);
 
-    state->queue_id = mystrdup("NOQUEUE");
-    state->sender = mystrdup("sender");
+    state->queue_id = arena_strdup(state->arena, "NOQUEUE");
+    state->sender = arena_strdup(state->arena, "sender");
     state->recip = mystrdup("recipient");
     state->client_name = "client_name";
     state->client_addr = "client_addr";
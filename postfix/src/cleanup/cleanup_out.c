@@ -33,6 +33,12 @@
 /*	void	cleanup_out_header(state, buf)
 /*	CLEANUP_STATE *state;
 /*	VSTRING	*buf;
+/*
+/*	void	cleanup_out_batch_start(state)
+/*	CLEANUP_STATE *state;
+/*
+/*	void	cleanup_out_batch_flush(state)
+/*	CLEANUP_STATE *state;
 /* DESCRIPTION
 /*	This module writes records to the output stream.
 /*
@@ -55,6 +61,17 @@
 /*	cleanup_out_header() outputs a multi-line header as records
 /*	of the specified type. The input is expected to be newline
 /*	separated (not newline terminated), and is modified.
+/*
+/*	cleanup_out_batch_start() collects the output from the above
+/*	routines in memory, and writes it with a few large gathered
+/*	writes. This is used for the recipient records of a large
+/*	envelope. The caller must not call vstream_ftell() or
+/*	vstream_fseek() on the output stream, or write to it directly,
+/*	before calling cleanup_out_batch_flush().
+/*
+/*	cleanup_out_batch_flush() writes the pending output and
+/*	terminates batched output. This is a null operation when
+/*	batched output is not active.
 /* LICENSE
 /* .ad
 /* .fi
@@ -85,6 +102,7 @@
 /* Global library. */
 
 #include <record.h>
+#include <rec_batch.h>
 #include <rec_type.h>
 #include <cleanup_user.h>
 #include <mail_params.h>
@@ -97,6 +115,29 @@
 
 #define STR	vstring_str
 
+ /*
+  * Batched output, reused for the next message.
+  */
+static REC_BATCH *cleanup_batch;
+
+#define CLEANUP_REC_PUT(s, t, b, l) ((s)->batch ? \
+	rec_batch_put((s)->dst, (s)->batch, (t), (b), (l)) : \
+	rec_put((s)->dst, (t), (b), (l)))
+
+/* cleanup_out_error - report output error */
+
+static void cleanup_out_error(CLEANUP_STATE *state)
+{
+    if (errno == EFBIG) {
+	msg_warn("%s: queue file size limit exceeded",
+		 state->queue_id);
+	state->errs |= CLEANUP_STAT_SIZE;
+    } else {
+	msg_warn("%s: write queue file: %m", state->queue_id);
+	state->errs |= CLEANUP_STAT_WRITE;
+    }
+}
+
 /* cleanup_out - output one single record */
 
 void    cleanup_out(CLEANUP_STATE *state, int type, const char *string, ssize_t len)
@@ -122,25 +163,17 @@ void    cleanup_out(CLEANUP_STATE *state, int type, const char *string, ssize_t
 	msg_panic("cleanup_out: bad line length limit: %d", var_line_limit);
     do {
 	if (len > var_line_limit && TEXT_RECORD(type)) {
-	    err = rec_put(state->dst, REC_TYPE_CONT, string, var_line_limit);
+	    err = CLEANUP_REC_PUT(state, REC_TYPE_CONT, string, var_line_limit);
 	    string += var_line_limit;
 	    len -= var_line_limit;
 	} else {
-	    err = rec_put(state->dst, type, string, len);
+	    err = CLEANUP_REC_PUT(state, type, string, len);
 	    break;
 	}
     } while (len > 0 && err >= 0);
 
-    if (err < 0) {
-	if (errno == EFBIG) {
-	    msg_warn("%s: queue file size limit exceeded",
-		     state->queue_id);
-	    state->errs |= CLEANUP_STAT_SIZE;
-	} else {
-	    msg_warn("%s: write queue file: %m", state->queue_id);
-	    state->errs |= CLEANUP_STAT_WRITE;
-	}
-    }
+    if (err < 0)
+	cleanup_out_error(state);
 }
 
 /* cleanup_out_string - output string to one single record */
@@ -223,3 +256,27 @@ void    cleanup_out_header(CLEANUP_STATE *state, VSTRING *header_buf)
 	}
     }
 }
+
+/* cleanup_out_batch_start - start batched output */
+
+void    cleanup_out_batch_start(CLEANUP_STATE *state)
+{
+    if (cleanup_batch == 0)
+	cleanup_batch = rec_batch_create(0);
+    state->batch = cleanup_batch;
+}
+
+/* cleanup_out_batch_flush - write pending output, stop batching */
+
+void    cleanup_out_batch_flush(CLEANUP_STATE *state)
+{
+    REC_BATCH *batch;
+
+    if ((batch = state->batch) != 0) {
+	state->batch = 0;
+	if (CLEANUP_OUT_OK(state) == 0)
+	    REC_BATCH_RESET(batch);
+	else if (rec_batch_flush(state->dst, batch) < 0)
+	    cleanup_out_error(state);
+    }
+}
@@ -92,16 +92,18 @@ int     cleanup_rewrite_external(const char *context_name, VSTRING *result,
 
 int    cleanup_rewrite_tree(const char *context_name, TOK822 *tree)
 {
-    VSTRING *dst = vstring_alloc(100);
-    VSTRING *src = vstring_alloc(100);
+    static VSTRING *dst;
+    static VSTRING *src;
     int     did_rewrite;
 
+    if (dst == 0) {
+	dst = vstring_alloc(100);
+	src = vstring_alloc(100);
+    }
     tok822_externalize(src, tree->head, TOK822_STR_DEFL);
     did_rewrite = cleanup_rewrite_external(context_name, dst, STR(src));
     tok822_free_tree(tree->head);
     tree->head = tok822_scan(STR(dst), &tree->tail);
-    vstring_free(dst);
-    vstring_free(src);
     return (did_rewrite);
 }
 
@@ -110,14 +112,16 @@ int    cleanup_rewrite_tree(const char *context_name, TOK822 *tree)
 int     cleanup_rewrite_internal(const char *context_name,
 				         VSTRING *result, const char *addr)
 {
-    VSTRING *dst = vstring_alloc(100);
-    VSTRING *src = vstring_alloc(100);
+    static VSTRING *dst;
+    static VSTRING *src;
     int     did_rewrite;
 
+    if (dst == 0) {
+	dst = vstring_alloc(100);
+	src = vstring_alloc(100);
+    }
     quote_822_local(src, addr);
     did_rewrite = cleanup_rewrite_external(context_name, dst, STR(src));
     unquote_822_local(result, STR(dst));
-    vstring_free(dst);
-    vstring_free(src);
     return (did_rewrite);
 }
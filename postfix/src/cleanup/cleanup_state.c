@@ -17,8 +17,12 @@
 /*	message.
 /*
 /*	cleanup_state_alloc() initializes the per-message state variables.
+/*	Strings that live as long as the message are allocated from
+/*	state->arena.
 /*
-/*	cleanup_state_free() cleans up.
+/*	cleanup_state_free() cleans up. With verbose logging, it
+/*	reports the number of memory allocator calls for the message.
+/*	The arena is kept for the next message.
 /* LICENSE
 /* .ad
 /* .fi
@@ -36,6 +40,7 @@
 
 /* Utility library. */
 
+#include <msg.h>
 #include <mymalloc.h>
 #include <vstring.h>
 #include <htable.h>
@@ -55,12 +60,22 @@
 
 #include "cleanup.h"
 
+ /*
+  * Arena for the next message.
+  */
+static ARENA *cleanup_arena;
+
 /* cleanup_state_alloc - initialize global state */
 
 CLEANUP_STATE *cleanup_state_alloc(VSTREAM *src)
 {
     CLEANUP_STATE *state = (CLEANUP_STATE *) mymalloc(sizeof(*state));
 
+    state->malloc_calls = MYMALLOC_CALLS();
+    if ((state->arena = cleanup_arena) != 0)
+	cleanup_arena = 0;
+    else
+	state->arena = arena_create(0);
     state->attr_buf = vstring_alloc(10);
     state->temp1 = vstring_alloc(10);
     state->temp2 = vstring_alloc(10);
@@ -68,6 +83,7 @@ CLEANUP_STATE *cleanup_state_alloc(VSTREAM *src)
 	state->stripped_buf = vstring_alloc(10);
     state->src = src;
     state->dst = 0;
+    state->batch = 0;
     state->handle = 0;
     state->queue_name = 0;
     state->queue_id = 0;
@@ -139,15 +155,15 @@ CLEANUP_STATE *cleanup_state_alloc(VSTREAM *src)
 
 void    cleanup_state_free(CLEANUP_STATE *state)
 {
+    if (msg_verbose)
+	msg_info("%s: %ld allocator calls", state->queue_id ?
+		 state->queue_id : "cleanup_state_free",
+		 MYMALLOC_CALLS() - state->malloc_calls);
     vstring_free(state->attr_buf);
     vstring_free(state->temp1);
     vstring_free(state->temp2);
     if (cleanup_strip_chars)
 	vstring_free(state->stripped_buf);
-    if (state->fullname)
-	myfree(state->fullname);
-    if (state->sender)
-	myfree(state->sender);
     if (state->recip)
 	myfree(state->recip);
     if (state->orig_rcpt)
@@ -159,10 +175,6 @@ void    cleanup_state_free(CLEANUP_STATE *state)
     argv_free(state->auto_hdrs);
     if (state->hbc_rcpt)
 	argv_free(state->hbc_rcpt);
-    if (state->queue_name)
-	myfree(state->queue_name);
-    if (state->queue_id)
-	myfree(state->queue_id);
     been_here_free(state->dups);
     if (state->reason)
 	myfree(state->reason);
@@ -175,12 +187,8 @@ void    cleanup_state_free(CLEANUP_STATE *state)
 	myfree(state->filter);
     if (state->redirect)
 	myfree(state->redirect);
-    if (state->dsn_envid)
-	myfree(state->dsn_envid);
     if (state->dsn_orcpt)
 	myfree(state->dsn_orcpt);
-    if (state->verp_delims)
-	myfree(state->verp_delims);
     if (state->milters)
 	milter_free(state->milters);
     if (state->milter_ext_from)
@@ -190,5 +198,13 @@ void    cleanup_state_free(CLEANUP_STATE *state)
     if (state->milter_err_text)
 	vstring_free(state->milter_err_text);
     cleanup_region_done(state);
+    if (state->batch)
+	REC_BATCH_RESET(state->batch);
+    if (cleanup_arena == 0) {
+	arena_reset(state->arena);
+	cleanup_arena = state->arena;
+    } else {
+	arena_free(state->arena);
+    }
     myfree((void *) state);
 }
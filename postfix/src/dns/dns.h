@@ -239,6 +239,37 @@ extern int dns_lookup_rv(const char *, unsigned, DNS_RR **, VSTRING *,
     dns_lookup_rv((name), (rflags), (list), (fqdn), (why), (int *) 0, \
 	(lflags), (ltype))
 
+#define DNS_LOOKUP_MAX_TYPES	10	/* dns_lookup_l() type list limit */
+
+#ifdef LIBDNS_INTERNAL
+extern int dns_lookup_reply(const char *, const char *, unsigned, unsigned,
+			            unsigned char *, int, DNS_RR **, VSTRING *,
+			            VSTRING *, int *, unsigned, char *, int,
+			            int *);
+
+#endif
+
+ /*
+  * dns_async.c
+  */
+typedef struct DNS_ASYNC DNS_ASYNC;
+typedef void (*DNS_ASYNC_FN) (int, DNS_RR *, const char *, const char *,
+				              int, void *);
+
+extern int dns_async_init(void);
+extern DNS_ASYNC *dns_async_lookup(const char *, unsigned, unsigned,
+				           unsigned, DNS_ASYNC_FN, void *);
+extern void dns_async_cancel(DNS_ASYNC *);
+extern void dns_async_wait(void);
+extern int dns_async_prefetch(const char *, unsigned, unsigned, unsigned *);
+extern void dns_async_flush(const char *);
+
+#ifdef LIBDNS_INTERNAL
+extern int dns_async_claim(const char *, unsigned, unsigned, unsigned,
+			           DNS_RR **, VSTRING *, VSTRING *, int *, int *);
+
+#endif
+
  /*
   * Request flags.
   */
@@ -247,6 +278,7 @@ extern int dns_lookup_rv(const char *, unsigned, DNS_RR **, VSTRING *,
 #define DNS_REQ_FLAG_STOP_NULLMX (1<<2)
 #define DNS_REQ_FLAG_STOP_MX_POLICY (1<<3)
 #define DNS_REQ_FLAG_NCACHE_TTL	(1<<4)
+#define DNS_REQ_FLAG_NO_BLOCK	(1<<5)
 #define DNS_REQ_FLAG_NONE	(0)
 
  /*
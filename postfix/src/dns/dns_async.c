@@ -0,0 +1,993 @@
+/*++
+/* NAME
+/*	dns_async 3
+/* SUMMARY
+/*	non-blocking domain name service lookup
+/* SYNOPSIS
+/*	#include <dns.h>
+/*
+/*	DNS_ASYNC *dns_async_lookup(name, type, rflags, lflags,
+/*					callback, context)
+/*	const char *name;
+/*	unsigned type;
+/*	unsigned rflags;
+/*	unsigned lflags;
+/*	void	(*callback)(int status, DNS_RR *list, const char *fqdn,
+/*				const char *why, int rcode, void *context);
+/*	void	*context;
+/*
+/*	int	dns_async_init()
+/*
+/*	void	dns_async_cancel(request)
+/*	DNS_ASYNC *request;
+/*
+/*	void	dns_async_wait()
+/*
+/*	int	dns_async_prefetch(name, rflags, lflags, types)
+/*	const char *name;
+/*	unsigned rflags;
+/*	unsigned lflags;
+/*	unsigned *types;
+/*
+/*	void	dns_async_flush(name)
+/*	const char *name;
+/* AUXILIARY FUNCTIONS
+/*	int	dns_async_claim(name, type, rflags, lflags, list, fqdn, why,
+/*				rcode, status)
+/*	const char *name;
+/*	unsigned type;
+/*	unsigned rflags;
+/*	unsigned lflags;
+/*	DNS_RR	**list;
+/*	VSTRING *fqdn;
+/*	VSTRING *why;
+/*	int	*rcode;
+/*	int	*status;
+/* DESCRIPTION
+/*	This module sends DNS queries over UDP to the name servers
+/*	that are listed in the resolver configuration, without
+/*	waiting for the reply. Many queries may be outstanding at
+/*	the same time. Replies are parsed with the same code as
+/*	dns_lookup(3), and results are reported with the same status
+/*	codes and DNS_RR lists.
+/*
+/*	dns_async_lookup() starts a lookup of the specified resource
+/*	type for the specified name, and returns a handle that can
+/*	be used to cancel the request. The name, type, rflags and
+/*	lflags arguments are as with dns_lookup(3); CNAME chains
+/*	are followed, up to the same limit.  When the lookup
+/*	completes, the callback function is invoked with the
+/*	dns_lookup() status, the list of resource records (which
+/*	the callback must pass to dns_rr_free()), the fully-qualified
+/*	name and the reason for failure (which are valid only during
+/*	the call), and the reply RCODE. The request handle is no
+/*	longer valid after the call. When no name server replies
+/*	in time, the status is DNS_RETRY and the RCODE is SERVFAIL.
+/*
+/*	Reply processing is driven by the event(3) loop: the
+/*	module registers its socket with event_enable_read(), and
+/*	uses event_request_timer() for retransmission.  The callback
+/*	is never invoked from within dns_async_lookup().
+/*
+/*	When the lflags argument includes DNS_REQ_FLAG_NO_BLOCK,
+/*	a lookup that cannot be completed without blocking (see
+/*	BUGS below) fails with DNS_RETRY, instead of being handed
+/*	to dns_lookup(3).  This is for event-driven programs such
+/*	as postscreen(8) that serve many clients at the same time.
+/*
+/*	dns_async_init() reads the resolver configuration, opens
+/*	the system random source, and returns the number of name
+/*	servers that can be queried without blocking. This function
+/*	is called implicitly by the other functions in this module;
+/*	a program should call it explicitly before it enters a
+/*	chroot jail.
+/*
+/*	dns_async_cancel() cancels a pending request. The callback
+/*	will not be invoked.
+/*
+/*	dns_async_wait() processes replies and timeouts until no
+/*	request is pending, without running the event loop. This
+/*	is for programs such as smtp(8) and smtpd(8) that serve
+/*	one client at a time, and that want to overlap a number of
+/*	lookups.
+/*
+/*	dns_async_prefetch() starts lookups for the specified
+/*	name and the specified zero-terminated list of resource
+/*	types, unless the same lookup was started earlier. The
+/*	result is the number of lookups that were started; this is
+/*	zero when the dns_parallel_lookup_enable parameter is off,
+/*	or when a lookup cannot be done without blocking. The caller
+/*	should invoke dns_async_wait() after all lookups have been
+/*	started; dns_lookup(3) will then pick up the results.
+/*
+/*	dns_async_flush() discards the results of dns_async_prefetch()
+/*	for the specified name, or for all names when the name is
+/*	a null pointer, including lookups that are still in progress.
+/*
+/*	dns_async_claim() is called by dns_lookup(3) to look for
+/*	a completed dns_async_prefetch() result with the specified
+/*	name, type, rflags and lflags. When one is found, the result
+/*	is removed from the list, the list, fqdn, why, rcode and
+/*	status arguments are updated as with dns_lookup(), and the
+/*	function returns non-zero.
+/* BUGS
+/*	Queries are sent to IPv4 name servers only. When the
+/*	resolver configuration has no IPv4 name server, when a UDP
+/*	reply is truncated, or when a name server does not support
+/*	EDNS0 for a DNSSEC query, the lookup is done with the
+/*	blocking dns_lookup(3) function instead, at the time that
+/*	the result would have been reported, unless the request
+/*	specifies DNS_REQ_FLAG_NO_BLOCK. The same is done for
+/*	requests with RES_DNSRCH or RES_DEFNAMES, because this
+/*	module sends only the name as specified.
+/*
+/*	As with res_send(), the AD (authenticated data) bit in a
+/*	reply is ignored unless resolv.conf specifies "options
+/*	trust-ad" (RES_TRUSTAD), on systems that support that option.
+/*
+/*	Query IDs are read from the system random source (see
+/*	PREFERRED_RAND_SOURCE in sys_defs.h), and each query ID
+/*	is sent from a new socket, so that the kernel picks a new
+/*	source port, as with res_send(). When the random source
+/*	is not available, all lookups are blocking. Each pending
+/*	request uses one file descriptor.
+/*
+/*	dns_async_wait() also completes requests that were made
+/*	with dns_async_lookup(), and a program should not mix the
+/*	two styles of use.
+/* SEE ALSO
+/*	dns_lookup(3), domain name service lookup
+/*	events(3), event manager
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*
+/*	Wietse Venema
+/*	Google, Inc.
+/*	111 8th Avenue
+/*	New York, NY 10011, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+
+#if defined(USE_SYSV_POLL) || defined(USE_SYSV_POLL_THEN_SELECT)
+#include <poll.h>
+#endif
+
+#ifdef USE_SYS_SELECT_H
+#include <sys/select.h>
+#endif
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <vstring.h>
+#include <events.h>
+#include <iostuff.h>
+#include <ring.h>
+#include <valid_hostname.h>
+
+/* Global library. */
+
+#include <mail_params.h>
+
+/* DNS library. */
+
+#define LIBDNS_INTERNAL
+#include "dns.h"
+
+/* Application-specific. */
+
+#define DNS_ASYNC_QUERY_SIZE	512	/* name + fixed data */
+#define DNS_ASYNC_REPLY_SIZE	4096
+#define DNS_ASYNC_MAX_SERVERS	3	/* as MAXNS */
+#define DNS_ASYNC_MAX_CNAME	10	/* as dns_lookup() */
+#define DNS_ASYNC_EDNS_SIZE	1200	/* advertised UDP reply size */
+
+#ifndef T_OPT
+#define T_OPT		41		/* [RFC6891] */
+#endif
+
+ /*
+  * One request.
+  */
+struct DNS_ASYNC {
+    RING    ring;			/* linkage */
+    char   *orig_name;			/* name as requested */
+    char    name[DNS_NAME_LEN];		/* current query name */
+    unsigned type;			/* T_A, T_MX, etc. */
+    unsigned rflags;			/* RES_DEBUG etc. */
+    unsigned lflags;			/* DNS_REQ_FLAG_NCACHE_TTL etc. */
+    unsigned qflags;			/* flags for current query */
+    int     maybe_secure;		/* CNAME chain was validated */
+    int     cname_count;		/* CNAME indirections */
+    unsigned qid;			/* query ID */
+    int     sock;			/* UDP socket for this query ID */
+    unsigned char query[DNS_ASYNC_QUERY_SIZE];	/* query packet */
+    int     query_len;			/* query packet length */
+    int     server;			/* current name server */
+    int     tries;			/* transmissions so far */
+    time_t  deadline;			/* retransmission time */
+    int     blocking;			/* use dns_lookup() */
+    VSTRING *fqdn;			/* fully-qualified name */
+    DNS_ASYNC_FN callback;		/* completion routine */
+    void   *context;			/* application context */
+};
+
+#define RING_TO_DNS_ASYNC(p) RING_TO_APPL((p), DNS_ASYNC, ring)
+
+static RING dns_async_pending;		/* pending requests */
+static int dns_async_count;		/* number of pending requests */
+static struct sockaddr_in dns_async_servers[DNS_ASYNC_MAX_SERVERS];
+static int dns_async_nservers = -1;	/* not initialized */
+static VSTRING *dns_async_why;		/* reason for failure */
+
+ /*
+  * Query IDs must be hard to guess.
+  */
+static int dns_async_rand_fd = -1;	/* random source */
+static unsigned char dns_async_rand_buf[256];	/* unused random bytes */
+static ssize_t dns_async_rand_len;	/* amount of unused random bytes */
+
+ /*
+  * The results of dns_async_prefetch().
+  */
+typedef struct DNS_PREFETCH {
+    RING    ring;			/* linkage */
+    char   *name;			/* query name */
+    unsigned type;			/* T_A, T_MX, etc. */
+    unsigned rflags;			/* RES_DEBUG etc. */
+    unsigned lflags;			/* DNS_REQ_FLAG_NCACHE_TTL etc. */
+    DNS_ASYNC *request;			/* null when completed */
+    int     status;			/* dns_lookup() result */
+    DNS_RR *rr;				/* resource records */
+    char   *fqdn;			/* fully-qualified name */
+    char   *why;			/* reason for failure */
+    int     rcode;			/* reply RCODE */
+    int     herrno;			/* h_errno after lookup */
+} DNS_PREFETCH;
+
+#define RING_TO_DNS_PREFETCH(p) RING_TO_APPL((p), DNS_PREFETCH, ring)
+
+static RING dns_prefetch_list;		/* prefetch results */
+
+static void dns_async_event(int, void *);
+static void dns_async_timer(int, void *);
+
+/* dns_async_init - one-time initialization */
+
+int     dns_async_init(void)
+{
+    int     n;
+
+    if (dns_async_nservers >= 0)
+	return (dns_async_nservers);
+
+    ring_init(&dns_async_pending);
+    ring_init(&dns_prefetch_list);
+    dns_async_why = vstring_alloc(100);
+    dns_async_nservers = 0;
+
+    /*
+     * Open the random source now. It may not be accessible after the
+     * process enters a chroot jail. Without it, all lookups are blocking.
+     */
+#ifdef PREFERRED_RAND_SOURCE
+    if (strncmp(PREFERRED_RAND_SOURCE, "dev:", 4) == 0)
+	dns_async_rand_fd = open(PREFERRED_RAND_SOURCE + 4, O_RDONLY, 0);
+#endif
+    if (dns_async_rand_fd < 0) {
+	msg_warn("dns_async_init: no random source for DNS query IDs; "
+		 "using blocking DNS lookups");
+	return (dns_async_nservers);
+    }
+    close_on_exec(dns_async_rand_fd, CLOSE_ON_EXEC);
+
+    /*
+     * Use the same name servers as the stub resolver. Skip servers that we
+     * can't reach with an IPv4 socket.
+     */
+    if ((_res.options & RES_INIT) == 0 && res_init() < 0) {
+	msg_warn("dns_async_init: name service initialization failure");
+	return (dns_async_nservers);
+    }
+    for (n = 0; n < _res.nscount && n < DNS_ASYNC_MAX_SERVERS; n++) {
+	if (_res.nsaddr_list[n].sin_family != AF_INET)
+	    continue;
+	dns_async_servers[dns_async_nservers++] = _res.nsaddr_list[n];
+    }
+    if (msg_verbose)
+	msg_info("dns_async_init: %d name server(s)", dns_async_nservers);
+    return (dns_async_nservers);
+}
+
+/* dns_async_random - unpredictable 16-bit value */
+
+static unsigned dns_async_random(void)
+{
+    if (dns_async_rand_len < 2) {
+	dns_async_rand_len = read(dns_async_rand_fd, dns_async_rand_buf,
+				  sizeof(dns_async_rand_buf));
+	if (dns_async_rand_len < 2)
+	    msg_fatal("dns_async_random: read %s: %s", PREFERRED_RAND_SOURCE,
+		      dns_async_rand_len < 0 ? strerror(errno) : "short read");
+    }
+    dns_async_rand_len -= 2;
+    return ((dns_async_rand_buf[dns_async_rand_len] << 8)
+	    | dns_async_rand_buf[dns_async_rand_len + 1]);
+}
+
+/* dns_async_close - close per-query socket */
+
+static void dns_async_close(DNS_ASYNC *req)
+{
+    if (req->sock >= 0) {
+	event_disable_readwrite(req->sock);
+	(void) close(req->sock);
+	req->sock = -1;
+    }
+}
+
+/* dns_async_schedule - update timer */
+
+static void dns_async_schedule(void)
+{
+    RING   *entry;
+    DNS_ASYNC *req;
+    time_t  now;
+    time_t  deadline;
+    time_t  next = 0;
+
+    if (dns_async_count == 0) {
+	event_cancel_timer(dns_async_timer, (void *) 0);
+	return;
+    }
+    now = time((time_t *) 0);
+    RING_FOREACH(entry, &dns_async_pending) {
+	req = RING_TO_DNS_ASYNC(entry);
+	deadline = (req->blocking ? now : req->deadline);
+	if (next == 0 || deadline < next)
+	    next = deadline;
+    }
+    event_request_timer(dns_async_timer, (void *) 0,
+			next > now ? next - now : 0);
+}
+
+/* dns_async_send - (re)transmit query */
+
+static void dns_async_send(DNS_ASYNC *req)
+{
+    struct sockaddr_in *sin = dns_async_servers + req->server;
+    int     round = req->tries / dns_async_nservers;
+    int     timeout;
+
+    /*
+     * Same retransmission schedule as res_send().
+     */
+    timeout = _res.retrans << round;
+    if (round > 0)
+	timeout /= dns_async_nservers;
+    if (timeout <= 0)
+	timeout = 1;
+    req->deadline = time((time_t *) 0) + timeout;
+    req->tries += 1;
+
+    if (msg_verbose)
+	msg_info("dns_async_send: %s (%s) id=%u try=%d",
+		 req->name, dns_strtype(req->type), req->qid, req->tries);
+    if (sendto(req->sock, (void *) req->query, req->query_len, 0,
+	       (struct sockaddr *) sin, sizeof(*sin)) != req->query_len) {
+	if (msg_verbose)
+	    msg_info("dns_async_send: sendto: %m");
+	req->deadline = 0;			/* try next server */
+    }
+}
+
+/* dns_async_query - prepare and send query for current name */
+
+static int dns_async_query(DNS_ASYNC *req)
+{
+    unsigned char *cp;
+
+    if ((req->query_len = res_mkquery(QUERY, req->name, C_IN, req->type,
+				      (unsigned char *) 0, 0,
+				      (unsigned char *) 0, req->query,
+				      sizeof(req->query))) < 0) {
+	if (msg_verbose)
+	    msg_info("dns_async_query: res_mkquery() failed for %s",
+		     req->name);
+	return (-1);
+    }
+
+    /*
+     * Request DNSSEC validation with an EDNS0 OPT record that has the DO
+     * bit set, as the stub resolver does for RES_USE_DNSSEC.
+     */
+    if (req->qflags & RES_USE_DNSSEC) {
+	if (req->query_len + 11 > sizeof(req->query))
+	    return (-1);
+	cp = req->query + req->query_len;
+	*cp++ = 0;				/* root domain */
+	*cp++ = T_OPT >> 8;
+	*cp++ = T_OPT & 0xff;
+	*cp++ = DNS_ASYNC_EDNS_SIZE >> 8;
+	*cp++ = DNS_ASYNC_EDNS_SIZE & 0xff;
+	*cp++ = 0;				/* extended RCODE */
+	*cp++ = 0;				/* EDNS version */
+	*cp++ = 0x80;				/* DO bit */
+	*cp++ = 0;
+	*cp++ = 0;				/* RDATA length */
+	*cp++ = 0;
+	req->query_len = cp - req->query;
+	((HEADER *) req->query)->arcount = htons(1);
+    }
+
+    /*
+     * Send each query ID from a new socket, so that a spoofed reply has to
+     * guess both the query ID and the source port.
+     */
+    dns_async_close(req);
+    if ((req->sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+	msg_warn("dns_async_query: socket: %m");
+	return (-1);
+    }
+    non_blocking(req->sock, NON_BLOCKING);
+    close_on_exec(req->sock, CLOSE_ON_EXEC);
+    event_enable_read(req->sock, dns_async_event, (void *) req);
+    req->qid = dns_async_random();
+    ((HEADER *) req->query)->id = htons(req->qid);
+    req->server = 0;
+    req->tries = 0;
+    dns_async_send(req);
+    return (0);
+}
+
+/* dns_async_done - report result and destroy request */
+
+static void dns_async_done(DNS_ASYNC *req, int status, DNS_RR *rr, int rcode)
+{
+    ring_detach(&req->ring);
+    dns_async_count -= 1;
+    dns_async_close(req);
+    if (msg_verbose)
+	msg_info("dns_async_done: %s (%s): status %d",
+		 req->orig_name, dns_strtype(req->type), status);
+    req->callback(status, rr, vstring_str(req->fqdn),
+		  vstring_str(dns_async_why), rcode, req->context);
+    vstring_free(req->fqdn);
+    myfree(req->orig_name);
+    myfree((void *) req);
+}
+
+/* dns_async_blocking - complete request with blocking lookup */
+
+static void dns_async_blocking(DNS_ASYNC *req)
+{
+    DNS_RR *rr;
+    int     rcode = 0;
+    int     status;
+
+    VSTRING_RESET(req->fqdn);
+    VSTRING_TERMINATE(req->fqdn);
+    VSTRING_RESET(dns_async_why);
+    VSTRING_TERMINATE(dns_async_why);
+
+    /*
+     * The caller can't afford to wait.
+     */
+    if (req->lflags & DNS_REQ_FLAG_NO_BLOCK) {
+	vstring_sprintf(dns_async_why, "Host or domain name not found. "
+			"Name service error for name=%s type=%s: "
+			"non-blocking lookup is not possible",
+			req->orig_name, dns_strtype(req->type));
+	SET_H_ERRNO(TRY_AGAIN);
+	dns_async_done(req, DNS_RETRY, (DNS_RR *) 0, SERVFAIL);
+	return;
+    }
+    status = dns_lookup_x(req->orig_name, req->type, req->rflags, &rr,
+			  req->fqdn, dns_async_why, &rcode, req->lflags);
+    dns_async_done(req, status, rr, rcode);
+}
+
+/* dns_async_expire - handle timeouts and deferred blocking lookups */
+
+static void dns_async_expire(void)
+{
+    RING   *entry;
+    DNS_ASYNC *req;
+    time_t  now = time((time_t *) 0);
+
+    /*
+     * Start over after each completion, because the application call-back
+     * may add or cancel requests.
+     */
+    for (entry = ring_succ(&dns_async_pending); entry != &dns_async_pending;
+	 /* see below */ ) {
+	req = RING_TO_DNS_ASYNC(entry);
+	entry = ring_succ(entry);
+	if (req->blocking) {
+	    dns_async_blocking(req);
+	} else if (req->deadline > now) {
+	    continue;
+	} else if (req->tries < dns_async_nservers * _res.retry) {
+	    req->server = (req->server + 1) % dns_async_nservers;
+	    dns_async_send(req);
+	    continue;
+	} else {
+	    vstring_sprintf(dns_async_why, "Host or domain name not found. "
+			    "Name service error for name=%s type=%s: %s",
+			    req->name, dns_strtype(req->type),
+			    dns_strerror(TRY_AGAIN));
+	    SET_H_ERRNO(TRY_AGAIN);
+	    dns_async_done(req, DNS_RETRY, (DNS_RR *) 0, SERVFAIL);
+	}
+	entry = ring_succ(&dns_async_pending);
+    }
+}
+
+/* dns_async_match - does this reply belong to the request */
+
+static int dns_async_match(DNS_ASYNC *req, unsigned char *buf, int len,
+			           struct sockaddr_in *sin)
+{
+    HEADER *hp = (HEADER *) buf;
+    char    qname[DNS_NAME_LEN];
+    unsigned char *pos;
+    unsigned qtype;
+    unsigned qclass;
+    int     n;
+    ssize_t nlen;
+
+    /*
+     * The reply must come from a name server that we sent queries to, and
+     * it must repeat the query ID and question of the request.
+     */
+    for (n = 0; n < dns_async_nservers; n++)
+	if (sin->sin_addr.s_addr == dns_async_servers[n].sin_addr.s_addr
+	    && sin->sin_port == dns_async_servers[n].sin_port)
+	    break;
+    if (n >= dns_async_nservers)
+	return (0);
+    if (len < HFIXEDSZ || hp->qr == 0 || ntohs(hp->qdcount) != 1)
+	return (0);
+    pos = buf + HFIXEDSZ;
+    if ((n = dn_expand(buf, buf + len, pos, qname, sizeof(qname))) < 0)
+	return (0);
+    pos += n;
+    if (pos + QFIXEDSZ > buf + len)
+	return (0);
+    GETSHORT(qtype, pos);
+    GETSHORT(qclass, pos);
+    if (qclass != C_IN || req->qid != ntohs(hp->id) || req->type != qtype)
+	return (0);
+    nlen = strlen(req->name);
+    if (nlen > 0 && req->name[nlen - 1] == '.')
+	nlen -= 1;
+    return (strncasecmp(req->name, qname, nlen) == 0 && qname[nlen] == 0);
+}
+
+/* dns_async_reply - process one reply */
+
+static void dns_async_reply(DNS_ASYNC *req, unsigned char *buf, int len)
+{
+    HEADER *hp = (HEADER *) buf;
+    char    cname[DNS_NAME_LEN];
+    DNS_RR *rr;
+    int     rcode;
+    int     status;
+
+    /*
+     * A truncated reply needs TCP. Let the stub resolver handle that.
+     */
+    if (hp->tc) {
+	if (msg_verbose)
+	    msg_info("dns_async_reply: %s (%s): truncated reply",
+		     req->name, dns_strtype(req->type));
+	req->blocking = 1;
+	return;
+    }
+
+    /*
+     * A server that does not understand EDNS0. Let the stub resolver handle
+     * that, too.
+     */
+    if (hp->rcode == FORMERR && (req->qflags & RES_USE_DNSSEC)) {
+	req->blocking = 1;
+	return;
+    }
+
+    /*
+     * Like res_send(), try the next name server after a server failure.
+     */
+    if ((hp->rcode == SERVFAIL || hp->rcode == NOTIMP
+	 || hp->rcode == REFUSED)
+	&& req->tries < dns_async_nservers * _res.retry) {
+	req->server = (req->server + 1) % dns_async_nservers;
+	dns_async_send(req);
+	return;
+    }
+    /*
+     * Like res_send() in resolver libraries that implement RES_TRUSTAD,
+     * don't believe a name server that claims to have validated its reply,
+     * unless resolv.conf says that the name servers are trusted. Otherwise,
+     * any name server that we can reach could fake DNSSEC security.
+     */
+#ifdef RES_TRUSTAD
+    if ((_res.options & RES_TRUSTAD) == 0)
+	hp->ad = 0;
+#endif
+    VSTRING_RESET(dns_async_why);
+    VSTRING_TERMINATE(dns_async_why);
+    status = dns_lookup_reply(req->orig_name, req->name, req->type,
+			      req->qflags, buf, len, &rr, req->fqdn,
+			      dns_async_why, &rcode, req->lflags,
+			      cname, sizeof(cname), &req->maybe_secure);
+    if (status != DNS_RECURSE) {
+	dns_async_done(req, status, rr, rcode);
+    } else if (++req->cname_count >= DNS_ASYNC_MAX_CNAME) {
+	vstring_sprintf(dns_async_why, "Name server loop for %s", cname);
+	msg_warn("dns_lookup: Name server loop for %s", cname);
+	dns_async_done(req, DNS_NOTFOUND, (DNS_RR *) 0, rcode);
+    } else {
+	/* Once a CNAME is not validated, don't ask for further validation. */
+	if (req->maybe_secure == 0)
+	    req->qflags &= ~RES_USE_DNSSEC;
+	strcpy(req->name, cname);
+	if (dns_async_query(req) < 0)
+	    req->blocking = 1;
+    }
+}
+
+/* dns_async_read - receive and process reply for one request */
+
+static void dns_async_read(DNS_ASYNC *req)
+{
+    unsigned char buf[DNS_ASYNC_REPLY_SIZE];
+    struct sockaddr_in sin;
+    SOCKADDR_SIZE sin_len;
+    ssize_t len;
+
+    /*
+     * Stop after the first matching reply. The request may be completed, or
+     * it may have moved on to a new socket.
+     */
+    while (req->sock >= 0) {
+	sin_len = sizeof(sin);
+	if ((len = recvfrom(req->sock, (void *) buf, sizeof(buf), 0,
+			    (struct sockaddr *) &sin, &sin_len)) < 0) {
+	    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR
+		&& msg_verbose)
+		msg_info("dns_async_read: recvfrom: %m");
+	    break;
+	}
+	if (sin_len != sizeof(sin) || sin.sin_family != AF_INET
+	    || !dns_async_match(req, buf, len, &sin)) {
+	    if (msg_verbose)
+		msg_info("dns_async_read: discarding unexpected reply");
+	    continue;
+	}
+	dns_async_reply(req, buf, len);
+	break;
+    }
+}
+
+/* dns_async_event - socket is readable */
+
+static void dns_async_event(int unused_event, void *context)
+{
+    dns_async_read((DNS_ASYNC *) context);
+    dns_async_expire();
+    dns_async_schedule();
+}
+
+/* dns_async_timer - retransmission timer */
+
+static void dns_async_timer(int unused_event, void *unused_context)
+{
+    dns_async_expire();
+    dns_async_schedule();
+}
+
+/* dns_async_lookup - start non-blocking lookup */
+
+DNS_ASYNC *dns_async_lookup(const char *name, unsigned type, unsigned rflags,
+			            unsigned lflags, DNS_ASYNC_FN callback,
+			            void *context)
+{
+    DNS_ASYNC *req;
+
+#define USER_FLAGS (RES_DEBUG | RES_DNSRCH | RES_DEFNAMES | RES_USE_DNSSEC)
+
+    if ((rflags & USER_FLAGS) != rflags)
+	msg_panic("dns_async_lookup: bad flags: %d", rflags);
+
+    (void) dns_async_init();
+    req = (DNS_ASYNC *) mymalloc(sizeof(*req));
+    req->orig_name = mystrdup(name);
+    req->type = type;
+    req->rflags = rflags;
+    req->lflags = lflags;
+    req->qflags = rflags;
+    req->maybe_secure = 1;
+    req->cname_count = 0;
+    req->qid = ~0;
+    req->sock = -1;
+    req->deadline = 0;
+    req->callback = callback;
+    req->context = context;
+    req->blocking = 0;
+    req->fqdn = vstring_alloc(10);
+    VSTRING_TERMINATE(req->fqdn);
+    ring_append(&dns_async_pending, &req->ring);
+    dns_async_count += 1;
+
+    /*
+     * Leave the hard cases to the blocking client. That includes names that
+     * dns_lookup() rejects without sending a query.
+     */
+    if (dns_async_nservers == 0
+	|| (rflags & (RES_DNSRCH | RES_DEFNAMES)) != 0
+	|| strlen(name) >= sizeof(req->name)
+	|| valid_hostaddr(name, DONT_GRIPE)
+	|| !valid_hostname(name, DONT_GRIPE)) {
+	req->blocking = 1;
+    } else {
+	strcpy(req->name, name);
+	if (dns_async_query(req) < 0)
+	    req->blocking = 1;
+    }
+    dns_async_schedule();
+    return (req);
+}
+
+/* dns_async_cancel - cancel pending request */
+
+void    dns_async_cancel(DNS_ASYNC *req)
+{
+    ring_detach(&req->ring);
+    dns_async_count -= 1;
+    dns_async_close(req);
+    vstring_free(req->fqdn);
+    myfree(req->orig_name);
+    myfree((void *) req);
+    dns_async_schedule();
+}
+
+/* dns_async_poll - wait until some socket is readable */
+
+static void dns_async_poll(int delay)
+{
+    RING   *entry;
+    DNS_ASYNC *req;
+
+#if defined(USE_SYSV_POLL) || defined(USE_SYSV_POLL_THEN_SELECT)
+    struct pollfd *fds;
+    int     nfds = 0;
+
+    fds = (struct pollfd *) mymalloc(sizeof(*fds) * dns_async_count);
+    RING_FOREACH(entry, &dns_async_pending) {
+	req = RING_TO_DNS_ASYNC(entry);
+	if (req->sock >= 0) {
+	    fds[nfds].fd = req->sock;
+	    fds[nfds].events = POLLIN;
+	    nfds++;
+	}
+    }
+    if (poll(fds, nfds, delay * 1000) < 0 && errno != EINTR)
+	msg_fatal("dns_async_poll: poll: %m");
+    myfree((void *) fds);
+#else
+    fd_set  read_fds;
+    struct timeval tv;
+    int     max_fd = -1;
+
+    FD_ZERO(&read_fds);
+    RING_FOREACH(entry, &dns_async_pending) {
+	req = RING_TO_DNS_ASYNC(entry);
+	if (req->sock >= 0) {
+	    if (req->sock >= FD_SETSIZE)
+		msg_fatal("descriptor %d does not fit FD_SETSIZE %d",
+			  req->sock, FD_SETSIZE);
+	    FD_SET(req->sock, &read_fds);
+	    if (req->sock > max_fd)
+		max_fd = req->sock;
+	}
+    }
+    tv.tv_sec = delay;
+    tv.tv_usec = 0;
+    if (select(max_fd + 1, &read_fds, (fd_set *) 0, (fd_set *) 0, &tv) < 0
+	&& errno != EINTR)
+	msg_fatal("dns_async_poll: select: %m");
+#endif
+}
+
+/* dns_async_wait - process replies until no request is pending */
+
+void    dns_async_wait(void)
+{
+    RING   *entry;
+    RING   *next;
+    DNS_ASYNC *req;
+    time_t  now;
+    int     delay;
+
+    while (dns_async_count > 0) {
+	now = time((time_t *) 0);
+	delay = -1;
+	RING_FOREACH(entry, &dns_async_pending) {
+	    req = RING_TO_DNS_ASYNC(entry);
+	    if (req->blocking || req->deadline <= now)
+		delay = 0;
+	    else if (delay < 0 || req->deadline - now < delay)
+		delay = req->deadline - now;
+	}
+	if (delay > 0)
+	    dns_async_poll(delay);
+
+	/*
+	 * Reading is non-blocking, so there is no need to find out which
+	 * sockets are readable. The dns_async_prefetch() call-back does not
+	 * cancel other requests.
+	 */
+	for (entry = ring_succ(&dns_async_pending);
+	     entry != &dns_async_pending; entry = next) {
+	    next = ring_succ(entry);
+	    dns_async_read(RING_TO_DNS_ASYNC(entry));
+	}
+	dns_async_expire();
+    }
+    dns_async_schedule();
+}
+
+/* dns_async_prefetch_done - save prefetch result */
+
+static void dns_async_prefetch_done(int status, DNS_RR *rr, const char *fqdn,
+				            const char *why, int rcode,
+				            void *context)
+{
+    DNS_PREFETCH *pf = (DNS_PREFETCH *) context;
+
+    pf->request = 0;
+    pf->status = status;
+    pf->rr = rr;
+    pf->fqdn = *fqdn ? mystrdup(fqdn) : 0;
+    pf->why = *why ? mystrdup(why) : 0;
+    pf->rcode = rcode;
+    pf->herrno = h_errno;
+}
+
+/* dns_async_prefetch_find - look up prefetch entry */
+
+static DNS_PREFETCH *dns_async_prefetch_find(const char *name, unsigned type,
+					             unsigned rflags,
+					             unsigned lflags)
+{
+    RING   *entry;
+    DNS_PREFETCH *pf;
+
+    RING_FOREACH(entry, &dns_prefetch_list) {
+	pf = RING_TO_DNS_PREFETCH(entry);
+	if (pf->type == type && pf->rflags == rflags && pf->lflags == lflags
+	    && strcmp(pf->name, name) == 0)
+	    return (pf);
+    }
+    return (0);
+}
+
+/* dns_async_prefetch_free - destroy prefetch entry */
+
+static void dns_async_prefetch_free(DNS_PREFETCH *pf)
+{
+    ring_detach(&pf->ring);
+    if (pf->request)
+	dns_async_cancel(pf->request);
+    if (pf->rr)
+	dns_rr_free(pf->rr);
+    if (pf->fqdn)
+	myfree(pf->fqdn);
+    if (pf->why)
+	myfree(pf->why);
+    myfree(pf->name);
+    myfree((void *) pf);
+}
+
+/* dns_async_prefetch - start lookups for later dns_lookup() calls */
+
+int     dns_async_prefetch(const char *name, unsigned rflags, unsigned lflags,
+			           unsigned *types)
+{
+    DNS_PREFETCH *pf;
+    int     count = 0;
+
+    /*
+     * Don't bother when the lookup would block anyway.
+     */
+    if (var_dns_parallel == 0
+	|| dns_async_init() == 0
+	|| (rflags & (RES_DNSRCH | RES_DEFNAMES)) != 0
+	|| valid_hostaddr(name, DONT_GRIPE)
+	|| !valid_hostname(name, DONT_GRIPE))
+	return (0);
+
+    for ( /* void */ ; *types != 0; types++) {
+	if (dns_async_prefetch_find(name, *types, rflags, lflags) != 0)
+	    continue;
+	pf = (DNS_PREFETCH *) mymalloc(sizeof(*pf));
+	pf->name = mystrdup(name);
+	pf->type = *types;
+	pf->rflags = rflags;
+	pf->lflags = lflags;
+	pf->rr = 0;
+	pf->fqdn = pf->why = 0;
+	ring_append(&dns_prefetch_list, &pf->ring);
+	pf->request = dns_async_lookup(name, *types, rflags, lflags,
+				       dns_async_prefetch_done, (void *) pf);
+	count += 1;
+    }
+    return (count);
+}
+
+/* dns_async_claim - pick up prefetch result */
+
+int     dns_async_claim(const char *name, unsigned type, unsigned rflags,
+			        unsigned lflags, DNS_RR **rrlist, VSTRING *fqdn,
+			        VSTRING *why, int *rcode, int *status)
+{
+    DNS_PREFETCH *pf;
+
+    if (dns_async_nservers < 0
+	|| (pf = dns_async_prefetch_find(name, type, rflags, lflags)) == 0
+	|| pf->request != 0)
+	return (0);
+    if (msg_verbose)
+	msg_info("dns_async_claim: %s (%s): status %d",
+		 name, dns_strtype(type), pf->status);
+    *status = pf->status;
+    *rrlist = pf->rr;
+    pf->rr = 0;
+    if (fqdn && pf->fqdn)
+	vstring_strcpy(fqdn, pf->fqdn);
+    if (why && pf->why)
+	vstring_strcpy(why, pf->why);
+    if (rcode)
+	*rcode = pf->rcode;
+    SET_H_ERRNO(pf->herrno);
+    dns_async_prefetch_free(pf);
+    return (1);
+}
+
+/* dns_async_flush - discard prefetch results */
+
+void    dns_async_flush(const char *name)
+{
+    RING   *entry;
+    DNS_PREFETCH *pf;
+
+    if (dns_async_nservers < 0)
+	return;
+    for (entry = ring_succ(&dns_prefetch_list);
+	 entry != &dns_prefetch_list; /* see below */ ) {
+	pf = RING_TO_DNS_PREFETCH(entry);
+	entry = ring_succ(entry);
+	if (name == 0 || strcmp(pf->name, name) == 0)
+	    dns_async_prefetch_free(pf);
+    }
+}
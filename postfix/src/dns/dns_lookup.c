@@ -74,6 +74,23 @@
 /*	VSTRING *why;
 /*	int	*rcode;
 /*	unsigned lflags;
+/*
+/*	int	dns_lookup_reply(orig_name, name, type, rflags, buf, len,
+/*				list, fqdn, why, rcode, lflags, cname, c_len)
+/*	const char *orig_name;
+/*	const char *name;
+/*	unsigned type;
+/*	unsigned rflags;
+/*	unsigned char *buf;
+/*	int	len;
+/*	DNS_RR	**list;
+/*	VSTRING *fqdn;
+/*	VSTRING *why;
+/*	int	*rcode;
+/*	unsigned lflags;
+/*	char	*cname;
+/*	int	c_len;
+/*	int	*maybe_secure;
 /* DESCRIPTION
 /*	dns_lookup() looks up DNS resource records. When requested to
 /*	look up data other than type CNAME, it will follow a limited
@@ -84,7 +101,12 @@
 /*	malformed replies are reported as transient errors.
 /*
 /*	dns_lookup_l() and dns_lookup_v() allow the user to specify
-/*	a list of resource types.
+/*	a list of resource types. When the list argument is not a
+/*	null pointer, the lflags argument does not specify
+/*	DNS_REQ_FLAG_STOP_OK, and the dns_parallel_lookup_enable
+/*	parameter is on, these functions send the queries for all
+/*	types at once with dns_async(3), and process the results
+/*	in the order as specified.
 /*
 /*	dns_lookup_x, dns_lookup_r(), dns_lookup_rl() and dns_lookup_rv()
 /*	accept or return additional information.
@@ -94,6 +116,14 @@
 /*	DNS_REQ_FLAG_NCACHE_TTL feature. The workaround does not
 /*	support EDNS0 or DNSSEC, but it should be sufficient for
 /*	DNSBL/DNSWL lookups.
+/*
+/*	dns_lookup_reply() is used by dns_async(3) to process a
+/*	reply that it received from a name server, with the same
+/*	result as one step of dns_lookup_x(). The result is
+/*	DNS_RECURSE when the reply contains only a CNAME record;
+/*	the alias is then stored in the cname buffer. The caller
+/*	initializes maybe_secure to 1 before the first step;
+/*	dns_lookup_reply() resets it when a CNAME was not validated.
 /* INPUTS
 /* .ad
 /* .fi
@@ -203,6 +233,7 @@
 /*	their own DNS client software.
 /* SEE ALSO
 /*	dns_rr(3) resource record memory and list management
+/*	dns_async(3) non-blocking domain name service lookup
 /* LICENSE
 /* .ad
 /* .fi
@@ -306,6 +337,29 @@ typedef struct DNS_REPLY {
   * libunbound a mandatory dependency for Postfix.
   */
 
+/* dns_set_h_errno - set h_errno from server reply code */
+
+static void dns_set_h_errno(HEADER *reply_header)
+{
+    switch (reply_header->rcode) {
+    case NXDOMAIN:
+	SET_H_ERRNO(HOST_NOT_FOUND);
+	break;
+    case NOERROR:
+	if (reply_header->ancount != 0)
+	    SET_H_ERRNO(0);
+	else
+	    SET_H_ERRNO(NO_DATA);
+	break;
+    case SERVFAIL:
+	SET_H_ERRNO(TRY_AGAIN);
+	break;
+    default:
+	SET_H_ERRNO(NO_RECOVERY);
+	break;
+    }
+}
+
 /* dns_res_query - a res_query() clone that can return negative replies */
 
 static int dns_res_query(const char *name, int class, int type,
@@ -350,23 +404,7 @@ static int dns_res_query(const char *name, int class, int type,
 	    msg_info("res_send() failed");
 	return (len);
     } else {
-	switch (reply_header->rcode) {
-	case NXDOMAIN:
-	    SET_H_ERRNO(HOST_NOT_FOUND);
-	    break;
-	case NOERROR:
-	    if (reply_header->ancount != 0)
-		SET_H_ERRNO(0);
-	    else
-		SET_H_ERRNO(NO_DATA);
-	    break;
-	case SERVFAIL:
-	    SET_H_ERRNO(TRY_AGAIN);
-	    break;
-	default:
-	    SET_H_ERRNO(NO_RECOVERY);
-	    break;
-	}
+	dns_set_h_errno(reply_header);
 	return (len);
     }
 }
@@ -406,6 +444,57 @@ static int dns_res_search(const char *name, int class, int type,
     return (len);
 }
 
+/* dns_query_fail - report name service error */
+
+static int dns_query_fail(const char *name, int type, DNS_REPLY *reply,
+			          VSTRING *why, int keep_notfound)
+{
+    if (why)
+	vstring_sprintf(why, "Host or domain name not found. "
+			"Name service error for name=%s type=%s: %s",
+			name, dns_strtype(type), dns_strerror(h_errno));
+    if (msg_verbose)
+	msg_info("dns_query: %s (%s): %s",
+		 name, dns_strtype(type), dns_strerror(h_errno));
+    switch (h_errno) {
+    case NO_RECOVERY:
+	return (DNS_FAIL);
+    case HOST_NOT_FOUND:
+    case NO_DATA:
+	if (keep_notfound == 0)
+	    SET_NO_DNS_REPLY_PACKET(reply);
+	return (DNS_NOTFOUND);
+    default:
+	return (DNS_RETRY);
+    }
+}
+
+/* dns_reply_setup - pre-parse the reply */
+
+static void dns_reply_setup(DNS_REPLY *reply, int len, unsigned flags)
+{
+    HEADER *reply_header = (HEADER *) reply->buf;
+
+    /*
+     * Initialize the reply structure. Some structure members are filled on
+     * the fly while the reply is being parsed.  Coerce AD bit to boolean.
+     */
+#if RES_USE_DNSSEC != 0
+    reply->dnssec_ad = (flags & RES_USE_DNSSEC) ? !!reply_header->ad : 0;
+#else
+    reply->dnssec_ad = 0;
+#endif
+    SET_HAVE_DNS_REPLY_PACKET(reply, len);
+    reply->query_start = reply->buf + sizeof(HEADER);
+    reply->answer_start = 0;
+    reply->query_count = ntohs(reply_header->qdcount);
+    reply->answer_count = ntohs(reply_header->ancount);
+    reply->auth_count = ntohs(reply_header->nscount);
+    if (msg_verbose > 1)
+	msg_info("dns_query: reply len=%d ancount=%d nscount=%d",
+		 len, reply->answer_count, reply->auth_count);
+}
+
 /* dns_query - query name server and pre-parse the reply */
 
 static int dns_query(const char *name, int type, unsigned flags,
@@ -415,6 +504,7 @@ static int dns_query(const char *name, int type, unsigned flags,
     int     len;
     unsigned long saved_options;
     int     keep_notfound = (lflags & DNS_REQ_FLAG_NCACHE_TTL);
+    int     status;
 
     /*
      * Initialize the reply buffer.
@@ -477,25 +567,9 @@ static int dns_query(const char *name, int type, unsigned flags,
 	reply_header = (HEADER *) reply->buf;
 	reply->rcode = reply_header->rcode;
 	if (h_errno != 0) {
-	    if (why)
-		vstring_sprintf(why, "Host or domain name not found. "
-				"Name service error for name=%s type=%s: %s",
-			    name, dns_strtype(type), dns_strerror(h_errno));
-	    if (msg_verbose)
-		msg_info("dns_query: %s (%s): %s",
-			 name, dns_strtype(type), dns_strerror(h_errno));
-	    switch (h_errno) {
-	    case NO_RECOVERY:
-		return (DNS_FAIL);
-	    case HOST_NOT_FOUND:
-	    case NO_DATA:
-		if (keep_notfound)
-		    break;
-		SET_NO_DNS_REPLY_PACKET(reply);
-		return (DNS_NOTFOUND);
-	    default:
-		return (DNS_RETRY);
-	    }
+	    status = dns_query_fail(name, type, reply, why, keep_notfound);
+	    if (status != DNS_NOTFOUND || keep_notfound == 0)
+		return (status);
 	} else {
 	    if (msg_verbose)
 		msg_info("dns_query: %s (%s): OK", name, dns_strtype(type));
@@ -525,24 +599,7 @@ static int dns_query(const char *name, int type, unsigned flags,
 	len = reply->buf_len;
     }
 
-    /*
-     * Initialize the reply structure. Some structure members are filled on
-     * the fly while the reply is being parsed.  Coerce AD bit to boolean.
-     */
-#if RES_USE_DNSSEC != 0
-    reply->dnssec_ad = (flags & RES_USE_DNSSEC) ? !!reply_header->ad : 0;
-#else
-    reply->dnssec_ad = 0;
-#endif
-    SET_HAVE_DNS_REPLY_PACKET(reply, len);
-    reply->query_start = reply->buf + sizeof(HEADER);
-    reply->answer_start = 0;
-    reply->query_count = ntohs(reply_header->qdcount);
-    reply->answer_count = ntohs(reply_header->ancount);
-    reply->auth_count = ntohs(reply_header->nscount);
-    if (msg_verbose > 1)
-	msg_info("dns_query: reply len=%d ancount=%d nscount=%d",
-		 len, reply->answer_count, reply->auth_count);
+    dns_reply_setup(reply, len, flags);
 
     /*
      * Future proofing. If this reaches the panic call, then some code change
@@ -901,6 +958,115 @@ static int dns_get_answer(const char *orig_name, DNS_REPLY *reply, int type,
     return (not_found_status);
 }
 
+/* dns_get_result - extract lookup result from pre-parsed reply */
+
+static int dns_get_result(const char *orig_name, const char *name,
+			          unsigned type, DNS_REPLY *reply, int status,
+			          DNS_RR **rrlist, VSTRING *fqdn, VSTRING *why,
+			          char *cname, int c_len, int *maybe_secure)
+{
+    if (status != DNS_OK) {
+
+	/*
+	 * If the record does not exist, and we have a copy of the server
+	 * response, try to extract the negative caching TTL for the SOA
+	 * record in the authority section. DO NOT return an error if an SOA
+	 * record is malformed.
+	 */
+	if (status == DNS_NOTFOUND && TEST_HAVE_DNS_REPLY_PACKET(reply)
+	    && reply->auth_count > 0) {
+	    reply->answer_count = reply->auth_count;	/* XXX TODO: Fix API */
+	    (void) dns_get_answer(orig_name, reply, T_SOA, rrlist, fqdn,
+				  cname, c_len, maybe_secure);
+	}
+	return (status);
+    }
+
+    /*
+     * Extract resource records of the requested type. Pick up CNAME
+     * information just in case the requested data is not found.
+     */
+    status = dns_get_answer(orig_name, reply, type, rrlist, fqdn,
+			    cname, c_len, maybe_secure);
+    switch (status) {
+    default:
+	if (why)
+	    vstring_sprintf(why, "Name service error for name=%s type=%s: "
+			    "Malformed or unexpected name server reply",
+			    name, dns_strtype(type));
+	return (status);
+    case DNS_NULLMX:
+	if (why)
+	    vstring_sprintf(why, "Domain %s does not accept mail (nullMX)",
+			    name);
+	SET_H_ERRNO(NO_DATA);
+	return (status);
+    case DNS_OK:
+	if (rrlist && dns_rr_filter_maps) {
+	    if (dns_rr_filter_execute(rrlist) < 0) {
+		if (why)
+		    vstring_sprintf(why,
+				    "Error looking up name=%s type=%s: "
+				    "Invalid DNS reply filter syntax",
+				    name, dns_strtype(type));
+		dns_rr_free(*rrlist);
+		*rrlist = 0;
+		status = DNS_RETRY;
+	    } else if (*rrlist == 0) {
+		if (why)
+		    vstring_sprintf(why,
+				    "Error looking up name=%s type=%s: "
+				    "DNS reply filter drops all results",
+				    name, dns_strtype(type));
+		status = DNS_POLICY;
+	    }
+	}
+	return (status);
+    case DNS_RECURSE:
+	if (msg_verbose)
+	    msg_info("dns_lookup: %s aliased to %s", name, cname);
+	return (status);
+    }
+}
+
+/* dns_lookup_reply - parse reply for the non-blocking client */
+
+int     dns_lookup_reply(const char *orig_name, const char *name,
+			         unsigned type, unsigned flags,
+			         unsigned char *buf, int len,
+			         DNS_RR **rrlist, VSTRING *fqdn, VSTRING *why,
+			         int *rcode, unsigned lflags,
+			         char *cname, int c_len, int *maybe_secure)
+{
+    DNS_REPLY reply;
+    int     keep_notfound = (lflags & DNS_REQ_FLAG_NCACHE_TTL);
+    int     status = DNS_OK;
+
+    /*
+     * Same as dns_query() and one dns_lookup_x() iteration, but with a reply
+     * that the caller received from the name server.
+     */
+    if (rrlist)
+	*rrlist = 0;
+    reply.buf = buf;
+    reply.buf_len = len;
+    reply.rcode = ((HEADER *) buf)->rcode;
+    SET_NO_DNS_REPLY_PACKET(&reply);
+    if (rcode)
+	*rcode = reply.rcode;
+    dns_set_h_errno((HEADER *) buf);
+    if (h_errno != 0) {
+	status = dns_query_fail(name, type, &reply, why, keep_notfound);
+    } else {
+	if (msg_verbose)
+	    msg_info("dns_query: %s (%s): OK", name, dns_strtype(type));
+    }
+    if (status == DNS_OK || (status == DNS_NOTFOUND && keep_notfound))
+	dns_reply_setup(&reply, len, flags);
+    return (dns_get_result(orig_name, name, type, &reply, status, rrlist,
+			   fqdn, why, cname, c_len, maybe_secure));
+}
+
 /* dns_lookup_x - DNS lookup user interface */
 
 int     dns_lookup_x(const char *name, unsigned type, unsigned flags,
@@ -950,6 +1116,13 @@ int     dns_lookup_x(const char *name, unsigned type, unsigned flags,
 	return (DNS_NOTFOUND);
     }
 
+    /*
+     * Use the result from a parallel lookup, if one is available.
+     */
+    if (rrlist != 0 && dns_async_claim(name, type, flags, lflags, rrlist,
+				       fqdn, why, rcode, &status))
+	return (status);
+
     /*
      * Perform the lookup. Follow CNAME chains, but only up to a
      * pre-determined maximum.
@@ -962,78 +1135,21 @@ int     dns_lookup_x(const char *name, unsigned type, unsigned flags,
 	status = dns_query(name, type, flags, &reply, why, lflags);
 	if (rcode)
 	    *rcode = reply.rcode;
-	if (status != DNS_OK) {
-
-	    /*
-	     * If the record does not exist, and we have a copy of the server
-	     * response, try to extract the negative caching TTL for the SOA
-	     * record in the authority section. DO NOT return an error if an
-	     * SOA record is malformed.
-	     */
-	    if (status == DNS_NOTFOUND && TEST_HAVE_DNS_REPLY_PACKET(&reply)
-		&& reply.auth_count > 0) {
-		reply.answer_count = reply.auth_count;	/* XXX TODO: Fix API */
-		(void) dns_get_answer(orig_name, &reply, T_SOA, rrlist, fqdn,
-				      cname, c_len, &maybe_secure);
-	    }
+	status = dns_get_result(orig_name, name, type, &reply, status, rrlist,
+				fqdn, why, cname, c_len, &maybe_secure);
+	if (status != DNS_RECURSE)
 	    return (status);
-	}
+#if RES_USE_DNSSEC
 
 	/*
-	 * Extract resource records of the requested type. Pick up CNAME
-	 * information just in case the requested data is not found.
+	 * Once an intermediate CNAME reply is not validated, all consequent
+	 * RRs are deemed not validated, so we don't ask for further DNSSEC
+	 * replies.
 	 */
-	status = dns_get_answer(orig_name, &reply, type, rrlist, fqdn,
-				cname, c_len, &maybe_secure);
-	switch (status) {
-	default:
-	    if (why)
-		vstring_sprintf(why, "Name service error for name=%s type=%s: "
-				"Malformed or unexpected name server reply",
-				name, dns_strtype(type));
-	    return (status);
-	case DNS_NULLMX:
-	    if (why)
-		vstring_sprintf(why, "Domain %s does not accept mail (nullMX)",
-				name);
-	    SET_H_ERRNO(NO_DATA);
-	    return (status);
-	case DNS_OK:
-	    if (rrlist && dns_rr_filter_maps) {
-		if (dns_rr_filter_execute(rrlist) < 0) {
-		    if (why)
-			vstring_sprintf(why,
-					"Error looking up name=%s type=%s: "
-					"Invalid DNS reply filter syntax",
-					name, dns_strtype(type));
-		    dns_rr_free(*rrlist);
-		    *rrlist = 0;
-		    status = DNS_RETRY;
-		} else if (*rrlist == 0) {
-		    if (why)
-			vstring_sprintf(why,
-					"Error looking up name=%s type=%s: "
-					"DNS reply filter drops all results",
-					name, dns_strtype(type));
-		    status = DNS_POLICY;
-		}
-	    }
-	    return (status);
-	case DNS_RECURSE:
-	    if (msg_verbose)
-		msg_info("dns_lookup: %s aliased to %s", name, cname);
-#if RES_USE_DNSSEC
-
-	    /*
-	     * Once an intermediate CNAME reply is not validated, all
-	     * consequent RRs are deemed not validated, so we don't ask for
-	     * further DNSSEC replies.
-	     */
-	    if (maybe_secure == 0)
-		flags &= ~RES_USE_DNSSEC;
+	if (maybe_secure == 0)
+	    flags &= ~RES_USE_DNSSEC;
 #endif
-	    name = cname;
-	}
+	name = cname;
     }
     if (why)
 	vstring_sprintf(why, "Name server loop for %s", name);
@@ -1048,15 +1164,21 @@ int     dns_lookup_rl(const char *name, unsigned flags, DNS_RR **rrlist,
 		              int lflags,...)
 {
     va_list ap;
-    unsigned type, next;
-    int     status = DNS_NOTFOUND;
-    int     hpref_status = INT_MIN;
-    VSTRING *hpref_rtext = 0;
-    int     hpref_rcode;
-    int     hpref_h_errno;
-    DNS_RR *rr;
+    unsigned types[DNS_LOOKUP_MAX_TYPES + 1];
+    int     n;
 
-    /* Save intermediate highest-priority result. */
+    va_start(ap, lflags);
+    for (n = 0; (types[n] = va_arg(ap, unsigned)) != 0; n++)
+	if (n >= DNS_LOOKUP_MAX_TYPES)
+	    msg_panic("dns_lookup_rl: too many types for %s", name);
+    va_end(ap);
+    return (dns_lookup_rv(name, flags, rrlist, fqdn, why, rcode,
+			  lflags, types));
+}
+
+ /*
+  * Save and restore the highest-priority result of a multi-type lookup.
+  */
 #define SAVE_HPREF_STATUS() do { \
 	hpref_status = status; \
 	if (rcode) \
@@ -1068,7 +1190,6 @@ int     dns_lookup_rl(const char *name, unsigned flags, DNS_RR **rrlist,
 	hpref_h_errno = h_errno; \
     } while (0)
 
-    /* Restore intermediate highest-priority result. */
 #define RESTORE_HPREF_STATUS() do { \
 	status = hpref_status; \
 	if (rcode) \
@@ -1078,45 +1199,6 @@ int     dns_lookup_rl(const char *name, unsigned flags, DNS_RR **rrlist,
 	SET_H_ERRNO(hpref_h_errno); \
     } while (0)
 
-    if (rrlist)
-	*rrlist = 0;
-    va_start(ap, lflags);
-    for (type = va_arg(ap, unsigned); type != 0; type = next) {
-	next = va_arg(ap, unsigned);
-	if (msg_verbose)
-	    msg_info("lookup %s type %s flags %s",
-		     name, dns_strtype(type), dns_str_resflags(flags));
-	status = dns_lookup_x(name, type, flags, rrlist ? &rr : (DNS_RR **) 0,
-			      fqdn, why, rcode, lflags);
-	if (rrlist && rr)
-	    *rrlist = dns_rr_append(*rrlist, rr);
-	if (status == DNS_OK) {
-	    if (lflags & DNS_REQ_FLAG_STOP_OK)
-		break;
-	} else if (status == DNS_INVAL) {
-	    if (lflags & DNS_REQ_FLAG_STOP_INVAL)
-		break;
-	} else if (status == DNS_POLICY) {
-	    if (type == T_MX && (lflags & DNS_REQ_FLAG_STOP_MX_POLICY))
-		break;
-	} else if (status == DNS_NULLMX) {
-	    if (lflags & DNS_REQ_FLAG_STOP_NULLMX)
-		break;
-	}
-	/* XXX Stop after NXDOMAIN error. */
-	if (next == 0)
-	    break;
-	if (status >= hpref_status)
-	    SAVE_HPREF_STATUS();		/* save last info */
-    }
-    va_end(ap);
-    if (status < hpref_status)
-	RESTORE_HPREF_STATUS();			/* else report last info */
-    if (hpref_rtext)
-	vstring_free(hpref_rtext);
-    return (status);
-}
-
 /* dns_lookup_rv - DNS lookup interface with types vector */
 
 int     dns_lookup_rv(const char *name, unsigned flags, DNS_RR **rrlist,
@@ -1130,9 +1212,21 @@ int     dns_lookup_rv(const char *name, unsigned flags, DNS_RR **rrlist,
     int     hpref_rcode;
     int     hpref_h_errno;
     DNS_RR *rr;
+    int     prefetched = 0;
 
     if (rrlist)
 	*rrlist = 0;
+
+    /*
+     * Send the queries for all types at once, so that we wait for the
+     * slowest reply instead of the sum of all replies. The loop below picks
+     * up the results in the order as specified. Don't send queries that the
+     * loop may never need.
+     */
+    if (rrlist && types[0] != 0 && types[1] != 0
+	&& (lflags & DNS_REQ_FLAG_STOP_OK) == 0
+	&& (prefetched = dns_async_prefetch(name, flags, lflags, types)) > 0)
+	dns_async_wait();
     for (type = *types++; type != 0; type = next) {
 	next = *types++;
 	if (msg_verbose)
@@ -1165,5 +1259,7 @@ int     dns_lookup_rv(const char *name, unsigned flags, DNS_RR **rrlist,
 	RESTORE_HPREF_STATUS();			/* else report last info */
     if (hpref_rtext)
 	vstring_free(hpref_rtext);
+    if (prefetched)
+	dns_async_flush(name);
     return (status);
 }
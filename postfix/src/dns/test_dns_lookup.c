@@ -7,7 +7,8 @@
 /*	test_dns_lookup query-type domain-name
 /* DESCRIPTION
 /*	test_dns_lookup performs a DNS query of the specified resource
-/*	type for the specified resource name.
+/*	type for the specified resource name. With the -a option,
+/*	queries for multiple types are sent in parallel.
 /* DIAGNOSTICS
 /*	Problems are reported to the standard error stream.
 /* LICENSE
@@ -60,7 +61,7 @@ static void print_rr(VSTRING *buf, DNS_RR *rr)
 
 static NORETURN usage(char **argv)
 {
-    msg_fatal("usage: %s [-npv] [-f filter] types name", argv[0]);
+    msg_fatal("usage: %s [-anpv] [-f filter] types name", argv[0]);
 }
 
 int     main(int argc, char **argv)
@@ -78,8 +79,11 @@ int     main(int argc, char **argv)
     int     lflags = DNS_REQ_FLAG_NONE;
 
     msg_vstream_init(argv[0], VSTREAM_ERR);
-    while ((ch = GETOPT(argc, argv, "f:npv")) > 0) {
+    while ((ch = GETOPT(argc, argv, "af:npv")) > 0) {
 	switch (ch) {
+	case 'a':
+	    var_dns_parallel = 1;
+	    break;
 	case 'v':
 	    msg_verbose++;
 	    break;
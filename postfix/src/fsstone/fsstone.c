@@ -5,7 +5,7 @@
 /*	measure directory operation overhead
 /* SYNOPSIS
 /* .fi
-/*	\fBfsstone\fR [\fB-cr\fR] [\fB-s \fIsize\fR]
+/*	\fBfsstone\fR [\fB-clqr\fR] [\fB-d \fIdeliveries\fR] [\fB-s \fIsize\fR]
 /*		\fImsg_count files_per_dir\fR
 /* DESCRIPTION
 /*	The \fBfsstone\fR command measures the cost of creating, renaming
@@ -16,9 +16,36 @@
 /*	and arranges for at most \fIfiles_per_dir\fR simultaneous files
 /*	in the same directory.
 /*
+/*	With \fB-l\fR, the program instead appends messages to a small
+/*	number of segment files, as an append-only queue store would.
+/*	A removed message is marked with a short record that is not
+/*	flushed to disk. A segment file is deleted when it has no
+/*	more live messages; a segment file that is mostly dead is
+/*	compacted by copying its live messages to the current
+/*	segment. At the end, the program reports the number of
+/*	segment files and of compacted messages.
+/*
+/*	With \fB-q\fR and \fB-l\fR, each message is read once when
+/*	it is queued for delivery, and then read again for each
+/*	delivery. After each delivery, one byte of the message is
+/*	overwritten in place, as a Postfix delivery agent marks a
+/*	recipient as done. These updates are not flushed to disk.
+/*
 /*	Options:
 /* .IP \fB-c\fR
 /*	Create and delete files.
+/* .IP \fB-d \fIdeliveries\fR
+/*	Specify the number of deliveries per message (default: 1;
+/*	requires \fB-q\fR or \fB-l\fR).
+/* .IP \fB-l\fR
+/*	Append to and compact segment files, instead of using one
+/*	file per message.
+/* .IP \fB-q\fR
+/*	Create, rename and delete files as the Postfix queue does
+/*	(implies \fB-c\fR): create a file under a temporary name,
+/*	rename it to its permanent name in the \fBincoming\fR
+/*	directory, move it to the \fBactive\fR directory, read it,
+/*	and delete it.
 /* .IP \fB-r\fR
 /*	Rename files twice (requires \fB-c\fR).
 /* .IP \fB-s \fIsize\fR
@@ -27,10 +54,15 @@
 /*	Problems are reported to the standard error stream.
 /* BUGS
 /*	The \fB-r\fR option renames files within the same directory.
-/*	For a more realistic simulation, the program should rename files
-/*	<i>between</i> directories, and should also have an option to use
-/*	<i>hashed</i> directories as implemented with, for example, the
-/*	\fBdir_forest\fR(3) module.
+/*	The \fB-q\fR option renames files between directories, but
+/*	does not use \fIhashed\fR directories as implemented with,
+/*	for example, the \fBdir_forest\fR(3) module.
+/*
+/*	The \fB-l\fR option measures a storage layout only. Postfix
+/*	has no segment-log queue backend: the queue relies on moving
+/*	one file per message between directories for crash recovery,
+/*	on file locks for exclusive access, and on queue file names
+/*	for its defer, bounce and trace logs.
 /* LICENSE
 /* .ad
 /* .fi
@@ -49,12 +81,16 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 
 /* Utility library. */
 
 #include <msg.h>
 #include <msg_vstream.h>
+#include <mymalloc.h>
 
 /* Global directory. */
 
@@ -149,11 +185,309 @@ static void remove_silent(int seq)
     (void) remove(path);
 }
 
+/* make_queue_file - create a little file as the Postfix queue does */
+
+static void make_queue_file(int seqno, int size)
+{
+    char    temp_path[BUFSIZ];
+    char    path[BUFSIZ];
+    char    buf[1024];
+    struct stat st;
+    int     fd;
+    int     i;
+
+    sprintf(temp_path, "incoming/%d.%d", seqno, (int) getpid());
+    if ((fd = open(temp_path, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0)
+	msg_fatal("create %s: %m", temp_path);
+    if (fstat(fd, &st) < 0)
+	msg_fatal("fstat %s: %m", temp_path);
+    sprintf(path, "incoming/%06d", seqno);
+    if (rename(temp_path, path) < 0)
+	msg_fatal("rename %s to %s: %m", temp_path, path);
+    memset(buf, 'x', sizeof(buf));
+    for (i = 0; i < size; i++)
+	if (write(fd, buf, sizeof(buf)) != sizeof(buf))
+	    msg_fatal("write: %m");
+    if (fchmod(fd, 0700) < 0)
+	msg_fatal("fchmod %s: %m", path);
+    if (fsync(fd))
+	msg_fatal("fsync: %m");
+    if (close(fd))
+	msg_fatal("close: %m");
+}
+
+/* deliver_queue_file - move file to the active queue and deliver it */
+
+static void deliver_queue_file(int seqno, int deliveries)
+{
+    char    old_path[BUFSIZ];
+    char    path[BUFSIZ];
+    FILE   *fp;
+    int     fd;
+    int     n;
+
+    sprintf(old_path, "incoming/%06d", seqno);
+    sprintf(path, "active/%06d", seqno);
+    if (rename(old_path, path))
+	msg_fatal("rename %s to %s: %m", old_path, path);
+    if ((fp = fopen(path, "r")) == 0)
+	msg_fatal("open %s: %m", path);
+    while (fgets(old_path, sizeof(old_path), fp))
+	 /* void */ ;
+    if (fclose(fp))
+	msg_fatal("fclose: %m");
+
+    /*
+     * Each delivery agent opens the queue file, reads the message, and
+     * marks its recipient as done by overwriting the record type.
+     */
+    for (n = 0; n < deliveries; n++) {
+	if ((fd = open(path, O_RDWR, 0)) < 0)
+	    msg_fatal("open %s: %m", path);
+	while (read(fd, old_path, sizeof(old_path)) > 0)
+	     /* void */ ;
+	if (pwrite(fd, "D", 1, (off_t) (n % 1024)) != 1)
+	    msg_fatal("write %s: %m", path);
+	if (close(fd))
+	    msg_fatal("close: %m");
+    }
+}
+
+/* remove_queue_file - delete delivered file */
+
+static void remove_queue_file(int seqno)
+{
+    char    path[BUFSIZ];
+
+    sprintf(path, "active/%06d", seqno);
+    if (remove(path))
+	msg_fatal("remove %s: %m", path);
+}
+
+ /*
+  * Segment log simulation. Each record starts with a header that identifies
+  * the message and its length, so that a segment file can be read without
+  * a separate index; a negative length marks a removed message. The
+  * in-memory index maps each message to its segment, offset and length.
+  */
+#define LOG_SEG_LIMIT	(4 * 1024 * 1024)	/* segment rollover size */
+#define LOG_SEG_COMPACT	4		/* compact when live < size / 4 */
+
+typedef struct {
+    int     seqno;			/* message */
+    int     len;			/* data length, or -1 */
+} LOG_HDR;
+
+typedef struct {
+    int     seg;			/* segment, or -1 */
+    off_t   offset;			/* record offset */
+    int     len;			/* data length */
+} LOG_REC;
+
+typedef struct {
+    int     fd;				/* segment file, or -1 */
+    off_t   size;			/* bytes appended */
+    off_t   live;			/* live data bytes */
+} LOG_SEG;
+
+typedef struct {
+    LOG_REC *recs;			/* per-message index */
+    int     rec_count;			/* index size */
+    LOG_SEG *segs;			/* all segments so far */
+    int     seg_alloc;			/* segment array size */
+    int     seg_count;			/* segments created */
+    int     seg_removed;		/* segments removed */
+    int     cur;			/* current segment */
+    int     compacted;			/* messages copied */
+    char   *buf;			/* message buffer */
+} LOG;
+
+/* log_seg_path - segment file name */
+
+static const char *log_seg_path(int seg)
+{
+    static char path[BUFSIZ];
+
+    sprintf(path, "seg%06d", seg);
+    return (path);
+}
+
+/* log_new_seg - start new segment */
+
+static void log_new_seg(LOG *log)
+{
+    LOG_SEG *sp;
+    const char *path;
+
+    if (log->seg_count >= log->seg_alloc) {
+	log->seg_alloc *= 2;
+	log->segs = (LOG_SEG *) myrealloc((void *) log->segs,
+				      log->seg_alloc * sizeof(*log->segs));
+    }
+    log->cur = log->seg_count++;
+    sp = log->segs + log->cur;
+    path = log_seg_path(log->cur);
+    if ((sp->fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0)
+	msg_fatal("create %s: %m", path);
+    sp->size = sp->live = 0;
+}
+
+/* log_append - append message to current segment */
+
+static void log_append(LOG *log, int seqno, int len, int sync)
+{
+    LOG_HDR *hp = (LOG_HDR *) log->buf;
+    LOG_SEG *sp = log->segs + log->cur;
+    LOG_REC *rp = log->recs + seqno;
+    ssize_t reclen = sizeof(*hp) + (len > 0 ? len : 0);
+
+    if (sp->size > 0 && sp->size + reclen > LOG_SEG_LIMIT) {
+	log_new_seg(log);
+	sp = log->segs + log->cur;
+    }
+    hp->seqno = seqno;
+    hp->len = len;
+    if (pwrite(sp->fd, log->buf, reclen, sp->size) != reclen)
+	msg_fatal("write %s: %m", log_seg_path(log->cur));
+    if (sync && fsync(sp->fd))
+	msg_fatal("fsync: %m");
+    if (len >= 0) {
+	rp->seg = log->cur;
+	rp->offset = sp->size;
+	rp->len = len;
+	sp->live += len;
+    }
+    sp->size += reclen;
+}
+
+/* log_read - read message */
+
+static void log_read(LOG *log, int seqno)
+{
+    LOG_HDR *hp = (LOG_HDR *) log->buf;
+    LOG_REC *rp = log->recs + seqno;
+    ssize_t reclen = sizeof(*hp) + rp->len;
+
+    if (rp->seg < 0)
+	msg_panic("log_read: message %d is not stored", seqno);
+    if (pread(log->segs[rp->seg].fd, log->buf, reclen, rp->offset) != reclen)
+	msg_fatal("read %s: %m", log_seg_path(rp->seg));
+    if (hp->seqno != seqno || hp->len != rp->len)
+	msg_fatal("%s: bad record at offset %ld",
+		  log_seg_path(rp->seg), (long) rp->offset);
+}
+
+/* log_deliver - read message and mark recipients as done, in place */
+
+static void log_deliver(LOG *log, int seqno, int deliveries)
+{
+    LOG_REC *rp = log->recs + seqno;
+    int     n;
+
+    for (n = 0; n < deliveries; n++) {
+	log_read(log, seqno);
+	if (pwrite(log->segs[rp->seg].fd, "D", 1,
+		   rp->offset + sizeof(LOG_HDR) + n % rp->len) != 1)
+	    msg_fatal("write %s: %m", log_seg_path(rp->seg));
+    }
+}
+
+/* log_remove_seg - delete segment file */
+
+static void log_remove_seg(LOG *log, int seg)
+{
+    const char *path = log_seg_path(seg);
+
+    if (close(log->segs[seg].fd) || remove(path))
+	msg_fatal("remove %s: %m", path);
+    log->segs[seg].fd = -1;
+    log->seg_removed++;
+}
+
+/* log_compact - copy live messages out of mostly dead segment */
+
+static void log_compact(LOG *log, int seg)
+{
+    int     seqno;
+
+    for (seqno = 0; seqno < log->rec_count; seqno++) {
+	if (log->recs[seqno].seg != seg)
+	    continue;
+	log_read(log, seqno);
+	log_append(log, seqno, log->recs[seqno].len, 0);
+	log->compacted++;
+    }
+    if (fsync(log->segs[log->cur].fd))
+	msg_fatal("fsync: %m");
+    log_remove_seg(log, seg);
+}
+
+/* log_remove - remove message */
+
+static void log_remove(LOG *log, int seqno)
+{
+    LOG_REC *rp = log->recs + seqno;
+    LOG_SEG *sp;
+    int     seg = rp->seg;
+
+    if (seg < 0)
+	msg_panic("log_remove: message %d is not stored", seqno);
+    log_append(log, seqno, -1, 0);
+    sp = log->segs + seg;			/* after realloc */
+    sp->live -= rp->len;
+    rp->seg = -1;
+    if (seg != log->cur) {
+	if (sp->live == 0)
+	    log_remove_seg(log, seg);
+	else if (sp->live * LOG_SEG_COMPACT < sp->size)
+	    log_compact(log, seg);
+    }
+}
+
+/* log_create - set up segment log simulation */
+
+static LOG *log_create(int rec_count, int size)
+{
+    LOG    *log;
+    int     seqno;
+
+    log = (LOG *) mymalloc(sizeof(*log));
+    log->recs = (LOG_REC *) mymalloc(rec_count * sizeof(*log->recs));
+    for (seqno = 0; seqno < rec_count; seqno++)
+	log->recs[seqno].seg = -1;
+    log->rec_count = rec_count;
+    log->seg_alloc = 16;
+    log->segs = (LOG_SEG *) mymalloc(log->seg_alloc * sizeof(*log->segs));
+    log->seg_count = 0;
+    log->seg_removed = 0;
+    log->compacted = 0;
+    log->buf = mymalloc(sizeof(LOG_HDR) + size * 1024);
+    memset(log->buf, 'x', sizeof(LOG_HDR) + size * 1024);
+    log_new_seg(log);
+    return (log);
+}
+
+/* log_free - clean up segment log simulation */
+
+static void log_free(LOG *log)
+{
+    int     seg;
+
+    for (seg = 0; seg < log->seg_count; seg++)
+	if (log->segs[seg].fd >= 0)
+	    log_remove_seg(log, seg);
+    myfree((void *) log->segs);
+    myfree((void *) log->recs);
+    myfree(log->buf);
+    myfree((void *) log);
+}
+
 /* usage - explain */
 
 static void usage(char *myname)
 {
-    msg_fatal("usage: %s [-cr] [-s size] messages directory_entries", myname);
+    msg_fatal("usage: %s [-clqr] [-d deliveries] [-s size] "
+	      "messages directory_entries", myname);
 }
 
 MAIL_VERSION_STAMP_DECLARE;
@@ -165,9 +499,14 @@ int     main(int argc, char **argv)
     struct timeval start, end;
     int     do_rename = 0;
     int     do_create = 0;
+    int     do_log = 0;
+    int     do_queue = 0;
+    LOG    *log = 0;
     int     seq;
     int     ch;
     int     size = 2;
+    int     deliveries = 1;
+    int     do_deliver = 0;
 
     /*
      * Fingerprint executables and core dumps.
@@ -175,11 +514,23 @@ int     main(int argc, char **argv)
     MAIL_VERSION_STAMP_ALLOCATE;
 
     msg_vstream_init(argv[0], VSTREAM_ERR);
-    while ((ch = GETOPT(argc, argv, "crs:")) != EOF) {
+    while ((ch = GETOPT(argc, argv, "cd:lqrs:")) != EOF) {
 	switch (ch) {
 	case 'c':
 	    do_create++;
 	    break;
+	case 'd':
+	    if ((deliveries = atoi(optarg)) < 0)
+		usage(argv[0]);
+	    do_deliver++;
+	    break;
+	case 'l':
+	    do_log++;
+	    break;
+	case 'q':
+	    do_queue++;
+	    do_create++;
+	    break;
 	case 'r':
 	    do_rename++;
 	    break;
@@ -192,7 +543,9 @@ int     main(int argc, char **argv)
 	}
     }
 
-    if (argc - optind != 2 || (do_rename && !do_create))
+    if (argc - optind != 2 || (do_rename && !do_create)
+	|| (do_log && do_create) || (do_queue && do_rename)
+	|| (do_deliver && !do_queue && !do_log))
 	usage(argv[0]);
     if ((op_count = atoi(argv[optind])) <= 0)
 	usage(argv[0]);
@@ -200,10 +553,25 @@ int     main(int argc, char **argv)
 	usage(argv[0]);
 
     /*
-     * Populate the directory with little files.
+     * Populate the directory with little files, or the segment log with
+     * little messages.
      */
-    for (seq = 0; seq < max_file; seq++)
-	make_file(seq, size);
+    if (do_log) {
+	log = log_create(max_file, size);
+	for (seq = 0; seq < max_file; seq++)
+	    log_append(log, seq, size * 1024, 1);
+    } else if (do_queue) {
+	if ((mkdir("incoming", 0700) && errno != EEXIST)
+	    || (mkdir("active", 0700) && errno != EEXIST))
+	    msg_fatal("mkdir: %m");
+	for (seq = 0; seq < max_file; seq++) {
+	    make_queue_file(seq, size);
+	    deliver_queue_file(seq, 0);
+	}
+    } else {
+	for (seq = 0; seq < max_file; seq++)
+	    make_file(seq, size);
+    }
 
     /*
      * Simulate arrival and delivery of mail messages.
@@ -211,7 +579,16 @@ int     main(int argc, char **argv)
     GETTIMEOFDAY(&start);
     while (op_count > 0) {
 	seq %= max_file;
-	if (do_create) {
+	if (do_log) {
+	    log_remove(log, seq);
+	    log_append(log, seq, size * 1024, 1);
+	    log_read(log, seq);
+	    log_deliver(log, seq, deliveries);
+	} else if (do_queue) {
+	    remove_queue_file(seq);
+	    make_queue_file(seq, size);
+	    deliver_queue_file(seq, deliveries);
+	} else if (do_create) {
 	    remove_file(seq);
 	    make_file(seq, size);
 	    if (do_rename) {
@@ -236,7 +613,18 @@ int     main(int argc, char **argv)
     /*
      * Clean up directory fillers.
      */
-    for (seq = 0; seq < max_file; seq++)
-	remove_silent(seq);
+    if (do_log) {
+	printf("segments: %d created, %d removed, %d messages compacted\n",
+	       log->seg_count, log->seg_removed, log->compacted);
+	log_free(log);
+    } else if (do_queue) {
+	for (seq = 0; seq < max_file; seq++)
+	    remove_queue_file(seq);
+	(void) rmdir("incoming");
+	(void) rmdir("active");
+    } else {
+	for (seq = 0; seq < max_file; seq++)
+	    remove_silent(seq);
+    }
     return (0);
 }
@@ -67,7 +67,14 @@
 /*	int	*auths;
 /* DESCRIPTION
 /*	anvil_clnt_create() instantiates a local anvil service
-/*	client endpoint.
+/*	client endpoint. With anvil_shared_counters_enable, it also
+/*	opens the shared counter table (see anvil_shm(3)); this
+/*	must be done before the process enters its chroot jail, with
+/*	mail_owner privileges. The routines below then update and
+/*	query that table directly while the anvil server maintains
+/*	it, and talk to the anvil server otherwise. A remote client
+/*	session stays with the method that was used to register
+/*	its connection.
 /*
 /*	anvil_clnt_connect() informs the anvil server that a
 /*	remote client has connected, and returns the current
@@ -132,6 +139,7 @@
 /*	server experienced a problem).
 /* SEE ALSO
 /*	anvil(8), connection/rate limiting
+/*	anvil_shm(3), shared counter table
 /* LICENSE
 /* .ad
 /* .fi
@@ -159,36 +167,71 @@
 #include <mail_proto.h>
 #include <mail_params.h>
 #include <anvil_clnt.h>
+#include <anvil_shm.h>
 
 /* Application specific. */
 
 #define ANVIL_IDENT(service, addr) \
     printable(concatenate(service, ":", addr, (char *) 0), '?')
 
+struct ANVIL_CLNT {
+    ATTR_CLNT *attr_clnt;		/* anvil server endpoint */
+    ANVIL_SHM *shm;			/* shared counters or null */
+    int     session;			/* how the connection was registered */
+};
+
+#define ANVIL_CLNT_SESS_NONE	0	/* no connection */
+#define ANVIL_CLNT_SESS_SHM	1	/* shared counters */
+#define ANVIL_CLNT_SESS_IPC	2	/* anvil server */
+
+#define ANVIL_CLNT_USE_SHM(a) \
+    ((a)->shm != 0 && (a)->session != ANVIL_CLNT_SESS_IPC)
+
 /* anvil_clnt_create - instantiate connection rate service client */
 
 ANVIL_CLNT *anvil_clnt_create(void)
 {
-    ATTR_CLNT *anvil_clnt;
+    ANVIL_CLNT *anvil_clnt;
+    char   *path;
+
+    anvil_clnt = (ANVIL_CLNT *) mymalloc(sizeof(*anvil_clnt));
 
     /*
      * Use whatever IPC is preferred for internal use: UNIX-domain sockets or
      * Solaris streams.
      */
 #ifndef VAR_ANVIL_SERVICE
-    anvil_clnt = attr_clnt_create("local:" ANVIL_CLASS "/" ANVIL_SERVICE,
-				  var_ipc_timeout, 0, 0);
+    anvil_clnt->attr_clnt =
+	attr_clnt_create("local:" ANVIL_CLASS "/" ANVIL_SERVICE,
+			 var_ipc_timeout, 0, 0);
 #else
-    anvil_clnt = attr_clnt_create(var_anvil_service, var_ipc_timeout, 0, 0);
+    anvil_clnt->attr_clnt =
+	attr_clnt_create(var_anvil_service, var_ipc_timeout, 0, 0);
 #endif
-    return ((ANVIL_CLNT *) anvil_clnt);
+
+    /*
+     * Optionally, skip the IPC round trip with shared counters.
+     */
+    if (var_anvil_shm_enable) {
+	path = concatenate(var_data_dir, "/", ANVIL_SHM_FILE, (char *) 0);
+	anvil_clnt->shm = anvil_shm_open(path, var_anvil_shm_size,
+					 ANVIL_SHM_FLAG_NONE);
+	myfree(path);
+    } else {
+	anvil_clnt->shm = 0;
+    }
+    anvil_clnt->session = ANVIL_CLNT_SESS_NONE;
+    return (anvil_clnt);
 }
 
 /* anvil_clnt_free - destroy connection rate service client */
 
 void    anvil_clnt_free(ANVIL_CLNT *anvil_clnt)
 {
-    attr_clnt_free((ATTR_CLNT *) anvil_clnt);
+    attr_clnt_free(anvil_clnt->attr_clnt);
+    if (anvil_clnt->shm)
+	anvil_shm_close(anvil_clnt->shm);
+    myfree((void *) anvil_clnt);
 }
 
 /* anvil_clnt_lookup - status query */
@@ -200,7 +243,11 @@ int     anvil_clnt_lookup(ANVIL_CLNT *anvil_clnt, const char *service,
     char   *ident = ANVIL_IDENT(service, addr);
     int     status;
 
-    if (attr_clnt_request((ATTR_CLNT *) anvil_clnt,
+    if (ANVIL_CLNT_USE_SHM(anvil_clnt)
+	&& anvil_shm_lookup(anvil_clnt->shm, ident, count, rate, msgs, rcpts,
+			    newtls, auths) == ANVIL_STAT_OK)
+	status = ANVIL_STAT_OK;
+    else if (attr_clnt_request(anvil_clnt->attr_clnt,
 			  ATTR_FLAG_NONE,	/* Query attributes. */
 			  SEND_ATTR_STR(ANVIL_ATTR_REQ, ANVIL_REQ_LOOKUP),
 			  SEND_ATTR_STR(ANVIL_ATTR_IDENT, ident),
@@ -229,7 +276,18 @@ int     anvil_clnt_connect(ANVIL_CLNT *anvil_clnt, const char *service,
     char   *ident = ANVIL_IDENT(service, addr);
     int     status;
 
-    if (attr_clnt_request((ATTR_CLNT *) anvil_clnt,
+    /*
+     * Use the same method for all requests in this remote client session.
+     */
+    if (anvil_clnt->shm != 0
+	&& anvil_shm_connect(anvil_clnt->shm, ident, count,
+			     rate) == ANVIL_STAT_OK) {
+	anvil_clnt->session = ANVIL_CLNT_SESS_SHM;
+	myfree(ident);
+	return (ANVIL_STAT_OK);
+    }
+    anvil_clnt->session = ANVIL_CLNT_SESS_IPC;
+    if (attr_clnt_request(anvil_clnt->attr_clnt,
 			  ATTR_FLAG_NONE,	/* Query attributes. */
 			  SEND_ATTR_STR(ANVIL_ATTR_REQ, ANVIL_REQ_CONN),
 			  SEND_ATTR_STR(ANVIL_ATTR_IDENT, ident),
@@ -254,7 +312,11 @@ int     anvil_clnt_mail(ANVIL_CLNT *anvil_clnt, const char *service,
     char   *ident = ANVIL_IDENT(service, addr);
     int     status;
 
-    if (attr_clnt_request((ATTR_CLNT *) anvil_clnt,
+    if (ANVIL_CLNT_USE_SHM(anvil_clnt)
+	&& anvil_shm_update(anvil_clnt->shm, ident, ANVIL_SHM_MAIL,
+			    msgs) == ANVIL_STAT_OK)
+	status = ANVIL_STAT_OK;
+    else if (attr_clnt_request(anvil_clnt->attr_clnt,
 			  ATTR_FLAG_NONE,	/* Query attributes. */
 			  SEND_ATTR_STR(ANVIL_ATTR_REQ, ANVIL_REQ_MAIL),
 			  SEND_ATTR_STR(ANVIL_ATTR_IDENT, ident),
@@ -278,7 +340,11 @@ int     anvil_clnt_rcpt(ANVIL_CLNT *anvil_clnt, const char *service,
     char   *ident = ANVIL_IDENT(service, addr);
     int     status;
 
-    if (attr_clnt_request((ATTR_CLNT *) anvil_clnt,
+    if (ANVIL_CLNT_USE_SHM(anvil_clnt)
+	&& anvil_shm_update(anvil_clnt->shm, ident, ANVIL_SHM_RCPT,
+			    rcpts) == ANVIL_STAT_OK)
+	status = ANVIL_STAT_OK;
+    else if (attr_clnt_request(anvil_clnt->attr_clnt,
 			  ATTR_FLAG_NONE,	/* Query attributes. */
 			  SEND_ATTR_STR(ANVIL_ATTR_REQ, ANVIL_REQ_RCPT),
 			  SEND_ATTR_STR(ANVIL_ATTR_IDENT, ident),
@@ -302,7 +368,11 @@ int     anvil_clnt_newtls(ANVIL_CLNT *anvil_clnt, const char *service,
     char   *ident = ANVIL_IDENT(service, addr);
     int     status;
 
-    if (attr_clnt_request((ATTR_CLNT *) anvil_clnt,
+    if (ANVIL_CLNT_USE_SHM(anvil_clnt)
+	&& anvil_shm_update(anvil_clnt->shm, ident, ANVIL_SHM_NTLS,
+			    newtls) == ANVIL_STAT_OK)
+	status = ANVIL_STAT_OK;
+    else if (attr_clnt_request(anvil_clnt->attr_clnt,
 			  ATTR_FLAG_NONE,	/* Query attributes. */
 			  SEND_ATTR_STR(ANVIL_ATTR_REQ, ANVIL_REQ_NTLS),
 			  SEND_ATTR_STR(ANVIL_ATTR_IDENT, ident),
@@ -326,7 +396,11 @@ int     anvil_clnt_newtls_stat(ANVIL_CLNT *anvil_clnt, const char *service,
     char   *ident = ANVIL_IDENT(service, addr);
     int     status;
 
-    if (attr_clnt_request((ATTR_CLNT *) anvil_clnt,
+    if (ANVIL_CLNT_USE_SHM(anvil_clnt)
+	&& anvil_shm_newtls_stat(anvil_clnt->shm, ident,
+				 newtls) == ANVIL_STAT_OK)
+	status = ANVIL_STAT_OK;
+    else if (attr_clnt_request(anvil_clnt->attr_clnt,
 			  ATTR_FLAG_NONE,	/* Query attributes. */
 			  SEND_ATTR_STR(ANVIL_ATTR_REQ, ANVIL_REQ_NTLS_STAT),
 			  SEND_ATTR_STR(ANVIL_ATTR_IDENT, ident),
@@ -350,7 +424,11 @@ int     anvil_clnt_auth(ANVIL_CLNT *anvil_clnt, const char *service,
     char   *ident = ANVIL_IDENT(service, addr);
     int     status;
 
-    if (attr_clnt_request((ATTR_CLNT *) anvil_clnt,
+    if (ANVIL_CLNT_USE_SHM(anvil_clnt)
+	&& anvil_shm_update(anvil_clnt->shm, ident, ANVIL_SHM_AUTH,
+			    auths) == ANVIL_STAT_OK)
+	status = ANVIL_STAT_OK;
+    else if (attr_clnt_request(anvil_clnt->attr_clnt,
 			  ATTR_FLAG_NONE,	/* Query attributes. */
 			  SEND_ATTR_STR(ANVIL_ATTR_REQ, ANVIL_REQ_AUTH),
 			  SEND_ATTR_STR(ANVIL_ATTR_IDENT, ident),
@@ -374,7 +452,9 @@ int     anvil_clnt_disconnect(ANVIL_CLNT *anvil_clnt, const char *service,
     char   *ident = ANVIL_IDENT(service, addr);
     int     status;
 
-    if (attr_clnt_request((ATTR_CLNT *) anvil_clnt,
+    if (anvil_clnt->session == ANVIL_CLNT_SESS_SHM)
+	status = anvil_shm_disconnect(anvil_clnt->shm, ident);
+    else if (attr_clnt_request(anvil_clnt->attr_clnt,
 			  ATTR_FLAG_NONE,	/* Query attributes. */
 			  SEND_ATTR_STR(ANVIL_ATTR_REQ, ANVIL_REQ_DISC),
 			  SEND_ATTR_STR(ANVIL_ATTR_IDENT, ident),
@@ -385,6 +465,7 @@ int     anvil_clnt_disconnect(ANVIL_CLNT *anvil_clnt, const char *service,
 	status = ANVIL_STAT_FAIL;
     else if (status != ANVIL_STAT_OK)
 	status = ANVIL_STAT_FAIL;
+    anvil_clnt->session = ANVIL_CLNT_SESS_NONE;
     myfree(ident);
     return (status);
 }
@@ -0,0 +1,899 @@
+/*++
+/* NAME
+/*	anvil_shm 3
+/* SUMMARY
+/*	shared-memory connection count and rate table
+/* SYNOPSIS
+/*	#include <anvil_shm.h>
+/*
+/*	ANVIL_SHM *anvil_shm_open(path, size, flags)
+/*	const char *path;
+/*	int	size;
+/*	int	flags;
+/*
+/*	int	anvil_shm_connect(shm, ident, count, rate)
+/*	ANVIL_SHM *shm;
+/*	const char *ident;
+/*	int	*count;
+/*	int	*rate;
+/*
+/*	int	anvil_shm_update(shm, ident, what, rate)
+/*	ANVIL_SHM *shm;
+/*	const char *ident;
+/*	int	what;
+/*	int	*rate;
+/*
+/*	int	anvil_shm_newtls_stat(shm, ident, newtls)
+/*	ANVIL_SHM *shm;
+/*	const char *ident;
+/*	int	*newtls;
+/*
+/*	int	anvil_shm_lookup(shm, ident, count, rate, msgs, rcpts,
+/*					newtls, auths)
+/*	ANVIL_SHM *shm;
+/*	const char *ident;
+/*	int	*count;
+/*	int	*rate;
+/*	int	*msgs;
+/*	int	*rcpts;
+/*	int	*newtls;
+/*	int	*auths;
+/*
+/*	int	anvil_shm_disconnect(shm, ident)
+/*	ANVIL_SHM *shm;
+/*	const char *ident;
+/*
+/*	void	anvil_shm_close(shm)
+/*	ANVIL_SHM *shm;
+/* SERVER INTERFACE
+/*	void	anvil_shm_maintain(shm, time_unit)
+/*	ANVIL_SHM *shm;
+/*	int	time_unit;
+/*
+/*	void	anvil_shm_peaks(shm, peaks)
+/*	ANVIL_SHM *shm;
+/*	ANVIL_SHM_PEAK peaks[ANVIL_SHM_PEAK_COUNT];
+/* DESCRIPTION
+/*	This module maintains anvil(8) connection count and rate
+/*	information in a memory-mapped file, so that server processes
+/*	can update that information without a round trip to the
+/*	anvil(8) server. The semantics are those of the anvil(8)
+/*	server: rates are reset after each anvil_rate_time_unit
+/*	interval, a local server process is counted as connected
+/*	to at most one remote client, and unused information is
+/*	discarded after it expires.
+/*
+/*	The table has a fixed number of (service, client) entries,
+/*	and each update is done while holding an exclusive lock on
+/*	the file. The anvil(8) server owns the table: it updates a
+/*	heartbeat time stamp, removes expired information, drops
+/*	connections of local server processes that terminated
+/*	without disconnecting, and logs the peak usage. The table
+/*	is used only while that heartbeat is recent.
+/*
+/*	anvil_shm_open() opens the specified file, creates it when
+/*	it does not exist, and maps it into memory. The size argument
+/*	specifies the number of (service, client) entries for a new
+/*	table. With ANVIL_SHM_FLAG_OWNER, an existing table with a
+/*	different size is replaced with a new one; otherwise the
+/*	existing size is used. The result is a null pointer in case
+/*	of error.
+/*
+/*	anvil_shm_connect() registers a connection from the specified
+/*	remote client for the calling process, and returns the
+/*	current connection count and connection rate.
+/*
+/*	anvil_shm_update() registers an ANVIL_SHM_MAIL, ANVIL_SHM_RCPT,
+/*	ANVIL_SHM_NTLS or ANVIL_SHM_AUTH event, and returns the
+/*	current rate for that event type.
+/*
+/*	anvil_shm_newtls_stat() returns the current new TLS session
+/*	rate without updating it.
+/*
+/*	anvil_shm_lookup() returns all count and rate information
+/*	for the specified remote client.
+/*
+/*	anvil_shm_disconnect() drops the connection that the calling
+/*	process registered for the specified remote client.
+/*
+/*	anvil_shm_close() unmaps the table. When called by the
+/*	owner, it also clears the heartbeat, so that other processes
+/*	stop using the table.
+/*
+/*	anvil_shm_maintain() is called periodically by the anvil(8)
+/*	server. It updates the heartbeat and the rate time unit,
+/*	drops connections of processes that no longer exist, and
+/*	removes expired information.
+/*
+/*	anvil_shm_peaks() copies the peak values that were measured
+/*	since the previous call, and resets them.
+/*
+/*	Arguments:
+/* .IP path
+/*	Pathname of the table file.
+/* .IP size
+/*	The number of (service, client) entries.
+/* .IP flags
+/*	ANVIL_SHM_FLAG_OWNER or ANVIL_SHM_FLAG_NONE.
+/* .IP shm
+/*	Table handle.
+/* .IP ident
+/*	Null-terminated (service, client) name.
+/* .IP time_unit
+/*	The time unit over which rates are calculated.
+/* DIAGNOSTICS
+/*	The update and query routines return ANVIL_STAT_OK in case
+/*	of success, and ANVIL_STAT_FAIL when the table cannot be
+/*	used: the anvil(8) server is not running, the name is too
+/*	long, or the table has no room for the name. The caller
+/*	should then use the anvil(8) server instead.
+/*
+/*	Problems with the table file are logged as a warning.
+/* BUGS
+/*	A remote client with a name that hashes to a full part of
+/*	the table is handled by the anvil(8) server, and its counts
+/*	are not combined with those in the table.
+/*
+/*	Terminated processes are detected with kill(2) and a process
+/*	ID; a reused process ID keeps a connection alive until that
+/*	process terminates, too.
+/* SEE ALSO
+/*	anvil(8), connection count and rate management
+/*	anvil_clnt(3), anvil(8) client
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <limits.h>
+
+#ifndef MAP_FAILED
+#define MAP_FAILED	((void *) -1)
+#endif
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <myflock.h>
+#include <iostuff.h>
+
+/* Global library. */
+
+#include <anvil_clnt.h>
+#include <anvil_shm.h>
+
+/* Application-specific. */
+
+#define ANVIL_SHM_MAGIC	0x616e7631	/* "anv1" */
+#define ANVIL_SHM_PROBE	16		/* max entries per name */
+
+ /*
+  * Per (service, client) information, as in the anvil(8) server. An entry
+  * with an empty name is free.
+  */
+typedef struct {
+    unsigned hash;			/* name hash */
+    int     count;			/* connection count */
+    int     rate;			/* connection rate */
+    int     mail;			/* message rate */
+    int     rcpt;			/* recipient rate */
+    int     ntls;			/* new TLS session rate */
+    int     auth;			/* AUTH request rate */
+    time_t  start;			/* time of first rate sample */
+    time_t  expire;			/* unused entry expiration time */
+    char    ident[ANVIL_SHM_IDENT_LEN];	/* lookup key */
+} ANVIL_SHM_REMOTE;
+
+ /*
+  * Per local server process information, so that we can drop the connection
+  * of a process that terminates without disconnecting. An entry with a zero
+  * process ID is free.
+  */
+typedef struct {
+    pid_t   pid;			/* local server process */
+    int     remote;			/* remote client entry */
+} ANVIL_SHM_LOCAL;
+
+ /*
+  * The file starts with a header, followed by the remote client and local
+  * server tables, which have the same number of entries.
+  */
+typedef struct {
+    unsigned magic;			/* ANVIL_SHM_MAGIC */
+    int     remote_size;		/* sizeof(ANVIL_SHM_REMOTE) */
+    int     size;			/* table entries */
+    int     used;			/* remote entries in use */
+    int     time_unit;			/* anvil_rate_time_unit */
+    time_t  heartbeat;			/* anvil(8) server is running */
+    ANVIL_SHM_PEAK peaks[ANVIL_SHM_PEAK_COUNT];
+} ANVIL_SHM_HDR;
+
+struct ANVIL_SHM {
+    int     fd;				/* table file */
+    int     flags;			/* ANVIL_SHM_FLAG_XXX */
+    size_t  len;			/* mapped length */
+    int     size;			/* table entries, as mapped */
+    ANVIL_SHM_HDR *hdr;			/* mapped file */
+    ANVIL_SHM_REMOTE *remote;		/* remote client table */
+    ANVIL_SHM_LOCAL *local;		/* local server table */
+};
+
+#define ANVIL_SHM_LEN(size) (sizeof(ANVIL_SHM_HDR) \
+	+ (size) * (sizeof(ANVIL_SHM_REMOTE) + sizeof(ANVIL_SHM_LOCAL)))
+
+ /*
+  * Every smtpd(8) process can write the table, so don't trust what it says
+  * about table positions. Use the table size that was mapped, not the size
+  * in the file header.
+  */
+#define ANVIL_SHM_REMOTE_OK(shm, local) \
+	((local)->remote >= 0 && (local)->remote < (shm)->size)
+
+ /*
+  * The anvil(8) server stopped updating the heartbeat.
+  */
+#define ANVIL_SHM_STALE(hdr, now) ((hdr)->heartbeat + 3 * ANVIL_SHM_TICK < (now))
+
+ /*
+  * Same as in the anvil(8) server.
+  */
+#define ANVIL_SHM_RSET_RATE(remote, _start) do { \
+	(remote)->rate = 0; \
+	(remote)->mail = 0; \
+	(remote)->rcpt = 0; \
+	(remote)->ntls = 0; \
+	(remote)->auth = 0; \
+	(remote)->start = (_start); \
+    } while (0)
+
+#define ANVIL_SHM_INCR(hdr, remote, now, _what) do { \
+	if ((remote)->start + (hdr)->time_unit < (now)) \
+	    ANVIL_SHM_RSET_RATE((remote), (now)); \
+	if ((remote)->_what < INT_MAX) \
+	    (remote)->_what += 1; \
+    } while (0)
+
+#define ANVIL_SHM_PEAK_UPDATE(hdr, which, _value, _ident, now) do { \
+	ANVIL_SHM_PEAK *_peak = (hdr)->peaks + (which); \
+	if ((_value) > _peak->value) { \
+	    _peak->value = (_value); \
+	    _peak->when = (now); \
+	    strcpy(_peak->ident, (_ident)); \
+	} \
+    } while (0)
+
+/* anvil_shm_hash - hash a string */
+
+static unsigned anvil_shm_hash(const char *s)
+{
+    unsigned long h = 0;
+    unsigned long g;
+
+    /*
+     * From the "Dragon" book by Aho, Sethi and Ullman. All processes must
+     * compute the same value, so there is no per-process seed.
+     */
+    while (*s) {
+	h = (h << 4U) + *(unsigned const char *) s++;
+	if ((g = (h & 0xf0000000)) != 0) {
+	    h ^= (g >> 24U);
+	    h ^= g;
+	}
+    }
+    return (h);
+}
+
+/* anvil_shm_lock - lock table, and check that it may be used */
+
+static int anvil_shm_lock(ANVIL_SHM *shm, const char *ident, time_t *now)
+{
+    if (strlen(ident) >= ANVIL_SHM_IDENT_LEN)
+	return (ANVIL_STAT_FAIL);
+    if (myflock(shm->fd, INTERNAL_LOCK, MYFLOCK_OP_EXCLUSIVE) < 0) {
+	msg_warn("lock anvil counter table: %m");
+	return (ANVIL_STAT_FAIL);
+    }
+    *now = time((time_t *) 0);
+    if (ANVIL_SHM_STALE(shm->hdr, *now)) {
+	if (msg_verbose)
+	    msg_info("anvil_shm_lock: anvil server heartbeat is stale");
+	if (myflock(shm->fd, INTERNAL_LOCK, MYFLOCK_OP_NONE) < 0)
+	    msg_fatal("unlock anvil counter table: %m");
+	return (ANVIL_STAT_FAIL);
+    }
+    return (ANVIL_STAT_OK);
+}
+
+/* anvil_shm_unlock - unlock table */
+
+static void anvil_shm_unlock(ANVIL_SHM *shm)
+{
+    if (myflock(shm->fd, INTERNAL_LOCK, MYFLOCK_OP_NONE) < 0)
+	msg_fatal("unlock anvil counter table: %m");
+}
+
+/* anvil_shm_find - look up or create remote client entry */
+
+static ANVIL_SHM_REMOTE *anvil_shm_find(ANVIL_SHM *shm, const char *ident,
+					        time_t now, int create)
+{
+    ANVIL_SHM_HDR *hdr = shm->hdr;
+    ANVIL_SHM_REMOTE *remote;
+    ANVIL_SHM_REMOTE *spare = 0;
+    unsigned hash = anvil_shm_hash(ident);
+    int     n;
+
+    /*
+     * Probe a fixed number of entries. An expired entry is as good as a free
+     * one; the anvil(8) server may not have removed it yet.
+     */
+    for (n = 0; n < ANVIL_SHM_PROBE && n < shm->size; n++) {
+	remote = shm->remote + (hash + n) % shm->size;
+	if (remote->ident[0] == 0) {
+	    if (spare == 0)
+		spare = remote;
+	} else if (remote->hash == hash && strcmp(remote->ident, ident) == 0) {
+	    return (remote);
+	} else if (remote->count == 0 && remote->expire <= now) {
+	    if (spare == 0)
+		spare = remote;
+	}
+    }
+    if (create == 0 || spare == 0)
+	return (0);
+    if (spare->ident[0] == 0)
+	hdr->used += 1;
+    spare->hash = hash;
+    strcpy(spare->ident, ident);
+    spare->count = 0;
+    spare->expire = 0;
+    ANVIL_SHM_RSET_RATE(spare, now);
+    ANVIL_SHM_PEAK_UPDATE(hdr, ANVIL_SHM_PEAK_CACHE_SIZE, hdr->used, "", now);
+    return (spare);
+}
+
+/* anvil_shm_local - look up or create local server entry */
+
+static ANVIL_SHM_LOCAL *anvil_shm_local(ANVIL_SHM *shm, pid_t pid, int create)
+{
+    ANVIL_SHM_LOCAL *local;
+    ANVIL_SHM_LOCAL *spare = 0;
+    int     n;
+
+    for (n = 0; n < ANVIL_SHM_PROBE && n < shm->size; n++) {
+	local = shm->local + ((unsigned) pid + n) % shm->size;
+	if (local->pid == pid)
+	    return (local);
+	if (local->pid == 0 && spare == 0)
+	    spare = local;
+    }
+    if (create && spare != 0)
+	spare->pid = pid;
+    return (create ? spare : 0);
+}
+
+/* anvil_shm_drop - drop one connection */
+
+static void anvil_shm_drop(ANVIL_SHM *shm, ANVIL_SHM_LOCAL *local, time_t now)
+{
+    ANVIL_SHM_REMOTE *remote;
+
+    if (ANVIL_SHM_REMOTE_OK(shm, local)) {
+	remote = shm->remote + local->remote;
+	if (remote->ident[0] != 0 && remote->count > 0)
+	    if (--remote->count == 0)
+		remote->expire = now + shm->hdr->time_unit;
+    }
+    local->pid = 0;
+}
+
+/* anvil_shm_conn_update - register connection from remote client */
+
+static ANVIL_SHM_REMOTE *anvil_shm_conn_update(ANVIL_SHM *shm,
+					               const char *ident,
+					               time_t now)
+{
+    ANVIL_SHM_HDR *hdr = shm->hdr;
+    ANVIL_SHM_REMOTE *remote;
+    ANVIL_SHM_LOCAL *local;
+    pid_t   pid = getpid();
+
+    /*
+     * Like the anvil(8) server, count a local server as connected to at most
+     * one remote client.
+     */
+    if ((local = anvil_shm_local(shm, pid, 0)) != 0)
+	anvil_shm_drop(shm, local, now);
+    if ((remote = anvil_shm_find(shm, ident, now, 1)) == 0
+	|| (local = anvil_shm_local(shm, pid, 1)) == 0)
+	return (0);
+    ANVIL_SHM_INCR(hdr, remote, now, rate);
+    remote->count += 1;
+    remote->expire = 0;
+    local->remote = remote - shm->remote;
+    return (remote);
+}
+
+/* anvil_shm_connect - register connection, query status */
+
+int     anvil_shm_connect(ANVIL_SHM *shm, const char *ident,
+			          int *count, int *rate)
+{
+    ANVIL_SHM_HDR *hdr = shm->hdr;
+    ANVIL_SHM_REMOTE *remote;
+    time_t  now;
+
+    if (anvil_shm_lock(shm, ident, &now) != ANVIL_STAT_OK)
+	return (ANVIL_STAT_FAIL);
+    if ((remote = anvil_shm_conn_update(shm, ident, now)) != 0) {
+	*count = remote->count;
+	*rate = remote->rate;
+	ANVIL_SHM_PEAK_UPDATE(hdr, ANVIL_SHM_PEAK_CONN_RATE,
+			      remote->rate, ident, now);
+	ANVIL_SHM_PEAK_UPDATE(hdr, ANVIL_SHM_PEAK_CONN_COUNT,
+			      remote->count, ident, now);
+    }
+    anvil_shm_unlock(shm);
+    return (remote ? ANVIL_STAT_OK : ANVIL_STAT_FAIL);
+}
+
+/* anvil_shm_update - register event, query status */
+
+int     anvil_shm_update(ANVIL_SHM *shm, const char *ident, int what,
+			         int *rate)
+{
+    ANVIL_SHM_HDR *hdr = shm->hdr;
+    ANVIL_SHM_REMOTE *remote;
+    time_t  now;
+
+    if (anvil_shm_lock(shm, ident, &now) != ANVIL_STAT_OK)
+	return (ANVIL_STAT_FAIL);
+
+    /*
+     * Like the anvil(8) server, be prepared for an event without connect.
+     */
+    if ((remote = anvil_shm_find(shm, ident, now, 0)) == 0)
+	remote = anvil_shm_conn_update(shm, ident, now);
+    if (remote != 0) {
+	switch (what) {
+	case ANVIL_SHM_MAIL:
+	    ANVIL_SHM_INCR(hdr, remote, now, mail);
+	    *rate = remote->mail;
+	    ANVIL_SHM_PEAK_UPDATE(hdr, ANVIL_SHM_PEAK_MAIL_RATE,
+				  remote->mail, ident, now);
+	    break;
+	case ANVIL_SHM_RCPT:
+	    ANVIL_SHM_INCR(hdr, remote, now, rcpt);
+	    *rate = remote->rcpt;
+	    ANVIL_SHM_PEAK_UPDATE(hdr, ANVIL_SHM_PEAK_RCPT_RATE,
+				  remote->rcpt, ident, now);
+	    break;
+	case ANVIL_SHM_NTLS:
+	    ANVIL_SHM_INCR(hdr, remote, now, ntls);
+	    *rate = remote->ntls;
+	    ANVIL_SHM_PEAK_UPDATE(hdr, ANVIL_SHM_PEAK_NTLS_RATE,
+				  remote->ntls, ident, now);
+	    break;
+	case ANVIL_SHM_AUTH:
+	    ANVIL_SHM_INCR(hdr, remote, now, auth);
+	    *rate = remote->auth;
+	    ANVIL_SHM_PEAK_UPDATE(hdr, ANVIL_SHM_PEAK_AUTH_RATE,
+				  remote->auth, ident, now);
+	    break;
+	default:
+	    msg_panic("anvil_shm_update: unknown event type: %d", what);
+	}
+    }
+    anvil_shm_unlock(shm);
+    return (remote ? ANVIL_STAT_OK : ANVIL_STAT_FAIL);
+}
+
+/* anvil_shm_newtls_stat - query newtls status */
+
+int     anvil_shm_newtls_stat(ANVIL_SHM *shm, const char *ident, int *newtls)
+{
+    int     count;
+    int     rate;
+    int     msgs;
+    int     rcpts;
+    int     auths;
+
+    return (anvil_shm_lookup(shm, ident, &count, &rate, &msgs, &rcpts,
+			     newtls, &auths));
+}
+
+/* anvil_shm_lookup - query status */
+
+int     anvil_shm_lookup(ANVIL_SHM *shm, const char *ident, int *count,
+			         int *rate, int *msgs, int *rcpts,
+			         int *newtls, int *auths)
+{
+    ANVIL_SHM_REMOTE *remote;
+    time_t  now;
+
+    if (anvil_shm_lock(shm, ident, &now) != ANVIL_STAT_OK)
+	return (ANVIL_STAT_FAIL);
+    if ((remote = anvil_shm_find(shm, ident, now, 0)) == 0) {
+	*count = *rate = *msgs = *rcpts = *newtls = *auths = 0;
+    } else {
+
+	/*
+	 * Do not report stale information.
+	 */
+	if (remote->start != 0
+	    && remote->start + shm->hdr->time_unit < now)
+	    ANVIL_SHM_RSET_RATE(remote, 0);
+	*count = remote->count;
+	*rate = remote->rate;
+	*msgs = remote->mail;
+	*rcpts = remote->rcpt;
+	*newtls = remote->ntls;
+	*auths = remote->auth;
+    }
+    anvil_shm_unlock(shm);
+    return (ANVIL_STAT_OK);
+}
+
+/* anvil_shm_disconnect - drop connection */
+
+int     anvil_shm_disconnect(ANVIL_SHM *shm, const char *ident)
+{
+    ANVIL_SHM_LOCAL *local;
+    time_t  now;
+
+    /*
+     * Drop the connection even when the heartbeat is stale; the connection
+     * was registered here, not with the anvil(8) server.
+     */
+    if (strlen(ident) >= ANVIL_SHM_IDENT_LEN)
+	return (ANVIL_STAT_FAIL);
+    if (myflock(shm->fd, INTERNAL_LOCK, MYFLOCK_OP_EXCLUSIVE) < 0) {
+	msg_warn("lock anvil counter table: %m");
+	return (ANVIL_STAT_FAIL);
+    }
+    now = time((time_t *) 0);
+    if ((local = anvil_shm_local(shm, getpid(), 0)) != 0
+	&& ANVIL_SHM_REMOTE_OK(shm, local)
+	&& strcmp(shm->remote[local->remote].ident, ident) == 0)
+	anvil_shm_drop(shm, local, now);
+    anvil_shm_unlock(shm);
+    return (ANVIL_STAT_OK);
+}
+
+/* anvil_shm_maintain - heartbeat and garbage collection */
+
+void    anvil_shm_maintain(ANVIL_SHM *shm, int time_unit)
+{
+    ANVIL_SHM_HDR *hdr = shm->hdr;
+    ANVIL_SHM_REMOTE *remote;
+    ANVIL_SHM_LOCAL *local;
+    time_t  now;
+    int     n;
+
+    if (myflock(shm->fd, INTERNAL_LOCK, MYFLOCK_OP_EXCLUSIVE) < 0) {
+	msg_warn("lock anvil counter table: %m");
+	return;
+    }
+    now = time((time_t *) 0);
+    hdr->heartbeat = now;
+    hdr->time_unit = time_unit;
+
+    /*
+     * Drop the connections of local servers that went away without
+     * disconnecting, as the anvil(8) server does when a client closes its
+     * socket.
+     */
+    for (local = shm->local; local < shm->local + shm->size; local++)
+	if (local->pid != 0 && kill(local->pid, 0) < 0 && errno == ESRCH)
+	    anvil_shm_drop(shm, local, now);
+
+    /*
+     * Remove expired information.
+     */
+    for (n = 0, remote = shm->remote; remote < shm->remote + shm->size; remote++) {
+	if (remote->ident[0] == 0)
+	    continue;
+	if (remote->count == 0 && remote->expire <= now) {
+	    if (msg_verbose)
+		msg_info("anvil_shm_maintain: expire %.*s",
+			 (int) sizeof(remote->ident), remote->ident);
+	    remote->ident[0] = 0;
+	} else {
+	    n++;
+	}
+    }
+    hdr->used = n;
+    anvil_shm_unlock(shm);
+}
+
+/* anvil_shm_peaks - report and reset peak usage */
+
+void    anvil_shm_peaks(ANVIL_SHM *shm, ANVIL_SHM_PEAK *peaks)
+{
+    ANVIL_SHM_HDR *hdr = shm->hdr;
+    int     n;
+
+    if (myflock(shm->fd, INTERNAL_LOCK, MYFLOCK_OP_EXCLUSIVE) < 0) {
+	msg_warn("lock anvil counter table: %m");
+	memset((void *) peaks, 0, sizeof(hdr->peaks));
+	return;
+    }
+    memcpy((void *) peaks, (void *) hdr->peaks, sizeof(hdr->peaks));
+    memset((void *) hdr->peaks, 0, sizeof(hdr->peaks));
+    anvil_shm_unlock(shm);
+    for (n = 0; n < ANVIL_SHM_PEAK_COUNT; n++)
+	peaks[n].ident[sizeof(peaks[n].ident) - 1] = 0;
+}
+
+/* anvil_shm_create - initialize new table */
+
+static int anvil_shm_create(int fd, int size)
+{
+    ANVIL_SHM_HDR hdr;
+
+    if (ftruncate(fd, ANVIL_SHM_LEN(size)) < 0)
+	return (-1);
+    memset((void *) &hdr, 0, sizeof(hdr));
+    hdr.magic = ANVIL_SHM_MAGIC;
+    hdr.remote_size = sizeof(ANVIL_SHM_REMOTE);
+    hdr.size = size;
+    if (lseek(fd, (off_t) 0, SEEK_SET) < 0
+	|| write(fd, (void *) &hdr, sizeof(hdr)) != sizeof(hdr))
+	return (-1);
+    return (0);
+}
+
+/* anvil_shm_open - open or create table */
+
+ANVIL_SHM *anvil_shm_open(const char *path, int size, int flags)
+{
+    ANVIL_SHM *shm;
+    ANVIL_SHM_HDR hdr;
+    struct stat st;
+    void   *ptr;
+    int     fd;
+    int     valid;
+
+    if (size <= 0)
+	msg_panic("anvil_shm_open: bad table size: %d", size);
+
+    /*
+     * Processes that use the table may start before the anvil(8) server,
+     * so any of them may create the file. Initialize while holding the
+     * lock, so that other processes never see a partial header.
+     */
+    for (;;) {
+	if ((fd = open(path, O_RDWR | O_CREAT, 0600)) < 0) {
+	    msg_warn("open %s: %m", path);
+	    return (0);
+	}
+	if (myflock(fd, INTERNAL_LOCK, MYFLOCK_OP_EXCLUSIVE) < 0) {
+	    msg_warn("lock %s: %m", path);
+	    (void) close(fd);
+	    return (0);
+	}
+	if (fstat(fd, &st) < 0)
+	    msg_fatal("fstat %s: %m", path);
+	if (st.st_size == 0) {
+	    if (anvil_shm_create(fd, size) < 0) {
+		msg_warn("initialize %s: %m", path);
+		(void) close(fd);
+		return (0);
+	    }
+	    break;
+	}
+	valid = (read(fd, (void *) &hdr, sizeof(hdr)) == sizeof(hdr)
+		 && hdr.magic == ANVIL_SHM_MAGIC
+		 && hdr.remote_size == sizeof(ANVIL_SHM_REMOTE)
+		 && hdr.size > 0
+		 && st.st_size == (off_t) ANVIL_SHM_LEN(hdr.size));
+	if (valid && (hdr.size == size || (flags & ANVIL_SHM_FLAG_OWNER) == 0)) {
+	    size = hdr.size;
+	    break;
+	}
+	if ((flags & ANVIL_SHM_FLAG_OWNER) == 0) {
+	    msg_warn("%s: bad table format", path);
+	    (void) close(fd);
+	    return (0);
+	}
+
+	/*
+	 * The owner replaces a table with the wrong size or format. Processes
+	 * that still use the old file will see its heartbeat go stale.
+	 */
+	msg_info("%s: creating new table with %d entries", path, size);
+	if (unlink(path) < 0)
+	    msg_fatal("remove %s: %m", path);
+	(void) close(fd);
+    }
+    close_on_exec(fd, CLOSE_ON_EXEC);
+
+    if ((ptr = mmap((void *) 0, ANVIL_SHM_LEN(size), PROT_READ | PROT_WRITE,
+		    MAP_SHARED, fd, (off_t) 0)) == MAP_FAILED) {
+	msg_warn("mmap %s: %m", path);
+	(void) close(fd);
+	return (0);
+    }
+    shm = (ANVIL_SHM *) mymalloc(sizeof(*shm));
+    shm->fd = fd;
+    shm->flags = flags;
+    shm->len = ANVIL_SHM_LEN(size);
+    shm->size = size;
+    shm->hdr = (ANVIL_SHM_HDR *) ptr;
+    shm->remote = (ANVIL_SHM_REMOTE *) (shm->hdr + 1);
+    shm->local = (ANVIL_SHM_LOCAL *) (shm->remote + size);
+    anvil_shm_unlock(shm);
+    return (shm);
+}
+
+/* anvil_shm_close - detach from table */
+
+void    anvil_shm_close(ANVIL_SHM *shm)
+{
+    if (shm->flags & ANVIL_SHM_FLAG_OWNER) {
+	if (myflock(shm->fd, INTERNAL_LOCK, MYFLOCK_OP_EXCLUSIVE) < 0) {
+	    msg_warn("lock anvil counter table: %m");
+	} else {
+	    shm->hdr->heartbeat = 0;
+	    anvil_shm_unlock(shm);
+	}
+    }
+    if (munmap((void *) shm->hdr, shm->len) < 0)
+	msg_warn("munmap anvil counter table: %m");
+    (void) close(shm->fd);
+    myfree((void *) shm);
+}
+
+#ifdef TEST
+
+ /*
+  * Stand-alone test program. Commands are the same as with the anvil_clnt
+  * test program, plus "maintain", "peaks", "orphan" (connect from a process
+  * that terminates without disconnect), and "stop" (the anvil server goes
+  * away).
+  */
+#include <sys/wait.h>
+#include <stdlib.h>
+#include <msg_vstream.h>
+#include <vstring.h>
+#include <vstring_vstream.h>
+#include <vstream.h>
+#include <stringops.h>
+
+static void usage(void)
+{
+    vstream_printf("usage: "
+		   ANVIL_REQ_CONN " ident | "
+		   ANVIL_REQ_DISC " ident | "
+		   ANVIL_REQ_MAIL " ident | "
+		   ANVIL_REQ_RCPT " ident | "
+		   ANVIL_REQ_NTLS " ident | "
+		   ANVIL_REQ_NTLS_STAT " ident | "
+		   ANVIL_REQ_AUTH " ident | "
+		   ANVIL_REQ_LOOKUP " ident | "
+		   "orphan ident | maintain | peaks | stop\n");
+}
+
+int     main(int argc, char **argv)
+{
+    static const char *peak_names[ANVIL_SHM_PEAK_COUNT] = {
+	"connection count", "connection rate", "message rate",
+	"recipient rate", "newtls rate", "auth rate", "cache size",
+    };
+    ANVIL_SHM_PEAK peaks[ANVIL_SHM_PEAK_COUNT];
+    VSTRING *inbuf = vstring_alloc(1);
+    ANVIL_SHM *shm;
+    ANVIL_SHM *owner;
+    char   *bufp;
+    char   *cmd;
+    char   *ident;
+    int     count;
+    int     rate;
+    int     msgs;
+    int     rcpts;
+    int     newtls;
+    int     auths;
+    int     status;
+    int     n;
+    pid_t   pid;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    if (argc != 3)
+	msg_fatal("usage: %s file size", argv[0]);
+    if ((owner = anvil_shm_open(argv[1], atoi(argv[2]),
+				ANVIL_SHM_FLAG_OWNER)) == 0)
+	msg_fatal("cannot open %s", argv[1]);
+    anvil_shm_maintain(owner, 60);
+    if ((shm = anvil_shm_open(argv[1], 1, ANVIL_SHM_FLAG_NONE)) == 0)
+	msg_fatal("cannot open %s", argv[1]);
+
+    while (vstring_fgets_nonl(inbuf, VSTREAM_IN)) {
+	bufp = vstring_str(inbuf);
+	if ((cmd = mystrtok(&bufp, " ")) == 0 || *cmd == '#')
+	    continue;
+	vstream_printf("> %s\n", vstring_str(inbuf));
+	ident = mystrtok(&bufp, " ");
+	status = ANVIL_STAT_OK;
+	if (strcmp(cmd, ANVIL_REQ_CONN) == 0 && ident) {
+	    if ((status = anvil_shm_connect(shm, ident, &count, &rate)) == 0)
+		vstream_printf("count=%d, rate=%d\n", count, rate);
+	} else if (strcmp(cmd, ANVIL_REQ_MAIL) == 0 && ident) {
+	    if ((status = anvil_shm_update(shm, ident, ANVIL_SHM_MAIL, &rate)) == 0)
+		vstream_printf("rate=%d\n", rate);
+	} else if (strcmp(cmd, ANVIL_REQ_RCPT) == 0 && ident) {
+	    if ((status = anvil_shm_update(shm, ident, ANVIL_SHM_RCPT, &rate)) == 0)
+		vstream_printf("rate=%d\n", rate);
+	} else if (strcmp(cmd, ANVIL_REQ_NTLS) == 0 && ident) {
+	    if ((status = anvil_shm_update(shm, ident, ANVIL_SHM_NTLS, &rate)) == 0)
+		vstream_printf("rate=%d\n", rate);
+	} else if (strcmp(cmd, ANVIL_REQ_AUTH) == 0 && ident) {
+	    if ((status = anvil_shm_update(shm, ident, ANVIL_SHM_AUTH, &rate)) == 0)
+		vstream_printf("rate=%d\n", rate);
+	} else if (strcmp(cmd, ANVIL_REQ_NTLS_STAT) == 0 && ident) {
+	    if ((status = anvil_shm_newtls_stat(shm, ident, &newtls)) == 0)
+		vstream_printf("rate=%d\n", newtls);
+	} else if (strcmp(cmd, ANVIL_REQ_DISC) == 0 && ident) {
+	    if ((status = anvil_shm_disconnect(shm, ident)) == 0)
+		vstream_printf("OK\n");
+	} else if (strcmp(cmd, ANVIL_REQ_LOOKUP) == 0 && ident) {
+	    if ((status = anvil_shm_lookup(shm, ident, &count, &rate, &msgs,
+				   &rcpts, &newtls, &auths)) == 0)
+		vstream_printf("count=%d, rate=%d msgs=%d rcpts=%d newtls=%d "
+			       "auths=%d\n", count, rate, msgs, rcpts, newtls,
+			       auths);
+	} else if (strcmp(cmd, "orphan") == 0 && ident) {
+	    vstream_fflush(VSTREAM_OUT);
+	    if ((pid = fork()) < 0)
+		msg_fatal("fork: %m");
+	    if (pid == 0)
+		_exit(anvil_shm_connect(shm, ident, &count, &rate) != 0);
+	    if (waitpid(pid, &status, 0) < 0)
+		msg_fatal("waitpid: %m");
+	    vstream_printf("exit status %d\n", WEXITSTATUS(status));
+	    status = ANVIL_STAT_OK;
+	} else if (strcmp(cmd, "maintain") == 0 && owner) {
+	    anvil_shm_maintain(owner, 60);
+	    vstream_printf("OK\n");
+	} else if (strcmp(cmd, "peaks") == 0 && owner) {
+	    anvil_shm_peaks(owner, peaks);
+	    for (n = 0; n < ANVIL_SHM_PEAK_COUNT; n++)
+		if (peaks[n].value > 0)
+		    vstream_printf("max %s %d (%s)\n", peak_names[n],
+				   peaks[n].value, peaks[n].ident);
+	} else if (strcmp(cmd, "stop") == 0 && owner) {
+	    anvil_shm_close(owner);
+	    owner = 0;
+	    vstream_printf("OK\n");
+	} else {
+	    vstream_printf("bad command: \"%s\"\n", cmd);
+	    usage();
+	}
+	if (status != ANVIL_STAT_OK)
+	    vstream_printf("fail\n");
+	vstream_fflush(VSTREAM_OUT);
+    }
+    if (owner)
+	anvil_shm_close(owner);
+    anvil_shm_close(shm);
+    vstring_free(inbuf);
+    return (0);
+}
+
+#endif
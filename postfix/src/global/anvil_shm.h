@@ -0,0 +1,76 @@
+#ifndef _ANVIL_SHM_H_INCLUDED_
+#define _ANVIL_SHM_H_INCLUDED_
+
+/*++
+/* NAME
+/*	anvil_shm 3h
+/* SUMMARY
+/*	shared-memory connection count and rate table
+/* SYNOPSIS
+/*	#include <anvil_shm.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * System library.
+  */
+#include <time.h>
+
+ /*
+  * External interface.
+  */
+typedef struct ANVIL_SHM ANVIL_SHM;
+
+#define ANVIL_SHM_FILE		"anvil_counters"	/* under data_directory */
+#define ANVIL_SHM_IDENT_LEN	100	/* (service, client) name */
+#define ANVIL_SHM_TICK		5	/* anvil(8) maintenance interval */
+
+#define ANVIL_SHM_FLAG_NONE	0
+#define ANVIL_SHM_FLAG_OWNER	(1<<0)	/* anvil(8) server */
+
+#define ANVIL_SHM_MAIL		1	/* message rate */
+#define ANVIL_SHM_RCPT		2	/* recipient rate */
+#define ANVIL_SHM_NTLS		3	/* new TLS session rate */
+#define ANVIL_SHM_AUTH		4	/* AUTH request rate */
+
+extern ANVIL_SHM *anvil_shm_open(const char *, int, int);
+extern int anvil_shm_connect(ANVIL_SHM *, const char *, int *, int *);
+extern int anvil_shm_update(ANVIL_SHM *, const char *, int, int *);
+extern int anvil_shm_newtls_stat(ANVIL_SHM *, const char *, int *);
+extern int anvil_shm_lookup(ANVIL_SHM *, const char *, int *, int *, int *, int *, int *, int *);
+extern int anvil_shm_disconnect(ANVIL_SHM *, const char *);
+extern void anvil_shm_close(ANVIL_SHM *);
+
+ /*
+  * Server interface.
+  */
+typedef struct {
+    int     value;			/* peak value */
+    time_t  when;			/* time of peak value */
+    char    ident[ANVIL_SHM_IDENT_LEN];	/* (service, client) */
+} ANVIL_SHM_PEAK;
+
+#define ANVIL_SHM_PEAK_CONN_COUNT	0
+#define ANVIL_SHM_PEAK_CONN_RATE	1
+#define ANVIL_SHM_PEAK_MAIL_RATE	2
+#define ANVIL_SHM_PEAK_RCPT_RATE	3
+#define ANVIL_SHM_PEAK_NTLS_RATE	4
+#define ANVIL_SHM_PEAK_AUTH_RATE	5
+#define ANVIL_SHM_PEAK_CACHE_SIZE	6
+#define ANVIL_SHM_PEAK_COUNT		7
+
+extern void anvil_shm_maintain(ANVIL_SHM *, int);
+extern void anvil_shm_peaks(ANVIL_SHM *, ANVIL_SHM_PEAK *);
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+#endif
@@ -0,0 +1,453 @@
+/*++
+/* NAME
+/*	dict_cachemap 3
+/* SUMMARY
+/*	dictionary manager interface for cached tables
+/* SYNOPSIS
+/*	#include <dict_cachemap.h>
+/*
+/*	DICT	*dict_cachemap_open(name, open_flags, dict_flags)
+/*	const char *name;
+/*	int	open_flags;
+/*	int	dict_flags;
+/* DESCRIPTION
+/*	dict_cachemap_open() opens a table that remembers recent
+/*	lookup results from another table.
+/*	Example: "\fBcachemap:{\fItype:name\fB}\fR".
+/*
+/*	This is meant for tables with a high lookup latency, such
+/*	as LDAP, SQL, tcp or socketmap tables. A "cachemap:" query
+/*	is answered from memory when the same query was looked up
+/*	recently; otherwise it is given to the underlying table,
+/*	and the result is saved for later. A "found" result is
+/*	remembered for $cachemap_cache_ttl seconds, and a "not
+/*	found" result for $cachemap_negative_cache_ttl seconds.
+/*	Lookup errors are never remembered. At most
+/*	$cachemap_cache_size results are kept per "cachemap:"
+/*	table; when the cache is full, the least-recently used
+/*	result is discarded first.
+/*
+/*	A "cachemap:" table lives in the memory of one process.
+/*	To share the cache among processes, use it through the
+/*	proxymap(8) server, as in "\fBproxy:cachemap:{\fItype:name\fB}\fR".
+/*
+/*	Every $cachemap_status_update_time seconds, the number of
+/*	lookups, cache hits, cache misses and lookup errors is
+/*	logged, together with the average and maximal latency of
+/*	the underlying table. This is also logged when the table
+/*	is closed in verbose mode.
+/*
+/*	The requestor flags of the "cachemap:" table, such as case
+/*	folding, are passed on to the underlying table before each
+/*	query, and results are remembered separately for each
+/*	combination of requestor flags. This allows one "cachemap:"
+/*	table in a proxymap(8) server to serve clients that use
+/*	different flags.
+/*
+/*	The first and last characters of the "cachemap:" table name
+/*	must be '{' and '}'. Within these is the name of exactly
+/*	one table.
+/*
+/*	The open_flags and dict_flags arguments are passed on to
+/*	the underlying dictionary.
+/* SEE ALSO
+/*	dict(3) generic dictionary manager
+/*	ttl_cache(3) cache with per-entry time to live
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <sys/time.h>
+#include <string.h>
+#include <time.h>
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <argv.h>
+#include <vstring.h>
+#include <ttl_cache.h>
+#include <dict.h>
+#include <stringops.h>
+
+/* Global library. */
+
+#include <mail_params.h>
+#include <dict_cachemap.h>
+
+/* Application-specific. */
+
+typedef struct {
+    DICT    dict;			/* generic members */
+    char   *map_name;			/* cached table name */
+    DICT   *map;			/* cached table */
+    TTL_CACHE *cache;			/* recent results, or null */
+    VSTRING *cache_key;			/* requestor flags and lookup key */
+    ARGV   *lookup_keys;		/* multi-key query */
+    time_t  next_report;		/* statistics deadline */
+    unsigned long hits;			/* answered from cache */
+    unsigned long misses;		/* answered by table */
+    unsigned long errors;		/* lookup errors */
+    unsigned long latency_sum;		/* table latency, microseconds */
+    unsigned long latency_max;		/* table latency, microseconds */
+} DICT_CACHEMAP;
+
+/* dict_cachemap_key - cache key for requestor flags and lookup key */
+
+static const char *dict_cachemap_key(DICT_CACHEMAP *dict_cachemap,
+				             const char *key)
+{
+
+    /*
+     * The requestor flags control case folding and UTF-8 processing, and may
+     * change the lookup result. The lookup key comes last, because it may
+     * contain any character.
+     */
+    vstring_sprintf(dict_cachemap->cache_key, "%d\n%s",
+		    dict_cachemap->dict.flags & DICT_FLAG_RQST_MASK, key);
+    return (vstring_str(dict_cachemap->cache_key));
+}
+
+/* dict_cachemap_update - save lookup result */
+
+static void dict_cachemap_update(DICT_CACHEMAP *dict_cachemap,
+				         const char *key, const char *value)
+{
+    int     ttl = (value ? var_cachemap_ttl : var_cachemap_neg_ttl);
+
+    if (ttl > 0)
+	ttl_cache_enter(dict_cachemap->cache,
+			dict_cachemap_key(dict_cachemap, key),
+			value ? mystrdup(value) : (void *) 0, ttl);
+}
+
+/* dict_cachemap_flags - pass on requestor flags */
+
+static void dict_cachemap_flags(DICT_CACHEMAP *dict_cachemap)
+{
+    DICT   *map = dict_cachemap->map;
+
+    map->flags = ((map->flags & ~DICT_FLAG_RQST_MASK)
+		  | (dict_cachemap->dict.flags & DICT_FLAG_RQST_MASK));
+}
+
+/* dict_cachemap_report - log and reset statistics */
+
+static void dict_cachemap_report(DICT_CACHEMAP *dict_cachemap, time_t now)
+{
+    DICT   *dict = &dict_cachemap->dict;
+    unsigned long avg;
+
+    if (dict_cachemap->hits + dict_cachemap->misses > 0) {
+	avg = (dict_cachemap->misses > 0 ?
+	       dict_cachemap->latency_sum / dict_cachemap->misses : 0);
+	msg_info("statistics: %s:%s lookups=%lu hits=%lu misses=%lu"
+		 " errors=%lu latency avg=%lu.%03lums max=%lu.%03lums",
+		 dict->type, dict->name,
+		 dict_cachemap->hits + dict_cachemap->misses,
+		 dict_cachemap->hits, dict_cachemap->misses,
+		 dict_cachemap->errors, avg / 1000, avg % 1000,
+		 dict_cachemap->latency_max / 1000,
+		 dict_cachemap->latency_max % 1000);
+    }
+    dict_cachemap->hits = dict_cachemap->misses = dict_cachemap->errors = 0;
+    dict_cachemap->latency_sum = dict_cachemap->latency_max = 0;
+    dict_cachemap->next_report = now + var_cachemap_stat_time;
+}
+
+/* dict_cachemap_latency - update table statistics */
+
+static void dict_cachemap_latency(DICT_CACHEMAP *dict_cachemap,
+				          struct timeval * start)
+{
+    struct timeval end;
+    unsigned long usec;
+
+    GETTIMEOFDAY(&end);
+    if (end.tv_sec < start->tv_sec
+	|| (end.tv_sec == start->tv_sec && end.tv_usec < start->tv_usec))
+	usec = 0;
+    else
+	usec = (end.tv_sec - start->tv_sec) * 1000000
+	    + end.tv_usec - start->tv_usec;
+    dict_cachemap->misses += 1;
+    dict_cachemap->latency_sum += usec;
+    if (usec > dict_cachemap->latency_max)
+	dict_cachemap->latency_max = usec;
+    if (dict_cachemap->map->error)
+	dict_cachemap->errors += 1;
+}
+
+/* dict_cachemap_lookup - search cache, then table */
+
+static const char *dict_cachemap_lookup(DICT *dict, const char *key)
+{
+    DICT_CACHEMAP *dict_cachemap = (DICT_CACHEMAP *) dict;
+    struct timeval start;
+    const char *value;
+    void   *cached;
+    time_t  now = time((time_t *) 0);
+
+    if (now >= dict_cachemap->next_report)
+	dict_cachemap_report(dict_cachemap, now);
+
+    if (dict_cachemap->cache != 0
+	&& ttl_cache_find(dict_cachemap->cache,
+			  dict_cachemap_key(dict_cachemap, key), &cached)) {
+	dict_cachemap->hits += 1;
+	value = (const char *) cached;
+	if (msg_verbose)
+	    msg_info("%s:%s: cached: %s: %s", dict->type, dict->name,
+		     key, value ? value : "not found");
+	DICT_ERR_VAL_RETURN(dict, DICT_ERR_NONE, value);
+    }
+    dict_cachemap_flags(dict_cachemap);
+    GETTIMEOFDAY(&start);
+    value = dict_get(dict_cachemap->map, key);
+    dict_cachemap_latency(dict_cachemap, &start);
+    if (value == 0 && dict_cachemap->map->error)
+	DICT_ERR_VAL_RETURN(dict, dict_cachemap->map->error, value);
+    if (dict_cachemap->cache != 0)
+	dict_cachemap_update(dict_cachemap, key, value);
+    DICT_ERR_VAL_RETURN(dict, DICT_ERR_NONE, value);
+}
+
+/* dict_cachemap_lookup_first - search cache, then table for first match */
+
+static const char *dict_cachemap_lookup_first(DICT *dict, ARGV *keys,
+					              ssize_t *which)
+{
+    DICT_CACHEMAP *dict_cachemap = (DICT_CACHEMAP *) dict;
+    struct timeval start;
+    const char *value;
+    void   *cached;
+    ssize_t found;
+    ssize_t n;
+    ssize_t k;
+    time_t  now = time((time_t *) 0);
+
+    if (now >= dict_cachemap->next_report)
+	dict_cachemap_report(dict_cachemap, now);
+
+    /*
+     * Skip keys with a fresh "not found" result, and stop at the first key
+     * with a fresh "found" result or without a fresh result.
+     */
+    n = 0;
+    if (dict_cachemap->cache != 0) {
+	for ( /* void */ ; n < keys->argc; n++) {
+	    if (!ttl_cache_find(dict_cachemap->cache,
+			     dict_cachemap_key(dict_cachemap, keys->argv[n]),
+				&cached))
+		break;
+	    if (cached != 0) {
+		dict_cachemap->hits += 1;
+		*which = n;
+		DICT_ERR_VAL_RETURN(dict, DICT_ERR_NONE, (const char *) cached);
+	    }
+	}
+	if (n >= keys->argc) {
+	    dict_cachemap->hits += 1;
+	    *which = -1;
+	    DICT_ERR_VAL_RETURN(dict, DICT_ERR_NONE, (char *) 0);
+	}
+    }
+
+    /*
+     * Look up the remaining keys with one table query, and save the result
+     * for each key that the table has examined.
+     */
+    argv_truncate(dict_cachemap->lookup_keys, 0);
+    for (k = n; k < keys->argc; k++)
+	argv_add(dict_cachemap->lookup_keys, keys->argv[k], (char *) 0);
+    dict_cachemap_flags(dict_cachemap);
+    GETTIMEOFDAY(&start);
+    value = dict_get_first(dict_cachemap->map, dict_cachemap->lookup_keys,
+			   &found);
+    dict_cachemap_latency(dict_cachemap, &start);
+    *which = (found >= 0 ? n + found : -1);
+    if (value == 0 && dict_cachemap->map->error)
+	DICT_ERR_VAL_RETURN(dict, dict_cachemap->map->error, value);
+    if (dict_cachemap->cache != 0) {
+	for (k = n; k < (value ? *which : keys->argc); k++)
+	    dict_cachemap_update(dict_cachemap, keys->argv[k], (char *) 0);
+	if (value != 0)
+	    dict_cachemap_update(dict_cachemap, keys->argv[*which], value);
+    }
+    DICT_ERR_VAL_RETURN(dict, DICT_ERR_NONE, value);
+}
+
+/* dict_cachemap_close - disassociate from cached table */
+
+static void dict_cachemap_close(DICT *dict)
+{
+    DICT_CACHEMAP *dict_cachemap = (DICT_CACHEMAP *) dict;
+
+    if (msg_verbose)
+	dict_cachemap_report(dict_cachemap, time((time_t *) 0));
+    dict_unregister(dict_cachemap->map_name);
+    myfree(dict_cachemap->map_name);
+    if (dict_cachemap->cache)
+	ttl_cache_free(dict_cachemap->cache);
+    vstring_free(dict_cachemap->cache_key);
+    argv_free(dict_cachemap->lookup_keys);
+    dict_free(dict);
+}
+
+/* dict_cachemap_open - open cached table */
+
+DICT   *dict_cachemap_open(const char *name, int open_flags, int dict_flags)
+{
+    static const char myname[] = "dict_cachemap_open";
+    DICT_CACHEMAP *dict_cachemap;
+    char   *saved_name = 0;
+    char   *dict_type_name;
+    ARGV   *argv = 0;
+    DICT   *dict;
+    size_t  len;
+
+    /*
+     * Clarity first. Let the optimizer worry about redundant code.
+     */
+#define DICT_CACHEMAP_RETURN(x) do { \
+	    if (saved_name != 0) \
+		myfree(saved_name); \
+	    if (argv != 0) \
+		argv_free(argv); \
+	    return (x); \
+	} while (0)
+
+    /*
+     * Sanity checks. A cache can't see updates made by other processes.
+     */
+    if (open_flags != O_RDONLY)
+	DICT_CACHEMAP_RETURN(dict_surrogate(DICT_TYPE_CACHEMAP, name,
+					    open_flags, dict_flags,
+				  "%s:%s map requires O_RDONLY access mode",
+					    DICT_TYPE_CACHEMAP, name));
+
+    /*
+     * Extract the table name.
+     */
+    if ((len = balpar(name, CHARS_BRACE)) == 0 || name[len] != 0
+	|| *(saved_name = mystrndup(name + 1, len - 2)) == 0
+	|| ((argv = argv_splitq(saved_name, CHARS_COMMA_SP, CHARS_BRACE)),
+	    (argv->argc != 1))
+	|| strchr(dict_type_name = argv->argv[0], ':') == 0)
+	DICT_CACHEMAP_RETURN(dict_surrogate(DICT_TYPE_CACHEMAP, name,
+					    open_flags, dict_flags,
+					    "bad syntax: \"%s:%s\"; "
+					    "need \"%s:{type:name}\"",
+					    DICT_TYPE_CACHEMAP, name,
+					    DICT_TYPE_CACHEMAP));
+    if (msg_verbose)
+	msg_info("%s: %s", myname, dict_type_name);
+    if ((dict = dict_handle(dict_type_name)) == 0)
+	dict = dict_open(dict_type_name, open_flags, dict_flags);
+    dict_register(dict_type_name, dict);
+
+    /*
+     * Bundle up the result. The cached table determines the trust level and
+     * the pattern-matching flags.
+     */
+    dict_cachemap = (DICT_CACHEMAP *)
+	dict_alloc(DICT_TYPE_CACHEMAP, name, sizeof(*dict_cachemap));
+    dict_cachemap->dict.lookup = dict_cachemap_lookup;
+    dict_cachemap->dict.lookup_first = dict_cachemap_lookup_first;
+    dict_cachemap->dict.close = dict_cachemap_close;
+    dict_cachemap->dict.flags = dict_flags
+	| (dict->flags & (DICT_FLAG_FIXED | DICT_FLAG_PATTERN));
+    dict_cachemap->dict.owner = dict->owner;
+    dict_cachemap->map_name = mystrdup(dict_type_name);
+    dict_cachemap->map = dict;
+    if (var_cachemap_size > 0
+	&& (var_cachemap_ttl > 0 || var_cachemap_neg_ttl > 0))
+	dict_cachemap->cache = ttl_cache_create(var_cachemap_size, myfree);
+    else
+	dict_cachemap->cache = 0;
+    dict_cachemap->cache_key = vstring_alloc(100);
+    dict_cachemap->lookup_keys = argv_alloc(10);
+    dict_cachemap->hits = dict_cachemap->misses = dict_cachemap->errors = 0;
+    dict_cachemap->latency_sum = dict_cachemap->latency_max = 0;
+    dict_cachemap->next_report = time((time_t *) 0) + var_cachemap_stat_time;
+    DICT_CACHEMAP_RETURN(DICT_DEBUG (&dict_cachemap->dict));
+}
+
+#ifdef TEST
+
+ /*
+  * Proof-of-concept test program. Read "get key" or "first key..." requests
+  * from stdin, and report the result. The "stats" command reports the cache
+  * hits, misses and errors so far.
+  */
+#include <stdlib.h>
+#include <vstream.h>
+#include <vstring.h>
+#include <vstring_vstream.h>
+#include <msg_vstream.h>
+
+int     main(int argc, char **argv)
+{
+    VSTRING *buf = vstring_alloc(100);
+    DICT_CACHEMAP *dict_cachemap;
+    DICT   *dict;
+    ARGV   *keys;
+    char   *bp;
+    char   *cmd;
+    const char *value;
+    ssize_t which;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    if (argc != 3)
+	msg_fatal("usage: %s cache-size cachemap:{type:name}", argv[0]);
+    var_cachemap_size = atoi(argv[1]);
+    var_cachemap_ttl = var_cachemap_neg_ttl = 3600;
+    var_cachemap_stat_time = 3600;
+    dict_open_register(DICT_TYPE_CACHEMAP, dict_cachemap_open);
+    dict = dict_open(argv[2], O_RDONLY, DICT_FLAG_LOCK);
+    if (strcmp(dict->type, DICT_TYPE_CACHEMAP) != 0)
+	msg_fatal("cannot open %s", argv[2]);
+    dict_cachemap = (DICT_CACHEMAP *) dict;
+    while (vstring_get_nonl(buf, VSTREAM_IN) != VSTREAM_EOF) {
+	bp = vstring_str(buf);
+	vstream_printf("> %s\n", bp);
+	if ((cmd = mystrtok(&bp, CHARS_SPACE)) == 0)
+	    continue;
+	keys = argv_split(bp, CHARS_SPACE);
+	if (strcmp(cmd, "get") == 0 && keys->argc == 1) {
+	    if ((value = dict_get(dict, keys->argv[0])) != 0)
+		vstream_printf("%s=%s\n", keys->argv[0], value);
+	    else
+		vstream_printf("%s: %s\n", keys->argv[0],
+			       dict->error ? "error" : "not found");
+	} else if (strcmp(cmd, "first") == 0 && keys->argc > 0) {
+	    if ((value = dict_get_first(dict, keys, &which)) != 0)
+		vstream_printf("%s=%s\n", keys->argv[which], value);
+	    else
+		vstream_printf("%s\n", dict->error ? "error" : "not found");
+	} else if (strcmp(cmd, "stats") == 0 && keys->argc == 0) {
+	    vstream_printf("hits=%lu misses=%lu errors=%lu\n",
+			   dict_cachemap->hits, dict_cachemap->misses,
+			   dict_cachemap->errors);
+	} else {
+	    vstream_printf("usage: get key | first key... | stats\n");
+	}
+	argv_free(keys);
+	vstream_fflush(VSTREAM_OUT);
+    }
+    vstring_free(buf);
+    return (0);
+}
+
+#endif
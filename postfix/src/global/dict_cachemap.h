@@ -0,0 +1,37 @@
+#ifndef _DICT_CACHEMAP_H_INCLUDED_
+#define _DICT_CACHEMAP_H_INCLUDED_
+
+/*++
+/* NAME
+/*	dict_cachemap 3h
+/* SUMMARY
+/*	dictionary manager interface for cached tables
+/* SYNOPSIS
+/*	#include <dict_cachemap.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * Utility library.
+  */
+#include <dict.h>
+
+ /*
+  * External interface.
+  */
+#define DICT_TYPE_CACHEMAP	"cachemap"
+
+extern DICT *dict_cachemap_open(const char *, int, int);
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+#endif
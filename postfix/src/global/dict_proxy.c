@@ -22,6 +22,11 @@
 /*	The connection to the Postfix proxymap server is automatically
 /*	closed after $ipc_idle seconds of idle time, or after $ipc_ttl
 /*	seconds of activity.
+/*
+/*	A multi-key lookup with dict_get_first() is sent to the
+/*	proxymap server as one request; the server looks up the
+/*	keys in order, and replies with the first key that is found
+/*	or that causes a lookup error.
 /* SECURITY
 /*	The proxy map server is not meant to be a trusted process. Proxy
 /*	maps must not be used to look up security sensitive information
@@ -242,6 +247,114 @@ static const char *dict_proxy_lookup(DICT *dict, const char *key)
     }
 }
 
+/* dict_proxy_lookup_first - find first matching table entry */
+
+static const char *dict_proxy_lookup_first(DICT *dict, ARGV *keys,
+					           ssize_t *which)
+{
+    const char *myname = "dict_proxy_lookup_first";
+    DICT_PROXY *dict_proxy = (DICT_PROXY *) dict;
+    VSTREAM *stream;
+    int     status;
+    int     count = 0;
+    int     request_flags;
+    const char *value;
+    ssize_t n;
+
+    /*
+     * Don't bother the server with requests that it would refuse.
+     */
+    if (keys->argc < 1 || keys->argc > PROXY_MAX_KEYS) {
+	for (n = 0; n < keys->argc; n++) {
+	    *which = n;
+	    if ((value = dict_proxy_lookup(dict, keys->argv[n])) != 0
+		|| dict->error != 0)
+		return (value);
+	}
+	*which = -1;
+	DICT_ERR_VAL_RETURN(dict, DICT_ERR_NONE, (char *) 0);
+    }
+
+    /*
+     * Same as dict_proxy_lookup(), except that we send a list of keys, and
+     * that the reply includes the key that was found or that failed.
+     */
+    VSTRING_RESET(dict_proxy->result);
+    VSTRING_TERMINATE(dict_proxy->result);
+    request_flags = dict_proxy->inst_flags
+	| (dict->flags & DICT_FLAG_RQST_MASK);
+    for (;;) {
+	stream = clnt_stream_access(dict_proxy->clnt);
+	errno = 0;
+	count += 1;
+	(void) attr_print(stream, ATTR_FLAG_MORE,
+			  SEND_ATTR_STR(MAIL_ATTR_REQ, PROXY_REQ_LOOKUP_FIRST),
+			  SEND_ATTR_STR(MAIL_ATTR_TABLE, dict->name),
+			  SEND_ATTR_INT(MAIL_ATTR_FLAGS, request_flags),
+			  SEND_ATTR_INT(MAIL_ATTR_SIZE, keys->argc),
+			  ATTR_TYPE_END);
+	for (n = 0; n < keys->argc; n++)
+	    (void) attr_print(stream, ATTR_FLAG_MORE,
+			      SEND_ATTR_STR(MAIL_ATTR_KEY, keys->argv[n]),
+			      ATTR_TYPE_END);
+	if (attr_print(stream, ATTR_FLAG_NONE, ATTR_TYPE_END) != 0
+	    || vstream_fflush(stream)
+	    || attr_scan(stream, ATTR_FLAG_STRICT,
+			 RECV_ATTR_INT(MAIL_ATTR_STATUS, &status),
+			 RECV_ATTR_STR(MAIL_ATTR_KEY, dict_proxy->reskey),
+			 RECV_ATTR_STR(MAIL_ATTR_VALUE, dict_proxy->result),
+			 ATTR_TYPE_END) != 3) {
+	    if (msg_verbose || count > 1 || (errno && errno != EPIPE && errno != ENOENT))
+		msg_warn("%s: service %s: %m", myname, VSTREAM_PATH(stream));
+	} else {
+	    if (msg_verbose)
+		msg_info("%s: table=%s flags=%s keys=%ld -> status=%d key=%s result=%s",
+			 myname, dict->name, dict_flags_str(request_flags),
+			 (long) keys->argc, status, STR(dict_proxy->reskey),
+			 STR(dict_proxy->result));
+	    for (n = 0; n < keys->argc; n++)
+		if (VSTREQ(dict_proxy->reskey, keys->argv[n]))
+		    break;
+	    *which = (n < keys->argc ? n : -1);
+	    switch (status) {
+	    case PROXY_STAT_BAD:
+		msg_fatal("%s lookup failed for table \"%s\" key \"%s\": "
+			  "invalid request",
+			  dict_proxy->service, dict->name, keys->argv[0]);
+	    case PROXY_STAT_DENY:
+		msg_fatal("%s service is not configured for table \"%s\"",
+			  dict_proxy->service, dict->name);
+	    case PROXY_STAT_NOKEY:
+		*which = -1;
+		DICT_ERR_VAL_RETURN(dict, DICT_ERR_NONE, (char *) 0);
+	    case PROXY_STAT_OK:
+	    case PROXY_STAT_RETRY:
+	    case PROXY_STAT_CONFIG:
+		if (*which < 0) {
+		    msg_warn("%s lookup failed for table \"%s\": "
+			     "unexpected reply key \"%s\"",
+			     dict_proxy->service, dict->name,
+			     STR(dict_proxy->reskey));
+		    break;
+		}
+		if (status == PROXY_STAT_OK)
+		    DICT_ERR_VAL_RETURN(dict, DICT_ERR_NONE,
+					STR(dict_proxy->result));
+		DICT_ERR_VAL_RETURN(dict, status == PROXY_STAT_RETRY ?
+				    DICT_ERR_RETRY : DICT_ERR_CONFIG,
+				    (char *) 0);
+	    default:
+		msg_warn("%s lookup failed for table \"%s\" key \"%s\": "
+			 "unexpected reply status %d",
+			 dict_proxy->service, dict->name, keys->argv[0],
+			 status);
+	    }
+	}
+	clnt_stream_recover(dict_proxy->clnt);
+	sleep(1);				/* XXX make configurable */
+    }
+}
+
 /* dict_proxy_update - update table entry */
 
 static int dict_proxy_update(DICT *dict, const char *key, const char *value)
@@ -455,6 +568,7 @@ DICT   *dict_proxy_open(const char *map, int open_flags, int dict_flags)
     dict_proxy = (DICT_PROXY *)
 	dict_alloc(DICT_TYPE_PROXY, map, sizeof(*dict_proxy));
     dict_proxy->dict.lookup = dict_proxy_lookup;
+    dict_proxy->dict.lookup_first = dict_proxy_lookup_first;
     dict_proxy->dict.update = dict_proxy_update;
     dict_proxy->dict.delete = dict_proxy_delete;
     dict_proxy->dict.sequence = dict_proxy_sequence;
@@ -31,6 +31,9 @@ extern DICT *dict_proxy_open(const char *, int, int);
 #define PROXY_REQ_UPDATE	"update"
 #define PROXY_REQ_DELETE	"delete"
 #define PROXY_REQ_SEQUENCE	"sequence"
+#define PROXY_REQ_LOOKUP_FIRST	"lookup_first"
+
+#define PROXY_MAX_KEYS		1000	/* lookup_first request limit */
 
 #define PROXY_STAT_OK		0	/* operation succeeded */
 #define PROXY_STAT_NOKEY	1	/* requested key not found */
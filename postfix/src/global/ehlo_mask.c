@@ -19,6 +19,7 @@
 /*	#define EHLO_MASK_ENHANCEDSTATUSCODES	(1<<10)
 /*	#define EHLO_MASK_DSN		(1<<11)
 /*	#define EHLO_MASK_SMTPUTF8	(1<<12)
+/*	#define EHLO_MASK_CHUNKING	(1<<13)
 /*	#define EHLO_MASK_SILENT	(1<<15)
 /*
 /*	int	ehlo_mask(keyword_list)
@@ -77,6 +78,7 @@ static const NAME_MASK ehlo_mask_table[] = {
     "ENHANCEDSTATUSCODES", EHLO_MASK_ENHANCEDSTATUSCODES,
     "DSN", EHLO_MASK_DSN,
     "EHLO_MASK_SMTPUTF8", EHLO_MASK_SMTPUTF8,
+    "CHUNKING", EHLO_MASK_CHUNKING,
     "SILENT-DISCARD", EHLO_MASK_SILENT,	/* XXX In-band signaling */
     0,
 };
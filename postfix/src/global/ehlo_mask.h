@@ -28,6 +28,7 @@
 #define EHLO_MASK_ENHANCEDSTATUSCODES	(1<<10)
 #define EHLO_MASK_DSN		(1<<11)
 #define EHLO_MASK_SMTPUTF8	(1<<12)
+#define EHLO_MASK_CHUNKING	(1<<13)
 #define EHLO_MASK_SILENT	(1<<15)
 
 extern int ehlo_mask(const char *);
@@ -0,0 +1,303 @@
+/*++
+/* NAME
+/*	group_sync 3
+/* SUMMARY
+/*	shared file system synchronization
+/* SYNOPSIS
+/*	#include <group_sync.h>
+/*
+/*	GROUP_SYNC *group_sync_open(path)
+/*	const char *path;
+/*
+/*	int	group_sync(gs, fd)
+/*	GROUP_SYNC *gs;
+/*	int	fd;
+/*
+/*	void	group_sync_close(gs)
+/*	GROUP_SYNC *gs;
+/* DESCRIPTION
+/*	This module implements "group commit" for processes that
+/*	each need to make a file durable, such as cleanup(8)
+/*	processes that finish a queue file. Instead of one fsync()
+/*	call per file, one process synchronizes the entire file
+/*	system, and that one operation covers the files of all
+/*	processes that were waiting while it was in progress.
+/*
+/*	The processes share two counters in a memory-mapped file:
+/*	the number of file system synchronizations that were
+/*	started, and the number that completed. At most one process
+/*	at a time runs a synchronization, while holding an exclusive
+/*	lock on the file. A process that arrives while a
+/*	synchronization is in progress waits for the lock. When
+/*	it gets the lock, it returns immediately if a synchronization
+/*	that started after its own data was written has completed.
+/*	Otherwise it runs the next synchronization on behalf of
+/*	all processes that are waiting.
+/*
+/*	group_sync_open() opens the specified file, creates it when
+/*	it does not exist, and maps it into memory. The result is
+/*	a null pointer in case of error, or when the system has no
+/*	support for file system synchronization. On Linux, the result
+/*	is also a null pointer with kernels older than 5.8, because
+/*	their syncfs() does not report errors from writing file
+/*	data.
+/*
+/*	group_sync() returns after the data and meta-data of the
+/*	file open on the specified descriptor are on stable storage.
+/*
+/*	group_sync_close() unmaps the file.
+/*
+/*	Arguments:
+/* .IP path
+/*	Pathname of the shared file.
+/* .IP gs
+/*	Handle for the shared file.
+/* .IP fd
+/*	File descriptor of a file that must be made durable.
+/* DIAGNOSTICS
+/*	group_sync() returns 0 in case of success, -1 in case of
+/*	error with errno set to the error from syncfs() or fsync().
+/*	When the shared file cannot be locked, group_sync() falls
+/*	back to fsync().
+/*
+/*	Problems with the shared file are logged as a warning.
+/* BUGS
+/*	A file system synchronization writes all modified data of
+/*	the file system, including data that is unrelated to mail.
+/* SEE ALSO
+/*	syncfs(2), fsync(2)
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#ifdef SYNCFS_ERRORS_SINCE_LINUX
+#include <sys/utsname.h>
+#include <stdio.h>			/* sscanf() */
+#endif
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#ifndef MAP_FAILED
+#define MAP_FAILED	((void *) -1)
+#endif
+
+#ifdef HAS_SYNCFS
+extern int syncfs(int);			/* not in the default name space */
+
+#endif
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <myflock.h>
+#include <iostuff.h>
+
+/* Global library. */
+
+#include <group_sync.h>
+
+/* Application-specific. */
+
+#define GROUP_SYNC_MAGIC	0x67737931	/* "gsy1" */
+
+ /*
+  * The shared counters. Only the lock holder updates them.
+  */
+typedef struct {
+    unsigned magic;			/* GROUP_SYNC_MAGIC */
+    unsigned long started;		/* synchronizations started */
+    unsigned long completed;		/* synchronizations completed */
+} GROUP_SYNC_HDR;
+
+struct GROUP_SYNC {
+    int     fd;				/* shared file */
+    char   *path;			/* shared file name */
+    volatile GROUP_SYNC_HDR *hdr;	/* mapped file */
+};
+
+/* group_sync_unlock - unlock shared file */
+
+static void group_sync_unlock(GROUP_SYNC *gs)
+{
+    if (myflock(gs->fd, INTERNAL_LOCK, MYFLOCK_OP_NONE) < 0)
+	msg_fatal("unlock %s: %m", gs->path);
+}
+
+#ifdef SYNCFS_ERRORS_SINCE_LINUX
+
+/* group_sync_reports_errors - does syncfs() report write errors */
+
+static int group_sync_reports_errors(void)
+{
+    struct utsname uts;
+    int     major;
+    int     minor;
+
+    /*
+     * Before Linux 5.8, syncfs() returns success even when the kernel
+     * failed to write file data, so we could acknowledge a message that is
+     * not on stable storage. fsync() does report such errors.
+     */
+    if (uname(&uts) < 0) {
+	msg_warn("uname: %m");
+	return (0);
+    }
+    if (sscanf(uts.release, "%d.%d", &major, &minor) != 2) {
+	msg_warn("cannot parse kernel release \"%s\"", uts.release);
+	return (0);
+    }
+    if (major * 100 + minor < SYNCFS_ERRORS_SINCE_LINUX) {
+	msg_warn("syncfs() does not report write errors with kernel %s; "
+		 "using fsync() instead", uts.release);
+	return (0);
+    }
+    return (1);
+}
+
+#endif
+
+/* group_sync_open - open shared file */
+
+GROUP_SYNC *group_sync_open(const char *path)
+{
+#ifdef HAS_SYNCFS
+    GROUP_SYNC *gs;
+    GROUP_SYNC_HDR hdr;
+    struct stat st;
+    void   *ptr;
+    int     fd;
+
+#ifdef SYNCFS_ERRORS_SINCE_LINUX
+    if (!group_sync_reports_errors())
+	return (0);
+#endif
+
+    /*
+     * Any process may create the file. Initialize while holding the lock,
+     * so that other processes never see a partial header. The counters
+     * have no meaning across restarts, so a bad header is simply replaced.
+     */
+    if ((fd = open(path, O_RDWR | O_CREAT, 0600)) < 0) {
+	msg_warn("open %s: %m", path);
+	return (0);
+    }
+    if (myflock(fd, INTERNAL_LOCK, MYFLOCK_OP_EXCLUSIVE) < 0) {
+	msg_warn("lock %s: %m", path);
+	(void) close(fd);
+	return (0);
+    }
+    if (fstat(fd, &st) < 0)
+	msg_fatal("fstat %s: %m", path);
+    if (st.st_size != sizeof(hdr)
+	|| read(fd, (void *) &hdr, sizeof(hdr)) != sizeof(hdr)
+	|| hdr.magic != GROUP_SYNC_MAGIC) {
+	hdr.magic = GROUP_SYNC_MAGIC;
+	hdr.started = hdr.completed = 0;
+	if (ftruncate(fd, (off_t) 0) < 0
+	    || lseek(fd, (off_t) 0, SEEK_SET) < 0
+	    || write(fd, (void *) &hdr, sizeof(hdr)) != sizeof(hdr)) {
+	    msg_warn("initialize %s: %m", path);
+	    (void) close(fd);
+	    return (0);
+	}
+    }
+    close_on_exec(fd, CLOSE_ON_EXEC);
+
+    if ((ptr = mmap((void *) 0, sizeof(hdr), PROT_READ | PROT_WRITE,
+		    MAP_SHARED, fd, (off_t) 0)) == MAP_FAILED) {
+	msg_warn("mmap %s: %m", path);
+	(void) close(fd);
+	return (0);
+    }
+    gs = (GROUP_SYNC *) mymalloc(sizeof(*gs));
+    gs->fd = fd;
+    gs->path = mystrdup(path);
+    gs->hdr = (GROUP_SYNC_HDR *) ptr;
+    group_sync_unlock(gs);
+    return (gs);
+#else
+    msg_warn("%s: file system synchronization is not supported on this system",
+	     path);
+    return (0);
+#endif
+}
+
+/* group_sync - make file durable, sharing the work with other processes */
+
+int     group_sync(GROUP_SYNC *gs, int fd)
+{
+    volatile GROUP_SYNC_HDR *hdr = gs->hdr;
+    unsigned long ticket;
+    int     status;
+    int     saved_errno;
+
+    /*
+     * Our data was written before we read the counter, so any
+     * synchronization that starts after this point covers it. The
+     * system calls on either side keep the compiler and CPU from moving
+     * this read.
+     */
+    ticket = hdr->started;
+
+    if (myflock(gs->fd, INTERNAL_LOCK, MYFLOCK_OP_EXCLUSIVE) < 0) {
+	msg_warn("lock %s: %m", gs->path);
+	return (fsync(fd));
+    }
+
+    /*
+     * Someone else already did the work while we were waiting for the lock.
+     */
+    if ((long) (hdr->completed - ticket) > 0) {
+	group_sync_unlock(gs);
+	if (msg_verbose)
+	    msg_info("group_sync: fd %d covered by sync %lu",
+		     fd, (unsigned long) hdr->completed);
+	return (0);
+    }
+
+    /*
+     * Do the work for everyone who is waiting. A failed synchronization
+     * does not count as completed, so that the next process will try
+     * again. Fall back to fsync() when the kernel is older than the C
+     * library.
+     */
+    hdr->started += 1;
+#ifdef HAS_SYNCFS
+    if ((status = syncfs(fd)) == 0)
+	hdr->completed = hdr->started;
+    else if (errno == ENOSYS)
+#endif
+	status = fsync(fd);
+    saved_errno = errno;
+    if (msg_verbose)
+	msg_info("group_sync: fd %d sync %lu status %d",
+		 fd, (unsigned long) hdr->started, status);
+    group_sync_unlock(gs);
+    errno = saved_errno;
+    return (status);
+}
+
+/* group_sync_close - unmap shared file */
+
+void    group_sync_close(GROUP_SYNC *gs)
+{
+    if (munmap((void *) gs->hdr, sizeof(*gs->hdr)) < 0)
+	msg_warn("munmap %s: %m", gs->path);
+    (void) close(gs->fd);
+    myfree(gs->path);
+    myfree((void *) gs);
+}
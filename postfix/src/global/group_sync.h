@@ -0,0 +1,36 @@
+#ifndef _GROUP_SYNC_H_INCLUDED_
+#define _GROUP_SYNC_H_INCLUDED_
+
+/*++
+/* NAME
+/*	group_sync 3h
+/* SUMMARY
+/*	shared file system synchronization
+/* SYNOPSIS
+/*	#include <group_sync.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * External interface.
+  */
+typedef struct GROUP_SYNC GROUP_SYNC;
+
+#define GROUP_SYNC_FILE		"queue_sync"	/* under data_directory */
+
+extern GROUP_SYNC *group_sync_open(const char *);
+extern int group_sync(GROUP_SYNC *, int);
+extern void group_sync_close(GROUP_SYNC *);
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+#endif
@@ -24,8 +24,8 @@
 /* .IP id
 /*	The queue id of the original message file.
 /* .IP stats
-/*	Time stamps from different message delivery stages
-/*	and session reuse count.
+/*	Time stamps from different message delivery stages,
+/*	session reuse count, and message content transfer size.
 /* .IP recipient
 /*	Recipient information. See recipient_list(3).
 /* .IP sender
@@ -89,6 +89,7 @@ void    log_adhoc(const char *id, MSG_STATS *stats, RECIPIENT *recipient,
     DELTA_TIME adelay;			/* queue manager latency */
     DELTA_TIME sdelay;			/* connection set-up latency */
     DELTA_TIME xdelay;			/* transmission latency */
+    DELTA_TIME ddelay;			/* content transfer time */
     struct timeval now;
 
     /*
@@ -201,6 +202,22 @@ void    log_adhoc(const char *id, MSG_STATS *stats, RECIPIENT *recipient,
     PRETTY_FORMAT(buf, "/", sdelay);
     PRETTY_FORMAT(buf, "/", xdelay);
 
+    /*
+     * The content transfer rate, when the delivery agent sent content over
+     * the network. This is optional, because it changes a logging format
+     * that many log file parsers depend on. Don't divide by zero when the
+     * clock resolution is poor.
+     */
+    if (var_xfer_rate_log
+	&& stats->data_bytes > 0 && TIME_STAMPED(stats->data_start)) {
+	DELTA(ddelay, now, stats->data_start);
+	if (ddelay.dt_sec == 0 && ddelay.dt_usec == 0)
+	    ddelay.dt_usec = 1;
+	vstring_sprintf_append(buf, ", rate=%.0fB/s",
+			       (double) stats->data_bytes * 1000000
+			       / (ddelay.dt_sec * 1000000.0 + ddelay.dt_usec));
+    }
+
     /*
      * Finally, the delivery status.
      */
@@ -47,6 +47,7 @@
 #include <dict_pgsql.h>
 #include <dict_sqlite.h>
 #include <dict_memcache.h>
+#include <dict_cachemap.h>
 #include <mail_dict.h>
 #include <mail_params.h>
 #include <mail_dict.h>
@@ -73,6 +74,7 @@ static const DICT_OPEN_INFO dict_open_info[] = {
 #endif
 #endif					/* !USE_DYNAMIC_MAPS */
     DICT_TYPE_MEMCACHE, dict_memcache_open,
+    DICT_TYPE_CACHEMAP, dict_cachemap_open,
     0,
 };
 
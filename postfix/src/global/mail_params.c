@@ -52,6 +52,12 @@
 /*	char	*var_mail_version;
 /*	int	var_ipc_idle_limit;
 /*	int	var_ipc_ttl_limit;
+/*	int	var_rewrite_cache_size;
+/*	int	var_rewrite_cache_ttl;
+/*	int	var_cachemap_size;
+/*	int	var_cachemap_ttl;
+/*	int	var_cachemap_neg_ttl;
+/*	int	var_cachemap_stat_time;
 /*	char	*var_db_type;
 /*	char	*var_hash_queue_names;
 /*	int	var_hash_queue_depth;
@@ -130,6 +136,11 @@
 /*	int     var_idna2003_compat;
 /*	int     var_compat_level;
 /*	char	*var_drop_hdrs;
+/*	bool	var_regexp_prefilter;
+/*	bool	var_dns_parallel;
+/*	bool	var_xfer_rate_log;
+/*	bool	var_anvil_shm_enable;
+/*	int	var_anvil_shm_size;
 /*
 /*	void	mail_params_init()
 /*
@@ -203,6 +214,7 @@
 #include <vstring_vstream.h>
 #include <iostuff.h>
 #include <midna_domain.h>
+#include <regexp_prefilter.h>
 
 /* Global library. */
 
@@ -263,6 +275,12 @@ char   *var_mail_release;
 char   *var_mail_version;
 int     var_ipc_idle_limit;
 int     var_ipc_ttl_limit;
+int     var_rewrite_cache_size;
+int     var_rewrite_cache_ttl;
+int     var_cachemap_size;
+int     var_cachemap_ttl;
+int     var_cachemap_neg_ttl;
+int     var_cachemap_stat_time;
 char   *var_db_type;
 char   *var_hash_queue_names;
 int     var_hash_queue_depth;
@@ -342,6 +360,11 @@ char   *var_smtputf8_autoclass;
 int     var_idna2003_compat;
 int     var_compat_level;
 char   *var_drop_hdrs;
+bool    var_regexp_prefilter;
+bool    var_dns_parallel;
+bool    var_xfer_rate_log;
+bool    var_anvil_shm_enable;
+int     var_anvil_shm_size;
 
 const char null_format_string[1] = "";
 
@@ -745,6 +768,9 @@ void    mail_params_init()
 	VAR_MIME_BOUND_LEN, DEF_MIME_BOUND_LEN, &var_mime_bound_len, 1, 0,
 	VAR_DELAY_MAX_RES, DEF_DELAY_MAX_RES, &var_delay_max_res, MIN_DELAY_MAX_RES, MAX_DELAY_MAX_RES,
 	VAR_INET_WINDOW, DEF_INET_WINDOW, &var_inet_windowsize, 0, 0,
+	VAR_ANVIL_SHM_SIZE, DEF_ANVIL_SHM_SIZE, &var_anvil_shm_size, 1, 0,
+	VAR_REWRITE_CACHE_SIZE, DEF_REWRITE_CACHE_SIZE, &var_rewrite_cache_size, 0, 0,
+	VAR_CACHEMAP_SIZE, DEF_CACHEMAP_SIZE, &var_cachemap_size, 0, 0,
 	0,
     };
     static const CONFIG_LONG_TABLE long_defaults[] = {
@@ -758,6 +784,10 @@ void    mail_params_init()
 	VAR_IPC_TIMEOUT, DEF_IPC_TIMEOUT, &var_ipc_timeout, 1, 0,
 	VAR_IPC_IDLE, DEF_IPC_IDLE, &var_ipc_idle_limit, 1, 0,
 	VAR_IPC_TTL, DEF_IPC_TTL, &var_ipc_ttl_limit, 1, 0,
+	VAR_REWRITE_CACHE_TTL, DEF_REWRITE_CACHE_TTL, &var_rewrite_cache_ttl, 0, 0,
+	VAR_CACHEMAP_TTL, DEF_CACHEMAP_TTL, &var_cachemap_ttl, 0, 0,
+	VAR_CACHEMAP_NEG_TTL, DEF_CACHEMAP_NEG_TTL, &var_cachemap_neg_ttl, 0, 0,
+	VAR_CACHEMAP_STAT_TIME, DEF_CACHEMAP_STAT_TIME, &var_cachemap_stat_time, 1, 0,
 	VAR_TRIGGER_TIMEOUT, DEF_TRIGGER_TIMEOUT, &var_trigger_timeout, 1, 0,
 	VAR_FORK_DELAY, DEF_FORK_DELAY, &var_fork_delay, 1, 0,
 	VAR_FLOCK_DELAY, DEF_FLOCK_DELAY, &var_flock_delay, 1, 0,
@@ -783,6 +813,10 @@ void    mail_params_init()
 	VAR_MULTI_ENABLE, DEF_MULTI_ENABLE, &var_multi_enable,
 	VAR_LONG_QUEUE_IDS, DEF_LONG_QUEUE_IDS, &var_long_queue_ids,
 	VAR_STRICT_SMTPUTF8, DEF_STRICT_SMTPUTF8, &var_strict_smtputf8,
+	VAR_REGEXP_PREFILTER, DEF_REGEXP_PREFILTER, &var_regexp_prefilter,
+	VAR_DNS_PARALLEL, DEF_DNS_PARALLEL, &var_dns_parallel,
+	VAR_XFER_RATE_LOG, DEF_XFER_RATE_LOG, &var_xfer_rate_log,
+	VAR_ANVIL_SHM_ENABLE, DEF_ANVIL_SHM_ENABLE, &var_anvil_shm_enable,
 	0,
     };
     const char *cp;
@@ -883,6 +917,7 @@ void    mail_params_init()
     dict_db_cache_size = var_db_read_buf;
     dict_lmdb_map_size = var_lmdb_map_size;
     inet_windowsize = var_inet_windowsize;
+    regexp_prefilter_enable = var_regexp_prefilter;
 
     /*
      * Variables whose defaults are determined at runtime, after other
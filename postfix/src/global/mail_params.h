@@ -378,6 +378,14 @@ extern char *var_rcpt_witheld;
 #define DEF_ALWAYS_ADD_HDRS	0
 extern bool var_always_add_hdrs;
 
+ /*
+  * Cleanup server: share queue file fsync() work with other cleanup(8)
+  * processes.
+  */
+#define VAR_CLEANUP_GROUP_COMMIT	"cleanup_group_commit_enable"
+#define DEF_CLEANUP_GROUP_COMMIT	0
+extern bool var_cleanup_group_commit;
+
  /*
   * Dropping message headers.
   */
@@ -702,6 +710,18 @@ extern int var_tls_rand_bytes;
 #define DEF_TLS_DAEMON_RAND_BYTES	32
 extern int var_tls_daemon_rand_bytes;
 
+ /*
+  * Optional shared-memory session cache, so that the SMTP client and server
+  * can save and resume TLS sessions without a round trip to tlsmgr(8).
+  */
+#define VAR_TLS_SHM_ENABLE	"tls_shared_session_cache_enable"
+#define DEF_TLS_SHM_ENABLE	0
+extern bool var_tls_shm_enable;
+
+#define VAR_TLS_SHM_SIZE	"tls_shared_session_cache_size"
+#define DEF_TLS_SHM_SIZE	2000
+extern int var_tls_shm_size;
+
 #define VAR_TLS_RESEED_PERIOD	"tls_random_reseed_period"
 #define DEF_TLS_RESEED_PERIOD	"3600s"
 extern int var_tls_reseed_period;
@@ -867,6 +887,14 @@ extern char *var_defer_xports;
 #define DEF_QMGR_CLOG_WARN_TIME	"300s"
 extern int var_qmgr_clog_warn_time;
 
+ /*
+  * Queue manager: keep an in-memory index of deferred queue files, so that
+  * periodic deferred queue runs need not read the queue directory.
+  */
+#define VAR_QMGR_DEFER_INDEX	"qmgr_deferred_index_enable"
+#define DEF_QMGR_DEFER_INDEX	1
+extern bool var_qmgr_defer_index;
+
  /*
   * Master: default process count limit per mail subsystem.
   */
@@ -929,6 +957,38 @@ extern int var_ipc_idle_limit;
 #define DEF_IPC_TTL		"1000s"
 extern int var_ipc_ttl_limit;
 
+ /*
+  * Any subsystem: the address rewriting and resolving clients remember up
+  * to this many trivial-rewrite(8) results, each for a limited time.
+  */
+#define VAR_REWRITE_CACHE_SIZE	"rewrite_client_cache_size"
+#define DEF_REWRITE_CACHE_SIZE	100
+extern int var_rewrite_cache_size;
+
+#define VAR_REWRITE_CACHE_TTL	"rewrite_client_cache_ttl"
+#define DEF_REWRITE_CACHE_TTL	"30s"
+extern int var_rewrite_cache_ttl;
+
+ /*
+  * Any subsystem: "cachemap:" tables remember recent lookup results, and
+  * periodically log usage statistics.
+  */
+#define VAR_CACHEMAP_SIZE	"cachemap_cache_size"
+#define DEF_CACHEMAP_SIZE	1000
+extern int var_cachemap_size;
+
+#define VAR_CACHEMAP_TTL	"cachemap_cache_ttl"
+#define DEF_CACHEMAP_TTL	"60s"
+extern int var_cachemap_ttl;
+
+#define VAR_CACHEMAP_NEG_TTL	"cachemap_negative_cache_ttl"
+#define DEF_CACHEMAP_NEG_TTL	"60s"
+extern int var_cachemap_neg_ttl;
+
+#define VAR_CACHEMAP_STAT_TIME	"cachemap_status_update_time"
+#define DEF_CACHEMAP_STAT_TIME	"600s"
+extern int var_cachemap_stat_time;
+
  /*
   * Any front-end subsystem: avoid running out of memory when someone sends
   * infinitely-long requests or replies.
@@ -1695,6 +1755,18 @@ extern char *var_smtp_sasl_tlsv_opts;
 #define DEF_SMTP_DUMMY_MAIL_AUTH	0
 extern bool var_smtp_dummy_mail_auth;
 
+#define VAR_SMTP_MAP_CONTENT	"smtp_mapped_content_enable"
+#define DEF_SMTP_MAP_CONTENT	1
+#define VAR_LMTP_MAP_CONTENT	"lmtp_mapped_content_enable"
+#define DEF_LMTP_MAP_CONTENT	1
+extern bool var_smtp_map_content;
+
+#define VAR_SMTP_CHUNKING	"smtp_chunking_enable"
+#define DEF_SMTP_CHUNKING	1
+#define VAR_LMTP_CHUNKING	"lmtp_chunking_enable"
+#define DEF_LMTP_CHUNKING	1
+extern bool var_smtp_chunking;
+
  /*
   * LMTP server. The soft error limit determines how many errors an LMTP
   * client may make before we start to slow down; the hard error limit
@@ -2372,6 +2444,10 @@ extern char *var_proxy_read_acl;
 #define DEF_PROXY_WRITE_ACL	"reject"
 extern char *var_proxy_write_acl;
 
+#define VAR_PROXY_CLIENT_LIMIT	"proxymap_client_limit"
+#define DEF_PROXY_CLIENT_LIMIT	0
+extern int var_proxy_client_limit;
+
  /*
   * Other.
   */
@@ -3030,6 +3106,18 @@ extern int var_anvil_time_unit;
 #define DEF_ANVIL_STAT_TIME		"600s"
 extern int var_anvil_stat_time;
 
+ /*
+  * Optional shared-memory counters, so that the SMTP server can update
+  * connection counts and rates without a round trip to the anvil server.
+  */
+#define VAR_ANVIL_SHM_ENABLE		"anvil_shared_counters_enable"
+#define DEF_ANVIL_SHM_ENABLE		0
+extern bool var_anvil_shm_enable;
+
+#define VAR_ANVIL_SHM_SIZE		"anvil_shared_counters_size"
+#define DEF_ANVIL_SHM_SIZE		10000
+extern int var_anvil_shm_size;
+
  /*
   * Temporary stop gap.
   */
@@ -3114,6 +3202,13 @@ extern bool var_reset_owner_attr;
 #define MIN_DELAY_MAX_RES		0
 extern int var_delay_max_res;
 
+ /*
+  * Optional content transfer rate in delivery logging.
+  */
+#define VAR_XFER_RATE_LOG		"transfer_rate_logging_enable"
+#define DEF_XFER_RATE_LOG		0
+extern bool var_xfer_rate_log;
+
  /*
   * Bounce message templates.
   */
@@ -3311,6 +3406,14 @@ extern int var_milt_cmd_time;
 #define DEF_MILT_MSG_TIME		"300s"
 extern int var_milt_msg_time;
 
+#define VAR_MILT_BODY_LIMIT		"milter_body_pipeline_limit"
+#define DEF_MILT_BODY_LIMIT		1
+extern int var_milt_body_limit;
+
+#define VAR_MILT_PARALLEL		"milter_parallel_events"
+#define DEF_MILT_PARALLEL		0
+extern bool var_milt_parallel;
+
 #define VAR_MILT_PROTOCOL		"milter_protocol"
 #define DEF_MILT_PROTOCOL		"6"
 extern char *var_milt_protocol;
@@ -3575,6 +3678,10 @@ extern char *var_psc_dnsbl_reply;
 #define DEF_PSC_DNSBL_TMOUT	"10s"
 extern int var_psc_dnsbl_tmout;
 
+#define VAR_PSC_DNSBL_ASYNC	"postscreen_dnsbl_async_enable"
+#define DEF_PSC_DNSBL_ASYNC	1
+extern bool var_psc_dnsbl_async;
+
 #define VAR_PSC_PIPEL_ENABLE	"postscreen_pipelining_enable"
 #define DEF_PSC_PIPEL_ENABLE	0
 extern bool var_psc_pipel_enable;
@@ -3627,6 +3734,10 @@ extern char *var_psc_cmd_time;
 #define DEF_PSC_WATCHDOG		"10s"
 extern int var_psc_watchdog;
 
+#define VAR_PSC_MULTI_PROC	"postscreen_multi_process_enable"
+#define DEF_PSC_MULTI_PROC	0
+extern bool var_psc_multi_proc;
+
 #define VAR_PSC_EHLO_DIS_WORDS	"postscreen_discard_ehlo_keywords"
 #define DEF_PSC_EHLO_DIS_WORDS	"$" VAR_SMTPD_EHLO_DIS_WORDS
 extern char *var_psc_ehlo_dis_words;
@@ -3709,6 +3820,10 @@ extern char *var_tlsproxy_service;
 #define DEF_TLSP_WATCHDOG	"10s"
 extern int var_tlsp_watchdog;
 
+#define VAR_TLSP_HS_LIMIT	"tlsproxy_handshake_limit"
+#define DEF_TLSP_HS_LIMIT	10
+extern int var_tlsp_hs_limit;
+
 #define VAR_TLSP_TLS_LEVEL	"tlsproxy_tls_security_level"
 #define DEF_TLSP_TLS_LEVEL	"$" VAR_SMTPD_TLS_LEVEL
 extern char *var_tlsp_tls_level;
@@ -3971,6 +4086,22 @@ extern int var_idna2003_compat;
 #define DEF_DNS_NCACHE_TTL_FIX		0
 extern bool var_dns_ncache_ttl_fix;
 
+ /*
+  * Skip regexp: and pcre: table rules whose required literal text is absent
+  * from the lookup string.
+  */
+#define VAR_REGEXP_PREFILTER		"regexp_table_prefilter"
+#define DEF_REGEXP_PREFILTER		1
+extern bool var_regexp_prefilter;
+
+ /*
+  * Send the DNS queries for a multi-type lookup, or for all mail exchangers
+  * of a domain, at the same time.
+  */
+#define VAR_DNS_PARALLEL		"dns_parallel_lookup_enable"
+#define DEF_DNS_PARALLEL		0
+extern bool var_dns_parallel;
+
 /* LICENSE
 /* .ad
 /* .fi
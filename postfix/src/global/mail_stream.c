@@ -38,6 +38,9 @@
 /*	void	mail_stream_ctl(info, op, ...)
 /*	MAIL_STREAM *info;
 /*	int	op;
+/*
+/*	void	mail_stream_group_sync(gs)
+/*	GROUP_SYNC *gs;
 /* DESCRIPTION
 /*	This module provides a generic interface to Postfix queue file
 /*	format messages to file, to Postfix server, or to external command.
@@ -96,6 +99,12 @@
 /*	file modification time stamp by this amount.  This has
 /*	effect only within the deferred mail queue.
 /*	This feature may have no effect with remote file systems.
+/* .PP
+/*	mail_stream_group_sync() specifies a group_sync(3) handle
+/*	that replaces the per-file fsync() call when a file stream
+/*	is finished, so that concurrent processes share the cost
+/*	of making their queue files durable. Specify a null pointer
+/*	to use fsync() again.
 /* LICENSE
 /* .ad
 /* .fi
@@ -142,6 +151,8 @@
 
 static VSTRING *id_buf;
 
+static GROUP_SYNC *mail_stream_gsync;
+
 #define FREE_AND_WIPE(free, arg) do { if (arg) free(arg); arg = 0; } while (0)
 
 #define STR(x)	vstring_str(x)
@@ -295,7 +306,9 @@ static int mail_stream_finish_file(MAIL_STREAM *info, VSTRING *unused_why)
 #endif
 	|| fchmod(vstream_fileno(info->stream), 0700 | info->mode)
 #ifdef HAS_FSYNC
-	|| fsync(vstream_fileno(info->stream))
+	|| (mail_stream_gsync ?
+	    group_sync(mail_stream_gsync, vstream_fileno(info->stream)) :
+	    fsync(vstream_fileno(info->stream)))
 #endif
 	|| (check_incoming_fs_clock
 	    && fstat(vstream_fileno(info->stream), &st) < 0)
@@ -617,3 +630,10 @@ void    mail_stream_ctl(MAIL_STREAM *info, int op,...)
 	vstring_free(new_path);
     }
 }
+
+/* mail_stream_group_sync - share file synchronization */
+
+void    mail_stream_group_sync(GROUP_SYNC *gs)
+{
+    mail_stream_gsync = gs;
+}
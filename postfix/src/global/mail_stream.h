@@ -23,6 +23,11 @@
 #include <vstring.h>
 #include <check_arg.h>
 
+ /*
+  * Global library.
+  */
+#include <group_sync.h>
+
  /*
   * External interface.
   */
@@ -75,6 +80,7 @@ extern MAIL_STREAM *mail_stream_command(const char *);
 extern void mail_stream_cleanup(MAIL_STREAM *);
 extern int mail_stream_finish(MAIL_STREAM *, VSTRING *);
 extern void mail_stream_ctl(MAIL_STREAM *, int,...);
+extern void mail_stream_group_sync(GROUP_SYNC *);
 
 
 /* LICENSE
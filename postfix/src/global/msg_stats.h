@@ -51,6 +51,10 @@
   * transaction. These agents explicitly update the deliver_done time stamp
   * to ensure that multiple recipient records show the exact same delay
   * values.
+  * 
+  * Network clients that send message content may also record when they
+  * started sending it, and how many bytes they sent, so that the transfer
+  * rate can be reported.
   */
 typedef struct {
     struct timeval incoming_arrival;	/* incoming queue entry */
@@ -58,6 +62,8 @@ typedef struct {
     struct timeval agent_handoff;	/* delivery agent hand-off */
     struct timeval conn_setup_done;	/* connection set-up done */
     struct timeval deliver_done;	/* transmission done */
+    struct timeval data_start;		/* content transmission start */
+    off_t   data_bytes;			/* content bytes sent */
     int     reuse_count;		/* connection reuse count */
 } MSG_STATS;
 
@@ -0,0 +1,51 @@
+#ifndef _REC_BATCH_H_INCLUDED_
+#define _REC_BATCH_H_INCLUDED_
+
+/*++
+/* NAME
+/*	rec_batch 3h
+/* SUMMARY
+/*	batched typed record output
+/* SYNOPSIS
+/*	#include <rec_batch.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * Utility library.
+  */
+#include <vstream.h>
+
+ /*
+  * External interface.
+  */
+typedef struct REC_BATCH {
+    ssize_t len;			/* pending output bytes */
+    ssize_t limit;			/* automatic flush threshold */
+    char  **chunks;			/* fixed-size storage units */
+    int     nchunks;			/* storage units in use */
+    int     chunk_count;		/* storage units allocated */
+} REC_BATCH;
+
+#define REC_BATCH_CHUNK		8192	/* storage unit size */
+
+extern REC_BATCH *rec_batch_create(ssize_t);
+extern int rec_batch_put(VSTREAM *, REC_BATCH *, int, const char *, ssize_t);
+extern int rec_batch_flush(VSTREAM *, REC_BATCH *);
+extern void rec_batch_free(REC_BATCH *);
+
+#define REC_BATCH_LEN(b)	((b)->len)
+#define REC_BATCH_RESET(b)	((b)->len = 0)
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+#endif
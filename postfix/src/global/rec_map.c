@@ -0,0 +1,255 @@
+/*++
+/* NAME
+/*	rec_map 3
+/* SUMMARY
+/*	memory-mapped typed record input
+/* SYNOPSIS
+/*	#include <rec_map.h>
+/*
+/*	REC_MAP *rec_map_open(stream, offset)
+/*	VSTREAM	*stream;
+/*	off_t	offset;
+/*
+/*	int	rec_map_get(map, data, len)
+/*	REC_MAP	*map;
+/*	const char **data;
+/*	ssize_t	*len;
+/*
+/*	REC_MAP	*rec_map_close(map)
+/*	REC_MAP	*map;
+/*
+/*	void	REC_MAP_REWIND(map)
+/*	REC_MAP	*map;
+/* DESCRIPTION
+/*	This module reads the same typed records as rec_get(3)
+/*	without record-following options, but it reads them from
+/*	a read-only memory mapping of the file instead of through
+/*	the stream buffer. The caller receives a pointer into the
+/*	mapped file, so that record data is not copied into a
+/*	VSTRING before it is used.
+/*
+/*	rec_map_open() maps the file that is open on the named
+/*	stream, from the specified offset to the end of the file.
+/*	The stream's file position is not changed. The result is
+/*	a null pointer when the file cannot be mapped; the caller
+/*	should then use rec_get(3) instead.
+/*
+/*	rec_map_get() returns the type of the next record, and
+/*	stores the location and length of the record data via the
+/*	\fIdata\fR and \fIlen\fR arguments. The record data is not
+/*	null-terminated, and remains valid until rec_map_close()
+/*	is called. The result is REC_TYPE_EOF at the end of the
+/*	file, and REC_TYPE_ERROR when a record is malformed.
+/*
+/*	rec_map_close() unmaps the file. The result is a null
+/*	pointer.
+/*
+/*	REC_MAP_REWIND() makes the next rec_map_get() call return
+/*	the record at the offset that was given to rec_map_open().
+/* DIAGNOSTICS
+/*	rec_map_open() and rec_map_get() log problems as a warning.
+/*	Fatal errors: insufficient memory.
+/* BUGS
+/*	The file must not be truncated while it is mapped. Postfix
+/*	queue files are truncated only by their owner, while no
+/*	delivery agent is reading them.
+/* SEE ALSO
+/*	record(3), typed record I/O
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef MAP_FAILED
+#define MAP_FAILED	((void *) -1)
+#endif
+
+#ifndef NBBY
+#define NBBY 8				/* XXX should be in sys_defs.h */
+#endif
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <vstream.h>
+
+/* Global library. */
+
+#include <record.h>
+#include <rec_map.h>
+
+/* rec_map_open - map file from offset to end */
+
+REC_MAP *rec_map_open(VSTREAM *stream, off_t offset)
+{
+    const char *myname = "rec_map_open";
+    REC_MAP *map;
+    struct stat st;
+    off_t   start;
+    void   *ptr;
+    long    page_size;
+
+    /*
+     * The mapping must start at a page boundary. Don't bother with files
+     * that are larger than the address space, or with an offset that is
+     * beyond the end of the file.
+     */
+    if (fstat(vstream_fileno(stream), &st) < 0) {
+	msg_warn("%s: fstat %s: %m", myname, VSTREAM_PATH(stream));
+	return (0);
+    }
+    if (offset < 0 || offset >= st.st_size
+	|| (off_t) (size_t) st.st_size != st.st_size)
+	return (0);
+    if ((page_size = sysconf(_SC_PAGESIZE)) <= 0)
+	page_size = 4096;
+    start = offset - offset % page_size;
+    if ((ptr = mmap((void *) 0, (size_t) (st.st_size - start), PROT_READ,
+		    MAP_SHARED, vstream_fileno(stream), start)) == MAP_FAILED) {
+	msg_warn("%s: mmap %s: %m", myname, VSTREAM_PATH(stream));
+	return (0);
+    }
+    map = (REC_MAP *) mymalloc(sizeof(*map));
+    map->base = (char *) ptr;
+    map->size = (size_t) (st.st_size - start);
+    map->start = map->cp = map->base + (offset - start);
+    map->end = map->base + map->size;
+    map->path = mystrdup(VSTREAM_PATH(stream));
+    return (map);
+}
+
+/* rec_map_get - read next record from memory */
+
+int     rec_map_get(REC_MAP *map, const char **data, ssize_t *len)
+{
+    const char *myname = "rec_map_get";
+    const unsigned char *cp = (const unsigned char *) map->cp;
+    const unsigned char *end = (const unsigned char *) map->end;
+    int     type;
+    ssize_t n;
+    unsigned shift;
+
+    /*
+     * Extract the record type.
+     */
+    if (cp >= end)
+	return (REC_TYPE_EOF);
+    type = *cp++;
+
+    /*
+     * Find out the record data length. This uses the same limits as
+     * rec_get(3), so that both accept the same input.
+     */
+    for (n = 0, shift = 0; /* void */ ; shift += 7) {
+	if (shift >= (int) (NBBY * sizeof(int))) {
+	    msg_warn("%s: too many length bits, record type %d",
+		     map->path, type);
+	    return (REC_TYPE_ERROR);
+	}
+	if (cp >= end) {
+	    msg_warn("%s: unexpected EOF reading length, record type %d",
+		     map->path, type);
+	    return (REC_TYPE_ERROR);
+	}
+	n |= (*cp & 0177) << shift;
+	if ((*cp++ & 0200) == 0)
+	    break;
+    }
+    if (n < 0) {
+	msg_warn("%s: illegal length %ld, record type %d",
+		 map->path, (long) n, type);
+	return (REC_TYPE_ERROR);
+    }
+    if (n > end - cp) {
+	msg_warn("%s: unexpected EOF in data, record type %d length %ld",
+		 map->path, type, (long) n);
+	return (REC_TYPE_ERROR);
+    }
+    *data = (const char *) cp;
+    *len = n;
+    map->cp = (const char *) cp + n;
+    if (msg_verbose > 2)
+	msg_info("%s: type %c len %ld data %.*s", myname,
+		 type, (long) n, (int) (n < 10 ? n : 10), *data);
+    return (type);
+}
+
+/* rec_map_close - unmap file */
+
+REC_MAP *rec_map_close(REC_MAP *map)
+{
+    if (munmap((void *) map->base, map->size) < 0)
+	msg_warn("munmap %s: %m", map->path);
+    myfree(map->path);
+    myfree((void *) map);
+    return (0);
+}
+
+#ifdef TEST
+
+ /*
+  * Proof-of-concept test program. Read a record file with rec_get() and
+  * with rec_map_get() from the specified offset, and verify that both
+  * produce the same records.
+  */
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <vstring.h>
+#include <msg_vstream.h>
+
+int     main(int argc, char **argv)
+{
+    VSTRING *buf = vstring_alloc(100);
+    VSTREAM *fp;
+    REC_MAP *map;
+    off_t   offset;
+    const char *data;
+    ssize_t len;
+    int     type1;
+    int     type2;
+    int     count = 0;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    if (argc != 3)
+	msg_fatal("usage: %s record-file offset", argv[0]);
+    if ((fp = vstream_fopen(argv[1], O_RDONLY, 0)) == 0)
+	msg_fatal("open %s: %m", argv[1]);
+    offset = atol(argv[2]);
+    if ((map = rec_map_open(fp, offset)) == 0)
+	msg_fatal("cannot map %s at offset %ld", argv[1], (long) offset);
+    if (vstream_fseek(fp, offset, SEEK_SET) < 0)
+	msg_fatal("seek %s: %m", argv[1]);
+    do {
+	type1 = rec_get_raw(fp, buf, 0, REC_FLAG_NONE);
+	type2 = rec_map_get(map, &data, &len);
+	if (type1 != type2)
+	    msg_fatal("record %d: type %d != %d", count, type1, type2);
+	if (type1 > 0 && (len != VSTRING_LEN(buf)
+			  || memcmp(data, vstring_str(buf), len) != 0))
+	    msg_fatal("record %d: data differs", count);
+	count += 1;
+    } while (type1 > 0);
+    vstream_printf("%d records\n", count - 1);
+    vstream_fflush(VSTREAM_OUT);
+    rec_map_close(map);
+    vstream_fclose(fp);
+    vstring_free(buf);
+    return (0);
+}
+
+#endif
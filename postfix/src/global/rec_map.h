@@ -0,0 +1,48 @@
+#ifndef _REC_MAP_H_INCLUDED_
+#define _REC_MAP_H_INCLUDED_
+
+/*++
+/* NAME
+/*	rec_map 3h
+/* SUMMARY
+/*	memory-mapped typed record input
+/* SYNOPSIS
+/*	#include <rec_map.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * Utility library.
+  */
+#include <vstream.h>
+
+ /*
+  * External interface.
+  */
+typedef struct REC_MAP {
+    char   *base;			/* mapped memory */
+    size_t  size;			/* mapped size */
+    const char *start;			/* initial read position */
+    const char *cp;			/* read position */
+    const char *end;			/* end of file */
+    char   *path;			/* for diagnostics */
+} REC_MAP;
+
+extern REC_MAP *rec_map_open(VSTREAM *, off_t);
+extern int rec_map_get(REC_MAP *, const char **, ssize_t *);
+extern REC_MAP *rec_map_close(REC_MAP *);
+
+#define REC_MAP_REWIND(m)	((m)->cp = (m)->start)
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+#endif
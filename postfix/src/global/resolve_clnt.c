@@ -48,6 +48,10 @@
 /*	resolve_clnt_verify_from() implements an alternative version that can
 /*	be used for address verification.
 /*
+/*	Results are cached for $rewrite_client_cache_ttl seconds;
+/*	at most $rewrite_client_cache_size results are kept, and
+/*	the least-recently used result is discarded first.
+/*
 /*	In the resolver reply, the flags member is the bit-wise OR of
 /*	zero or more of the following:
 /* .IP RESOLVE_FLAG_FINAL
@@ -116,6 +120,8 @@
 #include <vstring_vstream.h>
 #include <events.h>
 #include <iostuff.h>
+#include <mymalloc.h>
+#include <ttl_cache.h>
 
 /* Global library. */
 
@@ -131,11 +137,33 @@
   */
 extern CLNT_STREAM *rewrite_clnt_stream;
 
-static time_t last_expire;
-static VSTRING *last_class;
-static VSTRING *last_sender;
-static VSTRING *last_addr;
-static RESOLVE_REPLY last_reply;
+ /*
+  * Recently-used results, keyed by (class, sender, address).
+  */
+static TTL_CACHE *resolve_cache;
+static VSTRING *resolve_cache_key;
+static unsigned long resolve_cache_hits;
+static unsigned long resolve_cache_misses;
+
+/* resolve_cache_copy - copy reply */
+
+static void resolve_cache_copy(RESOLVE_REPLY *dst, RESOLVE_REPLY *src)
+{
+    vstring_strcpy(dst->transport, vstring_str(src->transport));
+    vstring_strcpy(dst->nexthop, vstring_str(src->nexthop));
+    vstring_strcpy(dst->recipient, vstring_str(src->recipient));
+    dst->flags = src->flags;
+}
+
+/* resolve_cache_free - destroy cached reply */
+
+static void resolve_cache_free(void *value)
+{
+    RESOLVE_REPLY *reply = (RESOLVE_REPLY *) value;
+
+    resolve_clnt_free(reply);
+    myfree((void *) reply);
+}
 
 /* resolve_clnt_init - initialize reply */
 
@@ -156,15 +184,17 @@ void    resolve_clnt(const char *class, const char *sender,
     VSTREAM *stream;
     int     server_flags;
     int     count = 0;
+    RESOLVE_REPLY *cached;
+    void   *ptr;
 
     /*
-     * One-entry cache.
+     * Multi-entry cache. Don't bother when it would hold less than one
+     * result.
      */
-    if (last_addr == 0) {
-	last_class = vstring_alloc(10);
-	last_sender = vstring_alloc(10);
-	last_addr = vstring_alloc(100);
-	resolve_clnt_init(&last_reply);
+    if (resolve_cache == 0 && var_rewrite_cache_size > 0) {
+	resolve_cache = ttl_cache_create(var_rewrite_cache_size,
+					 resolve_cache_free);
+	resolve_cache_key = vstring_alloc(100);
     }
 
     /*
@@ -177,32 +207,37 @@ void    resolve_clnt(const char *class, const char *sender,
 	msg_panic("%s: result clobbers input", myname);
 
     /*
-     * Peek at the cache.
+     * Peek at the cache. The sender length disambiguates the lookup key,
+     * because an address may contain any character.
      */
 #define IFSET(flag, text) ((reply->flags & (flag)) ? (text) : "")
 
-    if (time((time_t *) 0) < last_expire
-	&& *addr && strcmp(addr, STR(last_addr)) == 0
-	&& strcmp(class, STR(last_class)) == 0
-	&& strcmp(sender, STR(last_sender)) == 0) {
-	vstring_strcpy(reply->transport, STR(last_reply.transport));
-	vstring_strcpy(reply->nexthop, STR(last_reply.nexthop));
-	vstring_strcpy(reply->recipient, STR(last_reply.recipient));
-	reply->flags = last_reply.flags;
+    if (resolve_cache != 0 && *addr) {
+	vstring_sprintf(resolve_cache_key, "%s\n%ld\n%s%s", class,
+			(long) strlen(sender), sender, addr);
+	if (!ttl_cache_find(resolve_cache, STR(resolve_cache_key), &ptr)) {
+	    resolve_cache_misses += 1;
+	} else {
+	    resolve_cache_hits += 1;
+	    resolve_cache_copy(reply, (RESOLVE_REPLY *) ptr);
+	    if (msg_verbose)
+		msg_info("%s: cached: `%s' -> `%s' -> transp=`%s' host=`%s' rcpt=`%s' flags=%s%s%s%s class=%s%s%s%s%s",
+			 myname, sender, addr, STR(reply->transport),
+			 STR(reply->nexthop), STR(reply->recipient),
+			 IFSET(RESOLVE_FLAG_FINAL, "final"),
+			 IFSET(RESOLVE_FLAG_ROUTED, "routed"),
+			 IFSET(RESOLVE_FLAG_ERROR, "error"),
+			 IFSET(RESOLVE_FLAG_FAIL, "fail"),
+			 IFSET(RESOLVE_CLASS_LOCAL, "local"),
+			 IFSET(RESOLVE_CLASS_ALIAS, "alias"),
+			 IFSET(RESOLVE_CLASS_VIRTUAL, "virtual"),
+			 IFSET(RESOLVE_CLASS_RELAY, "relay"),
+			 IFSET(RESOLVE_CLASS_DEFAULT, "default"));
+	    return;
+	}
 	if (msg_verbose)
-	    msg_info("%s: cached: `%s' -> `%s' -> transp=`%s' host=`%s' rcpt=`%s' flags=%s%s%s%s class=%s%s%s%s%s",
-		     myname, sender, addr, STR(reply->transport),
-		     STR(reply->nexthop), STR(reply->recipient),
-		     IFSET(RESOLVE_FLAG_FINAL, "final"),
-		     IFSET(RESOLVE_FLAG_ROUTED, "routed"),
-		     IFSET(RESOLVE_FLAG_ERROR, "error"),
-		     IFSET(RESOLVE_FLAG_FAIL, "fail"),
-		     IFSET(RESOLVE_CLASS_LOCAL, "local"),
-		     IFSET(RESOLVE_CLASS_ALIAS, "alias"),
-		     IFSET(RESOLVE_CLASS_VIRTUAL, "virtual"),
-		     IFSET(RESOLVE_CLASS_RELAY, "relay"),
-		     IFSET(RESOLVE_CLASS_DEFAULT, "default"));
-	return;
+	    msg_info("%s: cache hits=%lu misses=%lu", myname,
+		     resolve_cache_hits, resolve_cache_misses);
     }
 
     /*
@@ -265,16 +300,15 @@ void    resolve_clnt(const char *class, const char *sender,
     }
 
     /*
-     * Update the cache.
+     * Update the cache. The cache key is still intact.
      */
-    vstring_strcpy(last_class, class);
-    vstring_strcpy(last_sender, sender);
-    vstring_strcpy(last_addr, addr);
-    vstring_strcpy(last_reply.transport, STR(reply->transport));
-    vstring_strcpy(last_reply.nexthop, STR(reply->nexthop));
-    vstring_strcpy(last_reply.recipient, STR(reply->recipient));
-    last_reply.flags = reply->flags;
-    last_expire = time((time_t *) 0) + 30;	/* XXX make configurable */
+    if (resolve_cache != 0 && *addr) {
+	cached = (RESOLVE_REPLY *) mymalloc(sizeof(*cached));
+	resolve_clnt_init(cached);
+	resolve_cache_copy(cached, reply);
+	ttl_cache_enter(resolve_cache, STR(resolve_cache_key), (void *) cached,
+			var_rewrite_cache_ttl);
+    }
 }
 
 /* resolve_clnt_free - destroy reply */
@@ -385,6 +419,11 @@ int     main(int argc, char **argv)
 	}
 	vstring_free(buffer);
     }
+    if (resolve_cache != 0) {
+	vstream_printf("cache hits=%lu misses=%lu\n",
+		       resolve_cache_hits, resolve_cache_misses);
+	vstream_fflush(VSTREAM_OUT);
+    }
     resolve_clnt_free(&reply);
     exit(0);
 }
@@ -21,7 +21,10 @@
 /*	rewrite_clnt() sends a rule set name and external-form address to the
 /*	rewriting service and returns the resulting external-form address.
 /*	In case of communication failure the program keeps trying until the
-/*	mail system shuts down.
+/*	mail system shuts down. Results are cached for
+/*	$rewrite_client_cache_ttl seconds; at most
+/*	$rewrite_client_cache_size results are kept, and the
+/*	least-recently used result is discarded first.
 /*
 /*	rewrite_clnt_internal() performs the same functionality but takes
 /*	input in internal (unquoted) form, and produces output in internal
@@ -56,6 +59,8 @@
 #include <vstring_vstream.h>
 #include <events.h>
 #include <iostuff.h>
+#include <mymalloc.h>
+#include <ttl_cache.h>
 #include <quote_822_local.h>
 
 /* Global library. */
@@ -72,10 +77,13 @@
   */
 CLNT_STREAM *rewrite_clnt_stream = 0;
 
-static time_t last_expire;
-static VSTRING *last_rule;
-static VSTRING *last_addr;
-static VSTRING *last_result;
+ /*
+  * Recently-used results, keyed by (rule, address).
+  */
+static TTL_CACHE *rewrite_cache;
+static VSTRING *rewrite_cache_key;
+static unsigned long rewrite_cache_hits;
+static unsigned long rewrite_cache_misses;
 
 /* rewrite_clnt - rewrite address to (transport, next hop, recipient) */
 
@@ -84,14 +92,15 @@ VSTRING *rewrite_clnt(const char *rule, const char *addr, VSTRING *result)
     VSTREAM *stream;
     int     server_flags;
     int     count = 0;
+    void   *cached;
 
     /*
-     * One-entry cache.
+     * Multi-entry cache. Don't bother when it would hold less than one
+     * result.
      */
-    if (last_addr == 0) {
-	last_rule = vstring_alloc(10);
-	last_addr = vstring_alloc(100);
-	last_result = vstring_alloc(100);
+    if (rewrite_cache == 0 && var_rewrite_cache_size > 0) {
+	rewrite_cache = ttl_cache_create(var_rewrite_cache_size, myfree);
+	rewrite_cache_key = vstring_alloc(100);
     }
 
     /*
@@ -108,14 +117,21 @@ VSTRING *rewrite_clnt(const char *rule, const char *addr, VSTRING *result)
     /*
      * Peek at the cache.
      */
-    if (time((time_t *) 0) < last_expire
-	&& strcmp(addr, STR(last_addr)) == 0
-	&& strcmp(rule, STR(last_rule)) == 0) {
-	vstring_strcpy(result, STR(last_result));
+    if (rewrite_cache != 0) {
+	vstring_sprintf(rewrite_cache_key, "%s\n%s", rule, addr);
+	if (!ttl_cache_find(rewrite_cache, STR(rewrite_cache_key), &cached)) {
+	    rewrite_cache_misses += 1;
+	} else {
+	    rewrite_cache_hits += 1;
+	    vstring_strcpy(result, (char *) cached);
+	    if (msg_verbose)
+		msg_info("rewrite_clnt: cached: %s: %s -> %s",
+			 rule, addr, vstring_str(result));
+	    return (result);
+	}
 	if (msg_verbose)
-	    msg_info("rewrite_clnt: cached: %s: %s -> %s",
-		     rule, addr, vstring_str(result));
-	return (result);
+	    msg_info("rewrite_clnt: cache hits=%lu misses=%lu",
+		     rewrite_cache_hits, rewrite_cache_misses);
     }
 
     /*
@@ -160,12 +176,11 @@ VSTRING *rewrite_clnt(const char *rule, const char *addr, VSTRING *result)
     }
 
     /*
-     * Update the cache.
+     * Update the cache. The cache key is still intact.
      */
-    vstring_strcpy(last_rule, rule);
-    vstring_strcpy(last_addr, addr);
-    vstring_strcpy(last_result, STR(result));
-    last_expire = time((time_t *) 0) + 30;	/* XXX make configurable */
+    if (rewrite_cache != 0)
+	ttl_cache_enter(rewrite_cache, STR(rewrite_cache_key),
+			mystrdup(STR(result)), var_rewrite_cache_ttl);
 
     return (result);
 }
@@ -257,6 +272,11 @@ int     main(int argc, char **argv)
 	}
 	vstring_free(buffer);
     }
+    if (rewrite_cache != 0) {
+	vstream_printf("cache hits=%lu misses=%lu\n",
+		       rewrite_cache_hits, rewrite_cache_misses);
+	vstream_fflush(VSTREAM_OUT);
+    }
     vstring_free(reply);
     exit(0);
 }
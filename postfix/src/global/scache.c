@@ -46,6 +46,16 @@
 /*	const char *dest_label;
 /*	VSTRING	*dest_prop;
 /*	VSTRING	*endp_prop;
+/*
+/*	void	scache_save_sess(scache, ttl, dest_label, dest_prop,
+/*				endp_label, endp_prop, fd)
+/*	SCACHE	*scache;
+/*	int	ttl;
+/*	const char *dest_label;
+/*	const char *dest_prop;
+/*	const char *endp_label;
+/*	const char *endp_prop;
+/*	int	fd;
 /* DESCRIPTION
 /*	This module implements a generic session cache interface.
 /*	Specific cache types are described in scache_single(3),
@@ -80,6 +90,16 @@
 /*	scache_find_dest() looks up a saved session under the
 /*	specified physical endpoint name.
 /*
+/*	scache_save_sess() combines scache_save_dest() and
+/*	scache_save_endp(): it stores an open session under the
+/*	specified physical endpoint name, and associates that
+/*	endpoint with the specified logical destination name.
+/*	Specify a null dest_label pointer to store the session
+/*	without a destination. Applications should use this
+/*	function instead of a scache_save_dest() and scache_save_endp()
+/*	pair; it saves a round trip with scache_clnt(3), and it is
+/*	required with scache_shard(3).
+/*
 /*	Arguments:
 /* .IP endp_ttl
 /*	How long the session should be cached.  When information
@@ -120,6 +140,9 @@
 /*	destination name, numerical port, whether the physical
 /*	endpoint is best mx host with respect to a logical or
 /*	fall-back destination, and when information expires.
+/* .IP ttl
+/*	With scache_save_sess(), the time to live of both the session
+/*	and the destination-to-endpoint binding.
 /* .IP fd
 /*	File descriptor with session to be cached.
 /* DIAGNOSTICS
@@ -132,6 +155,7 @@
 /*	scache_single(3), single-session, in-memory cache
 /*	scache_clnt(3), session cache client
 /*	scache_multi(3), multi-session, in-memory cache
+/*	scache_shard(3), sharded session cache client
 /* LICENSE
 /* .ad
 /* .fi
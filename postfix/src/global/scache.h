@@ -86,6 +86,14 @@ typedef int (*SCACHE_FIND_ENDP_FN) (SCACHE *, const char *, VSTRING *);
 typedef void (*SCACHE_SAVE_DEST_FN) (SCACHE *, int, const char *, const char *, const char *);
 typedef int (*SCACHE_FIND_DEST_FN) (SCACHE *, const char *, VSTRING *, VSTRING *);
 
+ /*
+  * Save a session and, optionally, its destination->endpoint binding in one
+  * operation. With a cache server this saves one round trip per session,
+  * and it guarantees that the binding and the session end up in the same
+  * cache instance.
+  */
+typedef void (*SCACHE_SAVE_SESS_FN) (SCACHE *, int, const char *, const char *, const char *, const char *, int);
+
  /*
   * Session cache statistics. These are the actual numbers at a specific
   * point in time.
@@ -105,6 +113,7 @@ struct SCACHE {
     SCACHE_FIND_ENDP_FN find_endp;
     SCACHE_SAVE_DEST_FN save_dest;
     SCACHE_FIND_DEST_FN find_dest;
+    SCACHE_SAVE_SESS_FN save_sess;
     void    (*size) (struct SCACHE *, SCACHE_SIZE *);
     void    (*free) (struct SCACHE *);
 };
@@ -112,6 +121,7 @@ struct SCACHE {
 extern SCACHE *scache_single_create(void);
 extern SCACHE *scache_clnt_create(const char *, int, int, int);
 extern SCACHE *scache_multi_create(void);
+extern SCACHE *scache_shard_create(const char *, int, int, int);
 
 #define scache_save_endp(scache, ttl, endp_label, endp_prop, fd) \
     (scache)->save_endp((scache), (ttl), (endp_label), (endp_prop), (fd))
@@ -121,6 +131,10 @@ extern SCACHE *scache_multi_create(void);
     (scache)->save_dest((scache), (ttl), (dest_label), (dest_prop), (endp_label))
 #define scache_find_dest(scache, dest_label, dest_prop, endp_prop) \
     (scache)->find_dest((scache), (dest_label), (dest_prop), (endp_prop))
+#define scache_save_sess(scache, ttl, dest_label, dest_prop, endp_label, \
+	    endp_prop, fd) \
+    (scache)->save_sess((scache), (ttl), (dest_label), (dest_prop), \
+	    (endp_label), (endp_prop), (fd))
 #define scache_size(scache, stats) (scache)->size((scache), (stats))
 #define scache_free(scache) (scache)->free(scache)
 
@@ -130,6 +144,7 @@ extern SCACHE *scache_multi_create(void);
 #define SCACHE_TYPE_SINGLE	1	/* single-instance cache */
 #define SCACHE_TYPE_CLIENT	2	/* session cache client */
 #define SCACHE_TYPE_MULTI	3	/* multi-instance cache */
+#define SCACHE_TYPE_SHARD	4	/* sharded session cache client */
 
  /*
   * Client-server protocol.
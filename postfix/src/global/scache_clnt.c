@@ -16,6 +16,9 @@
 /*	session cache service.
 /*
 /*	scache_clnt_create() creates a session cache service client.
+/*	The scache_save_sess() operation sends its two requests
+/*	back-to-back, so that it costs one round trip less than
+/*	scache_save_dest() followed by scache_save_endp().
 /*
 /*	Arguments:
 /* .IP server
@@ -375,6 +378,117 @@ static int scache_clnt_find_dest(SCACHE *scache, const char *dest_label,
     return (-1);
 }
 
+/* scache_clnt_save_sess - save session and destination binding */
+
+static void scache_clnt_save_sess(SCACHE *scache, int ttl,
+				          const char *dest_label,
+				          const char *dest_prop,
+				          const char *endp_label,
+				          const char *endp_prop, int fd)
+{
+    SCACHE_CLNT *sp = (SCACHE_CLNT *) scache;
+    const char *myname = "scache_clnt_save_sess";
+    VSTREAM *stream;
+    int     dest_status;
+    int     endp_status;
+    int     tries;
+    int     count = 0;
+
+    /*
+     * Without a destination there is nothing to combine.
+     */
+    if (dest_label == 0) {
+	scache_clnt_save_endp(scache, ttl, endp_label, endp_prop, fd);
+	return;
+    }
+    if (msg_verbose)
+	msg_info("%s: dest_label=%s dest_prop=%s endp=%s prop=%s fd=%d",
+		 myname, dest_label, dest_prop, endp_label, endp_prop, fd);
+
+    /*
+     * Sanity check.
+     */
+    if (ttl <= 0)
+	msg_panic("%s: bad ttl: %d", myname, ttl);
+
+    /*
+     * Send the save_dest and save_endp requests back-to-back, followed by
+     * the file descriptor, and then collect both replies. The server
+     * handles requests that arrive in the same read, so this costs one
+     * round trip instead of two.
+     * 
+     * With systems that need a handshake before a file descriptor can be
+     * sent, the server flushes the save_dest reply together with the dummy
+     * message that it sends before it waits for the descriptor. This costs
+     * two round trips instead of three.
+     * 
+     * Try a few times before disabling the cache; saving the same binding
+     * twice is harmless.
+     */
+    for (tries = 0; sp->auto_clnt != 0; tries++) {
+	if ((stream = auto_clnt_access(sp->auto_clnt)) != 0) {
+	    errno = 0;
+	    count += 1;
+	    if (attr_print(stream, ATTR_FLAG_NONE,
+			 SEND_ATTR_STR(MAIL_ATTR_REQ, SCACHE_REQ_SAVE_DEST),
+			   SEND_ATTR_INT(MAIL_ATTR_TTL, ttl),
+			   SEND_ATTR_STR(MAIL_ATTR_LABEL, dest_label),
+			   SEND_ATTR_STR(MAIL_ATTR_PROP, dest_prop),
+			   SEND_ATTR_STR(MAIL_ATTR_LABEL, endp_label),
+			   ATTR_TYPE_END) != 0
+		|| attr_print(stream, ATTR_FLAG_NONE,
+			 SEND_ATTR_STR(MAIL_ATTR_REQ, SCACHE_REQ_SAVE_ENDP),
+			      SEND_ATTR_INT(MAIL_ATTR_TTL, ttl),
+			      SEND_ATTR_STR(MAIL_ATTR_LABEL, endp_label),
+			      SEND_ATTR_STR(MAIL_ATTR_PROP, endp_prop),
+			      ATTR_TYPE_END) != 0
+		|| vstream_fflush(stream)
+#ifdef CANT_WRITE_BEFORE_SENDING_FD
+		|| attr_scan(stream, ATTR_FLAG_STRICT,
+			     RECV_ATTR_INT(MAIL_ATTR_STATUS, &dest_status),
+			     ATTR_TYPE_END) != 1
+		|| attr_scan(stream, ATTR_FLAG_STRICT,
+			     RECV_ATTR_STR(MAIL_ATTR_DUMMY, sp->dummy),
+			     ATTR_TYPE_END) != 1
+		|| LOCAL_SEND_FD(vstream_fileno(stream), fd) < 0
+#else
+		|| LOCAL_SEND_FD(vstream_fileno(stream), fd) < 0
+		|| attr_scan(stream, ATTR_FLAG_STRICT,
+			     RECV_ATTR_INT(MAIL_ATTR_STATUS, &dest_status),
+			     ATTR_TYPE_END) != 1
+#endif
+		|| attr_scan(stream, ATTR_FLAG_STRICT,
+			     RECV_ATTR_INT(MAIL_ATTR_STATUS, &endp_status),
+			     ATTR_TYPE_END) != 1) {
+		if (msg_verbose || count > 1 || (errno && errno != EPIPE && errno != ENOENT))
+		    msg_warn("problem talking to service %s: %m",
+			     VSTREAM_PATH(stream));
+		/* Give up or recover. */
+	    } else {
+		if (msg_verbose && dest_status != 0)
+		    msg_warn("%s: destination save failed with status %d",
+			     myname, dest_status);
+		if (msg_verbose && endp_status != 0)
+		    msg_warn("%s: descriptor save failed with status %d",
+			     myname, endp_status);
+		break;
+	    }
+	}
+	/* Give up or recover. */
+	if (tries >= SCACHE_MAX_TRIES - 1) {
+	    msg_warn("disabling connection caching");
+	    auto_clnt_free(sp->auto_clnt);
+	    sp->auto_clnt = 0;
+	    break;
+	}
+	sleep(1);				/* XXX make configurable */
+	auto_clnt_recover(sp->auto_clnt);
+    }
+    /* Always close the descriptor before returning. */
+    if (close(fd) < 0)
+	msg_warn("%s: close(%d): %m", myname, fd);
+}
+
 /* scache_clnt_size - dummy */
 
 static void scache_clnt_size(SCACHE *unused_scache, SCACHE_SIZE *size)
@@ -411,6 +525,7 @@ SCACHE *scache_clnt_create(const char *server, int timeout,
     sp->scache->find_endp = scache_clnt_find_endp;
     sp->scache->save_dest = scache_clnt_save_dest;
     sp->scache->find_dest = scache_clnt_find_dest;
+    sp->scache->save_sess = scache_clnt_save_sess;
     sp->scache->size = scache_clnt_size;
     sp->scache->free = scache_clnt_free;
 
@@ -449,6 +449,19 @@ static int scache_multi_find_dest(SCACHE *scache, const char *dest_label,
     return (-1);
 }
 
+/* scache_multi_save_sess - save session and destination binding */
+
+static void scache_multi_save_sess(SCACHE *scache, int ttl,
+				           const char *dest_label,
+				           const char *dest_prop,
+				           const char *endp_label,
+				           const char *endp_prop, int fd)
+{
+    if (dest_label)
+	scache_multi_save_dest(scache, ttl, dest_label, dest_prop, endp_label);
+    scache_multi_save_endp(scache, ttl, endp_label, endp_prop, fd);
+}
+
 /* scache_multi_size - size of multi-element cache object */
 
 static void scache_multi_size(SCACHE *scache, SCACHE_SIZE *size)
@@ -482,6 +495,7 @@ SCACHE *scache_multi_create(void)
     sp->scache->find_endp = scache_multi_find_endp;
     sp->scache->save_dest = scache_multi_save_dest;
     sp->scache->find_dest = scache_multi_find_dest;
+    sp->scache->save_sess = scache_multi_save_sess;
     sp->scache->size = scache_multi_size;
     sp->scache->free = scache_multi_free;
 
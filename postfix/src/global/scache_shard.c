@@ -0,0 +1,243 @@
+/*++
+/* NAME
+/*	scache_shard 3
+/* SUMMARY
+/*	sharded session cache client
+/* SYNOPSIS
+/*	#include <scache.h>
+/* DESCRIPTION
+/*	SCACHE *scache_shard_create(servers, timeout, idle_limit, ttl_limit)
+/*	const char *servers;
+/*	int	timeout;
+/*	int	idle_limit;
+/*	int	ttl_limit;
+/* DESCRIPTION
+/*	This module spreads session cache requests over multiple
+/*	session cache services, so that no single scache(8) process
+/*	has to hold all cached sessions or handle all requests.
+/*	Each service is accessed with scache_clnt(3).
+/*
+/*	A request for a logical destination goes to the service
+/*	that is selected by a hash of the destination name, and a
+/*	request for a physical endpoint without destination goes
+/*	to the service that is selected by a hash of the endpoint
+/*	name. scache_save_sess() stores a session together with its
+/*	destination binding in the destination's service, so that
+/*	scache_find_dest() can find it there.
+/*
+/*	scache_shard_create() creates a sharded session cache
+/*	client.
+/*
+/*	Arguments:
+/* .IP servers
+/*	The session cache service names, separated by comma or
+/*	whitespace.
+/* .IP timeout
+/*	Time limit for connect, send or receive operations.
+/* .IP idle_limit
+/*	Idle time after which the client disconnects.
+/* .IP ttl_limit
+/*	Upper bound on the time that a connection is allowed to persist.
+/* DIAGNOSTICS
+/*	Fatal error: memory allocation problem; no service name;
+/*	warning: communication error;
+/*	panic: internal consistency failure.
+/* BUGS
+/*	A session that is saved with a destination binding can be
+/*	found with scache_find_endp() only when the destination
+/*	and the endpoint hash to the same service. Likewise, the
+/*	scache_save_dest() and scache_save_endp() operations may
+/*	store a binding and its session in different services; use
+/*	scache_save_sess() instead.
+/*
+/*	Changing the list of service names moves most destinations
+/*	to a different service; their cached sessions expire unused.
+/* SEE ALSO
+/*	scache(3), generic session cache API
+/*	scache_clnt(3), session cache client
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <stringops.h>
+
+/* Global library. */
+
+#include <scache.h>
+
+/* Application-specific. */
+
+ /*
+  * SCACHE_SHARD is a derived type from the SCACHE super-class.
+  */
+typedef struct {
+    SCACHE  scache[1];			/* super-class */
+    SCACHE **shards;			/* scache_clnt instances */
+    int     count;			/* number of instances */
+} SCACHE_SHARD;
+
+/* scache_shard_pick - select cache instance by label */
+
+static SCACHE *scache_shard_pick(SCACHE_SHARD *sp, const char *label)
+{
+    size_t  h = 0;
+    size_t  g;
+
+    /*
+     * From the "Dragon" book by Aho, Sethi and Ullman, same as htable(3).
+     * The result must be the same in every client process.
+     */
+    while (*label) {
+	h = (h << 4U) + *(unsigned const char *) label++;
+	if ((g = (h & 0xf0000000)) != 0) {
+	    h ^= (g >> 24U);
+	    h ^= g;
+	}
+    }
+    return (sp->shards[h % sp->count]);
+}
+
+/* scache_shard_save_endp - save endpoint */
+
+static void scache_shard_save_endp(SCACHE *scache, int endp_ttl,
+				           const char *endp_label,
+				           const char *endp_prop, int fd)
+{
+    SCACHE_SHARD *sp = (SCACHE_SHARD *) scache;
+
+    scache_save_endp(scache_shard_pick(sp, endp_label), endp_ttl,
+		     endp_label, endp_prop, fd);
+}
+
+/* scache_shard_find_endp - look up cached session */
+
+static int scache_shard_find_endp(SCACHE *scache, const char *endp_label,
+				          VSTRING *endp_prop)
+{
+    SCACHE_SHARD *sp = (SCACHE_SHARD *) scache;
+
+    return (scache_find_endp(scache_shard_pick(sp, endp_label),
+			     endp_label, endp_prop));
+}
+
+/* scache_shard_save_dest - create destination/endpoint association */
+
+static void scache_shard_save_dest(SCACHE *scache, int dest_ttl,
+				           const char *dest_label,
+				           const char *dest_prop,
+				           const char *endp_label)
+{
+    SCACHE_SHARD *sp = (SCACHE_SHARD *) scache;
+
+    scache_save_dest(scache_shard_pick(sp, dest_label), dest_ttl,
+		     dest_label, dest_prop, endp_label);
+}
+
+/* scache_shard_find_dest - look up cached session */
+
+static int scache_shard_find_dest(SCACHE *scache, const char *dest_label,
+				          VSTRING *dest_prop,
+				          VSTRING *endp_prop)
+{
+    SCACHE_SHARD *sp = (SCACHE_SHARD *) scache;
+
+    return (scache_find_dest(scache_shard_pick(sp, dest_label),
+			     dest_label, dest_prop, endp_prop));
+}
+
+/* scache_shard_save_sess - save session and destination binding */
+
+static void scache_shard_save_sess(SCACHE *scache, int ttl,
+				           const char *dest_label,
+				           const char *dest_prop,
+				           const char *endp_label,
+				           const char *endp_prop, int fd)
+{
+    SCACHE_SHARD *sp = (SCACHE_SHARD *) scache;
+
+    /*
+     * The session must be stored with its destination binding, because the
+     * server resolves a destination to a session internally.
+     */
+    scache_save_sess(scache_shard_pick(sp, dest_label ?
+				       dest_label : endp_label), ttl,
+		     dest_label, dest_prop, endp_label, endp_prop, fd);
+}
+
+/* scache_shard_size - dummy */
+
+static void scache_shard_size(SCACHE *unused_scache, SCACHE_SIZE *size)
+{
+    size->dest_count = 0;
+    size->endp_count = 0;
+    size->sess_count = 0;
+}
+
+/* scache_shard_free - destroy cache */
+
+static void scache_shard_free(SCACHE *scache)
+{
+    SCACHE_SHARD *sp = (SCACHE_SHARD *) scache;
+    int     n;
+
+    for (n = 0; n < sp->count; n++)
+	scache_free(sp->shards[n]);
+    myfree((void *) sp->shards);
+    myfree((void *) sp);
+}
+
+/* scache_shard_create - initialize */
+
+SCACHE *scache_shard_create(const char *servers, int timeout,
+			            int idle_limit, int ttl_limit)
+{
+    const char *myname = "scache_shard_create";
+    SCACHE_SHARD *sp = (SCACHE_SHARD *) mymalloc(sizeof(*sp));
+    char   *saved_servers = mystrdup(servers);
+    char   *bp = saved_servers;
+    char   *server;
+    int     size = 2;
+
+    sp->scache->save_endp = scache_shard_save_endp;
+    sp->scache->find_endp = scache_shard_find_endp;
+    sp->scache->save_dest = scache_shard_save_dest;
+    sp->scache->find_dest = scache_shard_find_dest;
+    sp->scache->save_sess = scache_shard_save_sess;
+    sp->scache->size = scache_shard_size;
+    sp->scache->free = scache_shard_free;
+
+    sp->shards = (SCACHE **) mymalloc(size * sizeof(*sp->shards));
+    sp->count = 0;
+    while ((server = mystrtok(&bp, CHARS_COMMA_SP)) != 0) {
+	if (sp->count >= size) {
+	    size *= 2;
+	    sp->shards = (SCACHE **)
+		myrealloc((void *) sp->shards, size * sizeof(*sp->shards));
+	}
+	sp->shards[sp->count++] =
+	    scache_clnt_create(server, timeout, idle_limit, ttl_limit);
+    }
+    myfree(saved_servers);
+    if (sp->count == 0)
+	msg_fatal("%s: no session cache service name in \"%s\"",
+		  myname, servers);
+    if (msg_verbose)
+	msg_info("%s: %d session cache services", myname, sp->count);
+
+    return (sp->scache);
+}
@@ -258,6 +258,19 @@ static int scache_single_find_dest(SCACHE *scache, const char *dest_label,
     return (-1);
 }
 
+/* scache_single_save_sess - save session and destination binding */
+
+static void scache_single_save_sess(SCACHE *scache, int ttl,
+				            const char *dest_label,
+				            const char *dest_prop,
+				            const char *endp_label,
+				            const char *endp_prop, int fd)
+{
+    if (dest_label)
+	scache_single_save_dest(scache, ttl, dest_label, dest_prop, endp_label);
+    scache_single_save_endp(scache, ttl, endp_label, endp_prop, fd);
+}
+
 /* scache_single_size - size of single-element cache :-) */
 
 static void scache_single_size(SCACHE *scache, SCACHE_SIZE *size)
@@ -297,6 +310,7 @@ SCACHE *scache_single_create(void)
     sp->scache->find_endp = scache_single_find_endp;
     sp->scache->save_dest = scache_single_save_dest;
     sp->scache->find_dest = scache_single_find_dest;
+    sp->scache->save_sess = scache_single_save_sess;
     sp->scache->size = scache_single_size;
     sp->scache->free = scache_single_free;
 
@@ -25,6 +25,10 @@
 /*
 /*	tok822_free() releases the memory used for the specified token
 /*	and conveniently returns a null pointer value.
+/*
+/*	Released tokens are kept for re-use, together with their
+/*	string memory, so that a long-running process parses addresses
+/*	without memory allocator calls in the steady state.
 /* LICENSE
 /* .ad
 /* .fi
@@ -50,21 +54,60 @@
 
 #include "tok822.h"
 
+#define CONTAINER_TOKEN(x) \
+	((x) == TOK822_ADDR || (x) == TOK822_STARTGRP)
+
+#define STRING_TOKEN(x) \
+	((x) >= TOK822_MINTOK && !CONTAINER_TOKEN(x))
+
+ /*
+  * Pools of released tokens, with and without string memory. The string
+  * memory of a released token is kept unless it has grown large.
+  */
+static TOK822 *tok822_str_pool;
+static TOK822 *tok822_chr_pool;
+static int tok822_pool_len;
+
+#define TOK822_POOL_LIMIT	1000
+#define TOK822_POOL_STRLEN	256
+
+#define TOK822_POOL_GET(pool, tp) ((tp) = (pool), (pool) = (tp)->next, \
+	tok822_pool_len--)
+#define TOK822_POOL_PUT(pool, tp) ((tp)->next = (pool), (pool) = (tp), \
+	tok822_pool_len++)
+
 /* tok822_alloc - allocate and initialize token */
 
 TOK822 *tok822_alloc(int type, const char *strval)
 {
     TOK822 *tp;
 
-#define CONTAINER_TOKEN(x) \
-	((x) == TOK822_ADDR || (x) == TOK822_STARTGRP)
-
-    tp = (TOK822 *) mymalloc(sizeof(*tp));
+    if (STRING_TOKEN(type)) {
+	if (tok822_str_pool) {
+	    TOK822_POOL_GET(tok822_str_pool, tp);
+	    if (strval == 0) {
+		VSTRING_RESET(tp->vstr);
+		VSTRING_TERMINATE(tp->vstr);
+	    } else {
+		vstring_strcpy(tp->vstr, strval);
+	    }
+	} else {
+	    if (tok822_chr_pool)
+		TOK822_POOL_GET(tok822_chr_pool, tp);
+	    else
+		tp = (TOK822 *) mymalloc(sizeof(*tp));
+	    tp->vstr = (strval == 0 ? vstring_alloc(10) :
+		  vstring_strcpy(vstring_alloc(strlen(strval) + 1), strval));
+	}
+    } else {
+	if (tok822_chr_pool)
+	    TOK822_POOL_GET(tok822_chr_pool, tp);
+	else
+	    tp = (TOK822 *) mymalloc(sizeof(*tp));
+	tp->vstr = 0;
+    }
     tp->type = type;
     tp->next = tp->prev = tp->head = tp->tail = tp->owner = 0;
-    tp->vstr = (type < TOK822_MINTOK || CONTAINER_TOKEN(type) ? 0 :
-		strval == 0 ? vstring_alloc(10) :
-		vstring_strcpy(vstring_alloc(strlen(strval) + 1), strval));
     return (tp);
 }
 
@@ -72,8 +115,18 @@ TOK822 *tok822_alloc(int type, const char *strval)
 
 TOK822 *tok822_free(TOK822 *tp)
 {
-    if (tp->vstr)
+    if (tp->vstr && tp->vstr->vbuf.len > TOK822_POOL_STRLEN) {
 	vstring_free(tp->vstr);
-    myfree((void *) tp);
+	tp->vstr = 0;
+    }
+    if (tok822_pool_len >= TOK822_POOL_LIMIT) {
+	if (tp->vstr)
+	    vstring_free(tp->vstr);
+	myfree((void *) tp);
+    } else if (tp->vstr) {
+	TOK822_POOL_PUT(tok822_str_pool, tp);
+    } else {
+	TOK822_POOL_PUT(tok822_chr_pool, tp);
+    }
     return (0);
 }
@@ -16,6 +16,9 @@
 /*	VSTREAM	*stream;
 /*
 /*	void	event_server_drain()
+/*
+/*	void	event_server_busy(busy)
+/*	int	busy;
 /* DESCRIPTION
 /*	This module implements a skeleton for multi-threaded
 /*	mail subsystems: mail subsystem programs that service multiple
@@ -127,6 +130,14 @@
 /*	is available. A token is consumed for each connection request.
 /* .IP CA_MAIL_SERVER_SOLITARY
 /*	This service must be configured with process limit of 1.
+/* .IP "CA_MAIL_SERVER_SOLITARY_UNLESS(int *)"
+/*	This service must be configured with process limit of 1,
+/*	unless the specified configuration variable has a non-zero
+/*	value. Specify this after the configuration table that
+/*	initializes the variable. This allows an application to
+/*	opt in to running multiple processes that share one listen
+/*	socket, where each client connection stays with the process
+/*	that accepted it.
 /* .IP CA_MAIL_SERVER_UNLIMITED
 /*	This service must be configured with process limit of 0.
 /* .IP CA_MAIL_SERVER_PRIVILEGED
@@ -151,6 +162,16 @@
 /*	terminates when the last client is disconnected. A non-zero
 /*	result means this call should be tried again later.
 /*
+/*	event_server_busy() should be called with a non-zero argument
+/*	when the application temporarily does not wish to accept
+/*	new client connections, for example because it has too
+/*	much work in progress. The process stops monitoring the
+/*	listen socket, and tells the master that it is no longer
+/*	available, so that the master can start another process
+/*	for new clients (subject to the service's process limit).
+/*	Call event_server_busy() with a zero argument to accept
+/*	new clients again. Existing clients are not affected.
+/*
 /*	The var_use_limit variable limits the number of clients
 /*	that a server can service before it commits suicide.  This
 /*	value is taken from the global \fBmain.cf\fR configuration
@@ -263,6 +284,8 @@ static void (*event_server_pre_disconn) (VSTREAM *, char *, char **);
 static void (*event_server_slow_exit) (char *, char **);
 static int event_server_watchdog = 1000;
 static int event_server_saved_flags;
+static int event_server_is_busy;
+static int event_server_drained;
 
 /* event_server_exit - normal termination */
 
@@ -310,6 +333,7 @@ int     event_server_drain(void)
     case 0:
 	(void) msg_cleanup((MSG_CLEANUP_FN) 0);
 	event_fork();
+	event_server_drained = 1;
 	for (fd = MASTER_LISTEN_FD; fd < MASTER_LISTEN_FD + socket_count; fd++) {
 	    event_disable_readwrite(fd);
 	    (void) close(fd);
@@ -325,6 +349,31 @@ int     event_server_drain(void)
     }
 }
 
+/* event_server_busy - stop or resume accepting new clients */
+
+void    event_server_busy(int busy)
+{
+    int     fd;
+
+    /*
+     * After event_server_drain() the listen sockets are gone, and the master
+     * no longer knows about this process.
+     */
+    busy = (busy != 0);
+    if (busy == event_server_is_busy || event_server_drained)
+	return;
+    event_server_is_busy = busy;
+    for (fd = MASTER_LISTEN_FD; fd < MASTER_LISTEN_FD + socket_count; fd++) {
+	if (busy)
+	    event_disable_readwrite(fd);
+	else
+	    event_enable_read(fd, event_server_accept, CAST_INT_TO_VOID_PTR(fd));
+    }
+    if (master_notify(var_pid, event_server_generation, busy ?
+		      MASTER_STAT_TAKEN : MASTER_STAT_AVAIL) < 0)
+	event_server_abort(EVENT_NULL_TYPE, EVENT_NULL_CONTEXT);
+}
+
 /* event_server_disconnect - terminate client session */
 
 void    event_server_disconnect(VSTREAM *stream)
@@ -358,12 +407,13 @@ static void event_server_execute(int unused_event, void *context)
     /*
      * Do bother the application when the client disconnected. Don't drop the
      * already accepted client request after "postfix reload"; that would be
-     * rude.
+     * rude. Stay unavailable when the application says it is busy.
      */
     if (master_notify(var_pid, event_server_generation, MASTER_STAT_TAKEN) < 0)
 	 /* void */ ;
     event_server_service(stream, event_server_name, event_server_argv);
-    if (master_notify(var_pid, event_server_generation, MASTER_STAT_AVAIL) < 0)
+    if (event_server_is_busy == 0
+	&& master_notify(var_pid, event_server_generation, MASTER_STAT_AVAIL) < 0)
 	event_server_abort(EVENT_NULL_TYPE, EVENT_NULL_CONTEXT);
     if (attr)
 	htable_free(attr, myfree);
@@ -757,6 +807,11 @@ NORETURN event_server_main(int argc, char **argv, MULTI_SERVER_FN service,...)
 		msg_fatal("service %s requires a process limit of 1",
 			  service_name);
 	    break;
+	case MAIL_SERVER_SOLITARY_UNLESS:
+	    if (*va_arg(ap, int *) == 0 && stream == 0 && !alone)
+		msg_fatal("service %s requires a process limit of 1",
+			  service_name);
+	    break;
 	case MAIL_SERVER_UNLIMITED:
 	    if (stream == 0 && !zerolimit)
 		msg_fatal("service %s requires a process limit of 0",
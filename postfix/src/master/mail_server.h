@@ -44,6 +44,8 @@
 #define MAIL_SERVER_IN_FLOW_DELAY	20
 #define MAIL_SERVER_SLOW_EXIT	21
 #define MAIL_SERVER_BOUNCE_INIT	22
+#define MAIL_SERVER_SOLITARY_UNLESS	23
+#define MAIL_SERVER_CLIENT_LIMIT	24
 
 typedef void (*MAIL_SERVER_INIT_FN) (char *, char **);
 typedef int (*MAIL_SERVER_LOOP_FN) (char *, char **);
@@ -67,6 +69,8 @@ typedef void (*MAIL_SERVER_SLOW_EXIT_FN) (char *, char **);
 #define CA_MAIL_SERVER_EXIT(v)		MAIL_SERVER_EXIT, CHECK_VAL(MAIL_SERVER, MAIL_SERVER_EXIT_FN, (v))
 #define CA_MAIL_SERVER_PRE_ACCEPT(v)	MAIL_SERVER_PRE_ACCEPT, CHECK_VAL(MAIL_SERVER, MAIL_SERVER_ACCEPT_FN, (v))
 #define CA_MAIL_SERVER_SOLITARY	MAIL_SERVER_SOLITARY
+#define CA_MAIL_SERVER_SOLITARY_UNLESS(v) MAIL_SERVER_SOLITARY_UNLESS, CHECK_PTR(MAIL_SERVER, int, (v))
+#define CA_MAIL_SERVER_CLIENT_LIMIT(v) MAIL_SERVER_CLIENT_LIMIT, CHECK_PTR(MAIL_SERVER, int, (v))
 #define CA_MAIL_SERVER_UNLIMITED	MAIL_SERVER_UNLIMITED
 #define CA_MAIL_SERVER_PRE_DISCONN(v)	MAIL_SERVER_PRE_DISCONN, CHECK_VAL(MAIL_SERVER, MAIL_SERVER_DISCONN_FN, (v))
 #define CA_MAIL_SERVER_PRIVILEGED	MAIL_SERVER_PRIVILEGED
@@ -114,6 +118,7 @@ typedef void (*EVENT_SERVER_FN) (VSTREAM *, char *, char **);
 extern NORETURN event_server_main(int, char **, EVENT_SERVER_FN,...);
 extern void event_server_disconnect(VSTREAM *);
 extern int event_server_drain(void);
+extern void event_server_busy(int);
 
  /*
   * trigger_server.c
@@ -124,6 +124,22 @@
 /*	is available. A token is consumed for each connection request.
 /* .IP CA_MAIL_SERVER_SOLITARY
 /*	This service must be configured with process limit of 1.
+/* .IP "CA_MAIL_SERVER_SOLITARY_UNLESS(int *)"
+/*	This service must be configured with process limit of 1,
+/*	unless the specified configuration variable has a non-zero
+/*	value. Specify this after the configuration table that
+/*	initializes the variable. This allows an application to
+/*	opt in to running multiple processes that share one listen
+/*	socket, where each client connection stays with the process
+/*	that accepted it.
+/* .IP "CA_MAIL_SERVER_CLIENT_LIMIT(int *)"
+/*	Stop accepting new clients while the number of connected
+/*	clients is at or above the value of the specified configuration
+/*	variable, so that the master can start another process for
+/*	new clients (subject to the service's process limit). This
+/*	limits the number of clients that must wait while the
+/*	process handles one slow request. A zero value disables
+/*	the limit.
 /* .IP CA_MAIL_SERVER_UNLIMITED
 /*	This service must be configured with process limit of 0.
 /* .IP CA_MAIL_SERVER_PRIVILEGED
@@ -249,6 +265,10 @@ static int multi_server_in_flow_delay;
 static unsigned multi_server_generation;
 static void (*multi_server_pre_disconn) (VSTREAM *, char *, char **);
 static int multi_server_saved_flags;
+static int *multi_server_client_limit;
+static int multi_server_is_busy;
+static int multi_server_in_service;
+static int multi_server_drained;
 
 /* multi_server_exit - normal termination */
 
@@ -292,6 +312,7 @@ int     multi_server_drain(void)
     case 0:
 	(void) msg_cleanup((MSG_CLEANUP_FN) 0);
 	event_fork();
+	multi_server_drained = 1;
 	for (fd = MASTER_LISTEN_FD; fd < MASTER_LISTEN_FD + socket_count; fd++) {
 	    event_disable_readwrite(fd);
 	    (void) close(fd);
@@ -307,6 +328,35 @@ int     multi_server_drain(void)
     }
 }
 
+/* multi_server_busy - stop or resume accepting new clients */
+
+static void multi_server_busy(int busy)
+{
+    int     fd;
+
+    /*
+     * After multi_server_drain() the listen sockets are gone, and the master
+     * no longer knows about this process. While a request is being handled,
+     * multi_server_execute() tells the master about the new state.
+     */
+    if (busy == multi_server_is_busy || multi_server_drained)
+	return;
+    if (msg_verbose)
+	msg_info("%s new clients: %d connected",
+		 busy ? "stop accepting" : "resume accepting", client_count);
+    multi_server_is_busy = busy;
+    for (fd = MASTER_LISTEN_FD; fd < MASTER_LISTEN_FD + socket_count; fd++) {
+	if (busy)
+	    event_disable_readwrite(fd);
+	else
+	    event_enable_read(fd, multi_server_accept, CAST_INT_TO_VOID_PTR(fd));
+    }
+    if (multi_server_in_service == 0
+	&& master_notify(var_pid, multi_server_generation, busy ?
+			 MASTER_STAT_TAKEN : MASTER_STAT_AVAIL) < 0)
+	multi_server_abort(EVENT_NULL_TYPE, EVENT_NULL_CONTEXT);
+}
+
 /* multi_server_disconnect - terminate client session */
 
 void    multi_server_disconnect(VSTREAM *stream)
@@ -323,6 +373,8 @@ void    multi_server_disconnect(VSTREAM *stream)
 	use_count++;
     if (client_count == 0 && var_idle_limit > 0)
 	event_request_timer(multi_server_timeout, (void *) 0, var_idle_limit);
+    if (multi_server_is_busy && client_count < *multi_server_client_limit)
+	multi_server_busy(0);
 }
 
 /* multi_server_execute - in case (char *) != (struct *) */
@@ -341,13 +393,18 @@ static void multi_server_execute(int unused_event, void *context)
     /*
      * Do not bother the application when the client disconnected. Don't drop
      * the already accepted client request after "postfix reload"; that would
-     * be rude.
+     * be rude. A busy process has already told the master that it is not
+     * available.
      */
     if (peekfd(vstream_fileno(stream)) > 0) {
-	if (master_notify(var_pid, multi_server_generation, MASTER_STAT_TAKEN) < 0)
+	if (multi_server_is_busy == 0
+	    && master_notify(var_pid, multi_server_generation, MASTER_STAT_TAKEN) < 0)
 	     /* void */ ;
+	multi_server_in_service = 1;
 	multi_server_service(stream, multi_server_name, multi_server_argv);
-	if (master_notify(var_pid, multi_server_generation, MASTER_STAT_AVAIL) < 0)
+	multi_server_in_service = 0;
+	if (multi_server_is_busy == 0
+	    && master_notify(var_pid, multi_server_generation, MASTER_STAT_AVAIL) < 0)
 	    multi_server_abort(EVENT_NULL_TYPE, EVENT_NULL_CONTEXT);
     } else {
 	multi_server_disconnect(stream);
@@ -394,6 +451,9 @@ static void multi_server_wakeup(int fd, HTABLE *attr)
     non_blocking(fd, BLOCKING);
     close_on_exec(fd, CLOSE_ON_EXEC);
     client_count++;
+    if (multi_server_client_limit && *multi_server_client_limit > 0
+	&& client_count >= *multi_server_client_limit)
+	multi_server_busy(1);
     stream = vstream_fdopen(fd, O_RDWR);
     tmp = concatenate(multi_server_name, " socket", (char *) 0);
     vstream_control(stream,
@@ -753,6 +813,14 @@ NORETURN multi_server_main(int argc, char **argv, MULTI_SERVER_FN service,...)
 		msg_fatal("service %s requires a process limit of 1",
 			  service_name);
 	    break;
+	case MAIL_SERVER_SOLITARY_UNLESS:
+	    if (*va_arg(ap, int *) == 0 && stream == 0 && !alone)
+		msg_fatal("service %s requires a process limit of 1",
+			  service_name);
+	    break;
+	case MAIL_SERVER_CLIENT_LIMIT:
+	    multi_server_client_limit = va_arg(ap, int *);
+	    break;
 	case MAIL_SERVER_UNLIMITED:
 	    if (stream == 0 && !zerolimit)
 		msg_fatal("service %s requires a process limit of 0",
@@ -7,7 +7,8 @@
 /*	#include <milter.h>
 /*
 /*	MILTERS	*milter_create(milter_names, conn_timeout, cmd_timeout,
-/*					msg_timeout, protocol, def_action,
+/*					msg_timeout, body_limit, parallel,
+/*					protocol, def_action,
 /*					conn_macros, helo_macros,
 /*					mail_macros, rcpt_macros,
 /*					data_macros, eoh_macros,
@@ -17,6 +18,8 @@
 /*	int	conn_timeout;
 /*	int	cmd_timeout;
 /*	int	msg_timeout;
+/*	int	body_limit;
+/*	int	parallel;
 /*	const char *protocol;
 /*	const char *def_action;
 /*	const char *conn_macros;
@@ -127,7 +130,13 @@
 /*	function should be called during process initialization,
 /*	before entering a chroot jail. The timeout parameters specify
 /*	time limits for the completion of the specified request
-/*	classes. The protocol parameter specifies a protocol version
+/*	classes. The body_limit parameter specifies how many message
+/*	body chunks may be sent before the client waits for a reply.
+/*	With a non-zero parallel parameter, SMTP command events are
+/*	sent to all filters that do not modify messages before the
+/*	client waits for their replies; the replies are evaluated
+/*	in the order of the milter_names argument. The protocol
+/*	parameter specifies a protocol version
 /*	and optional extensions.  When the milter application is
 /*	unavailable, the milter client will go into a suitable error
 /*	state as specified with the def_action parameter (i.e.
@@ -391,6 +400,39 @@ void    milter_edit_callback(MILTERS *milters,
     milters->chg_context = chg_context;
 }
 
+/* milter_defer - start parallel event delivery */
+
+static void milter_defer(MILTERS *milters)
+{
+    MILTER *m;
+
+    if (milters->parallel)
+	for (m = milters->milter_list; m != 0; m = m->next)
+	    m->flags |= MILTER_FLAG_DEFER_REPLY;
+}
+
+/* milter_collect - receive deferred replies in configured order */
+
+static const char *milter_collect(MILTERS *milters, const char *resp)
+{
+    const char *first = 0;
+    const char *next;
+    MILTER *m;
+
+    /*
+     * A filter that received the event without waiting precedes the filter
+     * that produced the caller's response, if any.
+     */
+    if (milters->parallel == 0)
+	return (resp);
+    for (m = milters->milter_list; m != 0; m = m->next) {
+	m->flags &= ~MILTER_FLAG_DEFER_REPLY;
+	if ((next = m->collect(m)) != 0 && first == 0)
+	    first = next;
+    }
+    return (first ? first : resp);
+}
+
 /* milter_conn_event - report connect event */
 
 const char *milter_conn_event(MILTERS *milters,
@@ -413,6 +455,7 @@ const char *milter_conn_event(MILTERS *milters,
 
     if (msg_verbose)
 	msg_info("report connect to all milters");
+    milter_defer(milters);
     for (resp = 0, m = milters->milter_list; resp == 0 && m != 0; m = m->next) {
 	any_macros = MILTER_MACRO_EVAL(global_macros, m, milters, conn_macros);
 	resp = m->conn_event(m, client_name, client_addr, client_port,
@@ -422,7 +465,7 @@ const char *milter_conn_event(MILTERS *milters,
     }
     if (global_macros)
 	argv_free(global_macros);
-    return (resp);
+    return (milter_collect(milters, resp));
 }
 
 /* milter_helo_event - report helo event */
@@ -437,6 +480,7 @@ const char *milter_helo_event(MILTERS *milters, const char *helo_name,
 
     if (msg_verbose)
 	msg_info("report helo to all milters");
+    milter_defer(milters);
     for (resp = 0, m = milters->milter_list; resp == 0 && m != 0; m = m->next) {
 	any_macros = MILTER_MACRO_EVAL(global_macros, m, milters, helo_macros);
 	resp = m->helo_event(m, helo_name, esmtp_flag, any_macros);
@@ -445,7 +489,7 @@ const char *milter_helo_event(MILTERS *milters, const char *helo_name,
     }
     if (global_macros)
 	argv_free(global_macros);
-    return (resp);
+    return (milter_collect(milters, resp));
 }
 
 /* milter_mail_event - report mail from event */
@@ -459,6 +503,7 @@ const char *milter_mail_event(MILTERS *milters, const char **argv)
 
     if (msg_verbose)
 	msg_info("report sender to all milters");
+    milter_defer(milters);
     for (resp = 0, m = milters->milter_list; resp == 0 && m != 0; m = m->next) {
 	any_macros = MILTER_MACRO_EVAL(global_macros, m, milters, mail_macros);
 	resp = m->mail_event(m, argv, any_macros);
@@ -467,7 +512,7 @@ const char *milter_mail_event(MILTERS *milters, const char **argv)
     }
     if (global_macros)
 	argv_free(global_macros);
-    return (resp);
+    return (milter_collect(milters, resp));
 }
 
 /* milter_rcpt_event - report rcpt to event */
@@ -481,6 +526,7 @@ const char *milter_rcpt_event(MILTERS *milters, int flags, const char **argv)
 
     if (msg_verbose)
 	msg_info("report recipient to all milters (flags=0x%x)", flags);
+    milter_defer(milters);
     for (resp = 0, m = milters->milter_list; resp == 0 && m != 0; m = m->next) {
 	if ((flags & MILTER_FLAG_WANT_RCPT_REJ) == 0
 	    || (m->flags & MILTER_FLAG_WANT_RCPT_REJ) != 0) {
@@ -493,7 +539,7 @@ const char *milter_rcpt_event(MILTERS *milters, int flags, const char **argv)
     }
     if (global_macros)
 	argv_free(global_macros);
-    return (resp);
+    return (milter_collect(milters, resp));
 }
 
 /* milter_data_event - report data event */
@@ -507,6 +553,7 @@ const char *milter_data_event(MILTERS *milters)
 
     if (msg_verbose)
 	msg_info("report data to all milters");
+    milter_defer(milters);
     for (resp = 0, m = milters->milter_list; resp == 0 && m != 0; m = m->next) {
 	any_macros = MILTER_MACRO_EVAL(global_macros, m, milters, data_macros);
 	resp = m->data_event(m, any_macros);
@@ -515,7 +562,7 @@ const char *milter_data_event(MILTERS *milters)
     }
     if (global_macros)
 	argv_free(global_macros);
-    return (resp);
+    return (milter_collect(milters, resp));
 }
 
 /* milter_unknown_event - report unknown command */
@@ -529,6 +576,7 @@ const char *milter_unknown_event(MILTERS *milters, const char *command)
 
     if (msg_verbose)
 	msg_info("report unknown command to all milters");
+    milter_defer(milters);
     for (resp = 0, m = milters->milter_list; resp == 0 && m != 0; m = m->next) {
 	any_macros = MILTER_MACRO_EVAL(global_macros, m, milters, unk_macros);
 	resp = m->unknown_event(m, command, any_macros);
@@ -537,7 +585,7 @@ const char *milter_unknown_event(MILTERS *milters, const char *command)
     }
     if (global_macros)
 	argv_free(global_macros);
-    return (resp);
+    return (milter_collect(milters, resp));
 }
 
 /* milter_other_event - other SMTP event */
@@ -620,6 +668,10 @@ static ATTR_OVER_TIME time_table[] = {
     7 + VAR_MILT_MSG_TIME, DEF_MILT_MSG_TIME, 0, 1, 0,
     0,
 };
+static ATTR_OVER_INT int_table[] = {
+    7 + VAR_MILT_BODY_LIMIT, 0, 1, 0,
+    0,
+};
 static ATTR_OVER_STR str_table[] = {
     7 + VAR_MILT_PROTOCOL, 0, 1, 0,
     7 + VAR_MILT_DEF_ACTION, 0, 1, 0,
@@ -633,6 +685,8 @@ static ATTR_OVER_STR str_table[] = {
 #define my_cmd_timeout_offset	1
 #define my_msg_timeout_offset	2
 
+#define my_body_limit_offset	0
+
 #define	my_protocol_offset	0
 #define	my_def_action_offset	1
 
@@ -642,6 +696,8 @@ MILTERS *milter_new(const char *names,
 		            int conn_timeout,
 		            int cmd_timeout,
 		            int msg_timeout,
+		            int body_limit,
+		            int parallel,
 		            const char *protocol,
 		            const char *def_action,
 		            MILTER_MACROS *macros,
@@ -657,6 +713,7 @@ MILTERS *milter_new(const char *names,
     int     my_conn_timeout;
     int     my_cmd_timeout;
     int     my_msg_timeout;
+    int     my_body_limit;
     const char *my_protocol;
     const char *my_def_action;
 
@@ -666,6 +723,7 @@ MILTERS *milter_new(const char *names,
     link_override_table_to_variable(time_table, my_conn_timeout);
     link_override_table_to_variable(time_table, my_cmd_timeout);
     link_override_table_to_variable(time_table, my_msg_timeout);
+    link_override_table_to_variable(int_table, my_body_limit);
     link_override_table_to_variable(str_table, my_protocol);
     link_override_table_to_variable(str_table, my_def_action);
 
@@ -686,6 +744,7 @@ MILTERS *milter_new(const char *names,
 	    my_conn_timeout = conn_timeout;
 	    my_cmd_timeout = cmd_timeout;
 	    my_msg_timeout = msg_timeout;
+	    my_body_limit = body_limit;
 	    my_protocol = protocol;
 	    my_def_action = def_action;
 	    if (name[0] == parens[0]) {
@@ -697,11 +756,12 @@ MILTERS *milter_new(const char *names,
 		attr_override(op, sep, parens,
 			      CA_ATTR_OVER_STR_TABLE(str_table),
 			      CA_ATTR_OVER_TIME_TABLE(time_table),
+			      CA_ATTR_OVER_INT_TABLE(int_table),
 			      CA_ATTR_OVER_END);
 	    }
 	    milter = milter8_create(name, my_conn_timeout, my_cmd_timeout,
-				    my_msg_timeout, my_protocol,
-				    my_def_action, milters);
+				    my_msg_timeout, my_body_limit,
+				    my_protocol, my_def_action, milters);
 	    if (head == 0) {
 		head = milter;
 	    } else {
@@ -712,6 +772,7 @@ MILTERS *milter_new(const char *names,
 	myfree(saved_names);
     }
     milters->milter_list = head;
+    milters->parallel = parallel;
     milters->mac_lookup = 0;
     milters->mac_context = 0;
     milters->macros = macros;
@@ -849,13 +910,15 @@ MILTERS *milter_receive(VSTREAM *stream, int count)
      */
 #define NO_MILTERS	((char *) 0)
 #define NO_TIMEOUTS	0, 0, 0
+#define NO_BODY_LIMIT	0
+#define NO_PARALLEL	0
 #define NO_PROTOCOL	((char *) 0)
 #define NO_ACTION	((char *) 0)
 #define NO_MACROS	((MILTER_MACROS *) 0)
 #define NO_MACRO_DEFLTS	((HTABLE *) 0)
 
-    milters = milter_new(NO_MILTERS, NO_TIMEOUTS, NO_PROTOCOL, NO_ACTION,
-			 NO_MACROS, NO_MACRO_DEFLTS);
+    milters = milter_new(NO_MILTERS, NO_TIMEOUTS, NO_BODY_LIMIT, NO_PARALLEL,
+			 NO_PROTOCOL, NO_ACTION, NO_MACROS, NO_MACRO_DEFLTS);
 
     /*
      * XXX Optimization: don't send or receive further information when there
@@ -944,6 +1007,8 @@ MILTERS *milter_receive(VSTREAM *stream, int count)
 int     var_milt_conn_time = 10;
 int     var_milt_cmd_time = 10;
 int     var_milt_msg_time = 100;
+int     var_milt_body_limit = 1;
+bool    var_milt_parallel = 0;
 char   *var_milt_protocol = DEF_MILT_PROTOCOL;
 char   *var_milt_def_action = DEF_MILT_DEF_ACTION;
 
@@ -988,13 +1053,16 @@ int     main(int argc, char **argv)
 	= eoh_macros = eod_macros = unk_macros = macro_deflts = "";
 
     msg_vstream_init(argv[0], VSTREAM_ERR);
-    while ((ch = GETOPT(argc, argv, "V:v")) > 0) {
+    while ((ch = GETOPT(argc, argv, "a:Pp:v")) > 0) {
 	switch (ch) {
 	default:
-	    msg_fatal("usage: %s [-a action] [-p protocol] [-v]", argv[0]);
+	    msg_fatal("usage: %s [-a action] [-P] [-p protocol] [-v]", argv[0]);
 	case 'a':
 	    var_milt_def_action = optarg;
 	    break;
+	case 'P':
+	    var_milt_parallel = 1;
+	    break;
 	case 'p':
 	    var_milt_protocol = optarg;
 	    break;
@@ -1037,6 +1105,7 @@ int     main(int argc, char **argv)
 	    }
 	    milters = milter_create(args[0], var_milt_conn_time,
 				    var_milt_cmd_time, var_milt_msg_time,
+				    var_milt_body_limit, var_milt_parallel,
 				    var_milt_protocol, var_milt_def_action,
 				    conn_macros, helo_macros, mail_macros,
 				    rcpt_macros, data_macros, eoh_macros,
@@ -45,6 +45,7 @@ typedef struct MILTER {
     const char *(*other_event) (struct MILTER *);
     void    (*abort) (struct MILTER *);
     void    (*disc_event) (struct MILTER *);
+    const char *(*collect) (struct MILTER *);
     int     (*active) (struct MILTER *);
     int     (*send) (struct MILTER *, VSTREAM *);
     void    (*free) (struct MILTER *);
@@ -52,8 +53,9 @@ typedef struct MILTER {
 
 #define MILTER_FLAG_NONE		(0)
 #define MILTER_FLAG_WANT_RCPT_REJ	(1<<0)	/* see S8_RCPT_MAILER_ERROR */
+#define MILTER_FLAG_DEFER_REPLY		(1<<1)	/* see milter_parallel_events */
 
-extern MILTER *milter8_create(const char *, int, int, int, const char *, const char *, struct MILTERS *);
+extern MILTER *milter8_create(const char *, int, int, int, int, const char *, const char *, struct MILTERS *);
 extern MILTER *milter8_receive(VSTREAM *, struct MILTERS *);
 
  /*
@@ -103,6 +105,7 @@ typedef const char *(*MILTER_EDIT_BODY_FN) (void *, int, VSTRING *);
 
 typedef struct MILTERS {
     MILTER *milter_list;		/* linked list of Milters */
+    int     parallel;			/* parallel event delivery */
     MILTER_MAC_LOOKUP_FN mac_lookup;
     void   *mac_context;		/* macro lookup context */
     struct MILTER_MACROS *macros;
@@ -120,17 +123,19 @@ typedef struct MILTERS {
 } MILTERS;
 
 #define milter_create(milter_names, conn_timeout, cmd_timeout, msg_timeout, \
-			protocol, def_action, conn_macros, helo_macros, \
+			body_limit, parallel, protocol, def_action, \
+			conn_macros, helo_macros, \
 			mail_macros, rcpt_macros, data_macros, eoh_macros, \
 			eod_macros, unk_macros, macro_deflts) \
 	milter_new(milter_names, conn_timeout, cmd_timeout, msg_timeout, \
+		    body_limit, parallel, \
 		    protocol, def_action, milter_macros_create(conn_macros, \
 		    helo_macros, mail_macros, rcpt_macros, data_macros, \
 		    eoh_macros, eod_macros, unk_macros), \
 		    milter_macro_defaults_create(macro_deflts))
 
-extern MILTERS *milter_new(const char *, int, int, int, const char *,
-			           const char *, MILTER_MACROS *,
+extern MILTERS *milter_new(const char *, int, int, int, int, int,
+			           const char *, const char *, MILTER_MACROS *,
 			           struct HTABLE *);
 extern void milter_macro_callback(MILTERS *, MILTER_MAC_LOOKUP_FN, void *);
 extern void milter_edit_callback(MILTERS *milters, MILTER_ADD_HEADER_FN,
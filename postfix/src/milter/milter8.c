@@ -356,6 +356,7 @@ typedef struct {
     int     msg_timeout;		/* content inspection timeout */
     char   *protocol;			/* protocol version/extension */
     char   *def_action;			/* action if unavailable */
+    int     body_limit;			/* body chunks without reply */
     int     version;			/* application protocol version */
     int     rq_mask;			/* application requests (SMFIF_*) */
     int     ev_mask;			/* application events (SMFIP_*) */
@@ -371,8 +372,24 @@ typedef struct {
     int     state;			/* MILTER8_STAT_mumble */
     char   *def_reply;			/* error response or null */
     int     skip_event_type;		/* skip operations of this type */
+    int     pend_event;			/* event with deferred reply */
+    int     pend_count;			/* number of deferred replies */
 } MILTER8;
 
+ /*
+  * How to handle the reply to an event.
+  */
+#define DONT_SKIP_REPLY		0	/* wait for reply */
+#define MILTER8_SKIP_REPLY	1	/* no reply (SMFIP_NR_*) */
+#define MILTER8_DEFER_REPLY	2	/* receive reply later */
+
+ /*
+  * Requests that make a mail filter application more than a judge.
+  */
+#define MILTER8_EDIT_MASK \
+	(SMFIF_ADDHDRS | SMFIF_CHGBODY | SMFIF_ADDRCPT | SMFIF_DELRCPT \
+	| SMFIF_CHGHDRS | SMFIF_CHGFROM | SMFIF_ADDRCPT_PAR)
+
  /*
   * XXX Sendmail 8 libmilter automatically closes the MTA-to-filter socket
   * when it finds out that the SMTP client has disconnected. Because of this
@@ -941,6 +958,28 @@ static int milter8_write_cmd(MILTER8 *milter, int command,...)
     return (err);
 }
 
+static const char *milter8_event_reply(MILTER8 *, int);
+
+/* milter8_pend_reply - receive oldest deferred reply */
+
+static const char *milter8_pend_reply(MILTER8 *milter)
+{
+    int     state = milter->state;
+    const char *resp;
+
+    milter->pend_count -= 1;
+    resp = milter8_event_reply(milter, milter->pend_event);
+
+    /*
+     * After a final decision, libmilter silently ignores the remaining
+     * events of this type. SMFIR_SKIP is not final; the application still
+     * replies to the events that it receives.
+     */
+    if (resp != 0 || milter->state != state)
+	milter->pend_count = 0;
+    return (resp);
+}
+
 /* milter8_event - report event and receive reply */
 
 static const char *milter8_event(MILTER8 *milter, int event,
@@ -953,19 +992,9 @@ static const char *milter8_event(MILTER8 *milter, int event,
     va_list ap2;
     ssize_t data_len;
     int     err;
-    unsigned char cmd;
-    ssize_t data_size;
     const char *smfic_name;
-    const char *smfir_name;
-    MILTERS *parent = milter->m.parent;
-    UINT32_TYPE index;
-    const char *edit_resp = 0;
-    const char *retval = 0;
-    VSTRING *body_line_buf = 0;
-    int     done = 0;
-    int     body_edit_lockout = 0;
-
-#define DONT_SKIP_REPLY	0
+    const char *retval;
+    int     state;
 
     /*
      * Sanity check.
@@ -978,6 +1007,30 @@ static const char *milter8_event(MILTER8 *milter, int event,
 	return (milter->def_reply);
     }
 
+    /*
+     * Receive the replies for events that were sent without waiting: all of
+     * them before a different event, or the oldest one when the body chunk
+     * window is full. Don't send this event after a final decision.
+     */
+    while (milter->pend_count > 0
+	   && (event != milter->pend_event
+	       || skip_reply != MILTER8_DEFER_REPLY
+	       || milter->pend_count >= milter->body_limit)) {
+	state = milter->state;
+	if ((retval = milter8_pend_reply(milter)) != 0
+	    || milter->state != state)
+	    return (retval);
+    }
+
+    /*
+     * Parallel event delivery: see milter_parallel_events. A mail filter
+     * application that may edit the message gets events one at a time.
+     */
+    if (skip_reply == DONT_SKIP_REPLY
+	&& (milter->m.flags & MILTER_FLAG_DEFER_REPLY) != 0
+	&& (milter->rq_mask & MILTER8_EDIT_MASK) == 0)
+	skip_reply = MILTER8_DEFER_REPLY;
+
     /*
      * Skip this event if it doesn't exist in the protocol that I announced.
      */
@@ -1077,7 +1130,7 @@ static const char *milter8_event(MILTER8 *milter, int event,
      * to send multiple headers in one VSTREAM transaction, and improves
      * over-all performance.
      */
-    if (skip_reply) {
+    if (skip_reply == MILTER8_SKIP_REPLY) {
 	if (msg_verbose)
 	    msg_info("skipping reply for event %s from milter %s",
 		     (smfic_name = str_name_code(smfic_table, event)) != 0 ?
@@ -1085,6 +1138,44 @@ static const char *milter8_event(MILTER8 *milter, int event,
 	return (milter->def_reply);
     }
 
+    /*
+     * Pipelining: don't wait for the reply now, but receive it before the
+     * next event or in milter8_collect(). The stream is double-buffered, so
+     * we must flush it ourselves.
+     */
+    if (skip_reply == MILTER8_DEFER_REPLY) {
+	if (vstream_fflush(milter->fp) != 0) {
+	    msg_warn("milter %s: error writing command: %m", milter->m.name);
+	    milter8_comm_error(milter);
+	    return (milter->def_reply);
+	}
+	if (msg_verbose)
+	    msg_info("deferring reply for event %s from milter %s",
+		     (smfic_name = str_name_code(smfic_table, event)) != 0 ?
+		     smfic_name : "(unknown MTA event)", milter->m.name);
+	milter->pend_event = event;
+	milter->pend_count += 1;
+	return (milter->def_reply);
+    }
+    return (milter8_event_reply(milter, event));
+}
+
+/* milter8_event_reply - receive event reply */
+
+static const char *milter8_event_reply(MILTER8 *milter, int event)
+{
+    unsigned char cmd;
+    ssize_t data_size;
+    const char *smfic_name;
+    const char *smfir_name;
+    MILTERS *parent = milter->m.parent;
+    UINT32_TYPE index;
+    const char *edit_resp = 0;
+    const char *retval = 0;
+    VSTRING *body_line_buf = 0;
+    int     done = 0;
+    int     body_edit_lockout = 0;
+
     /*
      * Receive the reply or replies.
      * 
@@ -1582,7 +1673,7 @@ static const char *milter8_event(MILTER8 *milter, int event,
 	 */
 	msg_warn("milter %s: reply %s was followed by %ld data bytes",
 	milter->m.name, (smfir_name = str_name_code(smfir_table, cmd)) != 0 ?
-		 smfir_name : "unknown", (long) data_len);
+		 smfir_name : "unknown", (long) data_size);
 	milter8_comm_error(milter);
 	MILTER8_EVENT_BREAK(milter->def_reply);
     }
@@ -1854,6 +1945,7 @@ static void milter8_connect(MILTER8 *milter)
     milter->state = MILTER8_STAT_READY;
     milter8_def_reply(milter, 0);
     milter->skip_event_type = 0;
+    milter->pend_count = 0;
 
     /*
      * Secondary negotiations: override lists of macro names.
@@ -2200,6 +2292,23 @@ static const char *milter8_other_event(MILTER *m)
     return (milter->def_reply);
 }
 
+/* milter8_collect - receive deferred reply */
+
+static const char *milter8_collect(MILTER *m)
+{
+    MILTER8 *milter = (MILTER8 *) m;
+    const char *resp = 0;
+    const char *next;
+
+    /*
+     * Return the first decision; receive and discard the rest.
+     */
+    while (milter->pend_count > 0)
+	if ((next = milter8_pend_reply(milter)) != 0 && resp == 0)
+	    resp = next;
+    return (resp);
+}
+
 /* milter8_abort - cancel one milter's message receiving state */
 
 static void milter8_abort(MILTER *m)
@@ -2296,6 +2405,16 @@ typedef struct {
     const char *resp;			/* milter application response */
 } MILTER_MSG_CONTEXT;
 
+ /*
+  * Body chunks are sent without reply (SMFIP_NR_BODY), or pipelined with up
+  * to body_limit replies outstanding. Pipelining is safe with libmilter: it
+  * replies to each chunk, and ignores the chunks that arrive after a final
+  * decision.
+  */
+#define MILTER8_BODY_REPLY(m) \
+	(((m)->ev_mask & SMFIP_NR_BODY) ? MILTER8_SKIP_REPLY : \
+	 ((m)->body_limit > 1) ? MILTER8_DEFER_REPLY : DONT_SKIP_REPLY)
+
 /* milter8_header - milter8_message call-back for message header */
 
 static void milter8_header(void *ptr, int unused_header_class,
@@ -2433,7 +2552,7 @@ static void milter8_body(void *ptr, int rec_type,
      */
     if (msg_verbose > 1)
 	msg_info("%s: body milter %s: %.100s", myname, milter->m.name, buf);
-    skip_reply = ((milter->ev_mask & SMFIP_NR_BODY) != 0);
+    skip_reply = MILTER8_BODY_REPLY(milter);
     /* To append \r\n, simply redirect input to another buffer. */
     if (rec_type == REC_TYPE_NORM && todo == 0) {
 	bp = "\r\n";
@@ -2496,7 +2615,7 @@ static void milter8_eob(void *ptr)
      * have different macro lists.
      */
     if (LEN(milter->body) > 0) {
-	skip_reply = ((milter->ev_mask & SMFIP_NR_BODY) != 0);
+	skip_reply = MILTER8_BODY_REPLY(milter);
 	msg_ctx->resp =
 	    milter8_event(milter, SMFIC_BODY, SMFIP_NOBODY,
 			  skip_reply, msg_ctx->eod_macros,
@@ -2602,6 +2721,12 @@ static const char *milter8_message(MILTER *m, VSTREAM *qfile,
 	    if (rec_type != REC_TYPE_NORM && rec_type != REC_TYPE_CONT)
 		break;
 	}
+	if (milter->pend_count > 0) {
+	    const char *resp = milter8_collect(&milter->m);
+
+	    if (msg_ctx.resp == 0)
+		msg_ctx.resp = resp;
+	}
 	mime_state_free(mime_state);
 	vstring_free(buf);
 	if (milter->fp)
@@ -2632,6 +2757,7 @@ static const char *milter8_message(MILTER *m, VSTREAM *qfile,
 #define MAIL_ATTR_MILT_CONN	"milter_conn_timeout"
 #define MAIL_ATTR_MILT_CMD	"milter_cmd_timeout"
 #define MAIL_ATTR_MILT_MSG	"milter_msg_timeout"
+#define MAIL_ATTR_MILT_BODY	"milter_body_limit"
 #define MAIL_ATTR_MILT_ACT	"milter_action"
 #define MAIL_ATTR_MILT_MAC	"milter_macro_list"
 
@@ -2673,6 +2799,7 @@ static int milter8_send(MILTER *m, VSTREAM *stream)
 		   SEND_ATTR_INT(MAIL_ATTR_MILT_CONN, milter->conn_timeout),
 		   SEND_ATTR_INT(MAIL_ATTR_MILT_CMD, milter->cmd_timeout),
 		   SEND_ATTR_INT(MAIL_ATTR_MILT_MSG, milter->msg_timeout),
+		   SEND_ATTR_INT(MAIL_ATTR_MILT_BODY, milter->body_limit),
 		   SEND_ATTR_STR(MAIL_ATTR_MILT_ACT, milter->def_action),
 		   SEND_ATTR_INT(MAIL_ATTR_MILT_MAC, milter->m.macros != 0),
 		   ATTR_TYPE_END) != 0
@@ -2706,8 +2833,8 @@ static int milter8_send(MILTER *m, VSTREAM *stream)
     }
 }
 
-static MILTER8 *milter8_alloc(const char *, int, int, int, const char *,
-			              const char *, MILTERS *);
+static MILTER8 *milter8_alloc(const char *, int, int, int, int,
+			              const char *, const char *, MILTERS *);
 
 /* milter8_receive - receive milter instance */
 
@@ -2725,6 +2852,7 @@ MILTER *milter8_receive(VSTREAM *stream, MILTERS *parent)
     int     conn_timeout;
     int     cmd_timeout;
     int     msg_timeout;
+    int     body_limit;
     int     fd;
     int     has_macros;
     MILTER_MACROS *macros = 0;
@@ -2749,9 +2877,10 @@ MILTER *milter8_receive(VSTREAM *stream, MILTERS *parent)
 		  RECV_ATTR_INT(MAIL_ATTR_MILT_CONN, &conn_timeout),
 		  RECV_ATTR_INT(MAIL_ATTR_MILT_CMD, &cmd_timeout),
 		  RECV_ATTR_INT(MAIL_ATTR_MILT_MSG, &msg_timeout),
+		  RECV_ATTR_INT(MAIL_ATTR_MILT_BODY, &body_limit),
 		  RECV_ATTR_STR(MAIL_ATTR_MILT_ACT, act_buf),
 		  RECV_ATTR_INT(MAIL_ATTR_MILT_MAC, &has_macros),
-		  ATTR_TYPE_END) < 10
+		  ATTR_TYPE_END) < 11
 	|| (has_macros != 0
 	    && attr_scan(stream, ATTR_FLAG_STRICT,
 			 RECV_ATTR_FUNC(milter_macros_scan,
@@ -2783,7 +2912,8 @@ MILTER *milter8_receive(VSTREAM *stream, MILTERS *parent)
 	    msg_info("%s: milter %s", myname, STR(name_buf));
 
 	milter = milter8_alloc(STR(name_buf), conn_timeout, cmd_timeout,
-			    msg_timeout, NO_PROTOCOL, STR(act_buf), parent);
+			       msg_timeout, body_limit, NO_PROTOCOL,
+			       STR(act_buf), parent);
 	milter->fp = vstream_fdopen(fd, O_RDWR);
 	milter->m.macros = macros;
 	vstream_control(milter->fp, CA_VSTREAM_CTL_DOUBLE, CA_VSTREAM_CTL_END);
@@ -2825,7 +2955,7 @@ static void milter8_free(MILTER *m)
 
 static MILTER8 *milter8_alloc(const char *name, int conn_timeout,
 			              int cmd_timeout, int msg_timeout,
-			              const char *protocol,
+			              int body_limit, const char *protocol,
 			              const char *def_action,
 			              MILTERS *parent)
 {
@@ -2850,6 +2980,7 @@ static MILTER8 *milter8_alloc(const char *name, int conn_timeout,
     milter->m.other_event = milter8_other_event;
     milter->m.abort = milter8_abort;
     milter->m.disc_event = milter8_disc_event;
+    milter->m.collect = milter8_collect;
     milter->m.active = milter8_active;
     milter->m.send = milter8_send;
     milter->m.free = milter8_free;
@@ -2863,10 +2994,13 @@ static MILTER8 *milter8_alloc(const char *name, int conn_timeout,
     milter->conn_timeout = conn_timeout;
     milter->cmd_timeout = cmd_timeout;
     milter->msg_timeout = msg_timeout;
+    milter->body_limit = body_limit;
     milter->protocol = (protocol ? mystrdup(protocol) : 0);
     milter->def_action = mystrdup(def_action);
     milter->def_reply = 0;
     milter->skip_event_type = 0;
+    milter->pend_event = 0;
+    milter->pend_count = 0;
 
     return (milter);
 }
@@ -2874,8 +3008,9 @@ static MILTER8 *milter8_alloc(const char *name, int conn_timeout,
 /* milter8_create - create MTA-side Sendmail 8 Milter instance */
 
 MILTER *milter8_create(const char *name, int conn_timeout, int cmd_timeout,
-		               int msg_timeout, const char *protocol,
-		               const char *def_action, MILTERS *parent)
+		               int msg_timeout, int body_limit,
+		               const char *protocol, const char *def_action,
+		               MILTERS *parent)
 {
     MILTER8 *milter;
 
@@ -2883,7 +3018,7 @@ MILTER *milter8_create(const char *name, int conn_timeout, int cmd_timeout,
      * Fill in the structure.
      */
     milter = milter8_alloc(name, conn_timeout, cmd_timeout, msg_timeout,
-			   protocol, def_action, parent);
+			   body_limit, protocol, def_action, parent);
 
     /*
      * XXX Sendmail 8 libmilter closes the MTA-to-filter socket when it finds
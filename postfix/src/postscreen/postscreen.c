@@ -220,6 +220,12 @@
 /*	Available in Postfix version 3.0 and later:
 /* .IP "\fBpostscreen_dnsbl_timeout (10s)\fR"
 /*	The time limit for DNSBL or DNSWL lookups.
+/* .PP
+/*	Available in Postfix version 3.2 and later:
+/* .IP "\fBpostscreen_dnsbl_async_enable (yes)\fR"
+/*	Send DNSBL and DNSWL queries directly from the \fBpostscreen\fR(8)
+/*	process, instead of handing each query to a \fBdnsblog\fR(8)
+/*	process.
 /* AFTER 220 GREETING TESTS
 /* .ad
 /* .fi
@@ -304,6 +310,9 @@
 /* .IP "\fBpostscreen_command_time_limit (normal: 300s, overload: 10s)\fR"
 /*	The time limit to read an entire command line with \fBpostscreen\fR(8)'s
 /*	built-in SMTP protocol engine.
+/* .IP "\fBpostscreen_multi_process_enable (no)\fR"
+/*	Allow the \fBpostscreen\fR(8) service to run as multiple
+/*	processes that share one listen socket.
 /* .IP "\fBpostscreen_post_queue_limit ($default_process_limit)\fR"
 /*	The number of clients that can be waiting for service from a
 /*	real Postfix SMTP server process.
@@ -401,6 +410,7 @@
 #include <sys_defs.h>
 #include <sys/stat.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* Utility library. */
 
@@ -422,6 +432,8 @@
 #include <mail_proto.h>
 #include <data_redirect.h>
 #include <string_list.h>
+#include <dict_proxy.h>
+#include <dict_memcache.h>
 
 /* Master server protocols. */
 
@@ -485,6 +497,7 @@ char   *var_psc_dnsbl_action;
 int     var_psc_dnsbl_min_ttl;
 int     var_psc_dnsbl_max_ttl;
 int     var_psc_dnsbl_tmout;
+bool    var_psc_dnsbl_async;
 
 bool    var_psc_pipel_enable;
 char   *var_psc_pipel_action;
@@ -495,6 +508,7 @@ char   *var_psc_nsmtp_action;
 int     var_psc_nsmtp_ttl;
 
 bool    var_psc_barlf_enable;
+bool    var_psc_multi_proc;
 char   *var_psc_barlf_action;
 int     var_psc_barlf_ttl;
 
@@ -905,6 +919,19 @@ static void pre_jail_init(char *unused_name, char **unused_argv)
 #define PSC_DICT_OPEN_FLAGS (DICT_FLAG_DUP_REPLACE | DICT_FLAG_SYNC_UPDATE | \
 	    DICT_FLAG_OPEN_LOCK)
 
+    /*
+     * Multiple postscreen processes must not update the same local cache
+     * file independently. Insist on a cache that is designed for sharing.
+     */
+    if (var_psc_multi_proc && *var_psc_cache_map
+	&& strncmp(var_psc_cache_map, DICT_TYPE_PROXY ":",
+		   sizeof(DICT_TYPE_PROXY)) != 0
+	&& strncmp(var_psc_cache_map, DICT_TYPE_MEMCACHE ":",
+		   sizeof(DICT_TYPE_MEMCACHE)) != 0)
+	msg_fatal("%s requires a \"%s\" or \"%s\" type %s",
+		  VAR_PSC_MULTI_PROC, DICT_TYPE_PROXY, DICT_TYPE_MEMCACHE,
+		  VAR_PSC_CACHE_MAP);
+
     if (*var_psc_cache_map)
 	psc_cache_map =
 	    dict_cache_open(data_redirect_map(redirect, var_psc_cache_map),
@@ -920,6 +947,11 @@ static void pre_jail_init(char *unused_name, char **unused_argv)
      * Initialize the dummy SMTP engine.
      */
     psc_smtpd_pre_jail_init();
+
+    /*
+     * Initialize the DNSBL client.
+     */
+    psc_dnsbl_pre_jail_init();
 }
 
 /* pre_accept - see if tables have changed */
@@ -1158,6 +1190,8 @@ int     main(int argc, char **argv)
 	VAR_PSC_PIPEL_ENABLE, DEF_PSC_PIPEL_ENABLE, &var_psc_pipel_enable,
 	VAR_PSC_NSMTP_ENABLE, DEF_PSC_NSMTP_ENABLE, &var_psc_nsmtp_enable,
 	VAR_PSC_BARLF_ENABLE, DEF_PSC_BARLF_ENABLE, &var_psc_barlf_enable,
+	VAR_PSC_MULTI_PROC, DEF_PSC_MULTI_PROC, &var_psc_multi_proc,
+	VAR_PSC_DNSBL_ASYNC, DEF_PSC_DNSBL_ASYNC, &var_psc_dnsbl_async,
 	0,
     };
     static const CONFIG_RAW_TABLE raw_table[] = {
@@ -1192,7 +1226,7 @@ int     main(int argc, char **argv)
 		      CA_MAIL_SERVER_PRE_INIT(pre_jail_init),
 		      CA_MAIL_SERVER_POST_INIT(post_jail_init),
 		      CA_MAIL_SERVER_PRE_ACCEPT(pre_accept),
-		      CA_MAIL_SERVER_SOLITARY,
+		      CA_MAIL_SERVER_SOLITARY_UNLESS(&var_psc_multi_proc),
 		      CA_MAIL_SERVER_SLOW_EXIT(psc_drain),
 		      CA_MAIL_SERVER_EXIT(psc_dump),
 		      CA_MAIL_SERVER_WATCHDOG(&var_psc_watchdog),
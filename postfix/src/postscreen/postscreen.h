@@ -477,6 +477,7 @@ const char *psc_maps_find(MAPS *, const char *, int);
  /*
   * postscreen_dnsbl.c
   */
+extern void psc_dnsbl_pre_jail_init(void);
 extern void psc_dnsbl_init(void);
 extern int psc_dnsbl_retrieve(const char *, const char **, int, int *);
 extern int psc_dnsbl_request(const char *, void (*) (int, void *), void *);
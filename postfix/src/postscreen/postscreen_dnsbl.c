@@ -6,6 +6,8 @@
 /* SYNOPSIS
 /*	#include <postscreen.h>
 /*
+/*	void	psc_dnsbl_pre_jail_init(void)
+/*
 /*	void	psc_dnsbl_init(void)
 /*
 /*	int	psc_dnsbl_request(client_addr, callback, context)
@@ -24,9 +26,19 @@
 /*	Multiple requests for the same information are handled with
 /*	reference counts.
 /*
+/*	psc_dnsbl_pre_jail_init() reads the resolver configuration
+/*	before the process enters the chroot jail.
+/*
 /*	psc_dnsbl_init() initializes this module, and must be called
 /*	once before any of the other functions in this module.
 /*
+/*	By default, DNSBL and DNSWL queries are sent from the
+/*	postscreen(8) event loop with the dns_async(3) client, with
+/*	a random query ID and a new source port for each query.
+/*	With "postscreen_dnsbl_async_enable = no", or when no IPv4
+/*	name server or random source is available, each query is
+/*	handed to a dnsblog(8) process instead.
+/*
 /*	psc_dnsbl_request() requests a blocklist score for the
 /*	specified client IP address and increments the reference
 /*	count.  The request completes in the background. The client
@@ -89,6 +101,10 @@
 #include <mail_params.h>
 #include <mail_proto.h>
 
+/* DNS library. */
+
+#include <dns.h>
+
 /* Application-specific. */
 
 #include <postscreen.h>
@@ -98,6 +114,11 @@
   */
 static char *psc_dnsbl_service;
 
+ /*
+  * Talking to the DNS directly. Zero means use the DNSBLOG service.
+  */
+static int psc_dnsbl_async_servers;
+
  /*
   * Per-DNSBL filters and weights.
   * 
@@ -216,6 +237,19 @@ static VSTRING *reply_client;		/* client address in DNSBLOG reply */
 static VSTRING *reply_dnsbl;		/* domain in DNSBLOG reply */
 static VSTRING *reply_addr;		/* adress list in DNSBLOG reply */
 
+ /*
+  * Per-query state for lookups from within postscreen. The reply is matched
+  * to its query by the dns_async(3) module, using the query ID and question.
+  */
+typedef struct {
+    char   *client_addr;		/* client IP address */
+    const char *dnsbl;			/* DNSBL domain, not safe name */
+    int     request_id;			/* duplicate suppression */
+    DNS_ASYNC *request;			/* pending DNS request */
+} PSC_DNSBL_QUERY;
+
+static VSTRING *query_name;		/* reversed address + DNSBL domain */
+
 /* psc_dnsbl_add_site - add DNSBL site information */
 
 static void psc_dnsbl_add_site(const char *site)
@@ -361,28 +395,19 @@ int     psc_dnsbl_retrieve(const char *client_addr, const char **dnsbl_name,
     return (result_score);
 }
 
-/* psc_dnsbl_receive - receive DNSBL reply, update blocklist score */
+/* psc_dnsbl_update - update blocklist score with DNSBL reply */
 
-static void psc_dnsbl_receive(int event, void *context)
+static void psc_dnsbl_update(const char *client_addr, const char *dnsbl,
+			             int request_id, const char *addr_list,
+			             int dnsbl_ttl)
 {
-    const char *myname = "psc_dnsbl_receive";
-    VSTREAM *stream = (VSTREAM *) context;
+    const char *myname = "psc_dnsbl_update";
     PSC_DNSBL_SCORE *score;
     PSC_DNSBL_HEAD *head;
     PSC_DNSBL_SITE *site;
     ARGV   *reply_argv;
-    int     request_id;
-    int     dnsbl_ttl;
-
-    PSC_CLEAR_EVENT_REQUEST(vstream_fileno(stream), psc_dnsbl_receive, context);
 
     /*
-     * Receive the DNSBL lookup result.
-     * 
-     * This is preliminary code to explore the field. Later, DNSBL lookup will
-     * be handled by an UDP-based DNS client that is built directly into some
-     * Postfix daemon.
-     * 
      * Don't bother looking up the blocklist score when the client IP address is
      * not listed at the DNSBL.
      * 
@@ -391,6 +416,92 @@ static void psc_dnsbl_receive(int event, void *context)
      * client does not pregreet and the DNSBL reply arrives late, or when the
      * client triggers a "drop" action after hanging up.
      */
+    if ((score = (PSC_DNSBL_SCORE *)
+	 htable_find(dnsbl_score_cache, client_addr)) == 0
+	|| score->request_id != request_id)
+	return;
+
+    /*
+     * Run this response past all applicable DNSBL filters and update the
+     * blocklist score for this client IP address.
+     * 
+     * Don't panic when the DNSBL domain name is not found. The DNSBLOG server
+     * may be messed up.
+     */
+    if (msg_verbose > 1)
+	msg_info("%s: client=\"%s\" score=%d domain=\"%s\" reply=\"%d %s\"",
+		 myname, client_addr, score->total,
+		 dnsbl, dnsbl_ttl, addr_list);
+    head = (PSC_DNSBL_HEAD *) htable_find(dnsbl_site_cache, dnsbl);
+    if (head == 0) {
+	/* Bogus domain. Do nothing. */
+    } else if (*addr_list != 0) {
+	/* DNS reputation record(s) found. */
+	reply_argv = 0;
+	for (site = head->first; site != 0; site = site->next) {
+	    if (site->byte_codes == 0
+		|| psc_dnsbl_match(site->byte_codes, reply_argv ? reply_argv :
+				   (reply_argv = argv_split(addr_list, " ")))) {
+		if (score->dnsbl_name == 0
+		    || score->dnsbl_weight < site->weight) {
+		    score->dnsbl_name = head->safe_dnsbl;
+		    score->dnsbl_weight = site->weight;
+		}
+		score->total += site->weight;
+		if (msg_verbose > 1)
+		    msg_info("%s: filter=\"%s\" weight=%d score=%d",
+			     myname, site->filter ? site->filter : "null",
+			     site->weight, score->total);
+	    }
+	    /* As with dnsblog(8), a value < 0 means no reply TTL. */
+	    if (site->weight > 0) {
+		if (score->fail_ttl < 0 || score->fail_ttl > dnsbl_ttl)
+		    score->fail_ttl = dnsbl_ttl;
+	    } else {
+		if (score->pass_ttl < 0 || score->pass_ttl > dnsbl_ttl)
+		    score->pass_ttl = dnsbl_ttl;
+	    }
+	}
+	if (reply_argv != 0)
+	    argv_free(reply_argv);
+    } else {
+	/* No DNS reputation record found. */
+	for (site = head->first; site != 0; site = site->next) {
+	    /* As with dnsblog(8), a value < 0 means no reply TTL. */
+	    if (site->weight > 0) {
+		if (score->pass_ttl < 0 || score->pass_ttl > dnsbl_ttl)
+		    score->pass_ttl = dnsbl_ttl;
+	    } else {
+		if (score->fail_ttl < 0 || score->fail_ttl > dnsbl_ttl)
+		    score->fail_ttl = dnsbl_ttl;
+	    }
+	}
+    }
+
+    /*
+     * Notify the requestor(s) that the result is ready to be picked up. If
+     * this call isn't made, clients have to sit out the entire pre-handshake
+     * delay.
+     */
+    score->pending_lookups -= 1;
+    if (score->pending_lookups == 0)
+	PSC_CALL_BACK_NOTIFY(score, PSC_NULL_EVENT);
+}
+
+/* psc_dnsbl_receive - receive DNSBL reply from DNSBLOG service */
+
+static void psc_dnsbl_receive(int event, void *context)
+{
+    const char *myname = "psc_dnsbl_receive";
+    VSTREAM *stream = (VSTREAM *) context;
+    int     request_id;
+    int     dnsbl_ttl;
+
+    PSC_CLEAR_EVENT_REQUEST(vstream_fileno(stream), psc_dnsbl_receive, context);
+
+    /*
+     * Receive the DNSBL lookup result.
+     */
     if (event == EVENT_READ
 	&& attr_scan(stream,
 		     ATTR_FLAG_STRICT,
@@ -399,85 +510,165 @@ static void psc_dnsbl_receive(int event, void *context)
 		     RECV_ATTR_INT(MAIL_ATTR_LABEL, &request_id),
 		     RECV_ATTR_STR(MAIL_ATTR_RBL_ADDR, reply_addr),
 		     RECV_ATTR_INT(MAIL_ATTR_TTL, &dnsbl_ttl),
-		     ATTR_TYPE_END) == 5
-	&& (score = (PSC_DNSBL_SCORE *)
-	    htable_find(dnsbl_score_cache, STR(reply_client))) != 0
-	&& score->request_id == request_id) {
-
-	/*
-	 * Run this response past all applicable DNSBL filters and update the
-	 * blocklist score for this client IP address.
-	 * 
-	 * Don't panic when the DNSBL domain name is not found. The DNSBLOG
-	 * server may be messed up.
-	 */
-	if (msg_verbose > 1)
-	    msg_info("%s: client=\"%s\" score=%d domain=\"%s\" reply=\"%d %s\"",
-		     myname, STR(reply_client), score->total,
-		     STR(reply_dnsbl), dnsbl_ttl, STR(reply_addr));
-	head = (PSC_DNSBL_HEAD *)
-	    htable_find(dnsbl_site_cache, STR(reply_dnsbl));
-	if (head == 0) {
-	    /* Bogus domain. Do nothing. */
-	} else if (*STR(reply_addr) != 0) {
-	    /* DNS reputation record(s) found. */
-	    reply_argv = 0;
-	    for (site = head->first; site != 0; site = site->next) {
-		if (site->byte_codes == 0
-		    || psc_dnsbl_match(site->byte_codes, reply_argv ? reply_argv :
-			 (reply_argv = argv_split(STR(reply_addr), " ")))) {
-		    if (score->dnsbl_name == 0
-			|| score->dnsbl_weight < site->weight) {
-			score->dnsbl_name = head->safe_dnsbl;
-			score->dnsbl_weight = site->weight;
-		    }
-		    score->total += site->weight;
-		    if (msg_verbose > 1)
-			msg_info("%s: filter=\"%s\" weight=%d score=%d",
-			       myname, site->filter ? site->filter : "null",
-				 site->weight, score->total);
-		}
-		/* As with dnsblog(8), a value < 0 means no reply TTL. */
-		if (site->weight > 0) {
-		    if (score->fail_ttl < 0 || score->fail_ttl > dnsbl_ttl)
-			score->fail_ttl = dnsbl_ttl;
-		} else {
-		    if (score->pass_ttl < 0 || score->pass_ttl > dnsbl_ttl)
-			score->pass_ttl = dnsbl_ttl;
-		}
-	    }
-	    if (reply_argv != 0)
-		argv_free(reply_argv);
-	} else {
-	    /* No DNS reputation record found. */
-	    for (site = head->first; site != 0; site = site->next) {
-		/* As with dnsblog(8), a value < 0 means no reply TTL. */
-		if (site->weight > 0) {
-		    if (score->pass_ttl < 0 || score->pass_ttl > dnsbl_ttl)
-			score->pass_ttl = dnsbl_ttl;
-		} else {
-		    if (score->fail_ttl < 0 || score->fail_ttl > dnsbl_ttl)
-			score->fail_ttl = dnsbl_ttl;
-		}
-	    }
-	}
-
-	/*
-	 * Notify the requestor(s) that the result is ready to be picked up.
-	 * If this call isn't made, clients have to sit out the entire
-	 * pre-handshake delay.
-	 */
-	score->pending_lookups -= 1;
-	if (score->pending_lookups == 0)
-	    PSC_CALL_BACK_NOTIFY(score, PSC_NULL_EVENT);
+		     ATTR_TYPE_END) == 5) {
+	psc_dnsbl_update(STR(reply_client), STR(reply_dnsbl), request_id,
+			 STR(reply_addr), dnsbl_ttl);
     } else if (event == EVENT_TIME) {
 	msg_warn("dnsblog reply timeout %ds for %s",
 		 var_psc_dnsbl_tmout, (char *) vstream_context(stream));
     }
-    /* Here, score may be a null pointer. */
     vstream_fclose(stream);
 }
 
+/* psc_dnsbl_query_free - destroy query state */
+
+static void psc_dnsbl_query_free(PSC_DNSBL_QUERY *qp)
+{
+    myfree(qp->client_addr);
+    myfree((void *) qp);
+}
+
+/* psc_dnsbl_async_timeout - give up on DNS lookup */
+
+static void psc_dnsbl_async_timeout(int unused_event, void *context)
+{
+    PSC_DNSBL_QUERY *qp = (PSC_DNSBL_QUERY *) context;
+
+    /*
+     * As with a dnsblog(8) timeout, the client sits out the pre-handshake
+     * delay.
+     */
+    msg_warn("DNSBL lookup timeout %ds for %s", var_psc_dnsbl_tmout, qp->dnsbl);
+    dns_async_cancel(qp->request);
+    psc_dnsbl_query_free(qp);
+}
+
+/* psc_dnsbl_async_receive - receive DNSBL reply from DNS */
+
+static void psc_dnsbl_async_receive(int dns_status, DNS_RR *addr_list,
+				            const char *unused_fqdn,
+				            const char *why, int unused_rcode,
+				            void *context)
+{
+    const char *myname = "psc_dnsbl_async_receive";
+    PSC_DNSBL_QUERY *qp = (PSC_DNSBL_QUERY *) context;
+    MAI_HOSTADDR_STR hostaddr;
+    DNS_RR *rr;
+    int     dnsbl_ttl;
+
+    event_cancel_timer(psc_dnsbl_async_timeout, context);
+
+    /*
+     * Convert the reply as dnsblog(8) does: the lowest TTL in the response
+     * from the A record(s) if found, or from the SOA record(s) if available.
+     * If the reply specifies no TTL, or if the query fails, the TTL is -1.
+     */
+    VSTRING_RESET(reply_addr);
+    dnsbl_ttl = -1;
+    if (dns_status == DNS_OK) {
+	for (rr = addr_list; rr != 0; rr = rr->next) {
+	    if (dns_rr_to_pa(rr, &hostaddr) == 0) {
+		msg_warn("%s: skipping reply record type %s for query %s: %m",
+			 myname, dns_strtype(rr->type), rr->qname);
+	    } else {
+		msg_info("addr %s listed by domain %s as %s",
+			 qp->client_addr, qp->dnsbl, hostaddr.buf);
+		if (LEN(reply_addr) > 0)
+		    vstring_strcat(reply_addr, " ");
+		vstring_strcat(reply_addr, hostaddr.buf);
+		if (dnsbl_ttl < 0 || dnsbl_ttl > rr->ttl)
+		    dnsbl_ttl = rr->ttl;
+	    }
+	}
+    } else if (dns_status == DNS_NOTFOUND) {
+	if (msg_verbose)
+	    msg_info("%s: addr %s not listed by domain %s",
+		     myname, qp->client_addr, qp->dnsbl);
+	for (rr = addr_list; rr != 0; rr = rr->next) {
+	    if (rr->type == T_SOA && (dnsbl_ttl < 0 || dnsbl_ttl > rr->ttl))
+		dnsbl_ttl = rr->ttl;
+	}
+    } else {
+	msg_warn("%s: lookup error for addr %s domain %s: %s",
+		 myname, qp->client_addr, qp->dnsbl, why);
+    }
+    VSTRING_TERMINATE(reply_addr);
+    if (addr_list)
+	dns_rr_free(addr_list);
+    psc_dnsbl_update(qp->client_addr, qp->dnsbl, qp->request_id,
+		     STR(reply_addr), dnsbl_ttl);
+    psc_dnsbl_query_free(qp);
+}
+
+/* psc_dnsbl_query_name - reverse client address, append DNSBL domain */
+
+static const char *psc_dnsbl_query_name(const char *client_addr,
+					        const char *dnsbl)
+{
+    ARGV   *octets;
+    int     i;
+
+#ifdef HAS_IPV6
+    struct in6_addr ipv6_addr;
+
+#endif
+
+    VSTRING_RESET(query_name);
+
+    /*
+     * As with dnsblog(8), reverse an IPv6 address as 32 hexadecimal nibbles,
+     * and an IPv4 address as four decimal octet values.
+     */
+#ifdef HAS_IPV6
+    if (valid_ipv6_hostaddr(client_addr, DONT_GRIPE)) {
+	if (inet_pton(AF_INET6, client_addr, (void *) &ipv6_addr) != 1)
+	    return (0);
+	for (i = sizeof(ipv6_addr.s6_addr) - 1; i >= 0; i--)
+	    vstring_sprintf_append(query_name, "%x.%x.",
+				   ipv6_addr.s6_addr[i] & 0xf,
+				   ipv6_addr.s6_addr[i] >> 4);
+    } else
+#endif
+    {
+	octets = argv_split(client_addr, ".");
+	for (i = octets->argc - 1; i >= 0; i--) {
+	    vstring_strcat(query_name, octets->argv[i]);
+	    vstring_strcat(query_name, ".");
+	}
+	argv_free(octets);
+    }
+    vstring_strcat(query_name, dnsbl);
+    return (STR(query_name));
+}
+
+/* psc_dnsbl_async_request - send DNSBL query from within postscreen */
+
+static int psc_dnsbl_async_request(const char *client_addr, const char *dnsbl,
+				           int request_id)
+{
+    const char *myname = "psc_dnsbl_async_request";
+    PSC_DNSBL_QUERY *qp;
+    const char *name;
+
+    if ((name = psc_dnsbl_query_name(client_addr, dnsbl)) == 0) {
+	msg_warn("%s: unable to convert address %s", myname, client_addr);
+	return (-1);
+    }
+    if (msg_verbose > 1)
+	msg_info("%s: query %s", myname, name);
+    qp = (PSC_DNSBL_QUERY *) mymalloc(sizeof(*qp));
+    qp->client_addr = mystrdup(client_addr);
+    qp->dnsbl = dnsbl;
+    qp->request_id = request_id;
+    qp->request = dns_async_lookup(name, T_A, 0,
+				   DNS_REQ_FLAG_NCACHE_TTL
+				   | DNS_REQ_FLAG_NO_BLOCK,
+				   psc_dnsbl_async_receive, (void *) qp);
+    event_request_timer(psc_dnsbl_async_timeout, (void *) qp,
+			var_psc_dnsbl_tmout);
+    return (0);
+}
+
 /* psc_dnsbl_request  - send dnsbl query, increment reference count */
 
 int     psc_dnsbl_request(const char *client_addr,
@@ -544,12 +735,17 @@ int     psc_dnsbl_request(const char *client_addr,
     (void) htable_enter(dnsbl_score_cache, client_addr, (void *) score);
 
     /*
-     * Send a query to all DNSBL servers. Later, DNSBL lookup will be done
-     * with an UDP-based DNS client that is built directly into Postfix code.
-     * We therefore do not optimize the maximum out of this temporary
-     * implementation.
+     * Send a query to all DNSBL servers. Preferably, send the queries
+     * directly, and let the event loop pick up the replies, instead of
+     * handing each query to a DNSBLOG process.
      */
     for (ht = dnsbl_site_list; *ht; ht++) {
+	if (psc_dnsbl_async_servers > 0) {
+	    if (psc_dnsbl_async_request(client_addr, ht[0]->key,
+					score->request_id) == 0)
+		score->pending_lookups += 1;
+	    continue;
+	}
 	if ((fd = LOCAL_CONNECT(psc_dnsbl_service, NON_BLOCKING, 1)) < 0) {
 	    msg_warn("%s: connect to %s service: %m",
 		     myname, psc_dnsbl_service);
@@ -577,6 +773,22 @@ int     psc_dnsbl_request(const char *client_addr,
     return (PSC_CALL_BACK_INDEX_OF_LAST(score));
 }
 
+/* psc_dnsbl_pre_jail_init - pre-jail initialization */
+
+void    psc_dnsbl_pre_jail_init(void)
+{
+
+    /*
+     * Read the resolver configuration and open the random source for query
+     * IDs while they are still accessible. Without either, use the DNSBLOG
+     * service.
+     */
+    if (*var_psc_dnsbl_sites && var_psc_dnsbl_async
+	&& (psc_dnsbl_async_servers = dns_async_init()) == 0)
+	msg_warn("no IPv4 name server or random source for DNSBL lookups; "
+		 "using the %s service instead", var_dnsblog_service);
+}
+
 /* psc_dnsbl_init - initialize */
 
 void    psc_dnsbl_init(void)
@@ -619,4 +831,5 @@ void    psc_dnsbl_init(void)
     reply_client = vstring_alloc(100);
     reply_dnsbl = vstring_alloc(100);
     reply_addr = vstring_alloc(100);
+    query_name = vstring_alloc(100);
 }
@@ -299,6 +299,7 @@
 #include <mail_queue.h>
 #include <mail_open_ok.h>
 #include <file_id.h>
+#include <mail_proto.h>
 
 /* Application-specific. */
 
@@ -1420,6 +1421,21 @@ int     main(int argc, char **argv)
 	}
     }
 
+    /*
+     * The queue manager may keep an index of the deferred queue, and won't
+     * look at the deferred queue directory unless asked to. Tell it about
+     * messages that were released from hold or that were renamed. Ignore
+     * errors: the queue manager may not be running.
+     */
+    if (message_released > 0 || inode_fixed > 0) {
+	static char qmgr_scan_trigger[] = {
+	    QMGR_REQ_SCAN_DEFERRED,	/* scan deferred queue */
+	};
+
+	(void) mail_trigger(MAIL_CLASS_PUBLIC, var_queue_service,
+			    qmgr_scan_trigger, sizeof(qmgr_scan_trigger));
+    }
+
     /*
      * Report.
      */
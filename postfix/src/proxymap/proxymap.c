@@ -76,6 +76,17 @@
 /*	a lookup key and result value, if found.
 /* .sp
 /*	This request is supported in Postfix 2.9 and later.
+/* .IP "\fBlookup_first\fR \fImaptype:mapname flags count key...\fR"
+/*	Look up the specified keys in order, and stop at the first
+/*	key that is found or that causes a lookup error. The reply
+/*	is the request completion status code, that key, and the
+/*	lookup result value. This allows a client to look up all
+/*	candidate keys for one search (for example, an address,
+/*	its domain, and parent domains) in one round trip.
+/*	The \fImaptype:mapname\fR and \fIflags\fR are the same
+/*	as with the \fBopen\fR request.
+/* .sp
+/*	This request is supported in Postfix 3.2 and later.
 /* .PP
 /*	The request completion status is one of OK, RETRY, NOKEY
 /*	(lookup failed because the key was not found), BAD (malformed
@@ -128,7 +139,14 @@
 /* BUGS
 /*	The \fBproxymap\fR(8) server provides service to multiple clients,
 /*	and must therefore not be used for tables that have high-latency
-/*	lookups.
+/*	lookups, unless the number of clients per process is limited
+/*	with \fBproxymap_client_limit\fR.
+/*
+/*	The \fBproxymap\fR(8) server does not remember lookup results
+/*	by itself. To share recent results among all clients of a
+/*	\fBproxymap\fR(8) process, use a table of the form
+/*	\fBproxy:cachemap:{\fItype:name\fB}\fR, and list that table
+/*	in \fBproxy_read_maps\fR.
 /*
 /*	The \fBproxymap\fR(8) read-write service does not explicitly
 /*	close lookup tables (even if it did, this could not be relied on,
@@ -181,6 +199,11 @@
 /* .IP "\fBproxy_write_maps (see 'postconf -d' output)\fR"
 /*	The lookup tables that the \fBproxymap\fR(8) server is allowed to
 /*	access for the read-write service.
+/* .PP
+/*	Available in Postfix 3.2 and later:
+/* .IP "\fBproxymap_client_limit (0)\fR"
+/*	The maximal number of clients that one \fBproxymap\fR(8) process
+/*	serves at the same time.
 /* SEE ALSO
 /*	postconf(5), configuration parameters
 /*	master(5), generic daemon options
@@ -265,6 +288,7 @@ char   *var_smtpd_snd_auth_maps;
 char   *var_psc_cache_map;
 char   *var_proxy_read_maps;
 char   *var_proxy_write_maps;
+int     var_proxy_client_limit;
 
  /*
   * The pre-approved, pre-parsed list of maps.
@@ -278,6 +302,7 @@ static VSTRING *request;
 static VSTRING *request_map;
 static VSTRING *request_key;
 static VSTRING *request_value;
+static ARGV *request_keys;
 static VSTRING *map_type_name_flags;
 
  /*
@@ -447,6 +472,73 @@ static void proxymap_lookup_service(VSTREAM *client_stream)
 	       ATTR_TYPE_END);
 }
 
+/* proxymap_lookup_first_service - remote multi-key lookup service */
+
+static void proxymap_lookup_first_service(VSTREAM *client_stream)
+{
+    int     request_flags;
+    int     request_count;
+    DICT   *dict;
+    const char *reply_key;
+    const char *reply_value;
+    int     reply_status;
+    ssize_t which;
+    int     n;
+
+    /*
+     * Process the request. The last key is followed by the end of the
+     * request.
+     */
+    argv_truncate(request_keys, 0);
+    if (attr_scan(client_stream, ATTR_FLAG_MORE | ATTR_FLAG_STRICT,
+		  RECV_ATTR_STR(MAIL_ATTR_TABLE, request_map),
+		  RECV_ATTR_INT(MAIL_ATTR_FLAGS, &request_flags),
+		  RECV_ATTR_INT(MAIL_ATTR_SIZE, &request_count),
+		  ATTR_TYPE_END) != 3
+	|| request_count < 1 || request_count > PROXY_MAX_KEYS) {
+	request_count = 0;
+    }
+    for (n = 0; n < request_count; n++) {
+	if (attr_scan(client_stream, n < request_count - 1 ?
+		      ATTR_FLAG_MORE | ATTR_FLAG_STRICT : ATTR_FLAG_STRICT,
+		      RECV_ATTR_STR(MAIL_ATTR_KEY, request_key),
+		      ATTR_TYPE_END) != 1)
+	    break;
+	argv_add(request_keys, STR(request_key), (char *) 0);
+    }
+    reply_key = reply_value = "";
+    if (request_count == 0 || request_keys->argc != request_count) {
+	reply_status = PROXY_STAT_BAD;
+    } else if ((dict = proxy_map_find(STR(request_map), request_flags,
+				      &reply_status)) == 0) {
+	 /* void */ ;
+    } else {
+	dict->flags = ((dict->flags & ~DICT_FLAG_RQST_MASK)
+		       | (request_flags & DICT_FLAG_RQST_MASK));
+	if ((reply_value = dict_get_first(dict, request_keys, &which)) != 0) {
+	    reply_status = PROXY_STAT_OK;
+	    reply_key = request_keys->argv[which];
+	} else if (dict->error == 0) {
+	    reply_status = PROXY_STAT_NOKEY;
+	    reply_value = "";
+	} else {
+	    reply_status = (dict->error == DICT_ERR_RETRY ?
+			    PROXY_STAT_RETRY : PROXY_STAT_CONFIG);
+	    reply_key = request_keys->argv[which];
+	    reply_value = "";
+	}
+    }
+
+    /*
+     * Respond to the client.
+     */
+    attr_print(client_stream, ATTR_FLAG_NONE,
+	       SEND_ATTR_INT(MAIL_ATTR_STATUS, reply_status),
+	       SEND_ATTR_STR(MAIL_ATTR_KEY, reply_key),
+	       SEND_ATTR_STR(MAIL_ATTR_VALUE, reply_value),
+	       ATTR_TYPE_END);
+}
+
 /* proxymap_update_service - remote update service */
 
 static void proxymap_update_service(VSTREAM *client_stream)
@@ -622,6 +714,8 @@ static void proxymap_service(VSTREAM *client_stream, char *unused_service,
 		  ATTR_TYPE_END) == 1) {
 	if (VSTREQ(request, PROXY_REQ_LOOKUP)) {
 	    proxymap_lookup_service(client_stream);
+	} else if (VSTREQ(request, PROXY_REQ_LOOKUP_FIRST)) {
+	    proxymap_lookup_first_service(client_stream);
 	} else if (VSTREQ(request, PROXY_REQ_UPDATE)) {
 	    proxymap_update_service(client_stream);
 	} else if (VSTREQ(request, PROXY_REQ_DELETE)) {
@@ -681,6 +775,7 @@ static void post_jail_init(char *service_name, char **unused_argv)
     request_map = vstring_alloc(10);
     request_key = vstring_alloc(10);
     request_value = vstring_alloc(10);
+    request_keys = argv_alloc(10);
     map_type_name_flags = vstring_alloc(10);
 
     /*
@@ -727,6 +822,10 @@ MAIL_VERSION_STAMP_DECLARE;
 
 int     main(int argc, char **argv)
 {
+    static const CONFIG_INT_TABLE int_table[] = {
+	VAR_PROXY_CLIENT_LIMIT, DEF_PROXY_CLIENT_LIMIT, &var_proxy_client_limit, 0, 0,
+	0,
+    };
     static const CONFIG_STR_TABLE str_table[] = {
 	VAR_ALIAS_MAPS, DEF_ALIAS_MAPS, &var_alias_maps, 0, 0,
 	VAR_LOCAL_RCPT_MAPS, DEF_LOCAL_RCPT_MAPS, &var_local_rcpt_maps, 0, 0,
@@ -756,8 +855,10 @@ int     main(int argc, char **argv)
     MAIL_VERSION_STAMP_ALLOCATE;
 
     multi_server_main(argc, argv, proxymap_service,
+		      CA_MAIL_SERVER_INT_TABLE(int_table),
 		      CA_MAIL_SERVER_STR_TABLE(str_table),
 		      CA_MAIL_SERVER_POST_INIT(post_jail_init),
+		      CA_MAIL_SERVER_CLIENT_LIMIT(&var_proxy_client_limit),
 		      CA_MAIL_SERVER_PRE_ACCEPT(pre_accept),
     /* XXX CA_MAIL_SERVER_SOLITARY if proxywrite */
 		      0);
@@ -100,6 +100,8 @@
 /* .IP "\fBD (QMGR_REQ_SCAN_DEFERRED)\fR"
 /*	Start a deferred queue scan.  If a deferred queue scan is already
 /*	in progress, that scan will be restarted as soon as it finishes.
+/*	This request always reads the deferred queue directory, also
+/*	when the deferred queue index is enabled.
 /* .IP "\fBI (QMGR_REQ_SCAN_INCOMING)\fR"
 /*	Start an incoming queue scan. If an incoming queue scan is already
 /*	in progress, that scan will be restarted as soon as it finishes.
@@ -309,6 +311,12 @@
 /*	destination.
 /* .IP "\fItransport\fB_transport_rate_delay $default_transport_rate_delay\fR"
 /*	Idem, for delivery via the named message \fItransport\fR.
+/* .PP
+/*	Available in Postfix version 3.2 and later:
+/* .IP "\fBqmgr_deferred_index_enable (yes)\fR"
+/*	Maintain an in-memory index of deferred queue files and their
+/*	wakeup times, so that periodic deferred queue runs need not
+/*	read the deferred queue directory.
 /* SAFETY CONTROLS
 /* .ad
 /* .fi
@@ -460,6 +468,7 @@ int     var_local_con_lim;
 int     var_local_rcpt_lim;
 bool    var_verp_bounce_off;
 int     var_qmgr_clog_warn_time;
+bool    var_qmgr_defer_index;
 char   *var_conc_pos_feedback;
 char   *var_conc_neg_feedback;
 int     var_conc_cohort_limit;
@@ -474,6 +483,8 @@ int     var_vrfy_pend_limit;
 
 static QMGR_SCAN *qmgr_scans[2];
 
+QMGR_INDEX *qmgr_deferred_index;
+
 #define QMGR_SCAN_IDX_INCOMING 0
 #define QMGR_SCAN_IDX_DEFERRED 1
 #define QMGR_SCAN_IDX_COUNT (sizeof(qmgr_scans) / sizeof(qmgr_scans[0]))
@@ -524,7 +535,7 @@ static void qmgr_trigger_event(char *buf, ssize_t len,
 	    incoming_flag |= QMGR_SCAN_START;
 	    break;
 	case QMGR_REQ_SCAN_DEFERRED:
-	    deferred_flag |= QMGR_SCAN_START;
+	    deferred_flag |= QMGR_SCAN_START | QMGR_SCAN_DIR;
 	    break;
 	case QMGR_REQ_FLUSH_DEAD:
 	    deferred_flag |= QMGR_FLUSH_BEFORE;
@@ -619,7 +630,7 @@ static int qmgr_loop(char *unused_name, char **unused_argv)
 	if (token_count < var_proc_limit) {
 	    if (feed != 0 && last_scan_idx == QMGR_SCAN_IDX_INCOMING)
 		mail_flow_put(1);
-	    else if (qmgr_scans[QMGR_SCAN_IDX_INCOMING]->handle == 0)
+	    else if (!QMGR_SCAN_BUSY(qmgr_scans[QMGR_SCAN_IDX_INCOMING]))
 		mail_flow_put(var_proc_limit - token_count);
 	} else if (token_count > var_proc_limit) {
 	    mail_flow_get(token_count - var_proc_limit);
@@ -688,14 +699,19 @@ static void qmgr_post_init(char *name, char **unused_argv)
      * queue could cause anomalous delays when "postfix reload/start" are
      * issued often. Override the IPC timeout (default 3600s) so that the
      * queue manager can reset a broken IPC channel before the watchdog timer
-     * goes off.
+     * goes off. The deferred queue index, if enabled, is built by the first
+     * deferred queue scan.
      */
     var_ipc_timeout = var_qmgr_ipc_timeout;
     var_use_limit = 0;
     var_idle_limit = 0;
     qmgr_move(MAIL_QUEUE_ACTIVE, MAIL_QUEUE_INCOMING, event_time());
-    qmgr_scans[QMGR_SCAN_IDX_INCOMING] = qmgr_scan_create(MAIL_QUEUE_INCOMING);
-    qmgr_scans[QMGR_SCAN_IDX_DEFERRED] = qmgr_scan_create(MAIL_QUEUE_DEFERRED);
+    if (var_qmgr_defer_index)
+	qmgr_deferred_index = qmgr_index_create();
+    qmgr_scans[QMGR_SCAN_IDX_INCOMING] =
+	qmgr_scan_create(MAIL_QUEUE_INCOMING, (QMGR_INDEX *) 0);
+    qmgr_scans[QMGR_SCAN_IDX_DEFERRED] =
+	qmgr_scan_create(MAIL_QUEUE_DEFERRED, qmgr_deferred_index);
     qmgr_scan_request(qmgr_scans[QMGR_SCAN_IDX_INCOMING], QMGR_SCAN_START);
     qmgr_deferred_run_event(0, (void *) 0);
 }
@@ -752,6 +768,7 @@ int     main(int argc, char **argv)
 	VAR_VERP_BOUNCE_OFF, DEF_VERP_BOUNCE_OFF, &var_verp_bounce_off,
 	VAR_CONC_FDBACK_DEBUG, DEF_CONC_FDBACK_DEBUG, &var_conc_feedback_debug,
 	VAR_DSN_DELAY_CLEARED, DEF_DSN_DELAY_CLEARED, &var_dsn_delay_cleared,
+	VAR_QMGR_DEFER_INDEX, DEF_QMGR_DEFER_INDEX, &var_qmgr_defer_index,
 	0,
     };
 
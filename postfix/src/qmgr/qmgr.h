@@ -18,6 +18,7 @@
   * Utility library.
   */
 #include <vstream.h>
+#include <vstring.h>
 #include <scan_dir.h>
 
  /*
@@ -111,7 +112,7 @@ struct QMGR_TRANSPORT_LIST {
     QMGR_TRANSPORT *prev;
 };
 
-extern struct HTABLE *qmgr_transport_byname;	/* transport by name */
+extern struct OHTABLE *qmgr_transport_byname;	/* transport by name */
 extern QMGR_TRANSPORT_LIST qmgr_transport_list;	/* transports, round robin */
 
  /*
@@ -185,9 +186,9 @@ struct QMGR_TRANSPORT {
     int     slot_loan_factor;		/* factor, see qmgr_job_preempt() */
     int     min_slots;			/* when preemption can take effect at
 					 * all */
-    struct HTABLE *queue_byname;	/* queues indexed by domain */
+    struct OHTABLE *queue_byname;	/* queues indexed by domain */
     QMGR_QUEUE_LIST queue_list;		/* queues, round robin order */
-    struct HTABLE *job_byname;		/* jobs indexed by queue id */
+    struct OHTABLE *job_byname;		/* jobs indexed by queue id */
     QMGR_JOB_LIST job_list;		/* list of message jobs (1 per
 					 * message) ordered by scheduler */
     QMGR_JOB_LIST job_bytime;		/* jobs ordered by time since queued */
@@ -417,7 +418,7 @@ struct QMGR_JOB {
     int     stack_level;		/* job stack nesting level (-1 means
 					 * it's not on the lists at all) */
     int     blocker_tag;		/* tagged if blocks the job list */
-    struct HTABLE *peer_byname;		/* message job peers, indexed by
+    struct OHTABLE *peer_byname;	/* message job peers, indexed by
 					 * domain */
     QMGR_PEER_LIST peer_list;		/* list of message job peers */
     int     slots_used;			/* slots used during preemption */
@@ -490,15 +491,45 @@ extern void qmgr_enable_transport(QMGR_TRANSPORT *);
 extern void qmgr_enable_queue(QMGR_QUEUE *);
 
  /*
-  * Queue scan context.
+  * Deferred queue index.
+  */
+typedef struct QMGR_INDEX {
+    struct OHTABLE *table;		/* entries by queue ID */
+    struct QMGR_INDEX_ENTRY **heap;	/* entries by wakeup time */
+    ssize_t size;			/* heap array size */
+    ssize_t used;			/* heap array entries in use */
+    VSTRING *result;			/* qmgr_index_next() result */
+} QMGR_INDEX;
+
+extern QMGR_INDEX *qmgr_index_create(void);
+extern void qmgr_index_enter(QMGR_INDEX *, const char *, time_t);
+extern void qmgr_index_delete(QMGR_INDEX *, const char *);
+extern const char *qmgr_index_next(QMGR_INDEX *, time_t);
+extern void qmgr_index_reset(QMGR_INDEX *);
+
+#define QMGR_INDEX_COUNT(index)	((index)->used)
+
+extern QMGR_INDEX *qmgr_deferred_index;	/* null if disabled */
+
+ /*
+  * Queue scan context. A scan reads the queue directory, or takes the queue
+  * files that are due from the queue's index. The index is used only after
+  * one complete directory scan.
   */
 struct QMGR_SCAN {
     char   *queue;			/* queue name */
     int     flags;			/* private, this run */
     int     nflags;			/* private, next run */
     struct SCAN_DIR *handle;		/* scan */
+    QMGR_INDEX *index;			/* queue index, or null */
+    int     index_ready;		/* index is complete */
+    int     index_scan;		/* index scan in progress */
+    time_t  index_deadline;		/* index scan wakeup time limit */
 };
 
+#define QMGR_SCAN_BUSY(scan_info) \
+	((scan_info)->handle != 0 || (scan_info)->index_scan != 0)
+
  /*
   * Flags that control queue scans or destination selection. These are
   * similar to the QMGR_REQ_XXX request codes.
@@ -508,11 +539,12 @@ struct QMGR_SCAN {
 #define QMGR_FLUSH_ONCE	(1<<2)		/* unthrottle once */
 #define QMGR_FLUSH_DFXP	(1<<3)		/* override defer_transports */
 #define QMGR_FLUSH_EACH	(1<<4)		/* unthrottle per message */
+#define QMGR_SCAN_DIR	(1<<5)		/* read directory, not index */
 
  /*
   * qmgr_scan.c
   */
-extern QMGR_SCAN *qmgr_scan_create(const char *);
+extern QMGR_SCAN *qmgr_scan_create(const char *, QMGR_INDEX *);
 extern void qmgr_scan_request(QMGR_SCAN *, int);
 extern char *qmgr_scan_next(QMGR_SCAN *);
 
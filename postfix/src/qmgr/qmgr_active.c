@@ -33,6 +33,9 @@
 /*	future time stamps are ignored, and incoming queue files with
 /*	future time stamps are frowned upon.
 /* .PP
+/*	Queue files that are skipped because of their time stamp
+/*	are added to the queue's index, if it has one.
+/*
 /*	qmgr_active_drain() allocates one delivery process.
 /*	Process allocation is asynchronous. Once the delivery
 /*	process is available, an attempt is made to deliver
@@ -55,7 +58,8 @@
 /*	into the future by a minimal backoff time, whichever is more.
 /*	The minimal_backoff_time parameter specifies the minimal
 /*	amount of time between delivery attempts; maximal_backoff_time
-/*	specifies an upper limit.
+/*	specifies an upper limit. A deferred message is added to the
+/*	deferred queue index, if one is enabled.
 /* DIAGNOSTICS
 /*	Fatal: queue file access failures, out of memory.
 /*	Panic: interface violations, internal consistency errors.
@@ -161,8 +165,11 @@ static void qmgr_active_defer(const char *queue_name, const char *queue_id,
 		      queue_id, queue_name, dest_queue);
 	msg_warn("%s: rename %s from %s to %s: %m", myname,
 		 queue_id, queue_name, dest_queue);
-    } else if (msg_verbose) {
-	msg_info("%s: defer %s", myname, queue_id);
+    } else {
+	if (qmgr_deferred_index && strcmp(dest_queue, MAIL_QUEUE_DEFERRED) == 0)
+	    qmgr_index_enter(qmgr_deferred_index, queue_id, tbuf.modtime);
+	if (msg_verbose)
+	    msg_info("%s: defer %s", myname, queue_id);
     }
 }
 
@@ -198,8 +205,12 @@ int     qmgr_active_feed(QMGR_SCAN *scan_info, const char *queue_id)
 	if (msg_verbose)
 	    msg_info("%s: skip %s (%ld seconds)", myname, queue_id,
 		     (long) (st.st_mtime - event_time()));
+	if (scan_info->index)
+	    qmgr_index_enter(scan_info->index, queue_id, st.st_mtime);
 	return (0);
     }
+    if (scan_info->index)
+	qmgr_index_delete(scan_info->index, queue_id);
 
     /*
      * Move the message to the active queue. File access errors are fatal.
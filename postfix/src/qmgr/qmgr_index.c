@@ -0,0 +1,240 @@
+/*++
+/* NAME
+/*	qmgr_index 3
+/* SUMMARY
+/*	deferred queue index
+/* SYNOPSIS
+/*	#include "qmgr.h"
+/*
+/*	QMGR_INDEX *qmgr_index_create()
+/*
+/*	void	qmgr_index_enter(index, queue_id, when)
+/*	QMGR_INDEX *index;
+/*	const char *queue_id;
+/*	time_t	when;
+/*
+/*	void	qmgr_index_delete(index, queue_id)
+/*	QMGR_INDEX *index;
+/*	const char *queue_id;
+/*
+/*	const char *qmgr_index_next(index, deadline)
+/*	QMGR_INDEX *index;
+/*	time_t	deadline;
+/*
+/*	void	qmgr_index_reset(index)
+/*	QMGR_INDEX *index;
+/*
+/*	ssize_t	QMGR_INDEX_COUNT(index)
+/*	QMGR_INDEX *index;
+/* DESCRIPTION
+/*	This module maintains an in-memory list of deferred queue
+/*	files and their wakeup times, so that a deferred queue run
+/*	does not have to read the whole queue directory and look
+/*	at every queue file. The list is a binary heap ordered by
+/*	wakeup time, plus a hash table by queue ID.
+/*
+/*	The index is a hint. A queue file that is listed may no
+/*	longer exist, and the caller must still look at the queue
+/*	file before opening it.
+/*
+/*	qmgr_index_create() creates an empty index.
+/*
+/*	qmgr_index_enter() adds a queue file with the specified
+/*	wakeup time, or updates the wakeup time of a queue file
+/*	that is already listed.
+/*
+/*	qmgr_index_delete() removes a queue file from the index.
+/*	It is not an error when the queue file is not listed.
+/*
+/*	qmgr_index_next() removes and returns the queue ID with
+/*	the earliest wakeup time, provided that this time is not
+/*	after the deadline. The result is a null pointer when there
+/*	is no such queue file. The result is overwritten by the
+/*	next call.
+/*
+/*	qmgr_index_reset() removes all queue files from the index.
+/*
+/*	QMGR_INDEX_COUNT() returns the number of listed queue files.
+/* DIAGNOSTICS
+/*	Fatal: out of memory.
+/*	Panic: internal consistency errors.
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <ohtable.h>
+#include <vstring.h>
+
+/* Application-specific. */
+
+#include "qmgr.h"
+
+ /*
+  * One listed queue file. The queue ID is stored with the hash table entry.
+  */
+typedef struct QMGR_INDEX_ENTRY {
+    time_t  when;			/* wakeup time */
+    ssize_t pos;			/* heap position */
+    const char *queue_id;		/* hash table key */
+} QMGR_INDEX_ENTRY;
+
+#define QMGR_INDEX_INIT_SIZE	1024
+
+ /*
+  * Heap navigation.
+  */
+#define HEAP_PARENT(i)	(((i) - 1) / 2)
+#define HEAP_CHILD(i)	(2 * (i) + 1)
+
+/* qmgr_index_up - restore heap order towards the root */
+
+static void qmgr_index_up(QMGR_INDEX *index, ssize_t pos)
+{
+    QMGR_INDEX_ENTRY *entry = index->heap[pos];
+    QMGR_INDEX_ENTRY *parent;
+
+    while (pos > 0
+	   && (parent = index->heap[HEAP_PARENT(pos)])->when > entry->when) {
+	index->heap[pos] = parent;
+	parent->pos = pos;
+	pos = HEAP_PARENT(pos);
+    }
+    index->heap[pos] = entry;
+    entry->pos = pos;
+}
+
+/* qmgr_index_down - restore heap order towards the leaves */
+
+static void qmgr_index_down(QMGR_INDEX *index, ssize_t pos)
+{
+    QMGR_INDEX_ENTRY *entry = index->heap[pos];
+    QMGR_INDEX_ENTRY *child;
+    ssize_t cpos;
+
+    while ((cpos = HEAP_CHILD(pos)) < index->used) {
+	if (cpos + 1 < index->used
+	    && index->heap[cpos + 1]->when < index->heap[cpos]->when)
+	    cpos += 1;
+	if ((child = index->heap[cpos])->when >= entry->when)
+	    break;
+	index->heap[pos] = child;
+	child->pos = pos;
+	pos = cpos;
+    }
+    index->heap[pos] = entry;
+    entry->pos = pos;
+}
+
+/* qmgr_index_remove - remove entry from heap and hash table */
+
+static void qmgr_index_remove(QMGR_INDEX *index, QMGR_INDEX_ENTRY *entry)
+{
+    ssize_t pos = entry->pos;
+
+    if (pos < 0 || pos >= index->used || index->heap[pos] != entry)
+	msg_panic("qmgr_index_remove: bad heap position %ld for %s",
+		  (long) pos, entry->queue_id);
+    if (pos < --index->used) {
+	index->heap[pos] = index->heap[index->used];
+	index->heap[pos]->pos = pos;
+	if (pos > 0 && index->heap[HEAP_PARENT(pos)]->when > index->heap[pos]->when)
+	    qmgr_index_up(index, pos);
+	else
+	    qmgr_index_down(index, pos);
+    }
+    ohtable_delete(index->table, entry->queue_id, myfree);
+}
+
+/* qmgr_index_create - create empty index */
+
+QMGR_INDEX *qmgr_index_create(void)
+{
+    QMGR_INDEX *index;
+
+    index = (QMGR_INDEX *) mymalloc(sizeof(*index));
+    index->table = ohtable_create(QMGR_INDEX_INIT_SIZE);
+    index->heap = (QMGR_INDEX_ENTRY **)
+	mymalloc(sizeof(*index->heap) * QMGR_INDEX_INIT_SIZE);
+    index->size = QMGR_INDEX_INIT_SIZE;
+    index->used = 0;
+    index->result = vstring_alloc(20);
+    return (index);
+}
+
+/* qmgr_index_enter - add or update queue file */
+
+void    qmgr_index_enter(QMGR_INDEX *index, const char *queue_id, time_t when)
+{
+    QMGR_INDEX_ENTRY *entry;
+    OHTABLE_INFO *info;
+
+    if ((entry = (QMGR_INDEX_ENTRY *) ohtable_find(index->table, queue_id)) != 0) {
+	if (when < entry->when) {
+	    entry->when = when;
+	    qmgr_index_up(index, entry->pos);
+	} else if (when > entry->when) {
+	    entry->when = when;
+	    qmgr_index_down(index, entry->pos);
+	}
+	return;
+    }
+    if (index->used >= index->size) {
+	index->size *= 2;
+	index->heap = (QMGR_INDEX_ENTRY **)
+	    myrealloc((void *) index->heap,
+		      sizeof(*index->heap) * index->size);
+    }
+    entry = (QMGR_INDEX_ENTRY *) mymalloc(sizeof(*entry));
+    info = ohtable_enter(index->table, queue_id, (void *) entry);
+    entry->queue_id = info->key;
+    entry->when = when;
+    index->heap[index->used] = entry;
+    qmgr_index_up(index, index->used++);
+}
+
+/* qmgr_index_delete - remove queue file */
+
+void    qmgr_index_delete(QMGR_INDEX *index, const char *queue_id)
+{
+    QMGR_INDEX_ENTRY *entry;
+
+    if ((entry = (QMGR_INDEX_ENTRY *) ohtable_find(index->table, queue_id)) != 0)
+	qmgr_index_remove(index, entry);
+}
+
+/* qmgr_index_next - remove and return earliest queue file */
+
+const char *qmgr_index_next(QMGR_INDEX *index, time_t deadline)
+{
+    QMGR_INDEX_ENTRY *entry;
+
+    if (index->used == 0 || (entry = index->heap[0])->when > deadline)
+	return (0);
+    vstring_strcpy(index->result, entry->queue_id);
+    qmgr_index_remove(index, entry);
+    return (vstring_str(index->result));
+}
+
+/* qmgr_index_reset - remove all queue files */
+
+void    qmgr_index_reset(QMGR_INDEX *index)
+{
+    ohtable_free(index->table, myfree);
+    index->table = ohtable_create(QMGR_INDEX_INIT_SIZE);
+    index->used = 0;
+}
@@ -67,7 +67,7 @@
 /* Utility library. */
 
 #include <msg.h>
-#include <htable.h>
+#include <ohtable.h>
 #include <mymalloc.h>
 #include <sane_time.h>
 
@@ -104,7 +104,7 @@ static QMGR_JOB *qmgr_job_create(QMGR_MESSAGE *message, QMGR_TRANSPORT *transpor
     job = (QMGR_JOB *) mymalloc(sizeof(QMGR_JOB));
     job->message = message;
     QMGR_LIST_APPEND(message->job_list, job, message_peers);
-    htable_enter(transport->job_byname, message->queue_id, (void *) job);
+    ohtable_enter(transport->job_byname, message->queue_id, (void *) job);
     job->transport = transport;
     QMGR_LIST_INIT(job->transport_peers);
     QMGR_LIST_INIT(job->time_peers);
@@ -113,7 +113,7 @@ static QMGR_JOB *qmgr_job_create(QMGR_MESSAGE *message, QMGR_TRANSPORT *transpor
     QMGR_LIST_INIT(job->stack_siblings);
     job->stack_level = -1;
     job->blocker_tag = 0;
-    job->peer_byname = htable_create(0);
+    job->peer_byname = ohtable_create(0);
     QMGR_LIST_INIT(job->peer_list);
     job->slots_used = 0;
     job->slots_available = 0;
@@ -238,7 +238,8 @@ static QMGR_JOB *qmgr_job_find(QMGR_MESSAGE *message, QMGR_TRANSPORT *transport)
      * usage) than having single hash table (usually almost empty) for each
      * message.
      */
-    return ((QMGR_JOB *) htable_find(transport->job_byname, message->queue_id));
+    return ((QMGR_JOB *) ohtable_find(transport->job_byname,
+				      message->queue_id));
 }
 
 /* qmgr_job_obtain - find/create the appropriate job and make it ready for new recipients */
@@ -444,8 +445,9 @@ void    qmgr_job_free(QMGR_JOB *job)
     if (job->stack_level >= 0)
 	qmgr_job_unlink(job);
     QMGR_LIST_UNLINK(message->job_list, QMGR_JOB *, job, message_peers);
-    htable_delete(transport->job_byname, message->queue_id, (void (*) (void *)) 0);
-    htable_free(job->peer_byname, (void (*) (void *)) 0);
+    ohtable_delete(transport->job_byname, message->queue_id,
+		   (void (*) (void *)) 0);
+    ohtable_free(job->peer_byname, (void (*) (void *)) 0);
     myfree((void *) job);
 }
 
@@ -66,7 +66,7 @@
 /* Utility library. */
 
 #include <msg.h>
-#include <htable.h>
+#include <ohtable.h>
 #include <mymalloc.h>
 
 /* Application-specific. */
@@ -83,7 +83,7 @@ QMGR_PEER *qmgr_peer_create(QMGR_JOB *job, QMGR_QUEUE *queue)
     peer->queue = queue;
     peer->job = job;
     QMGR_LIST_APPEND(job->peer_list, peer, peers);
-    htable_enter(job->peer_byname, queue->name, (void *) peer);
+    ohtable_enter(job->peer_byname, queue->name, (void *) peer);
     peer->refcount = 0;
     QMGR_LIST_INIT(peer->entry_list);
     return (peer);
@@ -106,7 +106,7 @@ void    qmgr_peer_free(QMGR_PEER *peer)
 	msg_panic("%s: entry list not empty: %s", myname, queue->name);
 
     QMGR_LIST_UNLINK(job->peer_list, QMGR_PEER *, peer, peers);
-    htable_delete(job->peer_byname, queue->name, (void (*) (void *)) 0);
+    ohtable_delete(job->peer_byname, queue->name, (void (*) (void *)) 0);
     myfree((void *) peer);
 }
 
@@ -114,7 +114,7 @@ void    qmgr_peer_free(QMGR_PEER *peer)
 
 QMGR_PEER *qmgr_peer_find(QMGR_JOB *job, QMGR_QUEUE *queue)
 {
-    return ((QMGR_PEER *) htable_find(job->peer_byname, queue->name));
+    return ((QMGR_PEER *) ohtable_find(job->peer_byname, queue->name));
 }
 
 /* qmgr_peer_obtain - find/create peer associated with given job and queue */
@@ -103,7 +103,7 @@
 #include <msg.h>
 #include <mymalloc.h>
 #include <events.h>
-#include <htable.h>
+#include <ohtable.h>
 
 /* Global library. */
 
@@ -391,7 +391,8 @@ void    qmgr_queue_done(QMGR_QUEUE *queue)
      * Clean up this in-core queue.
      */
     QMGR_LIST_UNLINK(transport->queue_list, QMGR_QUEUE *, queue, peers);
-    htable_delete(transport->queue_byname, queue->name, (void (*) (void *)) 0);
+    ohtable_delete(transport->queue_byname, queue->name,
+		   (void (*) (void *)) 0);
     myfree(queue->name);
     myfree(queue->nexthop);
     qmgr_queue_count--;
@@ -427,7 +428,7 @@ QMGR_QUEUE *qmgr_queue_create(QMGR_TRANSPORT *transport, const char *name,
     queue->clog_time_to_warn = 0;
     queue->blocker_tag = 0;
     QMGR_LIST_APPEND(transport->queue_list, queue, peers);
-    htable_enter(transport->queue_byname, name, (void *) queue);
+    ohtable_enter(transport->queue_byname, name, (void *) queue);
     return (queue);
 }
 
@@ -435,5 +436,5 @@ QMGR_QUEUE *qmgr_queue_create(QMGR_TRANSPORT *transport, const char *name,
 
 QMGR_QUEUE *qmgr_queue_find(QMGR_TRANSPORT *transport, const char *name)
 {
-    return ((QMGR_QUEUE *) htable_find(transport->queue_byname, name));
+    return ((QMGR_QUEUE *) ohtable_find(transport->queue_byname, name));
 }
@@ -6,8 +6,9 @@
 /* SYNOPSIS
 /*	#include "qmgr.h"
 /*
-/*	QMGR_SCAN *qmgr_scan_create(queue_name)
+/*	QMGR_SCAN *qmgr_scan_create(queue_name, index)
 /*	const char *queue_name;
+/*	QMGR_INDEX *index;
 /*
 /*	char	*qmgr_scan_next(scan_info)
 /*	QMGR_SCAN *scan_info;
@@ -21,7 +22,15 @@
 /*	can request that a queue scan be restarted once it completes.
 /*
 /*	qmgr_scan_create() creates a context for scanning the named queue,
-/*	but does not start a queue scan.
+/*	but does not start a queue scan. The index argument is a null
+/*	pointer, or an index of the queue (see qmgr_index(3)).
+/*
+/*	With an index, the first queue scan reads the queue directory,
+/*	and the caller adds the queue files that are not yet due to
+/*	the index. When that scan has completed, a queue scan takes
+/*	only the queue files that are due from the index, unless
+/*	the scan request specifies QMGR_SCAN_ALL or QMGR_SCAN_DIR.
+/*	A directory scan rebuilds the index.
 /*
 /*	qmgr_scan_next() returns the base name of the next queue file.
 /*	A null pointer means that no file was found. qmgr_scan_next()
@@ -45,6 +54,9 @@
 /* .IP QMGR_SCAN_START
 /*	Start a queue scan when none is in progress, or restart the
 /*	current scan upon completion.
+/* .IP QMGR_SCAN_DIR
+/*	Read the queue directory instead of the index. This affects
+/*	the next queue scan.
 /* DIAGNOSTICS
 /*	Fatal: out of memory.
 /*	Panic: interface violations, internal consistency errors.
@@ -68,6 +80,7 @@
 #include <msg.h>
 #include <mymalloc.h>
 #include <scan_dir.h>
+#include <events.h>
 
 /* Global library. */
 
@@ -86,24 +99,48 @@ static void qmgr_scan_start(QMGR_SCAN *scan_info)
     /*
      * Sanity check.
      */
-    if (scan_info->handle)
+    if (QMGR_SCAN_BUSY(scan_info))
 	msg_panic("%s: %s queue scan in progress",
 		  myname, scan_info->queue);
 
+    /*
+     * Start or restart the scan.
+     */
+    scan_info->flags = scan_info->nflags;
+    scan_info->nflags = 0;
+
+    /*
+     * Take the queue files that are due from the index. Allow for the same
+     * one-second slack as qmgr_active_feed(). Queue files that are deferred
+     * during this scan have later wakeup times, so the scan terminates.
+     */
+    if (scan_info->index_ready
+	&& (scan_info->flags & (QMGR_SCAN_ALL | QMGR_SCAN_DIR)) == 0) {
+	if (msg_verbose)
+	    msg_info("%s: %sstart %s queue index scan (%ld files)",
+		     myname,
+		     scan_info->flags & QMGR_SCAN_START ? "re" : "",
+		     scan_info->queue,
+		     (long) QMGR_INDEX_COUNT(scan_info->index));
+	scan_info->index_scan = 1;
+	scan_info->index_deadline = event_time() + 1;
+	return;
+    }
+
     /*
      * Give the poor tester a clue.
      */
     if (msg_verbose)
 	msg_info("%s: %sstart %s queue scan",
 		 myname,
-		 scan_info->nflags & QMGR_SCAN_START ? "re" : "",
+		 scan_info->flags & QMGR_SCAN_START ? "re" : "",
 		 scan_info->queue);
 
     /*
-     * Start or restart the scan.
+     * A directory scan finds all queue files, so start the index over.
      */
-    scan_info->flags = scan_info->nflags;
-    scan_info->nflags = 0;
+    if (scan_info->index)
+	qmgr_index_reset(scan_info->index);
     scan_info->handle = scan_dir_open(scan_info->queue);
 }
 
@@ -129,26 +166,56 @@ void    qmgr_scan_request(QMGR_SCAN *scan_info, int flags)
      * Apply "ignore time stamp" requests also towards the scan that is
      * already in progress.
      */
-    if (scan_info->handle != 0 && (flags & QMGR_SCAN_ALL))
+    if (QMGR_SCAN_BUSY(scan_info) && (flags & QMGR_SCAN_ALL))
 	scan_info->flags |= QMGR_SCAN_ALL;
 
     /*
      * Apply "override defer_transports" requests also towards the scan that
      * is already in progress.
      */
-    if (scan_info->handle != 0 && (flags & QMGR_FLUSH_DFXP))
+    if (QMGR_SCAN_BUSY(scan_info) && (flags & QMGR_FLUSH_DFXP))
 	scan_info->flags |= QMGR_FLUSH_DFXP;
 
     /*
      * If a scan is in progress, just record the request.
      */
     scan_info->nflags |= flags;
-    if (scan_info->handle == 0 && (flags & QMGR_SCAN_START) != 0) {
+    if (!QMGR_SCAN_BUSY(scan_info) && (flags & QMGR_SCAN_START) != 0) {
 	scan_info->nflags &= ~QMGR_SCAN_START;
 	qmgr_scan_start(scan_info);
     }
 }
 
+/* qmgr_scan_next_file - look for next queue file in this scan */
+
+static char *qmgr_scan_next_file(QMGR_SCAN *scan_info)
+{
+    char   *path = 0;
+
+    if (scan_info->index_scan) {
+	if ((path = (char *) qmgr_index_next(scan_info->index,
+					  scan_info->index_deadline)) == 0) {
+	    scan_info->index_scan = 0;
+	    if (msg_verbose && (scan_info->nflags & QMGR_SCAN_START) == 0)
+		msg_info("done %s queue index scan", scan_info->queue);
+	}
+    } else if (scan_info->handle) {
+	if ((path = mail_scan_dir_next(scan_info->handle)) == 0) {
+	    scan_info->handle = scan_dir_close(scan_info->handle);
+	    if (scan_info->index) {
+		scan_info->index_ready = 1;
+		if (msg_verbose)
+		    msg_info("%s queue index: %ld files",
+			     scan_info->queue,
+			     (long) QMGR_INDEX_COUNT(scan_info->index));
+	    }
+	    if (msg_verbose && (scan_info->nflags & QMGR_SCAN_START) == 0)
+		msg_info("done %s queue scan", scan_info->queue);
+	}
+    }
+    return (path);
+}
+
 /* qmgr_scan_next - look for next queue file */
 
 char   *qmgr_scan_next(QMGR_SCAN *scan_info)
@@ -159,21 +226,18 @@ char   *qmgr_scan_next(QMGR_SCAN *scan_info)
      * Restart the scan if we reach the end and a queue scan request has
      * arrived in the mean time.
      */
-    if (scan_info->handle && (path = mail_scan_dir_next(scan_info->handle)) == 0) {
-	scan_info->handle = scan_dir_close(scan_info->handle);
-	if (msg_verbose && (scan_info->nflags & QMGR_SCAN_START) == 0)
-	    msg_info("done %s queue scan", scan_info->queue);
-    }
-    if (!scan_info->handle && (scan_info->nflags & QMGR_SCAN_START)) {
+    if (QMGR_SCAN_BUSY(scan_info))
+	path = qmgr_scan_next_file(scan_info);
+    if (!QMGR_SCAN_BUSY(scan_info) && (scan_info->nflags & QMGR_SCAN_START)) {
 	qmgr_scan_start(scan_info);
-	path = mail_scan_dir_next(scan_info->handle);
+	path = qmgr_scan_next_file(scan_info);
     }
     return (path);
 }
 
 /* qmgr_scan_create - create queue scan context */
 
-QMGR_SCAN *qmgr_scan_create(const char *queue)
+QMGR_SCAN *qmgr_scan_create(const char *queue, QMGR_INDEX *index)
 {
     QMGR_SCAN *scan_info;
 
@@ -181,5 +245,9 @@ QMGR_SCAN *qmgr_scan_create(const char *queue)
     scan_info->queue = mystrdup(queue);
     scan_info->flags = scan_info->nflags = 0;
     scan_info->handle = 0;
+    scan_info->index = index;
+    scan_info->index_ready = 0;
+    scan_info->index_scan = 0;
+    scan_info->index_deadline = 0;
     return (scan_info);
 }
@@ -92,7 +92,7 @@
 /* Utility library. */
 
 #include <msg.h>
-#include <htable.h>
+#include <ohtable.h>
 #include <events.h>
 #include <mymalloc.h>
 #include <vstream.h>
@@ -109,7 +109,7 @@
 
 #include "qmgr.h"
 
-HTABLE *qmgr_transport_byname;		/* transport by name */
+OHTABLE *qmgr_transport_byname;		/* transport by name */
 QMGR_TRANSPORT_LIST qmgr_transport_list;/* transports, round robin */
 
  /*
@@ -416,7 +416,7 @@ QMGR_TRANSPORT *qmgr_transport_create(const char *name)
 {
     QMGR_TRANSPORT *transport;
 
-    if (htable_find(qmgr_transport_byname, name) != 0)
+    if (ohtable_find(qmgr_transport_byname, name) != 0)
 	msg_panic("qmgr_transport_create: transport exists: %s", name);
     transport = (QMGR_TRANSPORT *) mymalloc(sizeof(QMGR_TRANSPORT));
     transport->flags = 0;
@@ -466,9 +466,9 @@ QMGR_TRANSPORT *qmgr_transport_create(const char *name)
     transport->refill_delay = get_mail_conf_time2(name, _XPORT_REFILL_DELAY,
 					 var_xport_refill_delay, 's', 1, 0);
 
-    transport->queue_byname = htable_create(0);
+    transport->queue_byname = ohtable_create(0);
     QMGR_LIST_INIT(transport->queue_list);
-    transport->job_byname = htable_create(0);
+    transport->job_byname = ohtable_create(0);
     QMGR_LIST_INIT(transport->job_list);
     QMGR_LIST_INIT(transport->job_bytime);
     transport->job_current = 0;
@@ -486,8 +486,8 @@ QMGR_TRANSPORT *qmgr_transport_create(const char *name)
 	get_mail_conf_int2(name, _CONC_COHORT_LIM,
 			   var_conc_cohort_limit, 0, 0);
     if (qmgr_transport_byname == 0)
-	qmgr_transport_byname = htable_create(10);
-    htable_enter(qmgr_transport_byname, name, (void *) transport);
+	qmgr_transport_byname = ohtable_create(10);
+    ohtable_enter(qmgr_transport_byname, name, (void *) transport);
     QMGR_LIST_PREPEND(qmgr_transport_list, transport, peers);
     if (msg_verbose)
 	msg_info("qmgr_transport_create: %s concurrency %d recipients %d",
@@ -500,5 +500,5 @@ QMGR_TRANSPORT *qmgr_transport_create(const char *name)
 
 QMGR_TRANSPORT *qmgr_transport_find(const char *name)
 {
-    return ((QMGR_TRANSPORT *) htable_find(qmgr_transport_byname, name));
+    return ((QMGR_TRANSPORT *) ohtable_find(qmgr_transport_byname, name));
 }
@@ -35,6 +35,11 @@
 /*	The connection cache daemon terminates when no client is
 /*	connected for \fBmax_idle\fR time units.
 /*
+/*	Multiple \fBscache\fR(8) services may be configured in
+/*	master.cf, each with its own process. Clients then select
+/*	a service by logical destination name; see the
+/*	\fBconnection_cache_service_name\fR parameter.
+/*
 /*	This server implements the following requests:
 /* .IP "\fBsave_endp\fI ttl endpoint endpoint_properties file_descriptor\fR"
 /*	Save the specified file descriptor and connection property data
@@ -88,7 +93,8 @@
 /* .IP "\fBconnection_cache_status_update_time (600s)\fR"
 /*	How frequently the \fBscache\fR(8) server logs usage statistics with
 /*	connection cache hit and miss rates for logical destinations and for
-/*	physical endpoints.
+/*	physical endpoints, and a histogram of the time that connections
+/*	were cached before they were reused.
 /* MISCELLANEOUS CONTROLS
 /* .ad
 /* .fi
@@ -147,11 +153,13 @@
 /* System library. */
 
 #include <sys_defs.h>
+#include <sys/time.h>
 #include <time.h>
 
 /* Utility library. */
 
 #include <msg.h>
+#include <mymalloc.h>
 #include <iostuff.h>
 #include <htable.h>
 #include <ring.h>
@@ -206,14 +214,66 @@ static int scache_endp_hits;
 static int scache_endp_miss;
 static int scache_endp_count;
 static int scache_sess_count;
+static int scache_sess_saves;
 time_t  scache_start_time;
 
+ /*
+  * Reuse age histogram: how long a session was cached before a client took
+  * it. The save time is looked up by file descriptor number, which is
+  * unique while a session is cached.
+  */
+static struct timeval *scache_save_time;
+static int scache_save_time_len;
+
+static const int scache_age_limit[] = {10, 100, 1000, 10000};	/* ms */
+
+#define SCACHE_AGE_BUCKETS \
+	(sizeof(scache_age_limit) / sizeof(scache_age_limit[0]) + 1)
+
+static int scache_age_hist[SCACHE_AGE_BUCKETS];
+
  /*
   * Silly little macros.
   */
 #define STR(x)			vstring_str(x)
 #define VSTREQ(x,y)		(strcmp(STR(x),y) == 0)
 
+/* scache_age_save - remember when session was saved */
+
+static void scache_age_save(int fd)
+{
+    int     new_len;
+
+    if (fd >= scache_save_time_len) {
+	new_len = (fd + 1) * 2;
+	scache_save_time = (struct timeval *)
+	    myrealloc((void *) scache_save_time,
+		      new_len * sizeof(*scache_save_time));
+	scache_save_time_len = new_len;
+    }
+    GETTIMEOFDAY(scache_save_time + fd);
+    scache_sess_saves++;
+}
+
+/* scache_age_reuse - update reuse age histogram */
+
+static void scache_age_reuse(int fd)
+{
+    struct timeval now;
+    long    age;
+    int     n;
+
+    if (fd >= scache_save_time_len)
+	return;
+    GETTIMEOFDAY(&now);
+    age = (now.tv_sec - scache_save_time[fd].tv_sec) * 1000
+	+ (now.tv_usec - scache_save_time[fd].tv_usec) / 1000;
+    for (n = 0; n < SCACHE_AGE_BUCKETS - 1; n++)
+	if (age < scache_age_limit[n])
+	    break;
+    scache_age_hist[n]++;
+}
+
 /* scache_save_endp_service - protocol to save endpoint->stream binding */
 
 static void scache_save_endp_service(VSTREAM *client_stream)
@@ -252,6 +312,7 @@ static void scache_save_endp_service(VSTREAM *client_stream)
 			  ATTR_TYPE_END);
 	return;
     } else {
+	scache_age_save(fd);
 	scache_save_endp(scache,
 			 ttl > var_scache_ttl_lim ? var_scache_ttl_lim : ttl,
 			 STR(scache_endp_label), STR(scache_endp_prop), fd);
@@ -311,6 +372,7 @@ static void scache_find_endp_service(VSTREAM *client_stream)
 #endif
 	    )
 	    msg_warn("%s: cannot send file descriptor: %m", myname);
+	scache_age_reuse(fd);
 	if (close(fd) < 0)
 	    msg_warn("close(%d): %m", fd);
 	scache_endp_hits++;
@@ -404,6 +466,7 @@ static void scache_find_dest_service(VSTREAM *client_stream)
 #endif
 	    )
 	    msg_warn("%s: cannot send file descriptor: %m", myname);
+	scache_age_reuse(fd);
 	if (close(fd) < 0)
 	    msg_warn("close(%d): %m", fd);
 	scache_dest_hits++;
@@ -434,7 +497,13 @@ static void scache_service(VSTREAM *client_stream, char *unused_service,
      * request from the same client. The do-while loop below will repeat
      * instead of discarding the client request. We must process it now
      * because there will be no select() notification.
+     *
+     * The same loop handles the back-to-back save_dest and save_endp
+     * requests from scache_clnt(3). A single-buffered stream discards
+     * unread input when it changes from reading to writing, so we make the
+     * stream double-buffered before the first reply is sent.
      */
+    vstream_control(client_stream, CA_VSTREAM_CTL_DOUBLE, CA_VSTREAM_CTL_END);
     do {
 	if (attr_scan(client_stream,
 		      ATTR_FLAG_MORE | ATTR_FLAG_STRICT,
@@ -464,10 +533,12 @@ static void scache_service(VSTREAM *client_stream, char *unused_service,
 
 static void scache_status_dump(char *unused_name, char **unused_argv)
 {
+    int     n;
+
     if (scache_dest_hits || scache_dest_miss
 	|| scache_endp_hits || scache_endp_miss
 	|| scache_dest_count || scache_endp_count
-	|| scache_sess_count)
+	|| scache_sess_count || scache_sess_saves)
 	msg_info("statistics: start interval %.15s",
 		 ctime(&scache_start_time) + 4);
 
@@ -485,6 +556,15 @@ static void scache_status_dump(char *unused_name, char **unused_argv)
 		 / (scache_endp_hits + scache_endp_miss));
 	scache_endp_hits = scache_endp_miss = 0;
     }
+    if (scache_sess_saves) {
+	msg_info("statistics: connections saved=%d reuse age"
+		 " <10ms=%d <100ms=%d <1s=%d <10s=%d >=10s=%d",
+		 scache_sess_saves, scache_age_hist[0], scache_age_hist[1],
+		 scache_age_hist[2], scache_age_hist[3], scache_age_hist[4]);
+	scache_sess_saves = 0;
+	for (n = 0; n < SCACHE_AGE_BUCKETS; n++)
+	    scache_age_hist[n] = 0;
+    }
     if (scache_dest_count || scache_endp_count || scache_sess_count) {
 	msg_info("statistics: max simultaneous domains=%d addresses=%d connection=%d",
 		 scache_dest_count, scache_endp_count, scache_sess_count);
@@ -521,6 +601,9 @@ static void post_jail_init(char *unused_name, char **unused_argv)
     scache_dest_prop = vstring_alloc(10);
     scache_endp_label = vstring_alloc(10);
     scache_endp_prop = vstring_alloc(10);
+    scache_save_time_len = 100;
+    scache_save_time = (struct timeval *)
+	mymalloc(scache_save_time_len * sizeof(*scache_save_time));
 #ifdef CANT_WRITE_BEFORE_SENDING_FD
     scache_dummy = vstring_alloc(10);
 #endif
@@ -121,5 +121,7 @@
 	VAR_LMTP_ASSUME_FINAL, DEF_LMTP_ASSUME_FINAL, &var_lmtp_assume_final,
 	VAR_LMTP_REC_DEADLINE, DEF_LMTP_REC_DEADLINE, &var_smtp_rec_deadline,
 	VAR_LMTP_DUMMY_MAIL_AUTH, DEF_LMTP_DUMMY_MAIL_AUTH, &var_smtp_dummy_mail_auth,
+	VAR_LMTP_MAP_CONTENT, DEF_LMTP_MAP_CONTENT, &var_smtp_map_content,
+	VAR_LMTP_CHUNKING, DEF_LMTP_CHUNKING, &var_smtp_chunking,
 	0,
     };
@@ -91,6 +91,7 @@
 /*	RFC 2554 (AUTH command)
 /*	RFC 2821 (SMTP protocol)
 /*	RFC 2920 (SMTP Pipelining)
+/*	RFC 3030 (CHUNKING and BDAT command)
 /*	RFC 3207 (STARTTLS command)
 /*	RFC 3461 (SMTP DSN Extension)
 /*	RFC 3463 (Enhanced Status Codes)
@@ -263,6 +264,22 @@
 /*	deliveries.
 /* .IP "\fBsmtp_dns_reply_filter (empty)\fR"
 /*	Optional filter for Postfix SMTP client DNS lookup results.
+/* .PP
+/*	Available in Postfix version 3.2 and later:
+/* .IP "\fBdns_parallel_lookup_enable (no)\fR"
+/*	Send the DNS queries for different record types or MX hosts
+/*	at the same time, instead of one after the other.
+/* .IP "\fBsmtp_mapped_content_enable (yes)\fR"
+/*	Send message content from a memory mapping of the queue file,
+/*	instead of copying each record through a buffer, when no content
+/*	conversion or inspection is needed.
+/* .IP "\fBsmtp_chunking_enable (yes)\fR"
+/*	Send message content with the BDAT command instead of DATA,
+/*	when the remote SMTP server announces CHUNKING support and no
+/*	content conversion or inspection is needed.
+/* .IP "\fBtransfer_rate_logging_enable (no)\fR"
+/*	Log the message content transfer rate, as "rate=\fInumber\fRB/s",
+/*	when a message is delivered.
 /* MIME PROCESSING CONTROLS
 /* .ad
 /* .fi
@@ -932,6 +949,8 @@ char   *var_smtp_dns_res_opt;
 char   *var_smtp_dns_support;
 bool    var_smtp_rec_deadline;
 bool    var_smtp_dummy_mail_auth;
+bool    var_smtp_map_content;
+bool    var_smtp_chunking;
 char   *var_smtp_dsn_filter;
 char   *var_smtp_dns_re_filter;
 
@@ -1113,17 +1132,25 @@ static void post_init(char *unused_name, char **unused_argv)
 			       smtp_host_lookup_mask));
 
     /*
-     * Session cache instance.
+     * Session cache instance. With multiple cache service names, spread the
+     * cached sessions over those services by destination.
      */
-    if (*var_smtp_cache_dest || var_smtp_cache_demand)
+    if (*var_smtp_cache_dest || var_smtp_cache_demand) {
 #if 0
 	smtp_scache = scache_multi_create();
 #else
-	smtp_scache = scache_clnt_create(var_scache_service,
-					 var_scache_proto_tmout,
-					 var_ipc_idle_limit,
-					 var_ipc_ttl_limit);
+	if (strpbrk(var_scache_service, CHARS_COMMA_SP) == 0)
+	    smtp_scache = scache_clnt_create(var_scache_service,
+					     var_scache_proto_tmout,
+					     var_ipc_idle_limit,
+					     var_ipc_ttl_limit);
+	else
+	    smtp_scache = scache_shard_create(var_scache_service,
+					      var_scache_proto_tmout,
+					      var_ipc_idle_limit,
+					      var_ipc_ttl_limit);
 #endif
+    }
 
     /*
      * Select DNS query flags.
@@ -1302,6 +1329,13 @@ static void pre_init(char *unused_name, char **unused_argv)
     if (*var_smtp_dns_re_filter)
 	dns_rr_filter_compile(VAR_LMTP_SMTP(DNS_RE_FILTER),
 			      var_smtp_dns_re_filter);
+
+    /*
+     * Parallel DNS lookups. Open the random source before entering the
+     * chroot jail.
+     */
+    if (var_dns_parallel)
+	(void) dns_async_init();
 }
 
 /* pre_accept - see if tables have changed */
@@ -248,6 +248,7 @@ static DNS_RR *smtp_addr_list(DNS_RR *mx_names, DSN_BUF *why)
     DNS_RR *addr_list = 0;
     DNS_RR *rr;
     int     res_opt = 0;
+    int     prefetched = 0;
 
     if (mx_names->dnssec_valid)
 	res_opt = RES_USE_DNSSEC;
@@ -277,12 +278,30 @@ static DNS_RR *smtp_addr_list(DNS_RR *mx_names, DSN_BUF *why)
      * (NIS server, nscd), so we can't even reliably turn this off by
      * tweaking the in-process resolver flags.
      */
+
+    /*
+     * Send the address queries for all mail exchangers at once, so that we
+     * wait for the slowest reply instead of the sum of all replies.
+     * smtp_addr_one() picks up the results in MX preference order.
+     */
+    if ((smtp_host_lookup_mask & SMTP_HOST_FLAG_DNS) && mx_names->next) {
+	for (rr = mx_names; rr; rr = rr->next)
+	    if (rr->type == T_MX)
+		prefetched += dns_async_prefetch((char *) rr->data,
+						 res_opt | smtp_dns_res_opt,
+						 DNS_REQ_FLAG_NONE,
+					 inet_proto_info()->dns_atype_list);
+	if (prefetched)
+	    dns_async_wait();
+    }
     for (rr = mx_names; rr; rr = rr->next) {
 	if (rr->type != T_MX)
 	    msg_panic("smtp_addr_list: bad resource type: %d", rr->type);
 	addr_list = smtp_addr_one(addr_list, (char *) rr->data, res_opt,
 				  rr->pref, why);
     }
+    if (prefetched)
+	dns_async_flush((char *) 0);
     return (addr_list);
 }
 
@@ -125,5 +125,7 @@
 	VAR_LMTP_ASSUME_FINAL, DEF_LMTP_ASSUME_FINAL, &var_lmtp_assume_final,
 	VAR_SMTP_REC_DEADLINE, DEF_SMTP_REC_DEADLINE, &var_smtp_rec_deadline,
 	VAR_SMTP_DUMMY_MAIL_AUTH, DEF_SMTP_DUMMY_MAIL_AUTH, &var_smtp_dummy_mail_auth,
+	VAR_SMTP_MAP_CONTENT, DEF_SMTP_MAP_CONTENT, &var_smtp_map_content,
+	VAR_SMTP_CHUNKING, DEF_SMTP_CHUNKING, &var_smtp_chunking,
 	0,
     };
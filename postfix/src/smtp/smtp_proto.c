@@ -133,6 +133,7 @@
 #include <bounce.h>
 #include <record.h>
 #include <rec_type.h>
+#include <rec_map.h>
 #include <off_cvt.h>
 #include <mark_corrupt.h>
 #include <quote_821_local.h>
@@ -245,6 +246,20 @@ char   *xfer_request[SMTP_STATE_LAST] = {
      && (session->features & SMTP_FEATURE_8BITMIME) == 0 \
      && strcmp(request->encoding, MAIL_ATTR_ENC_7BIT) != 0)
 
+ /*
+  * The BDAT command announces the content size before the content is sent.
+  * We know that size only when the content is sent as stored in the queue
+  * file, without MIME downgrading, address rewriting or header/body checks.
+  * Address probes need the DATA command as protocol stage.
+  */
+#define SMTP_CHUNKING(session, request) \
+    (var_smtp_chunking \
+     && ((session)->features & SMTP_FEATURE_CHUNKING) != 0 \
+     && !SMTP_MIME_DOWNGRADE((session), (request)) \
+     && smtp_generic_maps == 0 \
+     && smtp_header_checks == 0 && smtp_body_checks == 0 \
+     && !DEL_REQ_TRACE_ONLY((request)->flags))
+
 #ifdef USE_TLS
 
 static int smtp_start_tls(SMTP_STATE *);
@@ -258,6 +273,9 @@ static int smtp_start_tls(SMTP_STATE *);
 static void smtp_hbc_logger(void *, const char *, const char *, const char *, const char *);
 static void smtp_text_out(void *, int, const char *, ssize_t, off_t);
 
+#define SMTP_TEXT_FLAG_NONE	0
+#define SMTP_TEXT_FLAG_DOT	(1<<0)	/* dot-stuff lines */
+
 HBC_CALL_BACKS smtp_hbc_callbacks[1] = {
     smtp_hbc_logger,
     smtp_text_out,
@@ -592,6 +610,9 @@ int     smtp_helo(SMTP_STATE *state)
 		} else if (strcasecmp(word, "SMTPUTF8") == 0) {
 		    if ((discard_mask & EHLO_MASK_SMTPUTF8) == 0)
 			session->features |= SMTP_FEATURE_SMTPUTF8;
+		} else if (strcasecmp(word, "CHUNKING") == 0) {
+		    if ((discard_mask & EHLO_MASK_CHUNKING) == 0)
+			session->features |= SMTP_FEATURE_CHUNKING;
 		}
 		n++;
 	    }
@@ -1003,16 +1024,15 @@ static void smtp_hbc_logger(void *context, const char *action,
     }
 }
 
-/* smtp_text_out - output one header/body record */
+/* smtp_text_emit - output or measure one header/body record */
 
-static void smtp_text_out(void *context, int rec_type,
-			          const char *text, ssize_t len,
-			          off_t unused_offset)
+static ssize_t smtp_text_emit(SMTP_STATE *state, int rec_type,
+			              const char *text, ssize_t len,
+			              VSTREAM *stream, int flags)
 {
-    SMTP_STATE *state = (SMTP_STATE *) context;
-    SMTP_SESSION *session = state->session;
     ssize_t data_left;
     const char *data_start;
+    ssize_t count = 0;
 
     /*
      * Deal with an impedance mismatch between Postfix queue files (record
@@ -1020,33 +1040,108 @@ static void smtp_text_out(void *context, int rec_type,
      * $smtp_line_length_limit). The code below does a little too much work
      * when the SMTP line length limit is disabled, but it avoids code
      * duplication, and thus, it avoids testing and maintenance problems.
+     * 
+     * With a null stream, only count the bytes that would be sent, so that
+     * BDAT can announce the content size before sending the content. BDAT
+     * content is not dot-stuffed.
      */
+#define EMIT(stmt, n) do { \
+	if (stream) \
+	    stmt; \
+	count += (n); \
+    } while (0)
+
     data_left = len;
     data_start = text;
     do {
-	if (state->space_left == var_smtp_line_limit
+	if ((flags & SMTP_TEXT_FLAG_DOT) != 0
+	    && state->space_left == var_smtp_line_limit
 	    && data_left > 0 && *data_start == '.')
-	    smtp_fputc('.', session->stream);
+	    EMIT(smtp_fputc('.', stream), 1);
 	if (var_smtp_line_limit > 0 && data_left >= state->space_left) {
-	    smtp_fputs(data_start, state->space_left, session->stream);
+	    EMIT(smtp_fputs(data_start, state->space_left, stream),
+		 state->space_left + 2);
 	    data_start += state->space_left;
 	    data_left -= state->space_left;
 	    state->space_left = var_smtp_line_limit;
 	    if (data_left > 0 || rec_type == REC_TYPE_CONT) {
-		smtp_fputc(' ', session->stream);
+		EMIT(smtp_fputc(' ', stream), 1);
 		state->space_left -= 1;
 	    }
 	} else {
 	    if (rec_type == REC_TYPE_CONT) {
-		smtp_fwrite(data_start, data_left, session->stream);
+		EMIT(smtp_fwrite(data_start, data_left, stream), data_left);
 		state->space_left -= data_left;
 	    } else {
-		smtp_fputs(data_start, data_left, session->stream);
+		EMIT(smtp_fputs(data_start, data_left, stream), data_left + 2);
 		state->space_left = var_smtp_line_limit;
 	    }
 	    break;
 	}
     } while (data_left > 0);
+    return (count);
+}
+
+/* smtp_text_out - output one header/body record */
+
+static void smtp_text_out(void *context, int rec_type,
+			          const char *text, ssize_t len,
+			          off_t unused_offset)
+{
+    SMTP_STATE *state = (SMTP_STATE *) context;
+
+    state->request->msg_stats.data_bytes +=
+	smtp_text_emit(state, rec_type, text, len, state->session->stream,
+		       SMTP_TEXT_FLAG_DOT);
+}
+
+/* smtp_text_size - compute BDAT size of unmodified message content */
+
+static off_t smtp_text_size(SMTP_STATE *state, REC_MAP *map)
+{
+    DELIVER_REQUEST *request = state->request;
+    SMTP_SESSION *session = state->session;
+    const char *data;
+    ssize_t len;
+    int     rec_type;
+    int     prev_type = 0;
+    off_t   size = 0;
+
+    /*
+     * Mirror the content loop in smtp_loop(), including the check for the
+     * record that ends the message content. The server accepts the message
+     * as soon as it has received the announced number of bytes, so a
+     * malformed record must be found before BDAT is sent, not after.
+     */
+    if (map == 0
+	&& vstream_fseek(state->src, request->data_offset, SEEK_SET) < 0)
+	msg_fatal("seek queue file: %m");
+    state->space_left = var_smtp_line_limit;
+    for (;;) {
+	if (map != 0) {
+	    rec_type = rec_map_get(map, &data, &len);
+	} else if ((rec_type = rec_get(state->src, session->scratch, 0)) > 0) {
+	    data = vstring_str(session->scratch);
+	    len = VSTRING_LEN(session->scratch);
+	}
+	if (rec_type != REC_TYPE_NORM && rec_type != REC_TYPE_CONT)
+	    break;
+	size += smtp_text_emit(state, rec_type, data, len, (VSTREAM *) 0,
+			       SMTP_TEXT_FLAG_NONE);
+	prev_type = rec_type;
+    }
+    if (prev_type == REC_TYPE_CONT)		/* missing newline */
+	size += 2;
+    if (map != 0)
+	REC_MAP_REWIND(map);
+    else if (vstream_ferror(state->src))
+	msg_fatal("queue file read error");
+    if (rec_type != REC_TYPE_XTRA) {
+	msg_warn("%s: bad record type: %d in message content",
+		 request->queue_id, rec_type);
+	return (-1);
+    }
+    return (size);
 }
 
 /* smtp_format_out - output one header/body record */
@@ -1257,9 +1352,13 @@ static int smtp_loop(SMTP_STATE *state, NOCLOBBER int send_state,
     int     except;
     int     rec_type;
     NOCLOBBER int prev_type = 0;
+    REC_MAP *NOCLOBBER content_map = 0;
     NOCLOBBER int mail_from_rejected;
     NOCLOBBER int downgrading;
+    NOCLOBBER int chunking;
+    NOCLOBBER off_t bdat_size = 0;
     int     mime_errs;
+    int     text_flags;
     SMTP_RESP fake;
     int     fail_status;
 
@@ -1291,6 +1390,8 @@ static int smtp_loop(SMTP_STATE *state, NOCLOBBER int send_state,
 	    myfree((void *) survivors); \
 	if (session->mime_state) \
 	    session->mime_state = mime_state_free(session->mime_state); \
+	if (content_map) \
+	    content_map = rec_map_close(content_map); \
 	return (x); \
     } while (0)
 
@@ -1298,7 +1399,14 @@ static int smtp_loop(SMTP_STATE *state, NOCLOBBER int send_state,
 	(recv_state < send_state || recv_rcpt != send_rcpt)
 
 #define SENDER_IN_WAIT_STATE \
-	(send_state == SMTP_STATE_DOT || send_state == SMTP_STATE_LAST)
+	((send_state == SMTP_STATE_DOT && !PIPELINING_BDAT) \
+	 || send_state == SMTP_STATE_LAST)
+
+#define PIPELINING_BDAT \
+	(chunking && (session->features & SMTP_FEATURE_PIPELINING) != 0)
+
+#define DOT_REQUEST \
+	(chunking ? "BDAT command" : xfer_request[SMTP_STATE_DOT])
 
 #define SENDING_MAIL \
 	(recv_state <= SMTP_STATE_DOT)
@@ -1321,11 +1429,40 @@ static int smtp_loop(SMTP_STATE *state, NOCLOBBER int send_state,
      * receiver detects a serious problem (MAIL FROM rejected, all RCPT TO
      * commands rejected, DATA rejected) it forces the sender to abort the
      * SMTP dialog with RSET and QUIT.
+     * 
+     * With BDAT, the content is sent together with the command, and there
+     * is no DATA command. If the server supports PIPELINING, the sender may
+     * send BDAT before the receiver has seen the RCPT TO responses; if all
+     * recipients were rejected, the server discards the content.
      */
+    chunking = SMTP_CHUNKING(session, request);
     nrcpt = 0;
     next_rcpt = send_rcpt = recv_rcpt = recv_done = 0;
     mail_from_rejected = 0;
 
+    /*
+     * With DATA, a corrupt queue file is detected while the content is sent,
+     * and the transaction is aborted before the final ".". With BDAT, the
+     * server accepts the message once it has received the announced number
+     * of bytes. Therefore, check the entire content before starting the mail
+     * transaction. With a corrupt queue file, skip the mail transaction and
+     * end the session with RSET and QUIT, as when all recipients are
+     * rejected.
+     */
+    if (chunking && SENDING_MAIL) {
+	if (var_smtp_map_content)
+	    content_map = rec_map_open(state->src, request->data_offset);
+	if ((bdat_size = smtp_text_size(state, content_map)) < 0) {
+	    (void) smtp_mesg_fail(state, DSN_BY_LOCAL_MTA,
+				  SMTP_RESP_FAKE(&fake, "5.3.0"),
+				  "unreadable mail queue entry");
+	    /* If bounce_append() succeeded, status is still 0 */
+	    if (state->status == 0)
+		(void) mark_corrupt(state->src);
+	    send_state = recv_state = SMTP_STATE_ABORT;
+	}
+    }
+
     /*
      * Prepare for disaster. This should not be needed because the design
      * guarantees that no output is flushed before smtp_chat_resp() is
@@ -1455,6 +1592,8 @@ static int smtp_loop(SMTP_STATE *state, NOCLOBBER int send_state,
 	case SMTP_STATE_MAIL:
 	    request->msg_stats.reuse_count = session->reuse_count;
 	    GETTIMEOFDAY(&request->msg_stats.conn_setup_done);
+	    request->msg_stats.data_start.tv_sec = 0;
+	    request->msg_stats.data_bytes = 0;
 	    REWRITE_ADDRESS(session->scratch2, request->sender);
 	    QUOTE_ADDRESS(session->scratch, vstring_str(session->scratch2));
 	    vstring_sprintf(next_command, "MAIL FROM:<%s>",
@@ -1585,7 +1724,8 @@ static int smtp_loop(SMTP_STATE *state, NOCLOBBER int send_state,
 	    if ((next_rcpt = send_rcpt + 1) == SMTP_RCPT_LEFT(state))
 		next_state = (DEL_REQ_TRACE_ONLY(request->flags)
 			      && smtp_vrfy_tgt == SMTP_STATE_RCPT) ?
-		    SMTP_STATE_ABORT : SMTP_STATE_DATA;
+		    SMTP_STATE_ABORT : chunking ?
+		    SMTP_STATE_DOT : SMTP_STATE_DATA;
 	    break;
 
 	    /*
@@ -1606,7 +1746,11 @@ static int smtp_loop(SMTP_STATE *state, NOCLOBBER int send_state,
 	     * already-generated commands.
 	     */
 	case SMTP_STATE_DOT:
-	    vstring_strcpy(next_command, ".");
+	    if (chunking)
+		vstring_sprintf(next_command, "BDAT %lu LAST",
+				(unsigned long) bdat_size);
+	    else
+		vstring_strcpy(next_command, ".");
 	    if (THIS_SESSION_IS_EXPIRED)
 		DONT_CACHE_THIS_SESSION;
 	    next_state = THIS_SESSION_IS_CACHED ?
@@ -1868,7 +2012,8 @@ static int smtp_loop(SMTP_STATE *state, NOCLOBBER int send_state,
 		    if (++recv_rcpt == SMTP_RCPT_LEFT(state))
 			recv_state = (DEL_REQ_TRACE_ONLY(request->flags)
 				      && smtp_vrfy_tgt == SMTP_STATE_RCPT) ?
-			    SMTP_STATE_ABORT : SMTP_STATE_DATA;
+			    SMTP_STATE_ABORT : chunking ?
+			    SMTP_STATE_DOT : SMTP_STATE_DATA;
 		    /* XXX Also: record if non-delivering session. */
 		    break;
 
@@ -1932,7 +2077,7 @@ static int smtp_loop(SMTP_STATE *state, NOCLOBBER int send_state,
 					"host %s said: %s (in reply to %s)",
 					       session->namaddr,
 					     translit(resp->str, "\n", " "),
-					       xfer_request[SMTP_STATE_DOT]);
+					       DOT_REQUEST);
 			    } else {
 				for (nrcpt = 0; nrcpt < recv_rcpt; nrcpt++) {
 				    rcpt = request->rcpt_list.info + nrcpt;
@@ -1959,7 +2104,7 @@ static int smtp_loop(SMTP_STATE *state, NOCLOBBER int send_state,
 					"host %s said: %s (in reply to %s)",
 					       session->namaddr,
 					     translit(resp->str, "\n", " "),
-					       xfer_request[SMTP_STATE_DOT]);
+					       DOT_REQUEST);
 			    } else {
 				translit(resp->str, "\n", " ");
 				smtp_rcpt_done(state, resp, rcpt);
@@ -2036,11 +2181,13 @@ static int smtp_loop(SMTP_STATE *state, NOCLOBBER int send_state,
 	     * Apply a course correction if necessary: the sender wants to
 	     * send RCPT TO but MAIL FROM was rejected; the sender wants to
 	     * send DATA but all recipients were rejected; the sender wants
-	     * to deliver the message but DATA was rejected.
+	     * to deliver the message but DATA was rejected; the sender wants
+	     * to send BDAT but all recipients were rejected.
 	     */
 	    if ((send_state == SMTP_STATE_RCPT && mail_from_rejected)
 		|| (send_state == SMTP_STATE_DATA && nrcpt == 0)
-		|| (send_state == SMTP_STATE_DOT && nrcpt < 0)) {
+		|| (send_state == SMTP_STATE_DOT && nrcpt < 0)
+		|| (send_state == SMTP_STATE_DOT && chunking && nrcpt == 0)) {
 		send_state = recv_state = SMTP_STATE_ABORT;
 		send_rcpt = recv_rcpt = 0;
 		vstring_strcpy(next_command, "RSET");
@@ -2064,17 +2211,24 @@ static int smtp_loop(SMTP_STATE *state, NOCLOBBER int send_state,
 	 * server accepted at least one recipient send the entire message.
 	 * Otherwise, just send "." as per RFC 2197.
 	 * 
+	 * With BDAT, send the command followed by the entire message. We get
+	 * here only when the server may have accepted a recipient.
+	 * 
 	 * XXX If there is a hard MIME error while downgrading to 7-bit mail,
 	 * disconnect ungracefully, because there is no other way to cancel a
 	 * transaction in progress.
 	 */
-	if (send_state == SMTP_STATE_DOT && nrcpt > 0) {
+	if (send_state == SMTP_STATE_DOT && (nrcpt > 0 || chunking)) {
 
 	    smtp_stream_setup(session->stream, var_smtp_data1_tmout,
 			      var_smtp_rec_deadline);
 
 	    if ((except = vstream_setjmp(session->stream)) == 0) {
 
+		if (chunking)
+		    smtp_chat_cmd(session, "%s", vstring_str(next_command));
+		GETTIMEOFDAY(&request->msg_stats.data_start);
+
 		if (vstream_fseek(state->src, request->data_offset, SEEK_SET) < 0)
 		    msg_fatal("seek queue file: %m");
 
@@ -2106,25 +2260,56 @@ static int smtp_loop(SMTP_STATE *state, NOCLOBBER int send_state,
 							   (void *) state);
 		state->space_left = var_smtp_line_limit;
 
-		while ((rec_type = rec_get(state->src, session->scratch, 0)) > 0) {
-		    if (rec_type != REC_TYPE_NORM && rec_type != REC_TYPE_CONT)
-			break;
-		    if (session->mime_state == 0) {
-			smtp_text_out((void *) state, rec_type,
-				      vstring_str(session->scratch),
-				      VSTRING_LEN(session->scratch),
-				      (off_t) 0);
-		    } else {
-			mime_errs =
-			    mime_state_update(session->mime_state, rec_type,
-					      vstring_str(session->scratch),
-					      VSTRING_LEN(session->scratch));
-			if (mime_errs) {
-			    smtp_mime_fail(state, mime_errs);
-			    RETURN(0);
+		/*
+		 * Without content conversion or inspection, send the message
+		 * content straight from a memory mapping of the queue file.
+		 * This avoids copying each record into a scratch buffer.
+		 * smtp_text_emit() still does the line length limits and
+		 * dot-stuffing, and the stream does the encryption if any.
+		 * 
+		 * XXX We can't use sendfile(2) or splice(2): the queue file
+		 * content is stored as typed records, without <CR><LF>, and
+		 * lines that start with "." need to be escaped.
+		 */
+		text_flags = chunking ? SMTP_TEXT_FLAG_NONE : SMTP_TEXT_FLAG_DOT;
+		if (content_map == 0 && session->mime_state == 0
+		    && var_smtp_map_content)
+		    content_map = rec_map_open(state->src, request->data_offset);
+		if (content_map != 0) {
+		    const char *data;
+		    ssize_t len;
+
+		    while ((rec_type = rec_map_get(content_map, &data, &len)) > 0) {
+			if (rec_type != REC_TYPE_NORM && rec_type != REC_TYPE_CONT)
+			    break;
+			request->msg_stats.data_bytes +=
+			    smtp_text_emit(state, rec_type, data, len,
+					   session->stream, text_flags);
+			prev_type = rec_type;
+		    }
+		    content_map = rec_map_close(content_map);
+		} else {
+		    while ((rec_type = rec_get(state->src, session->scratch, 0)) > 0) {
+			if (rec_type != REC_TYPE_NORM && rec_type != REC_TYPE_CONT)
+			    break;
+			if (session->mime_state == 0) {
+			    request->msg_stats.data_bytes +=
+				smtp_text_emit(state, rec_type,
+					       vstring_str(session->scratch),
+					       VSTRING_LEN(session->scratch),
+					       session->stream, text_flags);
+			} else {
+			    mime_errs =
+				mime_state_update(session->mime_state, rec_type,
+						  vstring_str(session->scratch),
+						  VSTRING_LEN(session->scratch));
+			    if (mime_errs) {
+				smtp_mime_fail(state, mime_errs);
+				RETURN(0);
+			    }
 			}
+			prev_type = rec_type;
 		    }
-		    prev_type = rec_type;
 		}
 
 		if (session->mime_state) {
@@ -2145,8 +2330,10 @@ static int smtp_loop(SMTP_STATE *state, NOCLOBBER int send_state,
 			smtp_mime_fail(state, mime_errs);
 			RETURN(0);
 		    }
-		} else if (prev_type == REC_TYPE_CONT)	/* missing newline */
+		} else if (prev_type == REC_TYPE_CONT) {	/* missing newline */
 		    smtp_fputs("", 0, session->stream);
+		    request->msg_stats.data_bytes += 2;
+		}
 		if ((session->features & SMTP_FEATURE_PIX_DELAY_DOTCRLF) != 0
 		    && request->msg_stats.incoming_arrival.tv_sec
 		  <= vstream_ftime(session->stream) - var_smtp_pix_thresh) {
@@ -2196,7 +2383,8 @@ static int smtp_loop(SMTP_STATE *state, NOCLOBBER int send_state,
 	 * Copy the next command to the buffer and update the sender state.
 	 */
 	if (except == 0) {
-	    smtp_chat_cmd(session, "%s", vstring_str(next_command));
+	    if (send_state != SMTP_STATE_DOT || !chunking)
+		smtp_chat_cmd(session, "%s", vstring_str(next_command));
 	} else {
 	    DONT_CACHE_THIS_SESSION;
 	}
@@ -131,21 +131,18 @@ void    smtp_save_session(SMTP_STATE *state, int name_key_flags,
     state->session = 0;
 
     /*
-     * Save the session under the next-hop name, if available.
+     * Save the session under the next-hop name, if available, and save every
+     * good session under its physical endpoint address. Both are saved with
+     * one cache request.
      * 
      * XXX The logical to physical binding can be kept for as long as the DNS
      * allows us to (but that could result in the caching of lots of unused
      * bindings). The session should be idle for no more than 30 seconds or
      * so.
      */
-    if (HAVE_NEXTHOP_STATE(state))
-	scache_save_dest(smtp_scache, var_smtp_cache_conn, STR(state->dest_label),
-			 STR(state->dest_prop), STR(state->endp_label));
-
-    /*
-     * Save every good session under its physical endpoint address.
-     */
-    scache_save_endp(smtp_scache, var_smtp_cache_conn, STR(state->endp_label),
+    scache_save_sess(smtp_scache, var_smtp_cache_conn,
+		     HAVE_NEXTHOP_STATE(state) ? STR(state->dest_label) : 0,
+		     STR(state->dest_prop), STR(state->endp_label),
 		     STR(state->endp_prop), fd);
 }
 
@@ -142,6 +142,11 @@
 /*	Available in Postfix version 3.0 and later:
 /* .IP "\fBsmtpd_dns_reply_filter (empty)\fR"
 /*	Optional filter for Postfix SMTP server DNS lookup results.
+/* .PP
+/*	Available in Postfix version 3.2 and later:
+/* .IP "\fBdns_parallel_lookup_enable (no)\fR"
+/*	Send the DNS queries for different record types or MX hosts
+/*	at the same time, instead of one after the other.
 /* ADDRESS REWRITING CONTROLS
 /* .ad
 /* .fi
@@ -263,6 +268,14 @@
 /* .IP "\fBsmtpd_milter_maps (empty)\fR"
 /*	Lookup tables with Milter settings per remote SMTP client IP
 /*	address.
+/* .IP "\fBmilter_body_pipeline_limit (1)\fR"
+/*	The maximal number of message body chunks that the Postfix
+/*	MTA sends to a Milter (mail filter) application before it
+/*	waits for a response.
+/* .IP "\fBmilter_parallel_events (no)\fR"
+/*	Send each SMTP command event to all Milter (mail filter)
+/*	applications that don't modify messages, before waiting for
+/*	their responses.
 /* GENERAL CONTENT INSPECTION CONTROLS
 /* .ad
 /* .fi
@@ -1143,6 +1156,7 @@
 #include <iostuff.h>
 #include <split_at.h>
 #include <name_code.h>
+#include <set_eugid.h>
 #include <inet_proto.h>
 
 /* Global library. */
@@ -1370,6 +1384,8 @@ char   *var_smtpd_milter_maps;
 int     var_milt_conn_time;
 int     var_milt_cmd_time;
 int     var_milt_msg_time;
+int     var_milt_body_limit;
+bool    var_milt_parallel;
 char   *var_milt_protocol;
 char   *var_milt_def_action;
 char   *var_milt_daemon_name;
@@ -2046,7 +2062,7 @@ static int mail_open_stream(SMTPD_STATE *state)
      */
     if (state->dest) {
 	state->cleanup = state->dest->stream;
-	state->queue_id = mystrdup(state->dest->id);
+	state->queue_id = arena_strdup(state->arena, state->dest->id);
 	if (SMTPD_STAND_ALONE(state) == 0) {
 	    if (state->milters != 0
 		&& (state->saved_flags & MILTER_SKIP_FLAGS) == 0)
@@ -2619,18 +2635,18 @@ static int mail_cmd(SMTPD_STATE *state, int argc, SMTPD_TOKEN *argv)
      * No more early returns. The mail transaction is in progress.
      */
     GETTIMEOFDAY(&state->arrival_time);
-    state->sender = mystrdup(STR(state->addr_buf));
+    state->sender = arena_strdup(state->arena, STR(state->addr_buf));
     vstring_sprintf(state->instance, "%x.%lx.%lx.%x",
 		    var_pid, (unsigned long) state->arrival_time.tv_sec,
 	       (unsigned long) state->arrival_time.tv_usec, state->seqno++);
     if (verp_delims)
-	state->verp_delims = mystrdup(verp_delims);
+	state->verp_delims = arena_strdup(state->arena, verp_delims);
     if (dsn_envid)
-	state->dsn_envid = mystrdup(STR(state->dsn_buf));
+	state->dsn_envid = arena_strdup(state->arena, STR(state->dsn_buf));
     if (smtputf8)
 	state->flags |= SMTPD_FLAG_SMTPUTF8;
     if (USE_SMTPD_PROXY(state))
-	state->proxy_mail = mystrdup(STR(state->buffer));
+	state->proxy_mail = arena_strdup(state->arena, STR(state->buffer));
     if (var_smtpd_delay_open == 0 && mail_open_stream(state) < 0) {
 	/* XXX Reset access map side effects. */
 	mail_reset(state);
@@ -2659,24 +2675,14 @@ static void mail_reset(SMTPD_STATE *state)
 	state->cleanup = 0;
     }
     state->err = 0;
-    if (state->queue_id != 0) {
-	myfree(state->queue_id);
-	state->queue_id = 0;
-    }
+    state->queue_id = 0;
     if (state->sender) {
 	if (state->milters != 0)
 	    milter_abort(state->milters);
-	myfree(state->sender);
 	state->sender = 0;
     }
-    if (state->verp_delims) {
-	myfree(state->verp_delims);
-	state->verp_delims = 0;
-    }
-    if (state->proxy_mail) {
-	myfree(state->proxy_mail);
-	state->proxy_mail = 0;
-    }
+    state->verp_delims = 0;
+    state->proxy_mail = 0;
     if (state->saved_filter) {
 	myfree(state->saved_filter);
 	state->saved_filter = 0;
@@ -2707,15 +2713,13 @@ static void mail_reset(SMTPD_STATE *state)
 	smtpd_xforward_reset(state);
     if (state->prepend)
 	state->prepend = argv_free(state->prepend);
-    if (state->dsn_envid) {
-	myfree(state->dsn_envid);
-	state->dsn_envid = 0;
-    }
+    state->dsn_envid = 0;
     if (state->milter_argv) {
 	myfree((void *) state->milter_argv);
 	state->milter_argv = 0;
 	state->milter_argc = 0;
     }
+    arena_reset(state->arena);
 }
 
 /* rcpt_cmd - process RCPT TO command */
@@ -5346,6 +5350,8 @@ static void setup_milters(SMTPD_STATE *state)
 				       var_milt_conn_time,
 				       var_milt_cmd_time,
 				       var_milt_msg_time,
+				       var_milt_body_limit,
+				       var_milt_parallel,
 				       var_milt_protocol,
 				       var_milt_def_action,
 				       var_milt_conn_macros,
@@ -5530,6 +5536,25 @@ static void pre_jail_init(char *unused_name, char **unused_argv)
 	smtpd_cmd_filter = dict_open(var_smtpd_cmd_filter, O_RDONLY,
 				     DICT_FLAG_LOCK | DICT_FLAG_FOLD_FIX);
 
+    /*
+     * Connection rate management. This may open the shared anvil counters,
+     * which are not accessible after entering the chroot jail. Don't create
+     * a root-owned file, and don't use the counters in stand-alone mode.
+     */
+    if (var_smtpd_crate_limit || var_smtpd_cconn_limit
+	|| var_smtpd_cmail_limit || var_smtpd_crcpt_limit
+	|| var_smtpd_cntls_limit || var_smtpd_cauth_limit) {
+	if (getuid() == 0) {
+	    SAVE_AND_SET_EUGID(var_owner_uid, var_owner_gid);
+	    anvil_clnt = anvil_clnt_create();
+	    RESTORE_SAVED_EUGID();
+	} else {
+	    if (getuid() != var_owner_uid)
+		var_anvil_shm_enable = 0;
+	    anvil_clnt = anvil_clnt_create();
+	}
+    }
+
     /*
      * XXX Temporary fix to pretend that we consistently implement TLS
      * security levels. We implement only a subset for now. If we implement
@@ -5683,6 +5708,13 @@ static void pre_jail_init(char *unused_name, char **unused_argv)
     if (*var_smtpd_dns_re_filter)
 	dns_rr_filter_compile(VAR_SMTPD_DNS_RE_FILTER,
 			      var_smtpd_dns_re_filter);
+
+    /*
+     * Parallel DNS lookups. Open the random source before entering the
+     * chroot jail.
+     */
+    if (var_dns_parallel)
+	(void) dns_async_init();
 }
 
 /* post_jail_init - post-jail initialization */
@@ -5718,14 +5750,6 @@ static void post_jail_init(char *unused_name, char **unused_argv)
 	msg_warn("%s(%lu) should be at least 1.5*%s(%lu)",
 		 VAR_QUEUE_MINFREE, (unsigned long) var_queue_minfree,
 		 VAR_MESSAGE_LIMIT, (unsigned long) var_message_limit);
-
-    /*
-     * Connection rate management.
-     */
-    if (var_smtpd_crate_limit || var_smtpd_cconn_limit
-	|| var_smtpd_cmail_limit || var_smtpd_crcpt_limit
-	|| var_smtpd_cntls_limit || var_smtpd_cauth_limit)
-	anvil_clnt = anvil_clnt_create();
 }
 
 MAIL_VERSION_STAMP_DECLARE;
@@ -5778,6 +5802,7 @@ int     main(int argc, char **argv)
 #endif
 	VAR_SMTPD_POLICY_REQ_LIMIT, DEF_SMTPD_POLICY_REQ_LIMIT, &var_smtpd_policy_req_limit, 0, 0,
 	VAR_SMTPD_POLICY_TRY_LIMIT, DEF_SMTPD_POLICY_TRY_LIMIT, &var_smtpd_policy_try_limit, 1, 0,
+	VAR_MILT_BODY_LIMIT, DEF_MILT_BODY_LIMIT, &var_milt_body_limit, 1, 0,
 	0,
     };
     static const CONFIG_TIME_TABLE time_table[] = {
@@ -5824,6 +5849,7 @@ int     main(int argc, char **argv)
 	VAR_SMTPD_PEERNAME_LOOKUP, DEF_SMTPD_PEERNAME_LOOKUP, &var_smtpd_peername_lookup,
 	VAR_SMTPD_DELAY_OPEN, DEF_SMTPD_DELAY_OPEN, &var_smtpd_delay_open,
 	VAR_SMTPD_CLIENT_PORT_LOG, DEF_SMTPD_CLIENT_PORT_LOG, &var_smtpd_client_port_log,
+	VAR_MILT_PARALLEL, DEF_MILT_PARALLEL, &var_milt_parallel,
 	0,
     };
     static const CONFIG_NBOOL_TABLE nbool_table[] = {
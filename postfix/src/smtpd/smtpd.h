@@ -20,6 +20,7 @@
 #include <vstream.h>
 #include <vstring.h>
 #include <argv.h>
+#include <arena.h>
 #include <myaddrinfo.h>
 
  /*
@@ -159,7 +160,7 @@ typedef struct {
      * Pass-through proxy client.
      */
     struct SMTPD_PROXY *proxy;
-    char   *proxy_mail;			/* owned by mail_cmd() */
+    char   *proxy_mail;			/* in arena */
 
     /*
      * XFORWARD server state.
@@ -189,6 +190,12 @@ typedef struct {
      */
     VSTRING *ehlo_buf;
     ARGV   *ehlo_argv;
+
+    /*
+     * Memory for strings that live as long as the mail transaction.
+     */
+    ARENA  *arena;			/* reset by mail_reset() */
+    long    malloc_calls;		/* allocator calls before session */
 } SMTPD_STATE;
 
 #define SMTPD_FLAG_HANGUP	   (1<<0)	/* 421/521 disconnect */
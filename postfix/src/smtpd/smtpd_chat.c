@@ -109,16 +109,17 @@ void    smtpd_chat_reset(SMTPD_STATE *state)
 static void smtp_chat_append(SMTPD_STATE *state, char *direction,
 			             const char *text)
 {
-    char   *line;
+    static VSTRING *line;
 
     if (state->notify_mask == 0)
 	return;
 
+    if (line == 0)
+	line = vstring_alloc(100);
     if (state->history == 0)
 	state->history = argv_alloc(10);
-    line = concatenate(direction, text, (char *) 0);
-    argv_add(state->history, line, (char *) 0);
-    myfree(line);
+    vstring_sprintf(line, "%s%s", direction, text);
+    argv_add(state->history, STR(line), (char *) 0);
 }
 
 /* smtpd_chat_query - receive and record an SMTP request */
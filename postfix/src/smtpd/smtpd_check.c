@@ -2721,6 +2721,80 @@ static int check_access(SMTPD_STATE *state, const char *table, const char *name,
     CHK_ACCESS_RETURN(SMTPD_CHECK_DUNNO, MISSED);
 }
 
+/* check_access_key - add lookup key for batched table lookup */
+
+static void check_access_key(DICT *dict, ARGV *keys, ARGV *names,
+			             const char *key, const char *name,
+			             int flags)
+{
+    if (flags == 0 || (flags & dict->flags) != 0) {
+	argv_add(keys, key, (char *) 0);
+	argv_add(names, name, (char *) 0);
+    }
+}
+
+/* check_domain_keys - add domain and parent domain lookup keys */
+
+static void check_domain_keys(DICT *dict, ARGV *keys, ARGV *names,
+			              const char *domain, int flags)
+{
+    const char *name;
+    const char *next;
+    int     maybe_numerical = 1;
+
+    /*
+     * Try the name and its parent domains. Including top-level domains.
+     * 
+     * Helo names can end in ".". The test below avoids lookups of the empty
+     * key, because Berkeley DB cannot deal with it. [Victor Duchovni, Morgan
+     * Stanley].
+     */
+    for (name = domain; *name != 0; name = next) {
+	check_access_key(dict, keys, names, name, domain, flags);
+	/* Don't apply subdomain magic to numerical hostnames. */
+	if (maybe_numerical
+	    && (maybe_numerical = valid_hostaddr(domain, DONT_GRIPE)) != 0)
+	    break;
+	if ((next = strchr(name + 1, '.')) == 0)
+	    break;
+	if (access_parent_style == MATCH_FLAG_PARENT)
+	    next += 1;
+	flags = PARTIAL;
+    }
+}
+
+/* check_access_keys - batched table lookup */
+
+static int check_access_keys(SMTPD_STATE *state, const char *table,
+			             DICT *dict, ARGV *keys, ARGV *names,
+			             int *found, const char *reply_name,
+			             const char *reply_class,
+			             const char *def_acl)
+{
+    const char *value;
+    ssize_t which;
+
+    /*
+     * The first key that matches or that causes a table error decides the
+     * result, as if the keys were looked up one at a time. With a proxied
+     * table, this takes one proxymap(8) round trip instead of one per key.
+     */
+#define CHK_KEYS_RETURN(x,y) { *found = y; return(x); }
+
+    if ((value = dict_get_first(dict, keys, &which)) != 0)
+	CHK_KEYS_RETURN(check_table_result(state, table, value,
+					   names->argv[which], reply_name,
+					   reply_class, def_acl), FOUND);
+    if (dict->error != 0) {
+	msg_warn("%s: table lookup problem", table);
+	value = "451 4.3.5 Server configuration error";
+	CHK_KEYS_RETURN(check_table_result(state, table, value,
+					   names->argv[which], reply_name,
+					   reply_class, def_acl), FOUND);
+    }
+    CHK_KEYS_RETURN(SMTPD_CHECK_DUNNO, MISSED);
+}
+
 /* check_domain_access - domainname-based table lookup */
 
 static int check_domain_access(SMTPD_STATE *state, const char *table,
@@ -2730,21 +2804,17 @@ static int check_domain_access(SMTPD_STATE *state, const char *table,
 			               const char *def_acl)
 {
     const char *myname = "check_domain_access";
-    const char *name;
-    const char *next;
     const char *value;
     DICT   *dict;
-    int     maybe_numerical = 1;
+    ARGV   *keys;
+    ARGV   *names;
+    int     status;
 
     if (msg_verbose)
 	msg_info("%s: %s", myname, domain);
 
     /*
-     * Try the name and its parent domains. Including top-level domains.
-     * 
-     * Helo names can end in ".". The test below avoids lookups of the empty
-     * key, because Berkeley DB cannot deal with it. [Victor Duchovni, Morgan
-     * Stanley].
+     * Try the name and its parent domains.
      */
 #define CHK_DOMAIN_RETURN(x,y) { *found = y; return(x); }
 
@@ -2755,31 +2825,14 @@ static int check_domain_access(SMTPD_STATE *state, const char *table,
 					     domain, reply_name, reply_class,
 					     def_acl), FOUND);
     }
-    for (name = domain; *name != 0; name = next) {
-	if (flags == 0 || (flags & dict->flags) != 0) {
-	    if ((value = dict_get(dict, name)) != 0)
-		CHK_DOMAIN_RETURN(check_table_result(state, table, value,
-					    domain, reply_name, reply_class,
-						     def_acl), FOUND);
-	    if (dict->error != 0) {
-		msg_warn("%s: table lookup problem", table);
-		value = "451 4.3.5 Server configuration error";
-		CHK_DOMAIN_RETURN(check_table_result(state, table, value,
-					    domain, reply_name, reply_class,
-						     def_acl), FOUND);
-	    }
-	}
-	/* Don't apply subdomain magic to numerical hostnames. */
-	if (maybe_numerical
-	    && (maybe_numerical = valid_hostaddr(domain, DONT_GRIPE)) != 0)
-	    break;
-	if ((next = strchr(name + 1, '.')) == 0)
-	    break;
-	if (access_parent_style == MATCH_FLAG_PARENT)
-	    next += 1;
-	flags = PARTIAL;
-    }
-    CHK_DOMAIN_RETURN(SMTPD_CHECK_DUNNO, MISSED);
+    keys = argv_alloc(5);
+    names = argv_alloc(5);
+    check_domain_keys(dict, keys, names, domain, flags);
+    status = check_access_keys(state, table, dict, keys, names, found,
+			       reply_name, reply_class, def_acl);
+    argv_free(keys);
+    argv_free(names);
+    return (status);
 }
 
 /* check_addr_access - address-based table lookup */
@@ -2795,6 +2848,9 @@ static int check_addr_access(SMTPD_STATE *state, const char *table,
     const char *value;
     DICT   *dict;
     int     delim;
+    ARGV   *keys;
+    ARGV   *names;
+    int     status;
 
     if (msg_verbose)
 	msg_info("%s: %s", myname, address);
@@ -2819,24 +2875,17 @@ static int check_addr_access(SMTPD_STATE *state, const char *table,
 					   reply_name, reply_class,
 					   def_acl), FOUND);
     }
+    keys = argv_alloc(5);
+    names = argv_alloc(5);
     do {
-	if (flags == 0 || (flags & dict->flags) != 0) {
-	    if ((value = dict_get(dict, addr)) != 0)
-		CHK_ADDR_RETURN(check_table_result(state, table, value, address,
-						   reply_name, reply_class,
-						   def_acl), FOUND);
-	    if (dict->error != 0) {
-		msg_warn("%s: table lookup problem", table);
-		value = "451 4.3.5 Server configuration error";
-		CHK_ADDR_RETURN(check_table_result(state, table, value, address,
-						   reply_name, reply_class,
-						   def_acl), FOUND);
-	    }
-	}
+	check_access_key(dict, keys, names, addr, address, flags);
 	flags = PARTIAL;
     } while (split_at_right(addr, delim));
-
-    CHK_ADDR_RETURN(SMTPD_CHECK_DUNNO, MISSED);
+    status = check_access_keys(state, table, dict, keys, names, found,
+			       reply_name, reply_class, def_acl);
+    argv_free(keys);
+    argv_free(names);
+    return (status);
 }
 
 /* check_namadr_access - OK/FAIL based on host name/address lookup */
@@ -3149,10 +3198,14 @@ static int check_mail_access(SMTPD_STATE *state, const char *table,
     const char *myname = "check_mail_access";
     const RESOLVE_REPLY *reply;
     const char *domain;
+    const char *value;
     int     status;
     char   *local_at;
     char   *bare_addr;
     char   *bare_at;
+    DICT   *dict;
+    ARGV   *keys;
+    ARGV   *names;
 
     if (msg_verbose)
 	msg_info("%s: %s", myname, addr);
@@ -3176,6 +3229,15 @@ static int check_mail_access(SMTPD_STATE *state, const char *table,
     }
     domain += 1;
 
+    if ((dict = dict_handle(table)) == 0) {
+	msg_warn("%s: unexpected dictionary: %s", myname, table);
+	value = "451 4.3.5 Server configuration error";
+	*found = FOUND;
+	return (check_table_result(state, table, value,
+				   CONST_STR(reply->recipient), reply_name,
+				   reply_class, def_acl));
+    }
+
     /*
      * In case of address extensions.
      */
@@ -3185,86 +3247,71 @@ static int check_mail_access(SMTPD_STATE *state, const char *table,
 	bare_addr = strip_addr(addr, (char **) 0, var_rcpt_delim);
     }
 
-#define CHECK_MAIL_ACCESS_RETURN(x) \
-	{ if (bare_addr) myfree(bare_addr); return(x); }
-
     /*
-     * Source-routed (non-local or virtual) recipient addresses are too
-     * suspicious for returning an "OK" result. The complicated expression
-     * below was brought to you by the keyboard of Victor Duchovni, Morgan
-     * Stanley and hacked up a bit by Wietse.
+     * Look up all candidate keys in the order of precedence below, so that
+     * a proxied table needs only one proxymap(8) round trip.
      */
-#define SUSPICIOUS(reply, reply_class) \
-	(var_allow_untrust_route == 0 \
-	&& (reply->flags & RESOLVE_FLAG_ROUTED) \
-	&& strcmp(reply_class, SMTPD_NAME_RECIPIENT) == 0)
+    keys = argv_alloc(10);
+    names = argv_alloc(10);
 
     /*
      * Look up user+foo@domain if the address has an extension, user@domain
      * otherwise.
      */
-    if ((status = check_access(state, table, CONST_STR(reply->recipient), FULL,
-			       found, reply_name, reply_class, def_acl)) != 0
-	|| *found)
-	CHECK_MAIL_ACCESS_RETURN(status == SMTPD_CHECK_OK
-				 && SUSPICIOUS(reply, reply_class) ?
-				 SMTPD_CHECK_DUNNO : status);
+    check_access_key(dict, keys, names, CONST_STR(reply->recipient),
+		     CONST_STR(reply->recipient), FULL);
 
     /*
      * Try user@domain if the address has an extension.
      */
     if (bare_addr)
-	if ((status = check_access(state, table, bare_addr, PARTIAL,
-			      found, reply_name, reply_class, def_acl)) != 0
-	    || *found)
-	    CHECK_MAIL_ACCESS_RETURN(status == SMTPD_CHECK_OK
-				     && SUSPICIOUS(reply, reply_class) ?
-				     SMTPD_CHECK_DUNNO : status);
+	check_access_key(dict, keys, names, bare_addr, bare_addr, PARTIAL);
 
     /*
      * Look up the domain name, or parent domains thereof.
      */
-    if ((status = check_domain_access(state, table, domain, PARTIAL,
-			      found, reply_name, reply_class, def_acl)) != 0
-	|| *found)
-	CHECK_MAIL_ACCESS_RETURN(status == SMTPD_CHECK_OK
-				 && SUSPICIOUS(reply, reply_class) ?
-				 SMTPD_CHECK_DUNNO : status);
+    check_domain_keys(dict, keys, names, domain, PARTIAL);
 
     /*
      * Look up user+foo@ if the address has an extension, user@ otherwise.
-     * XXX This leaks a little memory if map lookup is aborted.
      */
     local_at = mystrndup(CONST_STR(reply->recipient),
 			 domain - CONST_STR(reply->recipient));
-    status = check_access(state, table, local_at, PARTIAL, found,
-			  reply_name, reply_class, def_acl);
+    check_access_key(dict, keys, names, local_at, local_at, PARTIAL);
     myfree(local_at);
-    if (status != 0 || *found)
-	CHECK_MAIL_ACCESS_RETURN(status == SMTPD_CHECK_OK
-				 && SUSPICIOUS(reply, reply_class) ?
-				 SMTPD_CHECK_DUNNO : status);
 
     /*
-     * Look up user@ if the address has an extension. XXX Same problem here.
+     * Look up user@ if the address has an extension.
      */
     if (bare_addr) {
 	bare_at = strrchr(bare_addr, '@');
 	local_at = (bare_at ? mystrndup(bare_addr, bare_at + 1 - bare_addr) :
 		    mystrdup(bare_addr));
-	status = check_access(state, table, local_at, PARTIAL, found,
-			      reply_name, reply_class, def_acl);
+	check_access_key(dict, keys, names, local_at, local_at, PARTIAL);
 	myfree(local_at);
-	if (status != 0 || *found)
-	    CHECK_MAIL_ACCESS_RETURN(status == SMTPD_CHECK_OK
-				     && SUSPICIOUS(reply, reply_class) ?
-				     SMTPD_CHECK_DUNNO : status);
+	myfree(bare_addr);
     }
 
     /*
-     * Undecided when no match found.
+     * Source-routed (non-local or virtual) recipient addresses are too
+     * suspicious for returning an "OK" result. The complicated expression
+     * below was brought to you by the keyboard of Victor Duchovni, Morgan
+     * Stanley and hacked up a bit by Wietse.
+     */
+#define SUSPICIOUS(reply, reply_class) \
+	(var_allow_untrust_route == 0 \
+	&& (reply->flags & RESOLVE_FLAG_ROUTED) \
+	&& strcmp(reply_class, SMTPD_NAME_RECIPIENT) == 0)
+
+    /*
+     * XXX This leaks a little memory if map lookup is aborted.
      */
-    CHECK_MAIL_ACCESS_RETURN(SMTPD_CHECK_DUNNO);
+    status = check_access_keys(state, table, dict, keys, names, found,
+			       reply_name, reply_class, def_acl);
+    argv_free(keys);
+    argv_free(names);
+    return (status == SMTPD_CHECK_OK && SUSPICIOUS(reply, reply_class) ?
+	    SMTPD_CHECK_DUNNO : status);
 }
 
 /* Support for different DNSXL lookup results. */
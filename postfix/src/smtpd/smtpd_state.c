@@ -16,7 +16,9 @@
 /* DESCRIPTION
 /*	smtpd_state_init() initializes session context.
 /*
-/*	smtpd_state_reset() cleans up session context.
+/*	smtpd_state_reset() cleans up session context. With verbose
+/*	logging, it reports the number of memory allocator calls for
+/*	the session.
 /*
 /*	Arguments:
 /* .IP state
@@ -78,6 +80,8 @@ void    smtpd_state_init(SMTPD_STATE *state, VSTREAM *stream,
      * Initialize the state information for this connection, and fill in the
      * connection-specific fields.
      */
+    state->malloc_calls = MYMALLOC_CALLS();
+    state->arena = arena_create(0);
     state->flags = 0;
     state->err = CLEANUP_STAT_OK;
     state->client = stream;
@@ -190,6 +194,10 @@ void    smtpd_state_reset(SMTPD_STATE *state)
      * filled in. The other fields are taken care of by their own
      * "destructor" functions.
      */
+    if (msg_verbose)
+	msg_info("%s: %ld allocator calls", state->namaddr,
+		 MYMALLOC_CALLS() - state->malloc_calls);
+    arena_free(state->arena);
     if (state->service)
 	myfree(state->service);
     if (state->buffer)
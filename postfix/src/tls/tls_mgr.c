@@ -56,6 +56,13 @@
 /*	tls_mgr_key() is used to retrieve the current TLS session ticket
 /*	encryption or decryption keys.
 /*
+/*	With "tls_shared_session_cache_enable = yes", tls_mgr_policy()
+/*	also attaches to the tlsmgr(8) shared-memory session cache.
+/*	tls_mgr_lookup(), tls_mgr_update() and tls_mgr_delete() then
+/*	use that cache for the cache types that were enabled with
+/*	tls_mgr_policy(), and send a request to the tlsmgr(8) server
+/*	only when the shared-memory cache cannot be used.
+/*
 /*	Arguments:
 /* .IP cache_type
 /*	One of TLS_MGR_SCACHE_SMTPD, TLS_MGR_SCACHE_SMTP or
@@ -98,6 +105,7 @@
 /*	communicate with the tlsmgr(8) server).
 /* SEE ALSO
 /*	tlsmgr(8) TLS session and PRNG management
+/*	tls_shm(3) shared-memory TLS session cache
 /* LICENSE
 /* .ad
 /* .fi
@@ -128,6 +136,7 @@
 #include <attr_clnt.h>
 #include <mymalloc.h>
 #include <stringops.h>
+#include <htable.h>
 
 /* Global library. */
 
@@ -136,6 +145,7 @@
 
 /* TLS library. */
 #include <tls_mgr.h>
+#include <tls_shm.h>
 
 /* Application-specific. */
 
@@ -144,6 +154,16 @@
 
 static ATTR_CLNT *tls_mgr;
 
+ /*
+  * Optional shared-memory session cache, and the session timeout for each
+  * cache type that may use it.
+  */
+static TLS_SHM *tls_mgr_shm;
+static HTABLE *tls_mgr_shm_types;
+
+#define TLS_MGR_SHM_TIMEOUT(type) \
+	(tls_mgr_shm != 0 ? tls_mgr_shm_timeout(type) : 0)
+
 /* tls_mgr_open - create client handle */
 
 static void tls_mgr_open(void)
@@ -171,6 +191,38 @@ static void tls_mgr_open(void)
 		      ATTR_CLNT_CTL_END);
 }
 
+/* tls_mgr_shm_open - attach to shared-memory session cache */
+
+static void tls_mgr_shm_open(const char *cache_type, int timeout)
+{
+    char   *path;
+
+    /*
+     * The tlsmgr(8) server creates the table before it replies to a policy
+     * request. Don't try again after failure.
+     */
+    if (tls_mgr_shm_types == 0) {
+	tls_mgr_shm_types = htable_create(1);
+	path = concatenate(var_data_dir, "/", TLS_SHM_FILE, (char *) 0);
+	tls_mgr_shm = tls_shm_open(path, var_tls_shm_size, TLS_SHM_FLAG_NONE);
+	myfree(path);
+    }
+    if (htable_locate(tls_mgr_shm_types, cache_type) == 0)
+	htable_enter(tls_mgr_shm_types, cache_type,
+		     CAST_INT_TO_VOID_PTR(timeout));
+}
+
+/* tls_mgr_shm_timeout - session timeout for shared-memory cache */
+
+static int tls_mgr_shm_timeout(const char *cache_type)
+{
+    HTABLE_INFO *ht;
+
+    if ((ht = htable_locate(tls_mgr_shm_types, cache_type)) == 0)
+	return (0);
+    return (CAST_ANY_PTR_TO_INT(ht->value));
+}
+
 /* tls_mgr_seed - request PRNG seed */
 
 int     tls_mgr_seed(VSTRING *buf, int len)
@@ -225,6 +277,13 @@ int     tls_mgr_policy(const char *cache_type, int *cachable, int *timeout)
 			  RECV_ATTR_INT(TLS_MGR_ATTR_SESSTOUT, timeout),
 			  ATTR_TYPE_END) != 3)
 	status = TLS_MGR_STAT_FAIL;
+
+    /*
+     * Use the shared-memory cache for this cache type.
+     */
+    if (var_tls_shm_enable && status == TLS_MGR_STAT_OK
+	&& *cachable && *timeout > 0)
+	tls_mgr_shm_open(cache_type, *timeout);
     return (status);
 }
 
@@ -235,6 +294,14 @@ int     tls_mgr_lookup(const char *cache_type, const char *cache_id,
 {
     int     status;
 
+    /*
+     * Try the shared-memory cache first.
+     */
+    if (TLS_MGR_SHM_TIMEOUT(cache_type) > 0
+	&& (status = tls_shm_lookup(tls_mgr_shm, cache_type, cache_id,
+				    buf)) != TLS_MGR_STAT_FAIL)
+	return (status);
+
     /*
      * Create the tlsmgr client handle.
      */
@@ -264,6 +331,15 @@ int     tls_mgr_update(const char *cache_type, const char *cache_id,
 		               const char *buf, ssize_t len)
 {
     int     status;
+    int     timeout;
+
+    /*
+     * Try the shared-memory cache first.
+     */
+    if ((timeout = TLS_MGR_SHM_TIMEOUT(cache_type)) > 0
+	&& tls_shm_update(tls_mgr_shm, cache_type, cache_id, buf, len,
+			  timeout) == TLS_MGR_STAT_OK)
+	return (TLS_MGR_STAT_OK);
 
     /*
      * Create the tlsmgr client handle.
@@ -294,6 +370,14 @@ int     tls_mgr_delete(const char *cache_type, const char *cache_id)
 {
     int     status;
 
+    /*
+     * Try the shared-memory cache first.
+     */
+    if (TLS_MGR_SHM_TIMEOUT(cache_type) > 0
+	&& (status = tls_shm_delete(tls_mgr_shm, cache_type,
+				    cache_id)) != TLS_MGR_STAT_FAIL)
+	return (status);
+
     /*
      * Create the tlsmgr client handle.
      */
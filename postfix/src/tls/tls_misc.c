@@ -17,6 +17,8 @@
 /*	char	*var_tls_dane_agility;
 /*	char	*var_tls_dane_digests;
 /*	int	var_tls_daemon_rand_bytes;
+/*	bool	var_tls_shm_enable;
+/*	int	var_tls_shm_size;
 /*	bool	var_tls_append_def_CA;
 /*	bool	var_tls_dane_taa_dgst;
 /*	bool	var_tls_preempt_clist;
@@ -243,6 +245,8 @@ char   *var_tls_low_clist;
 char   *var_tls_export_clist;
 char   *var_tls_null_clist;
 int     var_tls_daemon_rand_bytes;
+bool    var_tls_shm_enable;
+int     var_tls_shm_size;
 char   *var_tls_eecdh_strong;
 char   *var_tls_eecdh_ultra;
 char   *var_tls_dane_agility;
@@ -657,6 +661,7 @@ void    tls_param_init(void)
     };
     static const CONFIG_INT_TABLE int_table[] = {
 	VAR_TLS_DAEMON_RAND_BYTES, DEF_TLS_DAEMON_RAND_BYTES, &var_tls_daemon_rand_bytes, 1, 0,
+	VAR_TLS_SHM_SIZE, DEF_TLS_SHM_SIZE, &var_tls_shm_size, 1, 0,
 	0,
     };
     static const CONFIG_BOOL_TABLE bool_table[] = {
@@ -665,6 +670,7 @@ void    tls_param_init(void)
 	VAR_TLS_DANE_TAA_DGST, DEF_TLS_DANE_TAA_DGST, &var_tls_dane_taa_dgst,
 	VAR_TLS_PREEMPT_CLIST, DEF_TLS_PREEMPT_CLIST, &var_tls_preempt_clist,
 	VAR_TLS_MULTI_WILDCARD, DEF_TLS_MULTI_WILDCARD, &var_tls_multi_wildcard,
+	VAR_TLS_SHM_ENABLE, DEF_TLS_SHM_ENABLE, &var_tls_shm_enable,
 	0,
     };
     static int init_done;
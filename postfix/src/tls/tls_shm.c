@@ -0,0 +1,723 @@
+/*++
+/* NAME
+/*	tls_shm 3
+/* SUMMARY
+/*	shared-memory TLS session cache
+/* SYNOPSIS
+/*	#include <tls_shm.h>
+/*
+/*	TLS_SHM	*tls_shm_open(path, size, flags)
+/*	const char *path;
+/*	int	size;
+/*	int	flags;
+/*
+/*	int	tls_shm_lookup(shm, cache_type, cache_id, buf)
+/*	TLS_SHM	*shm;
+/*	const char *cache_type;
+/*	const char *cache_id;
+/*	VSTRING	*buf;
+/*
+/*	int	tls_shm_update(shm, cache_type, cache_id, buf, len, timeout)
+/*	TLS_SHM	*shm;
+/*	const char *cache_type;
+/*	const char *cache_id;
+/*	const char *buf;
+/*	ssize_t	len;
+/*	int	timeout;
+/*
+/*	int	tls_shm_delete(shm, cache_type, cache_id)
+/*	TLS_SHM	*shm;
+/*	const char *cache_type;
+/*	const char *cache_id;
+/*
+/*	void	tls_shm_close(shm)
+/*	TLS_SHM	*shm;
+/* SERVER INTERFACE
+/*	void	tls_shm_maintain(shm)
+/*	TLS_SHM	*shm;
+/*
+/*	void	tls_shm_stats(shm, stats)
+/*	TLS_SHM	*shm;
+/*	TLS_SHM_STATS *stats;
+/* DESCRIPTION
+/*	This module maintains passivated TLS sessions in a
+/*	memory-mapped file, so that the SMTP client and server
+/*	processes can save and resume sessions without a round trip
+/*	to the tlsmgr(8) server.
+/*
+/*	The table has a fixed number of entries, and each operation
+/*	is done while holding an exclusive lock on the file. A
+/*	session is stored in one of a fixed number of entries that
+/*	are selected by a hash of its cache type and ID. When all
+/*	those entries are in use, the least-recently used entry is
+/*	replaced. Each entry expires after the timeout that was
+/*	specified when it was saved. The tlsmgr(8) server owns the
+/*	table: it updates a heartbeat time stamp, removes expired
+/*	sessions, and logs usage statistics. The table is used only
+/*	while that heartbeat is recent.
+/*
+/*	A session that does not fit in an entry is saved with the
+/*	tlsmgr(8) server instead. The table then remembers only
+/*	that the session exists, so that a lookup is sent to the
+/*	tlsmgr(8) server only when it may succeed.
+/*
+/*	tls_shm_open() opens the specified file and maps it into
+/*	memory. Only the owner creates the file, or replaces an
+/*	existing table with a different size or format. The size
+/*	argument specifies the number of entries for a new table;
+/*	other processes use the existing size. The result is a null
+/*	pointer in case of error.
+/*
+/*	tls_shm_lookup() copies the specified session into the
+/*	result buffer.
+/*
+/*	tls_shm_update() saves the specified session, replacing
+/*	an existing session with the same cache type and ID.
+/*
+/*	tls_shm_delete() removes the specified session.
+/*
+/*	tls_shm_close() unmaps the table. When called by the owner,
+/*	it also clears the heartbeat, so that other processes stop
+/*	using the table.
+/*
+/*	tls_shm_maintain() is called periodically by the tlsmgr(8)
+/*	server. It updates the heartbeat, and removes expired
+/*	sessions.
+/*
+/*	tls_shm_stats() copies the usage statistics that were
+/*	collected since the previous call, and resets them.
+/*
+/*	Arguments:
+/* .IP path
+/*	Pathname of the table file.
+/* .IP size
+/*	The number of session entries.
+/* .IP flags
+/*	TLS_SHM_FLAG_OWNER or TLS_SHM_FLAG_NONE.
+/* .IP shm
+/*	Table handle.
+/* .IP cache_type
+/*	One of TLS_MGR_SCACHE_SMTPD, TLS_MGR_SCACHE_SMTP or
+/*	TLS_MGR_SCACHE_LMTP.
+/* .IP cache_id
+/*	The session cache lookup key.
+/* .IP buf
+/*	The result or input buffer.
+/* .IP len
+/*	The length of the input buffer.
+/* .IP timeout
+/*	The session lifetime in seconds.
+/* DIAGNOSTICS
+/*	The lookup, update and delete routines return TLS_MGR_STAT_OK
+/*	in case of success, TLS_MGR_STAT_ERR when the session was
+/*	not found, and TLS_MGR_STAT_FAIL when the caller should use
+/*	the tlsmgr(8) server instead: the server is not running,
+/*	the lookup key is too long, or the session is saved with
+/*	the server.
+/*
+/*	Problems with the table file are logged as a warning.
+/* BUGS
+/*	Least-recently used replacement is approximate: only the
+/*	entries that a session may be stored in are considered.
+/* SEE ALSO
+/*	tlsmgr(8), TLS session and PRNG management
+/*	tls_mgr(3), tlsmgr(8) client
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+
+#ifdef USE_TLS
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+
+#ifndef MAP_FAILED
+#define MAP_FAILED	((void *) -1)
+#endif
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <myflock.h>
+#include <iostuff.h>
+#include <vstring.h>
+
+/* TLS library. */
+
+#include <tls_mgr.h>
+#include <tls_shm.h>
+
+/* Application-specific. */
+
+#define TLS_SHM_MAGIC	0x746c7331	/* "tls1" */
+#define TLS_SHM_PROBE	16		/* max entries per session */
+
+#define TLS_SHM_REMOTE	(-1)		/* session is saved with tlsmgr(8) */
+
+ /*
+  * Per-session information. This is kept separate from the session data,
+  * so that tls_shm_maintain() touches only a small part of the file. An
+  * entry with an empty key is free.
+  */
+typedef struct {
+    unsigned hash;			/* key hash */
+    int     len;			/* session length or TLS_SHM_REMOTE */
+    unsigned long stamp;		/* time of last use */
+    time_t  expire;			/* session expiration time */
+    char    key[TLS_SHM_KEY_LEN];	/* cache type and ID */
+} TLS_SHM_ENTRY;
+
+ /*
+  * The file starts with a header, followed by the entry table and the
+  * session data, which have the same number of entries.
+  */
+typedef struct {
+    unsigned magic;			/* TLS_SHM_MAGIC */
+    int     entry_size;			/* sizeof(TLS_SHM_ENTRY) */
+    int     data_size;			/* TLS_SHM_DATA_LEN */
+    int     size;			/* table entries */
+    int     used;			/* entries in use */
+    unsigned long clock;		/* LRU clock */
+    time_t  heartbeat;			/* tlsmgr(8) server is running */
+    TLS_SHM_STATS stats;		/* usage since tls_shm_stats() */
+} TLS_SHM_HDR;
+
+struct TLS_SHM {
+    int     fd;				/* table file */
+    int     flags;			/* TLS_SHM_FLAG_XXX */
+    size_t  len;			/* mapped length */
+    int     size;			/* table entries, as mapped */
+    TLS_SHM_HDR *hdr;			/* mapped file */
+    TLS_SHM_ENTRY *entry;		/* entry table */
+    char   *data;			/* session data */
+    char    key[TLS_SHM_KEY_LEN];	/* lookup key buffer */
+};
+
+#define TLS_SHM_LEN(size) (sizeof(TLS_SHM_HDR) \
+	+ (size) * (sizeof(TLS_SHM_ENTRY) + TLS_SHM_DATA_LEN))
+
+#define TLS_SHM_DATA(shm, ent) \
+	((shm)->data + ((ent) - (shm)->entry) * TLS_SHM_DATA_LEN)
+
+ /*
+  * Every process that uses the cache can write the table, so the table size
+  * comes from the mapping, not from the header, and a session length that
+  * would run outside its data slot is treated as a miss.
+  */
+#define TLS_SHM_LEN_OK(ent) ((ent)->len >= 0 && (ent)->len <= TLS_SHM_DATA_LEN)
+
+ /*
+  * The tlsmgr(8) server stopped updating the heartbeat.
+  */
+#define TLS_SHM_STALE(hdr, now) ((hdr)->heartbeat + 3 * TLS_SHM_TICK < (now))
+
+#define TLS_SHM_FREE(hdr, ent) do { \
+	(ent)->key[0] = 0; \
+	(hdr)->used -= 1; \
+    } while (0)
+
+/* tls_shm_hash - hash a string */
+
+static unsigned tls_shm_hash(const char *s)
+{
+    unsigned long h = 0;
+    unsigned long g;
+
+    /*
+     * From the "Dragon" book by Aho, Sethi and Ullman. All processes must
+     * compute the same value, so there is no per-process seed.
+     */
+    while (*s) {
+	h = (h << 4U) + *(unsigned const char *) s++;
+	if ((g = (h & 0xf0000000)) != 0) {
+	    h ^= (g >> 24U);
+	    h ^= g;
+	}
+    }
+    return (h);
+}
+
+/* tls_shm_lock - lock table, and check that it may be used */
+
+static int tls_shm_lock(TLS_SHM *shm, const char *cache_type,
+			        const char *cache_id, time_t *now)
+{
+    size_t  type_len = strlen(cache_type);
+    size_t  id_len = strlen(cache_id);
+
+    /*
+     * The key combines the cache type and ID, as with the tlsmgr(8) server
+     * which has one database per cache type.
+     */
+    if (type_len + id_len + 2 > TLS_SHM_KEY_LEN)
+	return (TLS_MGR_STAT_FAIL);
+    memcpy(shm->key, cache_type, type_len);
+    shm->key[type_len] = ':';
+    memcpy(shm->key + type_len + 1, cache_id, id_len + 1);
+
+    if (myflock(shm->fd, INTERNAL_LOCK, MYFLOCK_OP_EXCLUSIVE) < 0) {
+	msg_warn("lock TLS session cache table: %m");
+	return (TLS_MGR_STAT_FAIL);
+    }
+    *now = time((time_t *) 0);
+    if (TLS_SHM_STALE(shm->hdr, *now)) {
+	if (msg_verbose)
+	    msg_info("tls_shm_lock: tlsmgr server heartbeat is stale");
+	if (myflock(shm->fd, INTERNAL_LOCK, MYFLOCK_OP_NONE) < 0)
+	    msg_fatal("unlock TLS session cache table: %m");
+	return (TLS_MGR_STAT_FAIL);
+    }
+    return (TLS_MGR_STAT_OK);
+}
+
+/* tls_shm_unlock - unlock table */
+
+static void tls_shm_unlock(TLS_SHM *shm)
+{
+    if (myflock(shm->fd, INTERNAL_LOCK, MYFLOCK_OP_NONE) < 0)
+	msg_fatal("unlock TLS session cache table: %m");
+}
+
+/* tls_shm_find - look up session entry, or find room for it */
+
+static TLS_SHM_ENTRY *tls_shm_find(TLS_SHM *shm, time_t now,
+				           TLS_SHM_ENTRY **spare)
+{
+    TLS_SHM_HDR *hdr = shm->hdr;
+    TLS_SHM_ENTRY *ent;
+    TLS_SHM_ENTRY *oldest = 0;
+    unsigned hash = tls_shm_hash(shm->key);
+    int     n;
+
+    /*
+     * Probe a fixed number of entries. Prefer a free entry, then an expired
+     * one that the tlsmgr(8) server has not yet removed, then the one that
+     * was used least recently.
+     */
+    *spare = 0;
+    for (n = 0; n < TLS_SHM_PROBE && n < shm->size; n++) {
+	ent = shm->entry + (hash + n) % shm->size;
+	if (ent->key[0] == 0) {
+	    if (*spare == 0 || (*spare)->key[0] != 0)
+		*spare = ent;
+	} else if (ent->hash == hash && strcmp(ent->key, shm->key) == 0) {
+	    if (ent->expire > now)
+		return (ent);
+	    TLS_SHM_FREE(hdr, ent);
+	    if (*spare == 0 || (*spare)->key[0] != 0)
+		*spare = ent;
+	} else if (ent->expire <= now) {
+	    if (*spare == 0)
+		*spare = ent;
+	} else if (oldest == 0 || (long) (ent->stamp - oldest->stamp) < 0) {
+	    oldest = ent;
+	}
+    }
+    if (*spare == 0)
+	*spare = oldest;
+    return (0);
+}
+
+/* tls_shm_lookup - look up session */
+
+int     tls_shm_lookup(TLS_SHM *shm, const char *cache_type,
+		               const char *cache_id, VSTRING *buf)
+{
+    TLS_SHM_HDR *hdr = shm->hdr;
+    TLS_SHM_ENTRY *ent;
+    TLS_SHM_ENTRY *spare;
+    time_t  now;
+    int     status;
+
+    if (tls_shm_lock(shm, cache_type, cache_id, &now) != TLS_MGR_STAT_OK)
+	return (TLS_MGR_STAT_FAIL);
+    if ((ent = tls_shm_find(shm, now, &spare)) == 0) {
+	hdr->stats.misses += 1;
+	status = TLS_MGR_STAT_ERR;
+    } else if (ent->len == TLS_SHM_REMOTE) {
+	hdr->stats.remote += 1;
+	status = TLS_MGR_STAT_FAIL;
+    } else if (!TLS_SHM_LEN_OK(ent)) {
+	msg_warn("TLS session cache table: %s: bad session length %d",
+		 shm->key, ent->len);
+	TLS_SHM_FREE(hdr, ent);
+	hdr->stats.misses += 1;
+	status = TLS_MGR_STAT_ERR;
+    } else {
+	vstring_memcpy(buf, TLS_SHM_DATA(shm, ent), ent->len);
+	ent->stamp = ++hdr->clock;
+	hdr->stats.hits += 1;
+	status = TLS_MGR_STAT_OK;
+    }
+    tls_shm_unlock(shm);
+    if (msg_verbose)
+	msg_info("tls_shm_lookup: %s: status %d", shm->key, status);
+    return (status);
+}
+
+/* tls_shm_update - save session */
+
+int     tls_shm_update(TLS_SHM *shm, const char *cache_type,
+		               const char *cache_id, const char *buf,
+		               ssize_t len, int timeout)
+{
+    TLS_SHM_HDR *hdr = shm->hdr;
+    TLS_SHM_ENTRY *ent;
+    TLS_SHM_ENTRY *spare;
+    time_t  now;
+    int     status;
+
+    if (tls_shm_lock(shm, cache_type, cache_id, &now) != TLS_MGR_STAT_OK)
+	return (TLS_MGR_STAT_FAIL);
+    if ((ent = tls_shm_find(shm, now, &spare)) == 0) {
+	if ((ent = spare) == 0) {
+	    tls_shm_unlock(shm);
+	    return (TLS_MGR_STAT_FAIL);
+	}
+	if (ent->key[0] == 0)
+	    hdr->used += 1;
+	else if (ent->expire > now)
+	    hdr->stats.evictions += 1;
+	ent->hash = tls_shm_hash(shm->key);
+	strcpy(ent->key, shm->key);
+    }
+
+    /*
+     * A session that does not fit is saved with the tlsmgr(8) server. Don't
+     * leave an older session in its place.
+     */
+    if (len > TLS_SHM_DATA_LEN) {
+	ent->len = TLS_SHM_REMOTE;
+	hdr->stats.oversize += 1;
+	status = TLS_MGR_STAT_FAIL;
+    } else {
+	memcpy(TLS_SHM_DATA(shm, ent), buf, len);
+	ent->len = len;
+	hdr->stats.stores += 1;
+	status = TLS_MGR_STAT_OK;
+    }
+    ent->stamp = ++hdr->clock;
+    ent->expire = now + timeout;
+    tls_shm_unlock(shm);
+    if (msg_verbose)
+	msg_info("tls_shm_update: %s: length %ld status %d",
+		 shm->key, (long) len, status);
+    return (status);
+}
+
+/* tls_shm_delete - remove session */
+
+int     tls_shm_delete(TLS_SHM *shm, const char *cache_type,
+		               const char *cache_id)
+{
+    TLS_SHM_HDR *hdr = shm->hdr;
+    TLS_SHM_ENTRY *ent;
+    TLS_SHM_ENTRY *spare;
+    time_t  now;
+    int     status;
+
+    if (tls_shm_lock(shm, cache_type, cache_id, &now) != TLS_MGR_STAT_OK)
+	return (TLS_MGR_STAT_FAIL);
+    if ((ent = tls_shm_find(shm, now, &spare)) == 0) {
+	status = TLS_MGR_STAT_ERR;
+    } else {
+	status = (ent->len == TLS_SHM_REMOTE ?
+		  TLS_MGR_STAT_FAIL : TLS_MGR_STAT_OK);
+	TLS_SHM_FREE(hdr, ent);
+    }
+    tls_shm_unlock(shm);
+    return (status);
+}
+
+/* tls_shm_maintain - heartbeat and garbage collection */
+
+void    tls_shm_maintain(TLS_SHM *shm)
+{
+    TLS_SHM_HDR *hdr = shm->hdr;
+    TLS_SHM_ENTRY *ent;
+    time_t  now;
+    int     n;
+
+    if (myflock(shm->fd, INTERNAL_LOCK, MYFLOCK_OP_EXCLUSIVE) < 0) {
+	msg_warn("lock TLS session cache table: %m");
+	return;
+    }
+    now = time((time_t *) 0);
+    hdr->heartbeat = now;
+
+    /*
+     * Remove expired sessions.
+     */
+    for (n = 0, ent = shm->entry; ent < shm->entry + shm->size; ent++) {
+	if (ent->key[0] == 0)
+	    continue;
+	if (ent->expire <= now) {
+	    if (msg_verbose)
+		msg_info("tls_shm_maintain: expire %.*s",
+			 (int) sizeof(ent->key), ent->key);
+	    ent->key[0] = 0;
+	} else {
+	    n++;
+	}
+    }
+    hdr->used = n;
+    tls_shm_unlock(shm);
+}
+
+/* tls_shm_stats - report and reset usage statistics */
+
+void    tls_shm_stats(TLS_SHM *shm, TLS_SHM_STATS *stats)
+{
+    TLS_SHM_HDR *hdr = shm->hdr;
+
+    if (myflock(shm->fd, INTERNAL_LOCK, MYFLOCK_OP_EXCLUSIVE) < 0) {
+	msg_warn("lock TLS session cache table: %m");
+	memset((void *) stats, 0, sizeof(*stats));
+	return;
+    }
+    *stats = hdr->stats;
+    stats->used = hdr->used;
+    stats->size = shm->size;
+    memset((void *) &hdr->stats, 0, sizeof(hdr->stats));
+    tls_shm_unlock(shm);
+}
+
+/* tls_shm_create - initialize new table */
+
+static int tls_shm_create(int fd, int size)
+{
+    TLS_SHM_HDR hdr;
+
+    if (ftruncate(fd, TLS_SHM_LEN(size)) < 0)
+	return (-1);
+    memset((void *) &hdr, 0, sizeof(hdr));
+    hdr.magic = TLS_SHM_MAGIC;
+    hdr.entry_size = sizeof(TLS_SHM_ENTRY);
+    hdr.data_size = TLS_SHM_DATA_LEN;
+    hdr.size = size;
+    if (lseek(fd, (off_t) 0, SEEK_SET) < 0
+	|| write(fd, (void *) &hdr, sizeof(hdr)) != sizeof(hdr))
+	return (-1);
+    return (0);
+}
+
+/* tls_shm_open - open or create table */
+
+TLS_SHM *tls_shm_open(const char *path, int size, int flags)
+{
+    TLS_SHM *shm;
+    TLS_SHM_HDR hdr;
+    struct stat st;
+    void   *ptr;
+    int     fd;
+    int     valid;
+
+    if (size <= 0)
+	msg_panic("tls_shm_open: bad table size: %d", size);
+
+    /*
+     * The table holds session keys, so only the tlsmgr(8) server creates
+     * the file, with its own file ownership. Other processes open the file
+     * after they have contacted the server. Initialize while holding the
+     * lock, so that other processes never see a partial header.
+     */
+    for (;;) {
+	if ((fd = open(path, (flags & TLS_SHM_FLAG_OWNER) ?
+		       O_RDWR | O_CREAT : O_RDWR, 0600)) < 0) {
+	    msg_warn("open %s: %m", path);
+	    return (0);
+	}
+	if (myflock(fd, INTERNAL_LOCK, MYFLOCK_OP_EXCLUSIVE) < 0) {
+	    msg_warn("lock %s: %m", path);
+	    (void) close(fd);
+	    return (0);
+	}
+	if (fstat(fd, &st) < 0)
+	    msg_fatal("fstat %s: %m", path);
+	if (st.st_size == 0 && (flags & TLS_SHM_FLAG_OWNER)) {
+	    if (tls_shm_create(fd, size) < 0) {
+		msg_warn("initialize %s: %m", path);
+		(void) close(fd);
+		return (0);
+	    }
+	    break;
+	}
+	valid = (read(fd, (void *) &hdr, sizeof(hdr)) == sizeof(hdr)
+		 && hdr.magic == TLS_SHM_MAGIC
+		 && hdr.entry_size == sizeof(TLS_SHM_ENTRY)
+		 && hdr.data_size == TLS_SHM_DATA_LEN
+		 && hdr.size > 0
+		 && st.st_size == (off_t) TLS_SHM_LEN(hdr.size));
+	if (valid && (hdr.size == size || (flags & TLS_SHM_FLAG_OWNER) == 0)) {
+	    size = hdr.size;
+	    break;
+	}
+	if ((flags & TLS_SHM_FLAG_OWNER) == 0) {
+	    msg_warn("%s: bad table format", path);
+	    (void) close(fd);
+	    return (0);
+	}
+
+	/*
+	 * The owner replaces a table with the wrong size or format. Processes
+	 * that still use the old file will see its heartbeat go stale.
+	 */
+	msg_info("%s: creating new table with %d entries", path, size);
+	if (unlink(path) < 0)
+	    msg_fatal("remove %s: %m", path);
+	(void) close(fd);
+    }
+    close_on_exec(fd, CLOSE_ON_EXEC);
+
+    if ((ptr = mmap((void *) 0, TLS_SHM_LEN(size), PROT_READ | PROT_WRITE,
+		    MAP_SHARED, fd, (off_t) 0)) == MAP_FAILED) {
+	msg_warn("mmap %s: %m", path);
+	(void) close(fd);
+	return (0);
+    }
+    shm = (TLS_SHM *) mymalloc(sizeof(*shm));
+    shm->fd = fd;
+    shm->flags = flags;
+    shm->len = TLS_SHM_LEN(size);
+    shm->size = size;
+    shm->hdr = (TLS_SHM_HDR *) ptr;
+    shm->entry = (TLS_SHM_ENTRY *) (shm->hdr + 1);
+    shm->data = (char *) (shm->entry + size);
+    tls_shm_unlock(shm);
+    return (shm);
+}
+
+/* tls_shm_close - detach from table */
+
+void    tls_shm_close(TLS_SHM *shm)
+{
+    if (shm->flags & TLS_SHM_FLAG_OWNER) {
+	if (myflock(shm->fd, INTERNAL_LOCK, MYFLOCK_OP_EXCLUSIVE) < 0) {
+	    msg_warn("lock TLS session cache table: %m");
+	} else {
+	    shm->hdr->heartbeat = 0;
+	    tls_shm_unlock(shm);
+	}
+    }
+    if (munmap((void *) shm->hdr, shm->len) < 0)
+	msg_warn("munmap TLS session cache table: %m");
+    (void) close(shm->fd);
+    myfree((void *) shm);
+}
+
+#ifdef TEST
+
+ /*
+  * Stand-alone test program. Commands: "update type id data [timeout]",
+  * "lookup type id", "delete type id", "maintain", "stats", and "stop" (the
+  * tlsmgr server goes away).
+  */
+#include <stdlib.h>
+#include <msg_vstream.h>
+#include <vstring_vstream.h>
+#include <vstream.h>
+#include <stringops.h>
+
+static void usage(void)
+{
+    vstream_printf("usage: update type id data [timeout] | lookup type id | "
+		   "delete type id | maintain | stats | stop\n");
+}
+
+int     main(int argc, char **argv)
+{
+    VSTRING *inbuf = vstring_alloc(1);
+    VSTRING *data = vstring_alloc(1);
+    TLS_SHM_STATS stats;
+    TLS_SHM *shm;
+    TLS_SHM *owner;
+    char   *bufp;
+    char   *cmd;
+    char   *type;
+    char   *id;
+    char   *value;
+    char   *timeout;
+    int     status;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    if (argc != 3)
+	msg_fatal("usage: %s file size", argv[0]);
+    if ((owner = tls_shm_open(argv[1], atoi(argv[2]),
+			      TLS_SHM_FLAG_OWNER)) == 0)
+	msg_fatal("cannot open %s", argv[1]);
+    tls_shm_maintain(owner);
+    if ((shm = tls_shm_open(argv[1], 1, TLS_SHM_FLAG_NONE)) == 0)
+	msg_fatal("cannot open %s", argv[1]);
+
+    while (vstring_fgets_nonl(inbuf, VSTREAM_IN)) {
+	bufp = vstring_str(inbuf);
+	if ((cmd = mystrtok(&bufp, " ")) == 0 || *cmd == '#')
+	    continue;
+	vstream_printf("> %s\n", vstring_str(inbuf));
+	type = mystrtok(&bufp, " ");
+	id = mystrtok(&bufp, " ");
+	value = mystrtok(&bufp, " ");
+	timeout = mystrtok(&bufp, " ");
+	status = TLS_MGR_STAT_OK;
+	if (strcmp(cmd, "update") == 0 && value) {
+	    if (strcmp(value, "oversize") == 0) {
+		VSTRING_SPACE(data, TLS_SHM_DATA_LEN + 1);
+		memset(vstring_str(data), 'x', TLS_SHM_DATA_LEN + 1);
+		value = vstring_str(data);
+		status = tls_shm_update(shm, type, id, value,
+					TLS_SHM_DATA_LEN + 1,
+					timeout ? atoi(timeout) : 3600);
+	    } else {
+		status = tls_shm_update(shm, type, id, value, strlen(value),
+					timeout ? atoi(timeout) : 3600);
+	    }
+	} else if (strcmp(cmd, "lookup") == 0 && id) {
+	    if ((status = tls_shm_lookup(shm, type, id, data)) == 0)
+		vstream_printf("%.*s\n", (int) VSTRING_LEN(data),
+			       vstring_str(data));
+	} else if (strcmp(cmd, "delete") == 0 && id) {
+	    status = tls_shm_delete(shm, type, id);
+	} else if (strcmp(cmd, "maintain") == 0 && owner) {
+	    tls_shm_maintain(owner);
+	} else if (strcmp(cmd, "stats") == 0 && owner) {
+	    tls_shm_stats(owner, &stats);
+	    vstream_printf("hits=%lu misses=%lu remote=%lu stores=%lu "
+			   "evictions=%lu oversize=%lu used=%d size=%d\n",
+			   stats.hits, stats.misses, stats.remote,
+			   stats.stores, stats.evictions, stats.oversize,
+			   stats.used, stats.size);
+	} else if (strcmp(cmd, "stop") == 0 && owner) {
+	    tls_shm_close(owner);
+	    owner = 0;
+	} else {
+	    vstream_printf("bad command: \"%s\"\n", cmd);
+	    usage();
+	}
+	vstream_printf("status %d\n", status);
+	vstream_fflush(VSTREAM_OUT);
+    }
+    if (owner)
+	tls_shm_close(owner);
+    tls_shm_close(shm);
+    vstring_free(inbuf);
+    vstring_free(data);
+    return (0);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef _TLS_SHM_H_INCLUDED_
+#define _TLS_SHM_H_INCLUDED_
+
+/*++
+/* NAME
+/*	tls_shm 3h
+/* SUMMARY
+/*	shared-memory TLS session cache
+/* SYNOPSIS
+/*	#include <tls_shm.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * Utility library.
+  */
+#include <vstring.h>
+
+ /*
+  * External interface.
+  */
+typedef struct TLS_SHM TLS_SHM;
+
+#define TLS_SHM_FILE		"tls_session_cache"	/* under data_directory */
+#define TLS_SHM_KEY_LEN		256	/* cache type and session ID */
+#define TLS_SHM_DATA_LEN	4096	/* larger sessions go to tlsmgr(8) */
+#define TLS_SHM_TICK		5	/* tlsmgr(8) maintenance interval */
+
+#define TLS_SHM_FLAG_NONE	0
+#define TLS_SHM_FLAG_OWNER	(1<<0)	/* tlsmgr(8) server */
+
+extern TLS_SHM *tls_shm_open(const char *, int, int);
+extern int tls_shm_lookup(TLS_SHM *, const char *, const char *, VSTRING *);
+extern int tls_shm_update(TLS_SHM *, const char *, const char *, const char *, ssize_t, int);
+extern int tls_shm_delete(TLS_SHM *, const char *, const char *);
+extern void tls_shm_close(TLS_SHM *);
+
+ /*
+  * Server interface.
+  */
+typedef struct {
+    unsigned long hits;			/* lookup found session */
+    unsigned long misses;		/* lookup found nothing */
+    unsigned long remote;		/* lookup deferred to tlsmgr(8) */
+    unsigned long stores;		/* session saved */
+    unsigned long evictions;		/* unexpired session replaced */
+    unsigned long oversize;		/* session saved with tlsmgr(8) */
+    int     used;			/* entries in use */
+    int     size;			/* table entries */
+} TLS_SHM_STATS;
+
+extern void tls_shm_maintain(TLS_SHM *);
+extern void tls_shm_stats(TLS_SHM *, TLS_SHM_STATS *);
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+#endif
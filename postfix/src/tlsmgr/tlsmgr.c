@@ -27,6 +27,14 @@
 /*	The \fBtlsmgr\fR(8) saves the PRNG state to an exchange file
 /*	periodically and when the process terminates, and reads
 /*	the exchange file when initializing its PRNG.
+/*
+/*	With \fBtls_shared_session_cache_enable = yes\fR, the
+/*	\fBtlsmgr\fR(8) also maintains a session cache in a
+/*	memory-mapped file under the \fBdata_directory\fR. The
+/*	\fBsmtpd\fR(8) and \fBsmtp\fR(8) processes save and
+/*	resume sessions in that file without sending a request to
+/*	the \fBtlsmgr\fR(8), which removes expired sessions and
+/*	periodically logs the cache hit ratio.
 /* SECURITY
 /* .ad
 /* .fi
@@ -90,6 +98,13 @@
 /* .IP "\fBsmtpd_tls_session_cache_timeout (3600s)\fR"
 /*	The expiration time of Postfix SMTP server TLS session cache
 /*	information.
+/* .PP
+/*	Available in Postfix version 3.2 and later:
+/* .IP "\fBtls_shared_session_cache_enable (no)\fR"
+/*	Enable the shared-memory TLS session cache that is maintained
+/*	by \fBtlsmgr\fR(8).
+/* .IP "\fBtls_shared_session_cache_size (2000)\fR"
+/*	The number of sessions in the shared-memory TLS session cache.
 /* PSEUDO RANDOM NUMBER GENERATOR
 /* .ad
 /* .fi
@@ -230,6 +245,7 @@
 #include <tls.h>			/* TLS_MGR_SCACHE_<type> */
 #include <tls_prng.h>
 #include <tls_scache.h>
+#include <tls_shm.h>
 
 /* Application-specific. */
 
@@ -311,6 +327,13 @@ static TLSMGR_SCACHE cache_table[] = {
 
 #define	smtpd_cache	(cache_table[0])
 
+ /*
+  * State for the optional shared-memory session cache.
+  */
+static TLS_SHM *tls_shm;
+
+#define TLSMGR_SHM_STAT_TIME	600	/* usage logging interval */
+
  /*
   * SLMs.
   */
@@ -464,6 +487,41 @@ static void tlsmgr_cache_run_event(int unused_event, void *ctx)
 			cache->cache_info->timeout);
 }
 
+/* tlsmgr_shm_stats - log and reset shared-memory cache usage */
+
+static void tlsmgr_shm_stats(void)
+{
+    TLS_SHM_STATS stats;
+    unsigned long lookups;
+
+    tls_shm_stats(tls_shm, &stats);
+    if ((lookups = stats.hits + stats.misses + stats.remote) == 0
+	&& stats.stores == 0 && stats.oversize == 0)
+	return;
+    msg_info("shared TLS session cache: lookups=%lu hits=%lu (%lu%%) "
+	     "misses=%lu remote=%lu stores=%lu oversize=%lu evictions=%lu "
+	     "entries=%d/%d", lookups, stats.hits,
+	     lookups ? 100 * stats.hits / lookups : 0, stats.misses,
+	     stats.remote, stats.stores, stats.oversize, stats.evictions,
+	     stats.used, stats.size);
+}
+
+/* tlsmgr_shm_event - maintain shared-memory cache periodically */
+
+static void tlsmgr_shm_event(int unused_event, void *unused_context)
+{
+    static time_t next_stats;
+    time_t  now;
+
+    tls_shm_maintain(tls_shm);
+    if ((now = time((time_t *) 0)) >= next_stats) {
+	if (next_stats)
+	    tlsmgr_shm_stats();
+	next_stats = now + TLSMGR_SHM_STAT_TIME;
+    }
+    event_request_timer(tlsmgr_shm_event, unused_context, TLS_SHM_TICK);
+}
+
 /* tlsmgr_key - return matching or current RFC 5077 session ticket keys */
 
 static int tlsmgr_key(VSTRING *buffer, int timeout)
@@ -782,7 +840,8 @@ static void tlsmgr_service(VSTREAM *client_stream, char *unused_service,
 		    msg_warn("bogus cache type \"%s\" in \"%s\" request",
 			     STR(cache_type), TLS_MGR_REQ_POLICY);
 		} else {
-		    cachable = (ent->cache_info != 0) ? 1 : 0;
+		    cachable = (ent->cache_info != 0
+			      || (tls_shm != 0 && *ent->cache_timeout > 0));
 		    timeout = *ent->cache_timeout;
 		    status = TLS_MGR_STAT_OK;
 		}
@@ -945,6 +1004,16 @@ static void tlsmgr_pre_init(char *unused_name, char **unused_argv)
     }
     htable_free(dup_filter, (void (*) (void *)) 0);
 
+    /*
+     * Create the shared-memory session cache. Clients open it only after
+     * they have contacted us.
+     */
+    if (var_tls_shm_enable) {
+	path = concatenate(var_data_dir, "/", TLS_SHM_FILE, (char *) 0);
+	tls_shm = tls_shm_open(path, var_tls_shm_size, TLS_SHM_FLAG_OWNER);
+	myfree(path);
+    }
+
     /*
      * Clean up and restore privilege.
      */
@@ -997,6 +1066,8 @@ static void tlsmgr_post_init(char *unused_name, char **unused_argv)
     for (ent = cache_table; ent->cache_label; ++ent)
 	if (ent->cache_info)
 	    tlsmgr_cache_run_event(NULL_EVENT, (void *) ent);
+    if (tls_shm)
+	tlsmgr_shm_event(NULL_EVENT, NULL_CONTEXT);
 }
 
 /* tlsmgr_before_exit - save PRNG state before exit */
@@ -1009,6 +1080,15 @@ static void tlsmgr_before_exit(char *unused_service_name, char **unused_argv)
      */
     if (rand_exch)
 	tls_prng_exch_update(rand_exch);
+
+    /*
+     * Log the final usage, and tell clients to stop using the shared cache.
+     */
+    if (tls_shm) {
+	tlsmgr_shm_stats();
+	tls_shm_close(tls_shm);
+	tls_shm = 0;
+    }
 }
 
 MAIL_VERSION_STAMP_DECLARE;
@@ -1038,6 +1118,11 @@ int     main(int argc, char **argv)
     };
     static const CONFIG_INT_TABLE int_table[] = {
 	VAR_TLS_RAND_BYTES, DEF_TLS_RAND_BYTES, &var_tls_rand_bytes, 1, 0,
+	VAR_TLS_SHM_SIZE, DEF_TLS_SHM_SIZE, &var_tls_shm_size, 1, 0,
+	0,
+    };
+    static const CONFIG_BOOL_TABLE bool_table[] = {
+	VAR_TLS_SHM_ENABLE, DEF_TLS_SHM_ENABLE, &var_tls_shm_enable,
 	0,
     };
 
@@ -1054,6 +1139,7 @@ int     main(int argc, char **argv)
 		      CA_MAIL_SERVER_TIME_TABLE(time_table),
 		      CA_MAIL_SERVER_INT_TABLE(int_table),
 		      CA_MAIL_SERVER_STR_TABLE(str_table),
+		      CA_MAIL_SERVER_BOOL_TABLE(bool_table),
 		      CA_MAIL_SERVER_PRE_INIT(tlsmgr_pre_init),
 		      CA_MAIL_SERVER_POST_INIT(tlsmgr_post_init),
 		      CA_MAIL_SERVER_EXIT(tlsmgr_before_exit),
@@ -15,7 +15,13 @@
 /*	Although one \fBtlsproxy\fR(8) process can serve multiple
 /*	sessions at the same time, it is a good idea to allow the
 /*	number of processes to increase with load, so that the
-/*	service remains responsive.
+/*	service remains responsive. A \fBtlsproxy\fR(8) process
+/*	stops accepting new sessions while it has
+/*	$tlsproxy_handshake_limit TLS handshakes in progress; the
+/*	\fBmaster\fR(8) daemon then hands new sessions to another
+/*	\fBtlsproxy\fR(8) process, so that handshakes during a
+/*	connection burst are spread over multiple CPU cores instead
+/*	of queueing up behind each other.
 /* PROTOCOL EXAMPLE
 /* .ad
 /* .fi
@@ -45,6 +51,14 @@
 /*	can be run chrooted at fixed low privilege.
 /* DIAGNOSTICS
 /*	Problems and transactions are logged to \fBsyslogd\fR(8).
+/*
+/*	Upon exit, a \fBtlsproxy\fR(8) process logs handshake
+/*	statistics: the number of completed and failed handshakes,
+/*	the peak number of concurrent handshakes, how often the
+/*	process stopped accepting new sessions, and the average and
+/*	maximal handshake time, compute time (time in the TLS
+/*	library), and queue delay (time that a handshake waited
+/*	while the process was computing other handshakes).
 /* CONFIGURATION PARAMETERS
 /* .ad
 /* .fi
@@ -153,6 +167,13 @@
 /* .IP "\fBtlsproxy_watchdog_timeout (10s)\fR"
 /*	How much time a \fBtlsproxy\fR(8) process may take to process local
 /*	or remote I/O before it is terminated by a built-in watchdog timer.
+/* .PP
+/*	Available in Postfix version 3.2 and later:
+/* .IP "\fBtlsproxy_handshake_limit (10)\fR"
+/*	The maximal number of TLS handshakes that one \fBtlsproxy\fR(8)
+/*	process will have in progress before it stops accepting new
+/*	sessions, so that the \fBmaster\fR(8) daemon can start another
+/*	\fBtlsproxy\fR(8) process.
 /* MISCELLANEOUS CONTROLS
 /* .ad
 /* .fi
@@ -298,6 +319,7 @@ char   *var_tlsp_tls_fpt_dgst;
 char   *var_tlsp_tls_level;
 
 int     var_tlsp_watchdog;
+int     var_tlsp_hs_limit;
 
  /*
   * TLS per-process status.
@@ -305,6 +327,44 @@ int     var_tlsp_watchdog;
 static TLS_APPL_STATE *tlsp_server_ctx;
 static int ask_client_cert;
 
+ /*
+  * Handshake bookkeeping. Handshakes in one process take turns on one CPU
+  * core. When too many are in progress, we stop accepting new sessions so
+  * that the master starts another tlsproxy(8) process on another core.
+  * 
+  * The compute clock is the total time that this process spent in
+  * SSL_accept(). When a handshake completes, the growth of the compute
+  * clock minus the handshake's own compute time is the time that the
+  * handshake was queued behind other handshakes.
+  */
+static int tlsp_hs_active;		/* handshakes in progress */
+static int tlsp_hs_peak;		/* max handshakes in progress */
+static int tlsp_hs_busy;		/* not accepting new sessions */
+static double tlsp_hs_clock;		/* process compute clock */
+
+typedef struct {
+    double  total;			/* sum of samples */
+    double  max;			/* largest sample */
+} TLSP_TIME_STAT;
+
+static unsigned long tlsp_hs_done;	/* completed handshakes */
+static unsigned long tlsp_hs_failed;	/* failed handshakes */
+static unsigned long tlsp_hs_throttled;	/* times not accepting sessions */
+static TLSP_TIME_STAT tlsp_hs_elapsed;	/* first SSL_accept() to completion */
+static TLSP_TIME_STAT tlsp_hs_compute;	/* time spent in SSL_accept() */
+static TLSP_TIME_STAT tlsp_hs_queued;	/* time waiting for other handshakes */
+
+#define TLSP_TIME_UPDATE(stat, sample) do { \
+	(stat).total += (sample); \
+	if ((sample) > (stat).max) \
+	    (stat).max = (sample); \
+    } while (0)
+
+#define TLSP_TIME_AVG_MS(stat, count) \
+	((count) ? 1000 * (stat).total / (count) : 0)
+
+#define TLSP_SECONDS(t) ((t).tv_sec + (t).tv_usec / 1000000.0)
+
  /*
   * SLMs.
   */
@@ -373,6 +433,75 @@ static void tlsp_drain(char *unused_service, char **unused_argv)
     }
 }
 
+/* tlsp_hs_stats - log handshake statistics */
+
+static void tlsp_hs_stats(char *unused_service, char **unused_argv)
+{
+    if (tlsp_hs_done == 0 && tlsp_hs_failed == 0)
+	return;
+    msg_info("statistics: handshakes=%lu failed=%lu peak=%d throttled=%lu"
+	     " time avg/max=%.1f/%.1fms"
+	     " compute avg/max=%.1f/%.1fms"
+	     " queue delay avg/max=%.1f/%.1fms",
+	     tlsp_hs_done, tlsp_hs_failed, tlsp_hs_peak, tlsp_hs_throttled,
+	     TLSP_TIME_AVG_MS(tlsp_hs_elapsed, tlsp_hs_done),
+	     1000 * tlsp_hs_elapsed.max,
+	     TLSP_TIME_AVG_MS(tlsp_hs_compute, tlsp_hs_done),
+	     1000 * tlsp_hs_compute.max,
+	     TLSP_TIME_AVG_MS(tlsp_hs_queued, tlsp_hs_done),
+	     1000 * tlsp_hs_queued.max);
+}
+
+/* tlsp_handshake_start - account for new session */
+
+static void tlsp_handshake_start(void)
+{
+    if (++tlsp_hs_active > tlsp_hs_peak)
+	tlsp_hs_peak = tlsp_hs_active;
+    if (var_tlsp_hs_limit > 0 && tlsp_hs_active >= var_tlsp_hs_limit
+	&& tlsp_hs_busy == 0) {
+	if (msg_verbose)
+	    msg_info("%d handshakes in progress -- not accepting sessions",
+		     tlsp_hs_active);
+	tlsp_hs_busy = 1;
+	tlsp_hs_throttled++;
+	event_server_busy(1);
+    }
+}
+
+/* tlsp_handshake_done - account for completed or abandoned handshake */
+
+void    tlsp_handshake_done(TLSP_STATE *state, int ok)
+{
+    struct timeval now;
+    double  elapsed;
+
+    /*
+     * Handshake time statistics include only handshakes that got as far as
+     * SSL_accept(). The handshake slot is released either way.
+     */
+    if (ok) {
+	GETTIMEOFDAY(&now);
+	elapsed = TLSP_SECONDS(now) - TLSP_SECONDS(state->hs_start);
+	tlsp_hs_done++;
+	TLSP_TIME_UPDATE(tlsp_hs_elapsed, elapsed);
+	TLSP_TIME_UPDATE(tlsp_hs_compute, state->hs_compute);
+	TLSP_TIME_UPDATE(tlsp_hs_queued,
+			 tlsp_hs_clock - state->hs_clock - state->hs_compute);
+    } else if (state->flags & TLSP_FLAG_HS_STARTED) {
+	tlsp_hs_failed++;
+    }
+    state->flags &= ~(TLSP_FLAG_DO_HANDSHAKE | TLSP_FLAG_HS_STARTED);
+    tlsp_hs_active--;
+    if (tlsp_hs_busy && tlsp_hs_active < var_tlsp_hs_limit) {
+	if (msg_verbose)
+	    msg_info("%d handshakes in progress -- accepting sessions",
+		     tlsp_hs_active);
+	tlsp_hs_busy = 0;
+	event_server_busy(0);
+    }
+}
+
 /* tlsp_eval_tls_error - translate TLS "error" result into action */
 
 static int tlsp_eval_tls_error(TLSP_STATE *state, int err)
@@ -460,6 +589,8 @@ static void tlsp_strategy(TLSP_STATE *state)
     int     ssl_read_err;
     int     ssl_write_err;
     int     handshake_err;
+    struct timeval before;
+    struct timeval after;
 
     /*
      * Be sure to complete the TLS handshake before enabling plain-text I/O.
@@ -467,7 +598,16 @@ static void tlsp_strategy(TLSP_STATE *state)
      * pending read/write and timeout event requests.
      */
     if (state->flags & TLSP_FLAG_DO_HANDSHAKE) {
+	GETTIMEOFDAY(&before);
+	if ((state->flags & TLSP_FLAG_HS_STARTED) == 0) {
+	    state->flags |= TLSP_FLAG_HS_STARTED;
+	    state->hs_start = before;
+	    state->hs_clock = tlsp_hs_clock;
+	}
 	ssl_stat = SSL_accept(tls_context->con);
+	GETTIMEOFDAY(&after);
+	state->hs_compute += TLSP_SECONDS(after) - TLSP_SECONDS(before);
+	tlsp_hs_clock += TLSP_SECONDS(after) - TLSP_SECONDS(before);
 	if (ssl_stat != 1) {
 	    handshake_err = SSL_get_error(tls_context->con, ssl_stat);
 	    tlsp_eval_tls_error(state, handshake_err);
@@ -488,7 +628,7 @@ static void tlsp_strategy(TLSP_STATE *state)
 	    tlsp_state_free(state);
 	    return;
 	}
-	state->flags &= ~TLSP_FLAG_DO_HANDSHAKE;
+	tlsp_handshake_done(state, 1);
     }
 
     /*
@@ -900,6 +1040,7 @@ static void tlsp_service(VSTREAM *plaintext_stream,
      * Receive postscreen's remote SMTP client address/port and socket.
      */
     state = tlsp_state_create(service, plaintext_stream);
+    tlsp_handshake_start();
     event_enable_read(plaintext_fd, tlsp_get_request_event, (void *) state);
     event_request_timer(tlsp_get_request_event, (void *) state,
 			TLSP_INIT_TIMEOUT);
@@ -1038,6 +1179,7 @@ int     main(int argc, char **argv)
 {
     static const CONFIG_INT_TABLE int_table[] = {
 	VAR_SMTPD_TLS_CCERT_VD, DEF_SMTPD_TLS_CCERT_VD, &var_smtpd_tls_ccert_vd, 0, 0,
+	VAR_TLSP_HS_LIMIT, DEF_TLSP_HS_LIMIT, &var_tlsp_hs_limit, 0, 0,
 	0,
     };
     static const CONFIG_NINT_TABLE nint_table[] = {
@@ -1126,6 +1268,7 @@ int     main(int argc, char **argv)
 		      CA_MAIL_SERVER_PRE_INIT(pre_jail_init),
 		      CA_MAIL_SERVER_POST_INIT(post_jail_init),
 		      CA_MAIL_SERVER_SLOW_EXIT(tlsp_drain),
+		      CA_MAIL_SERVER_EXIT(tlsp_hs_stats),
 		      CA_MAIL_SERVER_WATCHDOG(&var_tlsp_watchdog),
 		      0);
 }
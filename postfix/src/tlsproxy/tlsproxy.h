@@ -8,6 +8,11 @@
 /* DESCRIPTION
 /* .nf
 
+ /*
+  * System library.
+  */
+#include <sys/time.h>
+
  /*
   * Utility library.
   */
@@ -35,13 +40,22 @@ typedef struct {
     char   *server_id;			/* cache management */
     TLS_SESS_STATE *tls_context;	/* llibtls state */
     int     ssl_last_err;		/* TLS I/O state */
+    struct timeval hs_start;		/* first SSL_accept() call */
+    double  hs_clock;			/* process compute time at start */
+    double  hs_compute;			/* time spent in SSL_accept() */
 } TLSP_STATE;
 
 #define TLSP_FLAG_DO_HANDSHAKE	(1<<0)
+#define TLSP_FLAG_HS_STARTED	(1<<1)	/* SSL_accept() was called */
 
 extern TLSP_STATE *tlsp_state_create(const char *, VSTREAM *);
 extern void tlsp_state_free(TLSP_STATE *);
 
+ /*
+  * tlsproxy.c
+  */
+extern void tlsp_handshake_done(TLSP_STATE *, int);
+
 /* LICENSE
 /* .ad
 /* .fi
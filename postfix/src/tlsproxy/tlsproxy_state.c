@@ -49,6 +49,10 @@
 /* .IP server_id
 /*	TLS session cache identifier.
 /*	The destructor will automatically destroy the string.
+/* .IP flags
+/*	When the TLS handshake has not completed, the destructor
+/*	will automatically update the handshake bookkeeping with
+/*	tlsp_handshake_done().
 /* DIAGNOSTICS
 /*	All errors are fatal.
 /* LICENSE
@@ -108,6 +112,8 @@ TLSP_STATE *tlsp_state_create(const char *service,
     state->remote_endpt = 0;
     state->server_id = 0;
     state->tls_context = 0;
+    state->hs_clock = 0;
+    state->hs_compute = 0;
 
     return (state);
 }
@@ -116,6 +122,8 @@ TLSP_STATE *tlsp_state_create(const char *service,
 
 void    tlsp_state_free(TLSP_STATE *state)
 {
+    if (state->flags & TLSP_FLAG_DO_HANDSHAKE)
+	tlsp_handshake_done(state, 0);
     myfree(state->service);
     if (state->plaintext_buf)			/* turns off plaintext events */
 	nbbio_free(state->plaintext_buf);
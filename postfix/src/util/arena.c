@@ -0,0 +1,334 @@
+/*++
+/* NAME
+/*	arena 3
+/* SUMMARY
+/*	region-based memory allocator
+/* SYNOPSIS
+/*	#include <arena.h>
+/*
+/*	ARENA	*arena_create(size)
+/*	ssize_t	size;
+/*
+/*	void	*arena_alloc(arena, len)
+/*	ARENA	*arena;
+/*	ssize_t	len;
+/*
+/*	char	*arena_strdup(arena, str)
+/*	ARENA	*arena;
+/*	const char *str;
+/*
+/*	char	*arena_strndup(arena, str, len)
+/*	ARENA	*arena;
+/*	const char *str;
+/*	ssize_t	len;
+/*
+/*	char	*arena_memdup(arena, ptr, len)
+/*	ARENA	*arena;
+/*	const void *ptr;
+/*	ssize_t	len;
+/*
+/*	void	arena_reset(arena)
+/*	ARENA	*arena;
+/*
+/*	void	arena_free(arena)
+/*	ARENA	*arena;
+/* DESCRIPTION
+/*	This module manages memory whose lifetime ends at a well-defined
+/*	point in time, such as the end of a mail transaction. Memory
+/*	is carved sequentially from large chunks that are obtained
+/*	with mymalloc(), and there is no way to release an individual
+/*	request. Instead, all memory in an arena is released at once.
+/*	Compared to mymalloc() and myfree(), this avoids most calls
+/*	of the system memory allocator, and the per-request overhead.
+/*
+/*	arena_create() creates an arena that allocates memory in chunks
+/*	of the specified size. Specify zero for a default size.
+/*
+/*	arena_alloc() returns memory for the requested number of
+/*	bytes. The memory is not set to zero, and it has the same
+/*	alignment as memory from mymalloc(). Requests larger than
+/*	one quarter of the chunk size are given their own chunk.
+/*
+/*	arena_strdup(), arena_strndup() and arena_memdup() are
+/*	the counterparts of mystrdup(), mystrndup() and mymemdup().
+/*
+/*	arena_reset() makes all memory in the arena available for
+/*	re-use. A limited number of chunks of the default size are
+/*	kept, so that an arena that is reset after each transaction
+/*	needs no memory allocator calls in the steady state.
+/*
+/*	arena_free() destroys an arena, including all memory that
+/*	was allocated from it.
+/* DIAGNOSTICS
+/*	Problems are reported via the msg(3) diagnostics routines:
+/*	the requested amount of memory is not available; improper use
+/*	is detected; other fatal errors.
+/* BUGS
+/*	The caller must not pass arena memory to myfree() or
+/*	myrealloc().
+/* SEE ALSO
+/*	mymalloc(3) memory management wrappers
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <arena.h>
+
+ /*
+  * Structure of one chunk. The payload has the same alignment as memory
+  * from mymalloc().
+  */
+typedef struct ARENA_CHUNK {
+    struct ARENA_CHUNK *next;		/* older chunk */
+    ssize_t size;			/* payload size */
+    union {
+	ALIGN_TYPE align;
+	char    payload[1];		/* actually a bunch of bytes */
+    }       u;
+} ARENA_CHUNK;
+
+#define ARENA_DEF_SIZE	4000
+#define ARENA_ALIGN(n)	(((n) + sizeof(ALIGN_TYPE) - 1) \
+			    & ~(sizeof(ALIGN_TYPE) - 1))
+#define ARENA_BIG(ap, n) ((n) > (ap)->size / 4)
+#define ARENA_SPARE_MAX	16		/* chunks kept after reset */
+
+/* arena_chunk - allocate one chunk */
+
+static ARENA_CHUNK *arena_chunk(ssize_t size)
+{
+    ARENA_CHUNK *cp;
+
+    cp = (ARENA_CHUNK *) mymalloc(offsetof(ARENA_CHUNK, u.payload[0]) + size);
+    cp->size = size;
+    return (cp);
+}
+
+/* arena_create - create arena */
+
+ARENA  *arena_create(ssize_t size)
+{
+    ARENA  *ap;
+
+    if (size < 0)
+	msg_panic("arena_create: bad chunk size %ld", (long) size);
+    ap = (ARENA *) mymalloc(sizeof(*ap));
+    ap->size = ARENA_ALIGN(size > 0 ? size : ARENA_DEF_SIZE);
+    ap->chunk = arena_chunk(ap->size);
+    ap->chunk->next = 0;
+    ap->spare = 0;
+    ap->ptr = ap->chunk->u.payload;
+    ap->end = ap->ptr + ap->size;
+    ap->used = ap->calls = 0;
+    return (ap);
+}
+
+/* arena_alloc - allocate memory from arena */
+
+void   *arena_alloc(ARENA *ap, ssize_t len)
+{
+    ARENA_CHUNK *cp;
+    void   *ptr;
+
+    if (len < 1)
+	msg_panic("arena_alloc: requested length %ld", (long) len);
+    len = ARENA_ALIGN(len);
+    ap->calls += 1;
+    ap->used += len;
+
+    /*
+     * A large request gets its own chunk, behind the current one, so that
+     * the unused space in the current chunk is not lost.
+     */
+    if (ARENA_BIG(ap, len)) {
+	cp = arena_chunk(len);
+	cp->next = ap->chunk->next;
+	ap->chunk->next = cp;
+	return (cp->u.payload);
+    }
+    if (len > ap->end - ap->ptr) {
+	if ((cp = ap->spare) != 0)
+	    ap->spare = cp->next;
+	else
+	    cp = arena_chunk(ap->size);
+	cp->next = ap->chunk;
+	ap->chunk = cp;
+	ap->ptr = cp->u.payload;
+	ap->end = ap->ptr + ap->size;
+    }
+    ptr = ap->ptr;
+    ap->ptr += len;
+    return (ptr);
+}
+
+/* arena_strdup - save string in arena */
+
+char   *arena_strdup(ARENA *ap, const char *str)
+{
+    if (str == 0)
+	msg_panic("arena_strdup: null pointer argument");
+    return (strcpy(arena_alloc(ap, strlen(str) + 1), str));
+}
+
+/* arena_strndup - save substring in arena */
+
+char   *arena_strndup(ARENA *ap, const char *str, ssize_t len)
+{
+    char   *result;
+    char   *cp;
+
+    if (str == 0)
+	msg_panic("arena_strndup: null pointer argument");
+    if (len < 0)
+	msg_panic("arena_strndup: requested length %ld", (long) len);
+    if ((cp = memchr(str, 0, len)) != 0)
+	len = cp - str;
+    result = memcpy(arena_alloc(ap, len + 1), str, len);
+    result[len] = 0;
+    return (result);
+}
+
+/* arena_memdup - copy memory into arena */
+
+char   *arena_memdup(ARENA *ap, const void *ptr, ssize_t len)
+{
+    if (ptr == 0)
+	msg_panic("arena_memdup: null pointer argument");
+    return (memcpy(arena_alloc(ap, len), ptr, len));
+}
+
+/* arena_reset - make all memory in arena available for re-use */
+
+void    arena_reset(ARENA *ap)
+{
+    ARENA_CHUNK *cp;
+    ARENA_CHUNK *next;
+    ARENA_CHUNK *keep = 0;
+    int     spare_count = 0;
+
+    /*
+     * Don't hold on to the memory of one unusually large transaction.
+     */
+    for (cp = ap->spare; cp != 0; cp = cp->next)
+	spare_count += 1;
+    for (cp = ap->chunk; cp != 0; cp = next) {
+	next = cp->next;
+	if (cp->size != ap->size) {
+	    myfree((void *) cp);
+	} else if (keep == 0) {
+	    keep = cp;
+	} else if (spare_count < ARENA_SPARE_MAX) {
+	    cp->next = ap->spare;
+	    ap->spare = cp;
+	    spare_count += 1;
+	} else {
+	    myfree((void *) cp);
+	}
+    }
+    if (keep == 0)
+	msg_panic("arena_reset: no default-size chunk");
+    keep->next = 0;
+    ap->chunk = keep;
+    ap->ptr = keep->u.payload;
+    ap->end = ap->ptr + ap->size;
+    ap->used = ap->calls = 0;
+}
+
+/* arena_free - destroy arena */
+
+void    arena_free(ARENA *ap)
+{
+    ARENA_CHUNK *cp;
+    ARENA_CHUNK *next;
+
+    for (cp = ap->chunk; cp != 0; cp = next) {
+	next = cp->next;
+	myfree((void *) cp);
+    }
+    for (cp = ap->spare; cp != 0; cp = next) {
+	next = cp->next;
+	myfree((void *) cp);
+    }
+    myfree((void *) ap);
+}
+
+#ifdef TEST
+
+ /*
+  * Test program. Fill an arena with strings of random length, verify that
+  * nothing was overwritten and that the memory is aligned, then reset the
+  * arena and repeat. Report the number of memory allocator calls in each
+  * round; after the first round, only the large requests should need a
+  * call.
+  */
+#include <stdlib.h>
+#include <vstream.h>
+#include <msg_vstream.h>
+#include <myrand.h>
+
+#define ROUNDS		4
+#define REQUESTS	2000
+
+int     main(int unused_argc, char **argv)
+{
+    ARENA  *ap;
+    char   *strings[REQUESTS];
+    int     lengths[REQUESTS];
+    long    calls;
+    int     round;
+    int     n;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    mysrand(1);
+    ap = arena_create(0);
+    for (round = 0; round < ROUNDS; round++) {
+	calls = MYMALLOC_CALLS();
+	for (n = 0; n < REQUESTS; n++) {
+
+	    /*
+	     * Mostly short strings, with an occasional large one.
+	     */
+	    lengths[n] = (n % 100 == 99 ? 2000 : 1) + myrand() % 60;
+	    strings[n] = arena_alloc(ap, lengths[n]);
+	    if ((((char *) strings[n]) - (char *) 0) % sizeof(ALIGN_TYPE) != 0)
+		msg_fatal("request %d: bad alignment", n);
+	    memset(strings[n], 'a' + n % 26, lengths[n]);
+	}
+	for (n = 0; n < REQUESTS; n++)
+	    if (strings[n][0] != 'a' + n % 26
+		|| strings[n][lengths[n] - 1] != 'a' + n % 26)
+		msg_fatal("request %d: data was overwritten", n);
+	if (strcmp(arena_strdup(ap, "foo"), "foo") != 0
+	    || strcmp(arena_strndup(ap, "foobar", 3), "foo") != 0
+	    || memcmp(arena_memdup(ap, "bar", 3), "bar", 3) != 0)
+	    msg_fatal("string copy error");
+	vstream_printf("round %d: %ld requests, %ld allocator calls\n",
+		       round + 1, (long) ap->calls, MYMALLOC_CALLS() - calls);
+	calls = MYMALLOC_CALLS();
+	arena_reset(ap);
+	vstream_printf("round %d: reset, %ld allocator calls\n",
+		       round + 1, MYMALLOC_CALLS() - calls);
+    }
+    arena_free(ap);
+    vstream_fflush(VSTREAM_OUT);
+    exit(0);
+}
+
+#endif
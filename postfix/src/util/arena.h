@@ -0,0 +1,46 @@
+#ifndef _ARENA_H_INCLUDED_
+#define _ARENA_H_INCLUDED_
+
+/*++
+/* NAME
+/*	arena 3h
+/* SUMMARY
+/*	region-based memory allocator
+/* SYNOPSIS
+/*	#include <arena.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * External interface.
+  */
+typedef struct ARENA {
+    struct ARENA_CHUNK *chunk;		/* current chunk, then older ones */
+    struct ARENA_CHUNK *spare;		/* unused chunks, after reset */
+    char   *ptr;			/* first unused byte */
+    char   *end;			/* end of current chunk */
+    ssize_t size;			/* default chunk size */
+    ssize_t used;			/* bytes handed out since reset */
+    ssize_t calls;			/* requests since reset */
+} ARENA;
+
+extern ARENA *arena_create(ssize_t);
+extern void *arena_alloc(ARENA *, ssize_t);
+extern char *arena_strdup(ARENA *, const char *);
+extern char *arena_strndup(ARENA *, const char *, ssize_t);
+extern char *arena_memdup(ARENA *, const void *, ssize_t);
+extern void arena_reset(ARENA *);
+extern void arena_free(ARENA *);
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+#endif
@@ -95,15 +95,45 @@ VSTRING *base64_encode(VSTRING *result, const char *in, ssize_t len)
 VSTRING *base64_encode_opt(VSTRING *result, const char *in, ssize_t len,
 			           int flags)
 {
+    static unsigned char *to_b64_pair = 0;
     const unsigned char *cp;
     ssize_t count;
+    unsigned char *out;
+    unsigned int bits;
 
     /*
-     * Encode 3 -> 4.
+     * Once: initialize a table that encodes 12 input bits into two output
+     * characters, so that an input triplet takes two table lookups instead
+     * of four.
+     */
+#define PAIR_COUNT	(1 << 12)
+
+    if (to_b64_pair == 0) {
+	to_b64_pair = (unsigned char *) mymalloc(2 * PAIR_COUNT);
+	for (bits = 0; bits < PAIR_COUNT; bits++) {
+	    to_b64_pair[2 * bits] = to_b64[bits >> 6];
+	    to_b64_pair[2 * bits + 1] = to_b64[bits & 0x3f];
+	}
+    }
+
+    /*
+     * Encode 3 -> 4. Allocate space for the entire result up front, and
+     * encode whole input triplets without per-character buffer overflow
+     * checks; this makes a difference for large inputs. The last one or two
+     * input bytes are encoded the slow way.
      */
     if ((flags & BASE64_FLAG_APPEND) == 0)
 	VSTRING_RESET(result);
-    for (cp = UNSIG_CHAR_PTR(in), count = len; count > 0; count -= 3, cp += 3) {
+    VSTRING_SPACE(result, (len + 2) / 3 * 4 + 1);
+    out = UNSIG_CHAR_PTR(vstring_end(result));
+    for (cp = UNSIG_CHAR_PTR(in), count = len; count >= 3; count -= 3, cp += 3) {
+	bits = cp[0] << 16 | cp[1] << 8 | cp[2];
+	memcpy(out, to_b64_pair + 2 * (bits >> 12), 2);
+	memcpy(out + 2, to_b64_pair + 2 * (bits & 0xfff), 2);
+	out += 4;
+    }
+    VSTRING_AT_OFFSET(result, (char *) out - vstring_str(result));
+    for ( /* void */ ; count > 0; count -= 3, cp += 3) {
 	VSTRING_ADDCH(result, to_b64[cp[0] >> 2]);
 	if (count > 1) {
 	    VSTRING_ADDCH(result, to_b64[(cp[0] & 0x3) << 4 | cp[1] >> 4]);
@@ -143,6 +173,7 @@ VSTRING *base64_decode_opt(VSTRING *result, const char *in, ssize_t len,
     static unsigned char *un_b64 = 0;
     const unsigned char *cp;
     ssize_t count;
+    unsigned char *out;
     unsigned int ch0;
     unsigned int ch1;
     unsigned int ch2;
@@ -168,11 +199,31 @@ VSTRING *base64_decode_opt(VSTRING *result, const char *in, ssize_t len,
     }
 
     /*
-     * Decode 4 -> 3.
+     * Decode 4 -> 3. Allocate space for the entire result up front, and
+     * decode quartets of valid base 64 characters without per-character
+     * buffer overflow checks. All-valid quartets are recognized with one
+     * test, because INVALID has the high bit set and valid table entries
+     * don't. A quartet with padding or with an invalid character is decoded
+     * the slow way, which also handles the end of the input.
      */
     if ((flags & BASE64_FLAG_APPEND) == 0)
 	VSTRING_RESET(result);
-    for (cp = UNSIG_CHAR_PTR(in), count = 0; count < len; count += 4) {
+    VSTRING_SPACE(result, len / 4 * 3 + 1);
+    out = UNSIG_CHAR_PTR(vstring_end(result));
+    for (cp = UNSIG_CHAR_PTR(in), count = 0; count < len; count += 4, cp += 4) {
+	ch0 = un_b64[cp[0]];
+	ch1 = un_b64[cp[1]];
+	ch2 = un_b64[cp[2]];
+	ch3 = un_b64[cp[3]];
+	if ((ch0 | ch1 | ch2 | ch3) & 0x80)
+	    break;
+	out[0] = ch0 << 2 | ch1 >> 4;
+	out[1] = ch1 << 4 | ch2 >> 2;
+	out[2] = ch2 << 6 | ch3;
+	out += 3;
+    }
+    VSTRING_AT_OFFSET(result, (char *) out - vstring_str(result));
+    for ( /* void */ ; count < len; count += 4) {
 	if ((ch0 = un_b64[*cp++]) == INVALID
 	    || (ch1 = un_b64[*cp++]) == INVALID)
 	    return (0);
@@ -195,31 +246,96 @@ VSTRING *base64_decode_opt(VSTRING *result, const char *in, ssize_t len,
 #ifdef TEST
 
  /*
-  * Proof-of-concept test program: convert to base 64 and back.
+  * Proof-of-concept test program: convert to base 64 and back, for all
+  * input lengths up to 256 bytes. With "-t count", report the encoder and
+  * decoder throughput for a 1MB buffer, converted count times.
   */
+#include <sys/time.h>
+#include <stdlib.h>
+#include <vstream.h>
 
 #define STR(x)	vstring_str(x)
 #define LEN(x)	VSTRING_LEN(x)
 
-int     main(int unused_argc, char **unused_argv)
+#define BENCH_SIZE	(1024 * 1024)
+
+static double seconds_since(struct timeval *start)
+{
+    struct timeval now;
+
+    GETTIMEOFDAY(&now);
+    return (now.tv_sec - start->tv_sec
+	    + (now.tv_usec - start->tv_usec) / 1000000.0);
+}
+
+static void bench(int count)
+{
+    VSTRING *b1 = vstring_alloc(BENCH_SIZE * 2);
+    VSTRING *b2 = vstring_alloc(BENCH_SIZE);
+    char   *data = mymalloc(BENCH_SIZE);
+    struct timeval start;
+    double  elapsed;
+    int     n;
+
+    for (n = 0; n < BENCH_SIZE; n++)
+	data[n] = n * 7 + (n >> 8);
+
+#define MB_PER_SEC(bytes, count, elapsed) \
+	((elapsed) > 0 ? (double) (bytes) * (count) / (elapsed) / 1000000 : 0)
+
+    GETTIMEOFDAY(&start);
+    for (n = 0; n < count; n++)
+	base64_encode(b1, data, BENCH_SIZE);
+    elapsed = seconds_since(&start);
+    vstream_printf("encode: %d x %d bytes in %.3f s: %.1f MB/s\n",
+		   count, BENCH_SIZE, elapsed,
+		   MB_PER_SEC(BENCH_SIZE, count, elapsed));
+
+    GETTIMEOFDAY(&start);
+    for (n = 0; n < count; n++)
+	if (base64_decode(b2, STR(b1), LEN(b1)) == 0)
+	    msg_panic("bad base64");
+    elapsed = seconds_since(&start);
+    vstream_printf("decode: %d x %ld bytes in %.3f s: %.1f MB/s\n",
+		   count, (long) LEN(b1), elapsed,
+		   MB_PER_SEC(LEN(b1), count, elapsed));
+    vstream_fflush(VSTREAM_OUT);
+    if (LEN(b2) != BENCH_SIZE || memcmp(STR(b2), data, BENCH_SIZE) != 0)
+	msg_panic("bad decode result");
+    myfree(data);
+    vstring_free(b1);
+    vstring_free(b2);
+}
+
+int     main(int argc, char **argv)
 {
     VSTRING *b1 = vstring_alloc(1);
     VSTRING *b2 = vstring_alloc(1);
     char    test[256];
     int     n;
+    int     len;
 
+    if (argc == 3 && strcmp(argv[1], "-t") == 0) {
+	bench(atoi(argv[2]));
+	exit(0);
+    }
     for (n = 0; n < sizeof(test); n++)
 	test[n] = n;
-    base64_encode(b1, test, sizeof(test));
-    if (base64_decode(b2, STR(b1), LEN(b1)) == 0)
-	msg_panic("bad base64: %s", STR(b1));
-    if (LEN(b2) != sizeof(test))
-	msg_panic("bad decode length: %ld != %ld",
-		  (long) LEN(b2), (long) sizeof(test));
-    for (n = 0; n < sizeof(test); n++)
-	if (STR(b2)[n] != test[n])
-	    msg_panic("bad decode value %d != %d",
-		      (unsigned char) STR(b2)[n], (unsigned char) test[n]);
+    for (len = 0; len <= sizeof(test); len++) {
+	base64_encode(b1, test, len);
+	if (LEN(b1) != (len + 2) / 3 * 4)
+	    msg_panic("bad encode length: %ld != %ld",
+		      (long) LEN(b1), (long) (len + 2) / 3 * 4);
+	if (base64_decode(b2, STR(b1), LEN(b1)) == 0)
+	    msg_panic("bad base64: %s", STR(b1));
+	if (LEN(b2) != len)
+	    msg_panic("bad decode length: %ld != %ld",
+		      (long) LEN(b2), (long) len);
+	for (n = 0; n < len; n++)
+	    if (STR(b2)[n] != test[n])
+		msg_panic("bad decode value %d != %d",
+			  (unsigned char) STR(b2)[n], (unsigned char) test[n]);
+    }
     vstring_free(b1);
     vstring_free(b2);
     return (0);
@@ -0,0 +1,599 @@
+/*++
+/* NAME
+/*	cidr_index 3
+/* SUMMARY
+/*	prefix tree index for CIDR pattern lists
+/* SYNOPSIS
+/*	#include <cidr_index.h>
+/*
+/*	CIDR_INDEX *cidr_index_create(list)
+/*	CIDR_MATCH *list;
+/*
+/*	CIDR_MATCH *cidr_index_execute(index, address)
+/*	CIDR_INDEX *index;
+/*	const char *address;
+/*
+/*	void	cidr_index_free(index)
+/*	CIDR_INDEX *index;
+/* DESCRIPTION
+/*	This module builds an index for a list of parsed CIDR
+/*	patterns, so that an address lookup costs time proportional
+/*	to the address length instead of the number of patterns.
+/*	The result of a lookup is the same as with cidr_match_execute():
+/*	the first matching pattern in list order, with support for
+/*	negation and IF/ENDIF blocks.
+/*
+/*	The list is compiled into a sequence of steps. Each maximal
+/*	run of consecutive positive patterns becomes one path-compressed
+/*	binary prefix tree per address family, in which every pattern
+/*	remembers its position in the list. A lookup walks the tree
+/*	once and selects the matching pattern with the lowest
+/*	position. Negative patterns are evaluated one at a time,
+/*	and the body of an IF/ENDIF block is compiled recursively.
+/*
+/*	cidr_index_create() builds an index for the specified list.
+/*	The list must not be modified or destroyed while the index
+/*	is in use.
+/*
+/*	cidr_index_execute() looks up the specified address, and
+/*	returns the first matching list element, or a null pointer
+/*	when no pattern matches or when the address is malformed.
+/*
+/*	cidr_index_free() destroys the index. It does not destroy
+/*	the list.
+/* SEE ALSO
+/*	cidr_match(3) CIDR-style pattern matching
+/*	dict_cidr(3) CIDR-style lookup table
+/* DIAGNOSTICS
+/*	Fatal errors: out of memory.
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <myaddrinfo.h>
+#include <cidr_match.h>
+#include <cidr_index.h>
+
+/* Application-specific. */
+
+ /*
+  * A prefix tree node. Each node covers the first prefix_len bits of the
+  * network address bytes of some pattern in the subtree below it, so there
+  * is no need to store a private copy of the address bits. A node without
+  * pattern exists only to join two subtrees.
+  */
+typedef struct CIDR_INDEX_NODE {
+    const unsigned char *net_bytes;	/* prefix bits */
+    int     prefix_len;			/* prefix bit count */
+    int     position;			/* pattern list position */
+    CIDR_MATCH *entry;			/* pattern or null */
+    struct CIDR_INDEX_NODE *child[2];	/* next bit is 0 or 1 */
+} CIDR_INDEX_NODE;
+
+ /*
+  * One compiled step. A step is either a prefix tree with consecutive
+  * positive patterns, a single negative pattern, or an IF/ENDIF block.
+  */
+#define CIDR_INDEX_FAMILY_COUNT	2	/* AF_INET, AF_INET6 */
+
+typedef struct CIDR_INDEX_STEP {
+    int     type;			/* see below */
+    CIDR_INDEX_NODE *tree[CIDR_INDEX_FAMILY_COUNT];
+    CIDR_MATCH *entry;			/* negative pattern or IF */
+    CIDR_INDEX *block;			/* IF/ENDIF block body */
+    struct CIDR_INDEX_STEP *next;	/* next step */
+} CIDR_INDEX_STEP;
+
+#define CIDR_INDEX_STEP_TREE	1	/* positive patterns */
+#define CIDR_INDEX_STEP_MATCH	2	/* negative pattern */
+#define CIDR_INDEX_STEP_IF	3	/* IF/ENDIF block */
+
+struct CIDR_INDEX {
+    CIDR_INDEX_STEP *head;		/* first step */
+};
+
+#ifdef HAS_IPV6
+#define CIDR_INDEX_ADDR_FAMILY(a) (strchr((a), ':') ? AF_INET6 : AF_INET)
+#define CIDR_INDEX_FAMILY_SLOT(f) ((f) == AF_INET6)
+#else
+#define CIDR_INDEX_ADDR_FAMILY(a) (AF_INET)
+#define CIDR_INDEX_FAMILY_SLOT(f) (0)
+#endif
+
+#define CIDR_INDEX_BIT(bytes, n) (((bytes)[(n) / 8] >> (7 - (n) % 8)) & 1)
+
+/* cidr_index_prefix_match - compare leading address bits */
+
+static int cidr_index_prefix_match(const unsigned char *a,
+			             const unsigned char *b, int prefix_len)
+{
+    int     full_bytes = prefix_len / 8;
+    int     rest_bits = prefix_len % 8;
+    unsigned char mask;
+
+    if (full_bytes > 0 && memcmp(a, b, full_bytes) != 0)
+	return (0);
+    if (rest_bits == 0)
+	return (1);
+    mask = ~0U << (8 - rest_bits);
+    return (((a[full_bytes] ^ b[full_bytes]) & mask) == 0);
+}
+
+/* cidr_index_common_len - count leading equal address bits */
+
+static int cidr_index_common_len(const unsigned char *a,
+				         const unsigned char *b, int max_len)
+{
+    int     len = 0;
+
+    while (len + 8 <= max_len && a[len / 8] == b[len / 8])
+	len += 8;
+    while (len < max_len && CIDR_INDEX_BIT(a, len) == CIDR_INDEX_BIT(b, len))
+	len += 1;
+    return (len);
+}
+
+/* cidr_index_node_alloc - create prefix tree node */
+
+static CIDR_INDEX_NODE *cidr_index_node_alloc(const unsigned char *net_bytes,
+					              int prefix_len)
+{
+    CIDR_INDEX_NODE *node;
+
+    node = (CIDR_INDEX_NODE *) mymalloc(sizeof(*node));
+    node->net_bytes = net_bytes;
+    node->prefix_len = prefix_len;
+    node->position = 0;
+    node->entry = 0;
+    node->child[0] = node->child[1] = 0;
+    return (node);
+}
+
+/* cidr_index_insert - add positive pattern to prefix tree */
+
+static void cidr_index_insert(CIDR_INDEX_NODE **where, CIDR_MATCH *entry,
+			              int position)
+{
+    const unsigned char *net_bytes = entry->net_bytes;
+    int     prefix_len = entry->mask_shift;
+    CIDR_INDEX_NODE *node;
+    CIDR_INDEX_NODE *join;
+    int     common_len;
+
+    for (;;) {
+
+	/*
+	 * Empty slot: add a new leaf.
+	 */
+	if ((node = *where) == 0) {
+	    node = *where = cidr_index_node_alloc(net_bytes, prefix_len);
+	    node->entry = entry;
+	    node->position = position;
+	    return;
+	}
+	common_len = cidr_index_common_len(node->net_bytes, net_bytes,
+					   node->prefix_len < prefix_len ?
+					   node->prefix_len : prefix_len);
+
+	/*
+	 * The node prefix covers the new pattern. If the prefix is the same,
+	 * an earlier pattern wins. Otherwise, descend into the subtree.
+	 */
+	if (common_len == node->prefix_len) {
+	    if (prefix_len == node->prefix_len) {
+		if (node->entry == 0) {
+		    node->entry = entry;
+		    node->position = position;
+		}
+		return;
+	    }
+	    where = node->child + CIDR_INDEX_BIT(net_bytes, node->prefix_len);
+	    continue;
+	}
+
+	/*
+	 * The prefixes diverge, or the new pattern covers the node. Insert a
+	 * node for the common prefix.
+	 */
+	join = cidr_index_node_alloc(net_bytes, common_len);
+	join->child[CIDR_INDEX_BIT(node->net_bytes, common_len)] = node;
+	if (common_len == prefix_len) {
+	    join->entry = entry;
+	    join->position = position;
+	} else {
+	    join->child[CIDR_INDEX_BIT(net_bytes, common_len)] =
+		node = cidr_index_node_alloc(net_bytes, prefix_len);
+	    node->entry = entry;
+	    node->position = position;
+	}
+	*where = join;
+	return;
+    }
+}
+
+/* cidr_index_search - find earliest matching pattern in prefix tree */
+
+static CIDR_MATCH *cidr_index_search(CIDR_INDEX_NODE *node,
+				             const unsigned char *addr_bytes,
+				             int addr_bit_count)
+{
+    CIDR_INDEX_NODE *best = 0;
+
+    while (node != 0
+	   && cidr_index_prefix_match(node->net_bytes, addr_bytes,
+				      node->prefix_len)) {
+	if (node->entry != 0 && (best == 0 || node->position < best->position))
+	    best = node;
+	if (node->prefix_len >= addr_bit_count)
+	    break;
+	node = node->child[CIDR_INDEX_BIT(addr_bytes, node->prefix_len)];
+    }
+    return (best ? best->entry : 0);
+}
+
+/* cidr_index_node_free - destroy prefix tree */
+
+static void cidr_index_node_free(CIDR_INDEX_NODE *node)
+{
+    if (node != 0) {
+	cidr_index_node_free(node->child[0]);
+	cidr_index_node_free(node->child[1]);
+	myfree((void *) node);
+    }
+}
+
+/* cidr_index_step_alloc - append step */
+
+static CIDR_INDEX_STEP *cidr_index_step_alloc(CIDR_INDEX_STEP ***tail,
+					              int type)
+{
+    CIDR_INDEX_STEP *step;
+
+    step = (CIDR_INDEX_STEP *) mymalloc(sizeof(*step));
+    step->type = type;
+    step->tree[0] = step->tree[1] = 0;
+    step->entry = 0;
+    step->block = 0;
+    step->next = 0;
+    **tail = step;
+    *tail = &step->next;
+    return (step);
+}
+
+/* cidr_index_compile - compile list elements up to the block end */
+
+static CIDR_INDEX *cidr_index_compile(CIDR_MATCH *list, CIDR_MATCH *stop,
+				              int *position)
+{
+    CIDR_INDEX *index;
+    CIDR_INDEX_STEP **tail;
+    CIDR_INDEX_STEP *step = 0;
+    CIDR_MATCH *entry;
+
+    index = (CIDR_INDEX *) mymalloc(sizeof(*index));
+    index->head = 0;
+    tail = &index->head;
+
+    for (entry = list; entry != 0 && entry != stop; entry = entry->next) {
+	*position += 1;
+	switch (entry->op) {
+
+	    /*
+	     * Consecutive positive patterns share one prefix tree.
+	     */
+	case CIDR_MATCH_OP_MATCH:
+	    if (entry->match) {
+		if (step == 0 || step->type != CIDR_INDEX_STEP_TREE)
+		    step = cidr_index_step_alloc(&tail, CIDR_INDEX_STEP_TREE);
+		cidr_index_insert(step->tree
+				  + CIDR_INDEX_FAMILY_SLOT(entry->addr_family),
+				  entry, *position);
+	    } else {
+		step = cidr_index_step_alloc(&tail, CIDR_INDEX_STEP_MATCH);
+		step->entry = entry;
+	    }
+	    break;
+
+	    /*
+	     * An IF without matching ENDIF extends to the end of the list.
+	     */
+	case CIDR_MATCH_OP_IF:
+	    step = cidr_index_step_alloc(&tail, CIDR_INDEX_STEP_IF);
+	    step->entry = entry;
+	    step->block = cidr_index_compile(entry->next, entry->block_end,
+					      position);
+	    if ((entry = entry->block_end) == 0)
+		return (index);
+	    *position += 1;
+	    break;
+
+	    /*
+	     * An ENDIF without IF is ignored, as with cidr_match_execute().
+	     */
+	case CIDR_MATCH_OP_ENDIF:
+	    break;
+	}
+    }
+    return (index);
+}
+
+/* cidr_index_create - build index for CIDR pattern list */
+
+CIDR_INDEX *cidr_index_create(CIDR_MATCH *list)
+{
+    int     position = 0;
+
+    return (cidr_index_compile(list, (CIDR_MATCH *) 0, &position));
+}
+
+/* cidr_index_entry_match - match one pattern, with negation */
+
+static int cidr_index_entry_match(CIDR_MATCH *entry, unsigned addr_family,
+				          const unsigned char *addr_bytes)
+{
+    if (entry->addr_family != addr_family)
+	return (0);
+    return (cidr_index_prefix_match(entry->net_bytes, addr_bytes,
+				    entry->mask_shift) ? entry->match :
+	    !entry->match);
+}
+
+/* cidr_index_lookup - search compiled steps */
+
+static CIDR_MATCH *cidr_index_lookup(CIDR_INDEX *index, unsigned addr_family,
+				             const unsigned char *addr_bytes,
+				             int addr_bit_count)
+{
+    CIDR_INDEX_STEP *step;
+    CIDR_MATCH *entry;
+
+    for (step = index->head; step != 0; step = step->next) {
+	switch (step->type) {
+	case CIDR_INDEX_STEP_TREE:
+	    if ((entry = cidr_index_search(
+			    step->tree[CIDR_INDEX_FAMILY_SLOT(addr_family)],
+					   addr_bytes, addr_bit_count)) != 0)
+		return (entry);
+	    break;
+	case CIDR_INDEX_STEP_MATCH:
+	    if (cidr_index_entry_match(step->entry, addr_family, addr_bytes))
+		return (step->entry);
+	    break;
+	case CIDR_INDEX_STEP_IF:
+	    if (cidr_index_entry_match(step->entry, addr_family, addr_bytes)) {
+		if ((entry = cidr_index_lookup(step->block, addr_family,
+					   addr_bytes, addr_bit_count)) != 0)
+		    return (entry);
+	    }
+	    /* An IF without matching ENDIF has no end-of block entry. */
+	    else if (step->entry->block_end == 0)
+		return (0);
+	    break;
+	default:
+	    msg_panic("cidr_index_lookup: unknown step type %d", step->type);
+	}
+    }
+    return (0);
+}
+
+/* cidr_index_execute - look up address */
+
+CIDR_MATCH *cidr_index_execute(CIDR_INDEX *index, const char *addr)
+{
+    unsigned char addr_bytes[CIDR_MATCH_ABYTES];
+    unsigned addr_family;
+
+    addr_family = CIDR_INDEX_ADDR_FAMILY(addr);
+    if (inet_pton(addr_family, addr, addr_bytes) != 1)
+	return (0);
+    return (cidr_index_lookup(index, addr_family, addr_bytes,
+			      addr_family == AF_INET ?
+			      MAI_V4ADDR_BITS : MAI_V6ADDR_BITS));
+}
+
+/* cidr_index_free - destroy index */
+
+void    cidr_index_free(CIDR_INDEX *index)
+{
+    CIDR_INDEX_STEP *step;
+    CIDR_INDEX_STEP *next;
+
+    for (step = index->head; step != 0; step = next) {
+	next = step->next;
+	cidr_index_node_free(step->tree[0]);
+	cidr_index_node_free(step->tree[1]);
+	if (step->block)
+	    cidr_index_free(step->block);
+	myfree((void *) step);
+    }
+    myfree((void *) index);
+}
+
+#ifdef TEST
+
+ /*
+  * Test program. Read CIDR patterns from the named file, one per line, with
+  * optional "if pattern" and "endif" lines. Then read addresses from stdin,
+  * and report the matching pattern's line number. Each address is looked up
+  * with both cidr_index_execute() and cidr_match_execute(), and any
+  * difference is reported. With "-b count", time count passes over all
+  * addresses with each method.
+  */
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <msg_vstream.h>
+#include <vstream.h>
+#include <vstring.h>
+#include <vstring_vstream.h>
+#include <stringops.h>
+#include <argv.h>
+
+typedef struct {
+    CIDR_MATCH cidr_info;		/* must be first */
+    int     lineno;
+} TEST_ENTRY;
+
+#define MAX_NESTING	100
+
+static CIDR_MATCH *load_patterns(const char *path)
+{
+    VSTREAM *fp;
+    VSTRING *buf = vstring_alloc(100);
+    VSTRING *why = vstring_alloc(100);
+    TEST_ENTRY *stack[MAX_NESTING];
+    TEST_ENTRY *entry;
+    CIDR_MATCH *head = 0;
+    CIDR_MATCH **tail = &head;
+    int     nesting = 0;
+    int     lineno = 0;
+    char   *cp;
+    char   *word;
+    int     match;
+    int     is_if;
+
+    if ((fp = vstream_fopen(path, O_RDONLY, 0)) == 0)
+	msg_fatal("open %s: %m", path);
+    while (vstring_get_nonl(buf, fp) != VSTREAM_EOF) {
+	lineno++;
+	cp = vstring_str(buf);
+	if ((word = mystrtok(&cp, CHARS_SPACE)) == 0 || *word == '#')
+	    continue;
+	entry = (TEST_ENTRY *) mymalloc(sizeof(*entry));
+	entry->lineno = lineno;
+	if (strcasecmp(word, "endif") == 0) {
+	    if (nesting == 0)
+		msg_fatal("line %d: ENDIF without IF", lineno);
+	    cidr_match_endif(&entry->cidr_info);
+	    stack[--nesting]->cidr_info.block_end = &entry->cidr_info;
+	} else {
+	    if ((is_if = (strcasecmp(word, "if") == 0)) != 0
+		&& (word = mystrtok(&cp, CHARS_SPACE)) == 0)
+		msg_fatal("line %d: no address pattern", lineno);
+	    for (match = 1; *word == '!'; word++)
+		match = !match;
+	    if ((is_if ? cidr_match_parse_if : cidr_match_parse)
+		(&entry->cidr_info, word, match, why) != 0)
+		msg_fatal("line %d: %s", lineno, vstring_str(why));
+	    if (is_if) {
+		if (nesting >= MAX_NESTING)
+		    msg_fatal("line %d: too much nesting", lineno);
+		stack[nesting++] = entry;
+	    }
+	}
+	*tail = &entry->cidr_info;
+	tail = &entry->cidr_info.next;
+    }
+    vstream_fclose(fp);
+    vstring_free(buf);
+    vstring_free(why);
+    return (head);
+}
+
+static int entry_lineno(CIDR_MATCH *entry)
+{
+    return (entry ? ((TEST_ENTRY *) entry)->lineno : 0);
+}
+
+static double time_lookups(ARGV *addrs, int count, CIDR_MATCH *list,
+			           CIDR_INDEX *index)
+{
+    struct timeval start;
+    struct timeval stop;
+    int     pass;
+    char  **cpp;
+
+    GETTIMEOFDAY(&start);
+    for (pass = 0; pass < count; pass++)
+	for (cpp = addrs->argv; *cpp; cpp++)
+	    if (index)
+		(void) cidr_index_execute(index, *cpp);
+	    else
+		(void) cidr_match_execute(list, *cpp);
+    GETTIMEOFDAY(&stop);
+    return (((stop.tv_sec - start.tv_sec) * 1e6
+	     + (stop.tv_usec - start.tv_usec))
+	    / ((double) count * (addrs->argc ? addrs->argc : 1)));
+}
+
+int     main(int argc, char **argv)
+{
+    CIDR_MATCH *list;
+    CIDR_INDEX *index;
+    VSTRING *buf = vstring_alloc(100);
+    ARGV   *addrs = argv_alloc(100);
+    CIDR_MATCH *linear_result;
+    CIDR_MATCH *index_result;
+    char  **cpp;
+    int     bench_count = 0;
+    int     ch;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    while ((ch = GETOPT(argc, argv, "b:")) > 0) {
+	switch (ch) {
+	case 'b':
+	    if ((bench_count = atoi(optarg)) <= 0)
+		msg_fatal("bad count: %s", optarg);
+	    break;
+	default:
+	    msg_fatal("usage: %s [-b count] pattern_file", argv[0]);
+	}
+    }
+    if (argc != optind + 1)
+	msg_fatal("usage: %s [-b count] pattern_file", argv[0]);
+    list = load_patterns(argv[optind]);
+    index = cidr_index_create(list);
+
+    while (vstring_get_nonl(buf, VSTREAM_IN) != VSTREAM_EOF)
+	if (*vstring_str(buf) && *vstring_str(buf) != '#')
+	    argv_add(addrs, vstring_str(buf), (char *) 0);
+
+    if (bench_count > 0) {
+	vstream_printf("linear: %.3f usec/lookup\n",
+		       time_lookups(addrs, bench_count, list,
+				    (CIDR_INDEX *) 0));
+	vstream_printf("index:  %.3f usec/lookup\n",
+		       time_lookups(addrs, bench_count, list, index));
+    } else {
+	for (cpp = addrs->argv; *cpp; cpp++) {
+	    linear_result = cidr_match_execute(list, *cpp);
+	    index_result = cidr_index_execute(index, *cpp);
+	    if (linear_result != index_result)
+		vstream_printf("%s: MISMATCH linear=%d index=%d\n", *cpp,
+			       entry_lineno(linear_result),
+			       entry_lineno(index_result));
+	    else if (index_result)
+		vstream_printf("%s: line %d\n", *cpp,
+			       entry_lineno(index_result));
+	    else
+		vstream_printf("%s: not found\n", *cpp);
+	}
+    }
+    vstream_fflush(VSTREAM_OUT);
+    cidr_index_free(index);
+    argv_free(addrs);
+    vstring_free(buf);
+    exit(0);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef _CIDR_INDEX_H_INCLUDED_
+#define _CIDR_INDEX_H_INCLUDED_
+
+/*++
+/* NAME
+/*	cidr_index 3h
+/* SUMMARY
+/*	prefix tree index for CIDR pattern lists
+/* SYNOPSIS
+/*	#include <cidr_index.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * Utility library.
+  */
+#include <cidr_match.h>
+
+ /*
+  * External interface.
+  */
+typedef struct CIDR_INDEX CIDR_INDEX;
+
+extern CIDR_INDEX *cidr_index_create(CIDR_MATCH *);
+extern CIDR_MATCH *cidr_index_execute(CIDR_INDEX *, const char *);
+extern void cidr_index_free(CIDR_INDEX *);
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+#endif
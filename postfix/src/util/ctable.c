@@ -16,6 +16,10 @@
 /*	CTABLE	*cache;
 /*	const char *key;
 /*
+/*	const void *ctable_find(cache, key)
+/*	CTABLE	*cache;
+/*	const char *key;
+/*
 /*	const void *ctable_refresh(cache, key)
 /*	CTABLE	*cache;
 /*	const char *key;
@@ -46,6 +50,11 @@
 /*	ctable_locate() looks up or generates the value that corresponds to
 /*	the specified key, and returns that value.
 /*
+/*	ctable_find() looks up the value that corresponds to the
+/*	specified key, without generating a value when the key is
+/*	not in the cache; the result is then a null pointer. This
+/*	function does not change the cache, not even the MRU order.
+/*
 /*	ctable_refresh() flushes the value (if any) associated with
 /*	the specified key, and returns the same result as ctable_locate().
 /*
@@ -177,6 +186,17 @@ const void *ctable_locate(CTABLE *cache, const char *key)
     return (entry->value);
 }
 
+/* ctable_find - look up cache item, do not create */
+
+const void *ctable_find(CTABLE *cache, const char *key)
+{
+    CTABLE_ENTRY *entry;
+
+    if ((entry = (CTABLE_ENTRY *) htable_find(cache->table, key)) == 0)
+	return (0);
+    return (entry->value);
+}
+
 /* ctable_refresh - page-in fresh data for given key */
 
 const void *ctable_refresh(CTABLE *cache, const char *key)
@@ -24,6 +24,7 @@ extern CTABLE *ctable_create(ssize_t, CTABLE_CREATE_FN, CTABLE_DELETE_FN, void *
 extern void ctable_free(CTABLE *);
 extern void ctable_walk(CTABLE *, void (*) (const char *, const void *));
 extern const void *ctable_locate(CTABLE *, const char *);
+extern const void *ctable_find(CTABLE *, const char *);
 extern const void *ctable_refresh(CTABLE *, const char *);
 extern void ctable_newcontext(CTABLE *, void *);
 
@@ -80,6 +80,7 @@ typedef struct DICT {
     char   *name;			/* for diagnostics */
     int     flags;			/* see below */
     const char *(*lookup) (struct DICT *, const char *);
+    const char *(*lookup_first) (struct DICT *, ARGV *, ssize_t *);
     int     (*update) (struct DICT *, const char *, const char *);
     int     (*delete) (struct DICT *, const char *);
     int     (*sequence) (struct DICT *, int, const char **, const char **);
@@ -234,6 +235,8 @@ extern void dict_open_register(const char *, DICT_OPEN_FN);
 extern DICT_OPEN_EXTEND_FN dict_open_extend(DICT_OPEN_EXTEND_FN);
 
 #define dict_get(dp, key)	((const char *) (dp)->lookup((dp), (key)))
+#define dict_get_first(dp, keys, which) \
+	((const char *) (dp)->lookup_first((dp), (keys), (which)))
 #define dict_put(dp, key, val)	(dp)->update((dp), (key), (val))
 #define dict_del(dp, key)	(dp)->delete((dp), (key))
 #define dict_seq(dp, f, key, val) (dp)->sequence((dp), (f), (key), (val))
@@ -251,6 +254,7 @@ extern void dict_type_override(DICT *, const char *);
   */
 typedef struct DICT_UTF8_BACKUP {
     const char *(*lookup) (struct DICT *, const char *);
+    const char *(*lookup_first) (struct DICT *, ARGV *, ssize_t *);
     int     (*update) (struct DICT *, const char *, const char *);
     int     (*delete) (struct DICT *, const char *);
 } DICT_UTF8_BACKUP;
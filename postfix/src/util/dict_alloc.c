@@ -35,6 +35,12 @@
 /*	exclusively after it is opened) for databases that are not
 /*	multi-writer safe.
 /*
+/*	Another exception is the default lookup_first function. It
+/*	invokes the lookup method for one key at a time, until a
+/*	key is found or a lookup fails. A dictionary overrides this
+/*	only when it can look up multiple keys more efficiently,
+/*	for example with one request to a server.
+/*
 /*	dict_free() releases memory and cleans up after dict_alloc().
 /*	It is up to the caller to dispose of any memory that was allocated
 /*	by the caller.
@@ -85,6 +91,24 @@ static const char *dict_default_lookup(DICT *dict, const char *unused_key)
 	      dict->type, dict->name);
 }
 
+/* dict_default_lookup_first - look up one key at a time */
+
+static const char *dict_default_lookup_first(DICT *dict, ARGV *keys,
+					             ssize_t *which)
+{
+    const char *value;
+    ssize_t n;
+
+    for (n = 0; n < keys->argc; n++) {
+	if ((value = dict_get(dict, keys->argv[n])) != 0 || dict->error != 0) {
+	    *which = n;
+	    return (value);
+	}
+    }
+    *which = -1;
+    DICT_ERR_VAL_RETURN(dict, DICT_ERR_NONE, (char *) 0);
+}
+
 /* dict_default_update - trap unimplemented operation */
 
 static int dict_default_update(DICT *dict, const char *unused_key,
@@ -140,6 +164,7 @@ DICT   *dict_alloc(const char *dict_type, const char *dict_name, ssize_t size)
     dict->name = mystrdup(dict_name);
     dict->flags = DICT_FLAG_FIXED;
     dict->lookup = dict_default_lookup;
+    dict->lookup_first = dict_default_lookup_first;
     dict->update = dict_default_update;
     dict->delete = dict_default_delete;
     dict->sequence = dict_default_sequence;
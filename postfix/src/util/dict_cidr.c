@@ -14,6 +14,8 @@
 /*	dict_cidr_open() opens the named file and stores
 /*	the key/value pairs where the key must be either a
 /*	"naked" IP address or a netblock in CIDR notation.
+/*	The rules are indexed with cidr_index(3), so that the
+/*	lookup cost does not grow with the number of rules.
 /* SEE ALSO
 /*	dict(3) generic dictionary manager
 /* AUTHOR(S)
@@ -57,6 +59,7 @@
 #include <dict.h>
 #include <myaddrinfo.h>
 #include <cidr_match.h>
+#include <cidr_index.h>
 #include <dict_cidr.h>
 #include <warn_stat.h>
 #include <mvect.h>
@@ -75,6 +78,7 @@ typedef struct DICT_CIDR_ENTRY {
 typedef struct {
     DICT    dict;			/* generic members */
     DICT_CIDR_ENTRY *head;		/* first entry */
+    CIDR_INDEX *index;			/* prefix tree index */
 } DICT_CIDR;
 
 /* dict_cidr_lookup - CIDR table lookup */
@@ -90,7 +94,7 @@ static const char *dict_cidr_lookup(DICT *dict, const char *key)
     dict->error = 0;
 
     if ((entry = (DICT_CIDR_ENTRY *)
-	 cidr_match_execute(&(dict_cidr->head->cidr_info), key)) != 0)
+	 cidr_index_execute(dict_cidr->index, key)) != 0)
 	return (entry->value);
     return (0);
 }
@@ -103,6 +107,8 @@ static void dict_cidr_close(DICT *dict)
     DICT_CIDR_ENTRY *entry;
     DICT_CIDR_ENTRY *next;
 
+    if (dict_cidr->index)
+	cidr_index_free(dict_cidr->index);
     for (entry = dict_cidr->head; entry; entry = next) {
 	next = (DICT_CIDR_ENTRY *) entry->cidr_info.next;
 	myfree(entry->value);
@@ -293,6 +299,7 @@ DICT   *dict_cidr_open(const char *mapname, int open_flags, int dict_flags)
     dict_cidr->dict.close = dict_cidr_close;
     dict_cidr->dict.flags = dict_flags | DICT_FLAG_PATTERN;
     dict_cidr->head = 0;
+    dict_cidr->index = 0;
 
     dict_cidr->dict.owner.uid = st.st_uid;
     dict_cidr->dict.owner.status = (st.st_uid != 0);
@@ -341,5 +348,7 @@ DICT   *dict_cidr_open(const char *mapname, int open_flags, int dict_flags)
     if (rule_stack)
 	(void) mvect_free(&mvect);
 
+    dict_cidr->index = cidr_index_create(&(dict_cidr->head->cidr_info));
+
     DICT_CIDR_OPEN_RETURN(DICT_DEBUG (&dict_cidr->dict));
 }
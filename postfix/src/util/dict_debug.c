@@ -67,6 +67,25 @@ static const char *dict_debug_lookup(DICT *dict, const char *key)
     DICT_ERR_VAL_RETURN(dict, real_dict->error, result);
 }
 
+/* dict_debug_lookup_first - log multi-key lookup operation */
+
+static const char *dict_debug_lookup_first(DICT *dict, ARGV *keys,
+					           ssize_t *which)
+{
+    DICT_DEBUG *dict_debug = (DICT_DEBUG *) dict;
+    DICT   *real_dict = dict_debug->real_dict;
+    const char *result;
+
+    real_dict->flags = dict->flags;
+    result = dict_get_first(real_dict, keys, which);
+    dict->flags = real_dict->flags;
+    msg_info("%s:%s lookup_first: %ld keys, \"%s\" = \"%s\"",
+	     dict->type, dict->name, (long) keys->argc,
+	     *which >= 0 ? keys->argv[*which] : "",
+	     result ? result : real_dict->error ? "error" : "not_found");
+    DICT_ERR_VAL_RETURN(dict, real_dict->error, result);
+}
+
 /* dict_debug_update - log update operation */
 
 static int dict_debug_update(DICT *dict, const char *key, const char *value)
@@ -141,6 +160,7 @@ DICT   *dict_debug(DICT *real_dict)
 				      real_dict->name, sizeof(*dict_debug));
     dict_debug->dict.flags = real_dict->flags;	/* XXX not synchronized */
     dict_debug->dict.lookup = dict_debug_lookup;
+    dict_debug->dict.lookup_first = dict_debug_lookup_first;
     dict_debug->dict.update = dict_debug_update;
     dict_debug->dict.delete = dict_debug_delete;
     dict_debug->dict.sequence = dict_debug_sequence;
@@ -26,6 +26,11 @@
 /*	DICT	*dict;
 /*	const char *key;
 /*
+/*	const char *dict_get_first(dict, keys, which)
+/*	DICT	*dict;
+/*	ARGV	*keys;
+/*	ssize_t	*which;
+/*
 /*	int	dict_del(dict, key)
 /*	DICT	*dict;
 /*	const char *key;
@@ -192,8 +197,9 @@
 /*	dict_open3() takes separate arguments for dictionary type and
 /*	name, but otherwise performs the same functions as dict_open().
 /*
-/*	The dict_get(), dict_put(), dict_del(), and dict_seq()
-/*	macros evaluate their first argument multiple times.
+/*	The dict_get(), dict_get_first(), dict_put(), dict_del(),
+/*	and dict_seq() macros evaluate their first argument multiple
+/*	times.
 /*	These names should have been in uppercase.
 /*
 /*	dict_get() retrieves the value stored in the named dictionary
@@ -202,6 +208,13 @@
 /*	implementation. Make a copy if the result is to be modified,
 /*	or if the result is to survive multiple table lookups.
 /*
+/*	dict_get_first() looks up the specified keys in order, and
+/*	stops at the first key that is found or that causes a lookup
+/*	error. The result is as with dict_get() for that key, and
+/*	\fIwhich\fR is set to the index of that key, or to -1 when
+/*	no key was found. This allows a client of a remote table to
+/*	look up all candidate keys for one search with one request.
+/*
 /*	dict_put() stores the specified key and value into the named
 /*	dictionary. A zero (DICT_STAT_SUCCESS) result means the
 /*	update was made.
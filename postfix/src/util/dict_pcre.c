@@ -14,8 +14,15 @@
 /*	dict_pcre_open() opens the named file and compiles the contained
 /*	regular expressions. The result object can be used to match strings
 /*	against the table.
+/*
+/*	With regexp_prefilter_enable (the default), a lookup first
+/*	scans the lookup string once for the required literal
+/*	substrings of all positive patterns, and skips rules whose
+/*	literal is absent without running the regular expression.
+/*	This does not change the lookup result.
 /* SEE ALSO
 /*	dict(3) generic dictionary manager
+/*	regexp_prefilter(3) literal substring prefilter
 /* AUTHOR(S)
 /*	Andrew McNamara
 /*	andrewm@connect.com.au
@@ -66,6 +73,7 @@
 #include "pcre.h"
 #include "warn_stat.h"
 #include "mvect.h"
+#include "regexp_prefilter.h"
 
  /*
   * Backwards compatibility.
@@ -108,6 +116,7 @@ typedef struct {
 typedef struct DICT_PCRE_RULE {
     int     op;				/* DICT_PCRE_OP_MATCH/IF/ENDIF */
     int     lineno;			/* source file line number */
+    int     prefilter_id;		/* required literal or NONE */
     struct DICT_PCRE_RULE *next;	/* next rule in dict */
 } DICT_PCRE_RULE;
 
@@ -135,8 +144,22 @@ typedef struct {
     DICT    dict;			/* generic members */
     DICT_PCRE_RULE *head;
     VSTRING *expansion_buf;		/* lookup result */
+    REGEXP_PREFILTER *prefilter;	/* required literals */
 } DICT_PCRE;
 
+ /*
+  * A rule whose required literal is not in the lookup string cannot match.
+  */
+#define DICT_PCRE_SKIP(dict_pcre, rule) \
+    ((rule)->prefilter_id != REGEXP_PREFILTER_NONE \
+     && !REGEXP_PREFILTER_HIT((dict_pcre)->prefilter, (rule)->prefilter_id))
+
+ /*
+  * Patterns that ignore whitespace are not supported by the prefilter.
+  */
+#define DICT_PCRE_PREFILTER_OK(regexp) \
+    ((regexp).match && ((regexp).options & PCRE_EXTENDED) == 0)
+
 static int dict_pcre_init = 0;		/* flag need to init pcre library */
 
 /*
@@ -304,6 +327,13 @@ static const char *dict_pcre_lookup(DICT *dict, const char *lookup_string)
 	vstring_strcpy(dict->fold_buf, lookup_string);
 	lookup_string = lowercase(vstring_str(dict->fold_buf));
     }
+
+    /*
+     * Find out what rules can be skipped.
+     */
+    if (dict_pcre->prefilter)
+	regexp_prefilter_execute(dict_pcre->prefilter, lookup_string);
+
     for (rule = dict_pcre->head; rule; rule = rule->next) {
 
 	switch (rule->op) {
@@ -313,6 +343,8 @@ static const char *dict_pcre_lookup(DICT *dict, const char *lookup_string)
 	     */
 	case DICT_PCRE_OP_MATCH:
 	    match_rule = (DICT_PCRE_MATCH_RULE *) rule;
+	    if (DICT_PCRE_SKIP(dict_pcre, rule))
+		continue;
 	    if (!DICT_PCRE_EXEC(ctxt, dict->name, rule->lineno,
 				match_rule->pattern, match_rule->hints,
 			      match_rule->match, lookup_string, lookup_len))
@@ -352,9 +384,10 @@ static const char *dict_pcre_lookup(DICT *dict, const char *lookup_string)
 	     */
 	case DICT_PCRE_OP_IF:
 	    if_rule = (DICT_PCRE_IF_RULE *) rule;
-	    if (DICT_PCRE_EXEC(ctxt, dict->name, rule->lineno,
-			       if_rule->pattern, if_rule->hints,
-			       if_rule->match, lookup_string, lookup_len))
+	    if (!DICT_PCRE_SKIP(dict_pcre, rule)
+		&& DICT_PCRE_EXEC(ctxt, dict->name, rule->lineno,
+				  if_rule->pattern, if_rule->hints,
+				  if_rule->match, lookup_string, lookup_len))
 		continue;
 	    /* An IF without matching ENDIF has no "endif" rule. */
 	    if ((rule = if_rule->endif_rule) == 0)
@@ -412,6 +445,8 @@ static void dict_pcre_close(DICT *dict)
     }
     if (dict_pcre->expansion_buf)
 	vstring_free(dict_pcre->expansion_buf);
+    if (dict_pcre->prefilter)
+	regexp_prefilter_free(dict_pcre->prefilter);
     if (dict->fold_buf)
 	vstring_free(dict->fold_buf);
     dict_free(dict);
@@ -579,6 +614,7 @@ static DICT_PCRE_RULE *dict_pcre_rule_alloc(int op, int lineno, size_t size)
     rule = (DICT_PCRE_RULE *) mymalloc(size);
     rule->op = op;
     rule->lineno = lineno;
+    rule->prefilter_id = REGEXP_PREFILTER_NONE;
     rule->next = 0;
 
     return (rule);
@@ -588,7 +624,8 @@ static DICT_PCRE_RULE *dict_pcre_rule_alloc(int op, int lineno, size_t size)
 
 static DICT_PCRE_RULE *dict_pcre_parse_rule(const char *mapname, int lineno,
 					            char *line, int nesting,
-					            int dict_flags)
+					            int dict_flags,
+					            REGEXP_PREFILTER *prefilter)
 {
     char   *p;
     int     actual_sub;
@@ -695,6 +732,15 @@ static DICT_PCRE_RULE *dict_pcre_parse_rule(const char *mapname, int lineno,
 	    match_rule->replacement = mystrdup(p);
 	match_rule->pattern = engine.pattern;
 	match_rule->hints = engine.hints;
+
+	/*
+	 * Register the pattern's required literal, if any. Negative
+	 * patterns are always evaluated.
+	 */
+	if (prefilter != 0 && DICT_PCRE_PREFILTER_OK(regexp))
+	    match_rule->rule.prefilter_id =
+		regexp_prefilter_add(prefilter, regexp.regexp,
+				     REGEXP_PREFILTER_FLAG_PCRE);
 	return ((DICT_PCRE_RULE *) match_rule);
     }
 
@@ -743,6 +789,10 @@ static DICT_PCRE_RULE *dict_pcre_parse_rule(const char *mapname, int lineno,
 	if_rule->match = regexp.match;
 	if_rule->pattern = engine.pattern;
 	if_rule->hints = engine.hints;
+	if (prefilter != 0 && DICT_PCRE_PREFILTER_OK(regexp))
+	    if_rule->rule.prefilter_id =
+		regexp_prefilter_add(prefilter, regexp.regexp,
+				     REGEXP_PREFILTER_FLAG_PCRE);
 	return ((DICT_PCRE_RULE *) if_rule);
     }
 
@@ -850,6 +900,8 @@ DICT   *dict_pcre_open(const char *mapname, int open_flags, int dict_flags)
 	dict_pcre->dict.fold_buf = vstring_alloc(10);
     dict_pcre->head = 0;
     dict_pcre->expansion_buf = 0;
+    dict_pcre->prefilter =
+	regexp_prefilter_enable ? regexp_prefilter_create() : 0;
 
     if (dict_pcre_init == 0) {
 	pcre_malloc = (void *(*) (size_t)) mymalloc;
@@ -867,7 +919,8 @@ DICT   *dict_pcre_open(const char *mapname, int open_flags, int dict_flags)
 	trimblanks(p, 0)[0] = 0;		/* Trim space at end */
 	if (*p == 0)
 	    continue;
-	rule = dict_pcre_parse_rule(mapname, lineno, p, nesting, dict_flags);
+	rule = dict_pcre_parse_rule(mapname, lineno, p, nesting, dict_flags,
+				    dict_pcre->prefilter);
 	if (rule == 0)
 	    continue;
 	if (rule->op == DICT_PCRE_OP_IF) {
@@ -906,6 +959,14 @@ DICT   *dict_pcre_open(const char *mapname, int open_flags, int dict_flags)
     if (rule_stack)
 	(void) mvect_free(&mvect);
 
+    /*
+     * Don't scan lookup strings when no rule can be skipped.
+     */
+    if (dict_pcre->prefilter && dict_pcre->prefilter->patterns == 0) {
+	regexp_prefilter_free(dict_pcre->prefilter);
+	dict_pcre->prefilter = 0;
+    }
+
     DICT_PCRE_OPEN_RETURN(DICT_DEBUG (&dict_pcre->dict));
 }
 
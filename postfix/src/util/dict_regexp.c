@@ -14,8 +14,15 @@
 /*	dict_regexp_open() opens the named file and compiles the contained
 /*	regular expressions. The result object can be used to match strings
 /*	against the table.
+/*
+/*	With regexp_prefilter_enable (the default), a lookup first
+/*	scans the lookup string once for the required literal
+/*	substrings of all positive patterns, and skips rules whose
+/*	literal is absent without running the regular expression.
+/*	This does not change the lookup result.
 /* SEE ALSO
 /*	dict(3) generic dictionary manager
+/*	regexp_prefilter(3) literal substring prefilter
 /*	regexp_table(5) format of Postfix regular expression tables
 /* AUTHOR(S)
 /*	LaMont Jones
@@ -68,6 +75,7 @@
 #include "mac_parse.h"
 #include "warn_stat.h"
 #include "mvect.h"
+#include "regexp_prefilter.h"
 
  /*
   * Support for IF/ENDIF based on an idea by Bert Driehuis.
@@ -91,6 +99,7 @@ typedef struct {
 typedef struct DICT_REGEXP_RULE {
     int     op;				/* DICT_REGEXP_OP_MATCH/IF/ENDIF */
     int     lineno;			/* source file line number */
+    int     prefilter_id;		/* required literal or NONE */
     struct DICT_REGEXP_RULE *next;	/* next rule in dict */
 } DICT_REGEXP_RULE;
 
@@ -119,8 +128,16 @@ typedef struct {
     regmatch_t *pmatch;			/* matched substring info */
     DICT_REGEXP_RULE *head;		/* first rule */
     VSTRING *expansion_buf;		/* lookup result */
+    REGEXP_PREFILTER *prefilter;	/* required literals */
 } DICT_REGEXP;
 
+ /*
+  * A rule whose required literal is not in the lookup string cannot match.
+  */
+#define DICT_REGEXP_SKIP(dict_regexp, rule) \
+    ((rule)->prefilter_id != REGEXP_PREFILTER_NONE \
+     && !REGEXP_PREFILTER_HIT((dict_regexp)->prefilter, (rule)->prefilter_id))
+
  /*
   * Macros to make dense code more readable.
   */
@@ -237,6 +254,13 @@ static const char *dict_regexp_lookup(DICT *dict, const char *lookup_string)
 	vstring_strcpy(dict->fold_buf, lookup_string);
 	lookup_string = lowercase(vstring_str(dict->fold_buf));
     }
+
+    /*
+     * Find out what rules can be skipped.
+     */
+    if (dict_regexp->prefilter)
+	regexp_prefilter_execute(dict_regexp->prefilter, lookup_string);
+
     for (rule = dict_regexp->head; rule; rule = rule->next) {
 
 	switch (rule->op) {
@@ -247,6 +271,8 @@ static const char *dict_regexp_lookup(DICT *dict, const char *lookup_string)
 	     */
 	case DICT_REGEXP_OP_MATCH:
 	    match_rule = (DICT_REGEXP_MATCH_RULE *) rule;
+	    if (DICT_REGEXP_SKIP(dict_regexp, rule))
+		continue;
 	    if (!DICT_REGEXP_REGEXEC(error, dict->name, rule->lineno,
 				     match_rule->first_exp,
 				     match_rule->first_match,
@@ -297,9 +323,11 @@ static const char *dict_regexp_lookup(DICT *dict, const char *lookup_string)
 	     */
 	case DICT_REGEXP_OP_IF:
 	    if_rule = (DICT_REGEXP_IF_RULE *) rule;
-	    if (DICT_REGEXP_REGEXEC(error, dict->name, rule->lineno,
-			       if_rule->expr, if_rule->match, lookup_string,
-				    NULL_SUBSTITUTIONS, NULL_MATCH_RESULT))
+	    if (!DICT_REGEXP_SKIP(dict_regexp, rule)
+		&& DICT_REGEXP_REGEXEC(error, dict->name, rule->lineno,
+				       if_rule->expr, if_rule->match,
+				       lookup_string, NULL_SUBSTITUTIONS,
+				       NULL_MATCH_RESULT))
 		continue;
 	    /* An IF without matching ENDIF has no "endif" rule. */
 	    if ((rule = if_rule->endif_rule) == 0)
@@ -363,6 +391,8 @@ static void dict_regexp_close(DICT *dict)
 	myfree((void *) dict_regexp->pmatch);
     if (dict_regexp->expansion_buf)
 	vstring_free(dict_regexp->expansion_buf);
+    if (dict_regexp->prefilter)
+	regexp_prefilter_free(dict_regexp->prefilter);
     if (dict->fold_buf)
 	vstring_free(dict->fold_buf);
     dict_free(dict);
@@ -539,6 +569,7 @@ static DICT_REGEXP_RULE *dict_regexp_rule_alloc(int op, int lineno, size_t size)
     rule = (DICT_REGEXP_RULE *) mymalloc(size);
     rule->op = op;
     rule->lineno = lineno;
+    rule->prefilter_id = REGEXP_PREFILTER_NONE;
     rule->next = 0;
 
     return (rule);
@@ -547,8 +578,9 @@ static DICT_REGEXP_RULE *dict_regexp_rule_alloc(int op, int lineno, size_t size)
 /* dict_regexp_parseline - parse one rule */
 
 static DICT_REGEXP_RULE *dict_regexp_parseline(const char *mapname, int lineno,
-					            char *line, int nesting,
-					               int dict_flags)
+						char *line, int nesting,
+						int dict_flags,
+						REGEXP_PREFILTER *prefilter)
 {
     char   *p;
 
@@ -662,6 +694,16 @@ static DICT_REGEXP_RULE *dict_regexp_parseline(const char *mapname, int lineno,
 	    match_rule->replacement = prescan_context.literal;
 	else
 	    match_rule->replacement = mystrdup(p);
+
+	/*
+	 * Register the primary pattern's required literal, if any. Negative
+	 * and POSIX basic patterns are always evaluated.
+	 */
+	if (prefilter != 0 && first_pat.match
+	    && (first_pat.options & REG_EXTENDED))
+	    match_rule->rule.prefilter_id =
+		regexp_prefilter_add(prefilter, first_pat.regexp,
+				     REGEXP_PREFILTER_FLAG_POSIX);
 	return ((DICT_REGEXP_RULE *) match_rule);
     }
 
@@ -693,6 +735,11 @@ static DICT_REGEXP_RULE *dict_regexp_parseline(const char *mapname, int lineno,
 				   sizeof(DICT_REGEXP_IF_RULE));
 	if_rule->expr = expr;
 	if_rule->match = pattern.match;
+	if (prefilter != 0 && pattern.match
+	    && (pattern.options & REG_EXTENDED))
+	    if_rule->rule.prefilter_id =
+		regexp_prefilter_add(prefilter, pattern.regexp,
+				     REGEXP_PREFILTER_FLAG_POSIX);
 	return ((DICT_REGEXP_RULE *) if_rule);
     }
 
@@ -790,6 +837,8 @@ DICT   *dict_regexp_open(const char *mapname, int open_flags, int dict_flags)
     dict_regexp->head = 0;
     dict_regexp->pmatch = 0;
     dict_regexp->expansion_buf = 0;
+    dict_regexp->prefilter =
+	regexp_prefilter_enable ? regexp_prefilter_create() : 0;
     dict_regexp->dict.owner.uid = st.st_uid;
     dict_regexp->dict.owner.status = (st.st_uid != 0);
 
@@ -801,7 +850,8 @@ DICT   *dict_regexp_open(const char *mapname, int open_flags, int dict_flags)
 	trimblanks(p, 0)[0] = 0;
 	if (*p == 0)
 	    continue;
-	rule = dict_regexp_parseline(mapname, lineno, p, nesting, dict_flags);
+	rule = dict_regexp_parseline(mapname, lineno, p, nesting, dict_flags,
+				     dict_regexp->prefilter);
 	if (rule == 0)
 	    continue;
 	if (rule->op == DICT_REGEXP_OP_MATCH) {
@@ -843,6 +893,14 @@ DICT   *dict_regexp_open(const char *mapname, int open_flags, int dict_flags)
     if (rule_stack)
 	(void) mvect_free(&mvect);
 
+    /*
+     * Don't scan lookup strings when no rule can be skipped.
+     */
+    if (dict_regexp->prefilter && dict_regexp->prefilter->patterns == 0) {
+	regexp_prefilter_free(dict_regexp->prefilter);
+	dict_regexp->prefilter = 0;
+    }
+
     /*
      * Allocate space for only as many matched substrings as used in the
      * replacement text.
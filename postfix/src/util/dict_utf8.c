@@ -9,8 +9,8 @@
 /*	DICT	*dict_utf8_activate(
 /*	DICT	*dict)
 /* DESCRIPTION
-/*	dict_utf8_activate() wraps a dictionary's lookup/update/delete
-/*	methods with code that enforces UTF-8 checks on keys and
+/*	dict_utf8_activate() wraps a dictionary's lookup/lookup_first/
+/*	update/delete methods with code that enforces UTF-8 checks on keys and
 /*	values, and that logs a warning when incorrect UTF-8 is
 /*	encountered. The original dictionary handle becomes invalid.
 /*
@@ -167,6 +167,69 @@ static const char *dict_utf8_lookup(DICT *dict, const char *key)
     }
 }
 
+/* dict_utf8_lookup_first - UTF-8 multi-key lookup method wrapper */
+
+static const char *dict_utf8_lookup_first(DICT *dict, ARGV *keys,
+					          ssize_t *which)
+{
+    DICT_UTF8_BACKUP *backup;
+    const char *utf8_err;
+    const char *fold_res;
+    const char *value;
+    int     saved_flags;
+    ARGV   *fold_keys;
+    ssize_t *fold_index;
+    ssize_t fold_which;
+    ssize_t n;
+
+    /*
+     * Validate and optionally fold the keys, and skip invalid keys. Remember
+     * where each remaining key came from.
+     */
+    fold_keys = argv_alloc(keys->argc + 1);
+    fold_index = (ssize_t *) mymalloc(sizeof(*fold_index) * (keys->argc + 1));
+    for (n = 0; n < keys->argc; n++) {
+	if ((fold_res = dict_utf8_check_fold(dict, keys->argv[n],
+					     &utf8_err)) == 0) {
+	    msg_warn("%s:%s: non-UTF-8 key \"%s\": %s",
+		     dict->type, dict->name, keys->argv[n], utf8_err);
+	    continue;
+	}
+	fold_index[fold_keys->argc] = n;
+	argv_add(fold_keys, fold_res, (char *) 0);
+    }
+
+    /*
+     * Proxy the request with casefolding turned off.
+     */
+    if (fold_keys->argc > 0) {
+	saved_flags = (dict->flags & DICT_FLAG_FOLD_ANY);
+	dict->flags &= ~DICT_FLAG_FOLD_ANY;
+	backup = dict->utf8_backup;
+	value = backup->lookup_first(dict, fold_keys, &fold_which);
+	dict->flags |= saved_flags;
+	*which = (fold_which >= 0 ? fold_index[fold_which] : -1);
+    } else {
+	dict->error = DICT_ERR_NONE;
+	value = 0;
+	*which = -1;
+    }
+    argv_free(fold_keys);
+    myfree((void *) fold_index);
+
+    /*
+     * Validate the result, and if invalid fail the request.
+     */
+    if (value != 0 && dict_utf8_check(value, &utf8_err) == 0) {
+	msg_warn("%s:%s: key \"%s\": non-UTF-8 value \"%s\": %s",
+		 dict->type, dict->name, keys->argv[*which], value, utf8_err);
+	dict->error = DICT_ERR_CONFIG;
+	return (0);
+    } else {
+	return (value);
+    }
+}
+
 /* dict_utf8_update - UTF-8 update method wrapper */
 
 static int dict_utf8_update(DICT *dict, const char *key, const char *value)
@@ -274,14 +337,16 @@ DICT   *dict_utf8_activate(DICT *dict)
     backup = dict->utf8_backup = (DICT_UTF8_BACKUP *) mymalloc(sizeof(*backup));
 
     /*
-     * Interpose on the lookup/update/delete methods. It is a conscious
-     * decision not to tinker with the iterator or destructor.
+     * Interpose on the lookup/lookup_first/update/delete methods. It is a
+     * conscious decision not to tinker with the iterator or destructor.
      */
     backup->lookup = dict->lookup;
+    backup->lookup_first = dict->lookup_first;
     backup->update = dict->update;
     backup->delete = dict->delete;
 
     dict->lookup = dict_utf8_lookup;
+    dict->lookup_first = dict_utf8_lookup_first;
     dict->update = dict_utf8_update;
     dict->delete = dict_utf8_delete;
 
@@ -156,7 +156,7 @@
 #include "mymalloc.h"
 #include "msg.h"
 #include "iostuff.h"
-#include "ring.h"
+#include "binhash.h"
 #include "events.h"
 
 #if !defined(EVENTS_STYLE)
@@ -499,8 +499,16 @@ typedef struct epoll_event EVENT_BUFFER;
 #endif
 
  /*
-  * Timer events. Timer requests are kept sorted, in a circular list. We use
-  * the RING abstraction, so we get to use a couple ugly macros.
+  * Timer events. Timer requests are kept in a binary min-heap that is
+  * ordered by (deadline, request sequence number), so that insert, reset
+  * and cancel cost O(log n) instead of a linear walk over a sorted list.
+  * Each request remembers its own heap position. A separate hash table
+  * indexes requests by (callback, context) so that an existing request is
+  * found in O(1) time.
+  * 
+  * The request sequence number provides first-come, first-served order
+  * among requests for the same time slot: a (re)scheduled request goes
+  * after all other requests for that time slot.
   * 
   * When a call-back function adds a timer request, we label the request with
   * the event_loop() call instance that invoked the call-back. We use this to
@@ -509,25 +517,37 @@ typedef struct epoll_event EVENT_BUFFER;
   */
 typedef struct EVENT_TIMER EVENT_TIMER;
 
-struct EVENT_TIMER {
-    time_t  when;			/* when event is wanted */
+typedef struct {
     EVENT_NOTIFY_TIME_FN callback;	/* callback function */
     char   *context;			/* callback context */
+} EVENT_TIMER_KEY;
+
+struct EVENT_TIMER {
+    time_t  when;			/* when event is wanted */
+    long    seqno;			/* request order within time slot */
+    EVENT_TIMER_KEY key;		/* callback, context */
     long    loop_instance;		/* event_loop() call instance */
-    RING    ring;			/* linkage */
+    ssize_t heap_index;			/* position in timer heap */
 };
 
-static RING event_timer_head;		/* timer queue head */
+static EVENT_TIMER **event_timer_heap;	/* timer queue, heap-ordered */
+static ssize_t event_timer_count;	/* number of timer requests */
+static ssize_t event_timer_slots;	/* allocated heap slots */
+static BINHASH *event_timer_table;	/* (callback, context) index */
+static long event_timer_seqno;		/* timer request counter */
 static long event_loop_instance;	/* event_loop() call instance */
 
-#define RING_TO_TIMER(r) \
-	((EVENT_TIMER *) ((void *) (r) - offsetof(EVENT_TIMER, ring)))
+#define EVENT_TIMER_ALLOC_INCR	64
 
-#define FOREACH_QUEUE_ENTRY(entry, head) \
-	for (entry = ring_succ(head); entry != (head); entry = ring_succ(entry))
+#define EVENT_TIMER_BEFORE(a, b) \
+	((a)->when < (b)->when \
+	 || ((a)->when == (b)->when && (a)->seqno < (b)->seqno))
 
-#define FIRST_TIMER(head) \
-	(ring_succ(head) != (head) ? RING_TO_TIMER(ring_succ(head)) : 0)
+#define EVENT_TIMER_PARENT(i)	(((i) - 1) / 2)
+#define EVENT_TIMER_CHILD(i)	(2 * (i) + 1)
+
+#define FIRST_TIMER() \
+	(event_timer_count > 0 ? event_timer_heap[0] : 0)
 
  /*
   * Other private data structures.
@@ -591,7 +611,11 @@ static void event_init(void)
     /*
      * Initialize timer stuff.
      */
-    ring_init(&event_timer_head);
+    event_timer_slots = EVENT_TIMER_ALLOC_INCR;
+    event_timer_heap = (EVENT_TIMER **)
+	mymalloc(sizeof(*event_timer_heap) * event_timer_slots);
+    event_timer_count = 0;
+    event_timer_table = binhash_create(EVENT_TIMER_ALLOC_INCR);
     (void) time(&event_present);
 
     /*
@@ -670,7 +694,7 @@ void    event_drain(int time_limit)
     (void) time(&event_present);
     max_time = event_present + time_limit;
     while (event_present < max_time
-	   && (event_timer_head.pred != &event_timer_head
+	   && (event_timer_count > 0
 	       || EVENT_MASK_CMP(&zero_mask, &event_xmask) != 0)) {
 	event_loop(1);
 #if (EVENTS_STYLE != EVENTS_STYLE_SELECT)
@@ -889,12 +913,102 @@ void    event_disable_readwrite(int fd)
     fdp->context = 0;
 }
 
+/* event_timer_move - store timer request at heap position */
+
+static void event_timer_move(EVENT_TIMER *timer, ssize_t index)
+{
+    event_timer_heap[index] = timer;
+    timer->heap_index = index;
+}
+
+/* event_timer_sift_up - restore heap order towards the root */
+
+static void event_timer_sift_up(EVENT_TIMER *timer)
+{
+    ssize_t index = timer->heap_index;
+    ssize_t parent;
+
+    while (index > 0) {
+	parent = EVENT_TIMER_PARENT(index);
+	if (!EVENT_TIMER_BEFORE(timer, event_timer_heap[parent]))
+	    break;
+	event_timer_move(event_timer_heap[parent], index);
+	index = parent;
+    }
+    event_timer_move(timer, index);
+}
+
+/* event_timer_sift_down - restore heap order towards the leaves */
+
+static void event_timer_sift_down(EVENT_TIMER *timer)
+{
+    ssize_t index = timer->heap_index;
+    ssize_t child;
+
+    while ((child = EVENT_TIMER_CHILD(index)) < event_timer_count) {
+	if (child + 1 < event_timer_count
+	    && EVENT_TIMER_BEFORE(event_timer_heap[child + 1],
+				  event_timer_heap[child]))
+	    child += 1;
+	if (!EVENT_TIMER_BEFORE(event_timer_heap[child], timer))
+	    break;
+	event_timer_move(event_timer_heap[child], index);
+	index = child;
+    }
+    event_timer_move(timer, index);
+}
+
+/* event_timer_insert - add request to timer queue */
+
+static void event_timer_insert(EVENT_TIMER *timer)
+{
+    if (event_timer_count >= event_timer_slots) {
+	event_timer_slots *= 2;
+	event_timer_heap = (EVENT_TIMER **)
+	    myrealloc((void *) event_timer_heap,
+		      sizeof(*event_timer_heap) * event_timer_slots);
+    }
+    timer->heap_index = event_timer_count++;
+    event_timer_sift_up(timer);
+}
+
+/* event_timer_remove - take request away from timer queue */
+
+static void event_timer_remove(EVENT_TIMER *timer)
+{
+    const char *myname = "event_timer_remove";
+    ssize_t index = timer->heap_index;
+    EVENT_TIMER *last;
+
+    if (index < 0 || index >= event_timer_count
+	|| event_timer_heap[index] != timer)
+	msg_panic("%s: corrupt timer queue", myname);
+    last = event_timer_heap[--event_timer_count];
+    if (last != timer) {
+	last->heap_index = index;
+	event_timer_sift_up(last);
+	if (last->heap_index == index)
+	    event_timer_sift_down(last);
+    }
+    timer->heap_index = -1;
+}
+
+/* event_timer_key - fill in (callback, context) lookup key */
+
+static void event_timer_key(EVENT_TIMER_KEY *key, EVENT_NOTIFY_TIME_FN callback,
+			            void *context)
+{
+    memset((void *) key, 0, sizeof(*key));	/* XXX structure padding */
+    key->callback = callback;
+    key->context = context;
+}
+
 /* event_request_timer - (re)set timer */
 
 time_t  event_request_timer(EVENT_NOTIFY_TIME_FN callback, void *context, int delay)
 {
     const char *myname = "event_request_timer";
-    RING   *ring;
+    EVENT_TIMER_KEY key;
     EVENT_TIMER *timer;
 
     if (EVENT_INIT_NEEDED())
@@ -912,51 +1026,43 @@ time_t  event_request_timer(EVENT_NOTIFY_TIME_FN callback, void *context, int de
     time(&event_present);
 
     /*
-     * See if they are resetting an existing timer request. If so, take the
-     * request away from the timer queue so that it can be inserted at the
-     * right place.
+     * See if they are resetting an existing timer request. If so, update
+     * the request in place and restore the heap order.
+     * 
+     * XXX Give the request a new sequence number, so that it goes after
+     * existing requests for the same time slot. The event_loop() routine
+     * depends on this to avoid starving I/O events when a call-back
+     * function schedules a zero-delay timer request.
      */
-    FOREACH_QUEUE_ENTRY(ring, &event_timer_head) {
-	timer = RING_TO_TIMER(ring);
-	if (timer->callback == callback && timer->context == context) {
-	    timer->when = event_present + delay;
-	    timer->loop_instance = event_loop_instance;
-	    ring_detach(ring);
-	    if (msg_verbose > 2)
-		msg_info("%s: reset 0x%lx 0x%lx %d", myname,
-			 (long) callback, (long) context, delay);
-	    break;
-	}
+    event_timer_key(&key, callback, context);
+    if ((timer = (EVENT_TIMER *) binhash_find(event_timer_table, (void *) &key,
+					      sizeof(key))) != 0) {
+	timer->when = event_present + delay;
+	timer->seqno = event_timer_seqno++;
+	timer->loop_instance = event_loop_instance;
+	event_timer_sift_up(timer);
+	event_timer_sift_down(timer);
+	if (msg_verbose > 2)
+	    msg_info("%s: reset 0x%lx 0x%lx %d", myname,
+		     (long) callback, (long) context, delay);
     }
 
     /*
      * If not found, schedule a new timer request.
      */
-    if (ring == &event_timer_head) {
+    else {
 	timer = (EVENT_TIMER *) mymalloc(sizeof(EVENT_TIMER));
 	timer->when = event_present + delay;
-	timer->callback = callback;
-	timer->context = context;
+	timer->seqno = event_timer_seqno++;
+	timer->key = key;
 	timer->loop_instance = event_loop_instance;
+	binhash_enter(event_timer_table, (void *) &timer->key,
+		      sizeof(timer->key), (void *) timer);
+	event_timer_insert(timer);
 	if (msg_verbose > 2)
 	    msg_info("%s: set 0x%lx 0x%lx %d", myname,
 		     (long) callback, (long) context, delay);
     }
-
-    /*
-     * Timer requests are kept sorted to reduce lookup overhead in the event
-     * loop.
-     * 
-     * XXX Append the new request after existing requests for the same time
-     * slot. The event_loop() routine depends on this to avoid starving I/O
-     * events when a call-back function schedules a zero-delay timer request.
-     */
-    FOREACH_QUEUE_ENTRY(ring, &event_timer_head) {
-	if (timer->when < RING_TO_TIMER(ring)->when)
-	    break;
-    }
-    ring_prepend(ring, &timer->ring);
-
     return (timer->when);
 }
 
@@ -965,7 +1071,7 @@ time_t  event_request_timer(EVENT_NOTIFY_TIME_FN callback, void *context, int de
 int     event_cancel_timer(EVENT_NOTIFY_TIME_FN callback, void *context)
 {
     const char *myname = "event_cancel_timer";
-    RING   *ring;
+    EVENT_TIMER_KEY key;
     EVENT_TIMER *timer;
     int     time_left = -1;
 
@@ -977,15 +1083,15 @@ int     event_cancel_timer(EVENT_NOTIFY_TIME_FN callback, void *context)
      * when the request is not found. It might have been canceled from some
      * other thread.
      */
-    FOREACH_QUEUE_ENTRY(ring, &event_timer_head) {
-	timer = RING_TO_TIMER(ring);
-	if (timer->callback == callback && timer->context == context) {
-	    if ((time_left = timer->when - event_present) < 0)
-		time_left = 0;
-	    ring_detach(ring);
-	    myfree((void *) timer);
-	    break;
-	}
+    event_timer_key(&key, callback, context);
+    if ((timer = (EVENT_TIMER *) binhash_find(event_timer_table, (void *) &key,
+					      sizeof(key))) != 0) {
+	if ((time_left = timer->when - event_present) < 0)
+	    time_left = 0;
+	event_timer_remove(timer);
+	binhash_delete(event_timer_table, (void *) &key, sizeof(key),
+		       (void (*) (void *)) 0);
+	myfree((void *) timer);
     }
     if (msg_verbose > 2)
 	msg_info("%s: 0x%lx 0x%lx %d", myname,
@@ -1026,21 +1132,22 @@ void    event_loop(int delay)
      * XXX Also print the select() masks?
      */
     if (msg_verbose > 2) {
-	RING   *ring;
+	ssize_t index;
 
-	FOREACH_QUEUE_ENTRY(ring, &event_timer_head) {
-	    timer = RING_TO_TIMER(ring);
+	for (index = 0; index < event_timer_count; index++) {
+	    timer = event_timer_heap[index];
 	    msg_info("%s: time left %3d for 0x%lx 0x%lx", myname,
 		     (int) (timer->when - event_present),
-		     (long) timer->callback, (long) timer->context);
+		     (long) timer->key.callback, (long) timer->key.context);
 	}
     }
 
     /*
-     * Find out when the next timer would go off. Timer requests are sorted.
-     * If any timer is scheduled, adjust the delay appropriately.
+     * Find out when the next timer would go off. The earliest timer request
+     * is at the top of the heap. If any timer is scheduled, adjust the delay
+     * appropriately.
      */
-    if ((timer = FIRST_TIMER(&event_timer_head)) != 0) {
+    if ((timer = FIRST_TIMER()) != 0) {
 	event_present = time((time_t *) 0);
 	if ((select_delay = timer->when - event_present) < 0) {
 	    select_delay = 0;
@@ -1102,9 +1209,9 @@ void    event_loop(int delay)
 
     /*
      * Deliver timer events. Allow the application to add/delete timer queue
-     * requests while it is being called back. Requests are sorted: we keep
-     * running over the timer request queue from the start, and stop when we
-     * reach the future or the list end. We also stop when we reach a timer
+     * requests while it is being called back. Requests are heap-ordered: we
+     * keep taking the earliest request from the timer queue, and stop when
+     * we reach the future or when the queue is empty. We also stop when we reach a timer
      * request that was added by a call-back that was invoked from this
      * event_loop() call instance, for reasons that are explained below.
      * 
@@ -1119,22 +1226,24 @@ void    event_loop(int delay)
      * instance that invoked the timer event call-back. We use this instance
      * label here to prevent zero-delay timer requests from running in a
      * tight loop and starving I/O events. To make this solution work,
-     * event_request_timer() appends a new request after existing requests
-     * for the same time slot.
+     * event_request_timer() gives a new request a sequence number that
+     * places it after existing requests for the same time slot.
      */
     event_present = time((time_t *) 0);
     event_loop_instance += 1;
 
-    while ((timer = FIRST_TIMER(&event_timer_head)) != 0) {
+    while ((timer = FIRST_TIMER()) != 0) {
 	if (timer->when > event_present)
 	    break;
 	if (timer->loop_instance == event_loop_instance)
 	    break;
-	ring_detach(&timer->ring);		/* first this */
+	event_timer_remove(timer);		/* first this */
+	binhash_delete(event_timer_table, (void *) &timer->key,
+		       sizeof(timer->key), (void (*) (void *)) 0);
 	if (msg_verbose > 2)
 	    msg_info("%s: timer 0x%lx 0x%lx", myname,
-		     (long) timer->callback, (long) timer->context);
-	timer->callback(EVENT_TIME, timer->context);	/* then this */
+		     (long) timer->key.callback, (long) timer->key.context);
+	timer->key.callback(EVENT_TIME, timer->key.context);	/* then this */
 	myfree((void *) timer);
     }
 
@@ -1208,6 +1317,10 @@ void    event_loop(int delay)
   * Proof-of-concept test program for the event manager. Schedule a series of
   * events at one-second intervals and let them happen, while echoing any
   * lines read from stdin.
+  * 
+  * With "bench count" arguments, time the cost of setting, resetting and
+  * canceling a large number of timer requests, similar to what a busy
+  * postscreen(8) or qmgr(8) process would do.
   */
 #include <stdio.h>
 #include <ctype.h>
@@ -1248,8 +1361,65 @@ static void request(int unused_event, void *unused_context)
     event_request_timer(timer_event, "0 second", 0);
 }
 
+/* bench_event - dummy timer call-back */
+
+static void bench_event(int unused_event, void *unused_context)
+{
+}
+
+/* bench_elapsed - elapsed time in microseconds */
+
+static double bench_elapsed(struct timeval *start)
+{
+    struct timeval now;
+
+    GETTIMEOFDAY(&now);
+    return ((now.tv_sec - start->tv_sec) * 1e6
+	    + (now.tv_usec - start->tv_usec));
+}
+
+/* timer_bench - time timer set, reset and cancel operations */
+
+static void timer_bench(int count)
+{
+    char   *contexts = mymalloc(count);
+    struct timeval start;
+    double  usec;
+    int     round;
+    int     i;
+
+#define BENCH_RESETS	3
+
+    GETTIMEOFDAY(&start);
+    for (i = 0; i < count; i++)
+	event_request_timer(bench_event, contexts + i, (i * 7919) % 3600);
+    usec = bench_elapsed(&start);
+    printf("set:    %d timers, %.3f usec/op\n", count, usec / count);
+
+    GETTIMEOFDAY(&start);
+    for (round = 1; round <= BENCH_RESETS; round++)
+	for (i = 0; i < count; i++)
+	    event_request_timer(bench_event, contexts + i,
+				(i * 7919 + round * 104729) % 3600);
+    usec = bench_elapsed(&start);
+    printf("reset:  %d timers, %.3f usec/op\n", count,
+	   usec / (count * BENCH_RESETS));
+
+    GETTIMEOFDAY(&start);
+    for (i = count - 1; i >= 0; i--)
+	if (event_cancel_timer(bench_event, contexts + i) < 0)
+	    msg_panic("timer_bench: timer %d not found", i);
+    usec = bench_elapsed(&start);
+    printf("cancel: %d timers, %.3f usec/op\n", count, usec / count);
+    myfree(contexts);
+}
+
 int     main(int argc, void **argv)
 {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+	timer_bench(argc > 2 ? atoi(argv[2]) : 100000);
+	exit(0);
+    }
     if (argv[1])
 	msg_verbose = atoi(argv[1]);
     event_request_timer(request, (void *) 0, 0);
@@ -26,6 +26,10 @@
 /*	char	*mymemdup(ptr, len)
 /*	const char *ptr;
 /*	ssize_t	len;
+/*
+/*	MYMALLOC_STATS mymalloc_stats;
+/*
+/*	long	MYMALLOC_CALLS()
 /* DESCRIPTION
 /*	This module performs low-level memory management with error
 /*	handling. A call of these functions either succeeds or it does
@@ -57,6 +61,12 @@
 /*	mymemdup() makes a copy of the memory pointed to by \fIptr\fR
 /*	with length \fIlen\fR. The result is NOT null-terminated.
 /*	This routine uses mymalloc().
+/*
+/*	mymalloc_stats counts the calls of mymalloc(), myrealloc()
+/*	and myfree(), including calls made on behalf of the string
+/*	copy routines. MYMALLOC_CALLS() returns the sum of these
+/*	counts. Programs may log the difference between two readings
+/*	to measure the allocator cost of an operation.
 /* SEE ALSO
 /*	msg(3) diagnostics interface
 /* DIAGNOSTICS
@@ -140,6 +150,8 @@ static const char empty_string[] = "";
 
 #endif
 
+MYMALLOC_STATS mymalloc_stats;
+
 /* mymalloc - allocate memory or bust */
 
 void   *mymalloc(ssize_t len)
@@ -154,6 +166,7 @@ void   *mymalloc(ssize_t len)
      */
     if (len < 1)
 	msg_panic("mymalloc: requested length %ld", (long) len);
+    mymalloc_stats.malloc_calls++;
 #ifdef MYMALLOC_FUZZ
     len += MYMALLOC_FUZZ;
 #endif
@@ -184,6 +197,7 @@ void   *myrealloc(void *ptr, ssize_t len)
      */
     if (len < 1)
 	msg_panic("myrealloc: requested length %ld", (long) len);
+    mymalloc_stats.realloc_calls++;
 #ifdef MYMALLOC_FUZZ
     len += MYMALLOC_FUZZ;
 #endif
@@ -208,6 +222,7 @@ void    myfree(void *ptr)
     if (ptr != empty_string) {
 #endif
 	CHECK_IN_PTR(ptr, real_ptr, len, "myfree");
+	mymalloc_stats.free_calls++;
 	memset((void *) real_ptr, FILLER, SPACE_FOR(len));
 	free((void *) real_ptr);
 #ifndef NO_SHARED_EMPTY_STRINGS
@@ -21,6 +21,21 @@ extern char *mystrdup(const char *);
 extern char *mystrndup(const char *, ssize_t);
 extern char *mymemdup(const void *, ssize_t);
 
+ /*
+  * Instrumentation.
+  */
+typedef struct MYMALLOC_STATS {
+    long    malloc_calls;		/* mymalloc() calls */
+    long    realloc_calls;		/* myrealloc() calls */
+    long    free_calls;			/* myfree() calls */
+} MYMALLOC_STATS;
+
+extern MYMALLOC_STATS mymalloc_stats;
+
+#define MYMALLOC_CALLS() \
+	(mymalloc_stats.malloc_calls + mymalloc_stats.realloc_calls \
+	    + mymalloc_stats.free_calls)
+
 /* LICENSE
 /* .ad
 /* .fi
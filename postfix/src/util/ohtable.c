@@ -0,0 +1,674 @@
+/*++
+/* NAME
+/*	ohtable 3
+/* SUMMARY
+/*	open-addressing hash table manager
+/* SYNOPSIS
+/*	#include <ohtable.h>
+/*
+/*	typedef	struct {
+/* .in +4
+/*		char	*key;
+/*		void	*value;
+/* .in -4
+/*	} OHTABLE_INFO;
+/*
+/*	OHTABLE	*ohtable_create(size)
+/*	int	size;
+/*
+/*	OHTABLE_INFO *ohtable_enter(table, key, value)
+/*	OHTABLE	*table;
+/*	const char *key;
+/*	void	*value;
+/*
+/*	char	*ohtable_find(table, key)
+/*	OHTABLE	*table;
+/*	const char *key;
+/*
+/*	OHTABLE_INFO *ohtable_locate(table, key)
+/*	OHTABLE	*table;
+/*	const char *key;
+/*
+/*	void	ohtable_delete(table, key, free_fn)
+/*	OHTABLE	*table;
+/*	const char *key;
+/*	void	(*free_fn)(void *);
+/*
+/*	void	ohtable_free(table, free_fn)
+/*	OHTABLE	*table;
+/*	void	(*free_fn)(void *);
+/*
+/*	void	ohtable_walk(table, action, ptr)
+/*	OHTABLE	*table;
+/*	void	(*action)(OHTABLE_INFO *, void *ptr);
+/*	void	*ptr;
+/*
+/*	OHTABLE_INFO **ohtable_list(table)
+/*	OHTABLE	*table;
+/*
+/*	OHTABLE_INFO *ohtable_sequence(table, how)
+/*	OHTABLE	*table;
+/*	int	how;
+/* DESCRIPTION
+/*	This module provides the same interface as htable(3), with
+/*	an implementation that is friendlier to the CPU cache. The
+/*	table is an array of (hash value, entry pointer) slots with
+/*	linear probing, so that a lookup compares stored hash values
+/*	in adjacent memory, and follows an entry pointer only when
+/*	the hash values are equal. Each entry and its key are
+/*	allocated together.
+/*
+/*	When the table fills up, a new slot array of twice the size
+/*	is allocated, and each subsequent update moves a few entries
+/*	from the old array to the new one. Lookups search both arrays
+/*	until the old one is empty. Thus, growing a large table does
+/*	not stall the program. Entry pointers remain valid until the
+/*	entry is deleted.
+/*
+/*	ohtable_create() creates a table of the specified size and returns a
+/*	pointer to the result. The lookup keys are copied.
+/*	ohtable_enter() stores a (key, value) pair into the specified table
+/*	and returns a pointer to the resulting entry. The code does not
+/*	check if an entry with that key already exists: use ohtable_locate()
+/*	for updating an existing entry.
+/*
+/*	ohtable_find() returns the value that was stored under the given key,
+/*	or a null pointer if it was not found. In order to distinguish
+/*	a null value from a non-existent value, use ohtable_locate().
+/*
+/*	ohtable_locate() returns a pointer to the entry that was stored
+/*	for the given key, or a null pointer if it was not found.
+/*
+/*	ohtable_delete() removes one entry that was stored under the given key.
+/*	If the free_fn argument is not a null pointer, the corresponding
+/*	function is called with as argument the non-zero value stored under
+/*	the key.
+/*
+/*	ohtable_free() destroys a hash table, including contents. If the
+/*	free_fn argument is not a null pointer, the corresponding function
+/*	is called for each table entry, with as argument the non-zero value
+/*	stored with the entry.
+/*
+/*	ohtable_walk() invokes the action function for each table entry, with
+/*	a pointer to the entry as its argument. The ptr argument is passed
+/*	on to the action function.
+/*
+/*	ohtable_list() returns a null-terminated list of pointers to
+/*	all elements in the named table. The list should be passed to
+/*	myfree().
+/*
+/*	ohtable_sequence() returns the first or next element depending
+/*	on the value of the "how" argument.  Specify OHTABLE_SEQ_FIRST
+/*	to start a new sequence, OHTABLE_SEQ_NEXT to continue, and
+/*	OHTABLE_SEQ_STOP to terminate a sequence early.  The caller
+/*	must not delete an element before it is visited.
+/* RESTRICTIONS
+/*	A callback function should not modify the hash table that is
+/*	specified to its caller.
+/* DIAGNOSTICS
+/*	The following conditions are reported and cause the program to
+/*	terminate immediately: memory allocation failure; an attempt
+/*	to delete a non-existent entry.
+/* SEE ALSO
+/*	htable(3) chained hash table manager
+/*	mymalloc(3) memory management wrapper
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+/* C library */
+
+#include <sys_defs.h>
+#include <string.h>
+
+/* Local stuff */
+
+#include "mymalloc.h"
+#include "msg.h"
+#include "ohtable.h"
+
+ /*
+  * One slot. An empty slot has a null entry pointer. A slot in the old
+  * array whose entry was moved or deleted is marked as such, so that probe
+  * sequences that pass through it are not broken.
+  */
+typedef struct OHTABLE_SLOT {
+    size_t  hash;			/* full hash value */
+    OHTABLE_INFO *info;			/* entry or null */
+} OHTABLE_SLOT;
+
+static OHTABLE_INFO ohtable_moved;
+
+#define OHTABLE_MOVED	(&ohtable_moved)
+
+ /*
+  * Grow when the new array is half full; with linear probing, a failed
+  * lookup becomes expensive at higher load factors. Each update moves this
+  * many old slots. Since the new array has room for another size/4 entries
+  * before it must grow again, and the old array has size/2 slots, any
+  * number larger than 2 guarantees that the old array is empty by then.
+  */
+#define OHTABLE_FULL(n, size)	((n) * 2 > (size))
+#define OHTABLE_MOVE_STEP	8
+
+#define	STREQ(x,y) (x == y || (x[0] == y[0] && strcmp(x,y) == 0))
+
+/* ohtable_hash - hash a string */
+
+static size_t ohtable_hash(const char *s)
+{
+    size_t  h = 2166136261U;
+
+    /*
+     * FNV-1a, with a final mix so that the low-order bits, which select the
+     * slot, depend on all input bits.
+     */
+    while (*s) {
+	h ^= *(unsigned const char *) s++;
+	h *= 16777619U;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    return (h);
+}
+
+/* ohtable_probe - find slot with key */
+
+static ssize_t ohtable_probe(OHTABLE_SLOT *data, ssize_t size,
+			             size_t hash, const char *key)
+{
+    size_t  mask = size - 1;
+    size_t  i;
+    OHTABLE_INFO *info;
+
+    for (i = hash & mask; (info = data[i].info) != 0; i = (i + 1) & mask)
+	if (data[i].hash == hash && info != OHTABLE_MOVED
+	    && STREQ(key, info->key))
+	    return (i);
+    return (-1);
+}
+
+/* ohtable_link - insert entry into slot array without moved slots */
+
+static void ohtable_link(OHTABLE_SLOT *data, ssize_t size, size_t hash,
+			         OHTABLE_INFO *info)
+{
+    size_t  mask = size - 1;
+    size_t  i;
+
+    for (i = hash & mask; data[i].info != 0; i = (i + 1) & mask)
+	 /* void */ ;
+    data[i].hash = hash;
+    data[i].info = info;
+}
+
+/* ohtable_unlink - remove slot, keeping probe sequences intact */
+
+static void ohtable_unlink(OHTABLE_SLOT *data, ssize_t size, size_t i)
+{
+    size_t  mask = size - 1;
+    size_t  j;
+    size_t  home;
+
+    /*
+     * Backward-shift deletion: move later entries of the same probe
+     * sequence into the hole, so that no marker is needed.
+     */
+    for (j = (i + 1) & mask; data[j].info != 0; j = (j + 1) & mask) {
+	home = data[j].hash & mask;
+	if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+	    continue;
+	data[i] = data[j];
+	i = j;
+    }
+    data[i].info = 0;
+}
+
+/* ohtable_alloc - allocate empty slot array */
+
+static OHTABLE_SLOT *ohtable_alloc(ssize_t size)
+{
+    OHTABLE_SLOT *data;
+
+    data = (OHTABLE_SLOT *) mymalloc(size * sizeof(*data));
+    memset((void *) data, 0, size * sizeof(*data));
+    return (data);
+}
+
+/* ohtable_create - create initial hash table */
+
+OHTABLE *ohtable_create(ssize_t size)
+{
+    OHTABLE *table;
+    ssize_t slots;
+
+    for (slots = 16; OHTABLE_FULL(size, slots); slots *= 2)
+	 /* void */ ;
+    table = (OHTABLE *) mymalloc(sizeof(OHTABLE));
+    table->data = ohtable_alloc(slots);
+    table->size = slots;
+    table->used = 0;
+    table->old_data = 0;
+    table->old_size = table->old_used = table->old_pos = 0;
+    table->seq_bucket = table->seq_element = 0;
+    return (table);
+}
+
+/* ohtable_move - move entries from the old slot array */
+
+static void ohtable_move(OHTABLE *table, ssize_t count)
+{
+    OHTABLE_SLOT *slot;
+
+    while (table->old_data != 0 && count-- > 0) {
+	slot = table->old_data + table->old_pos++;
+	if (slot->info != 0 && slot->info != OHTABLE_MOVED) {
+	    ohtable_link(table->data, table->size, slot->hash, slot->info);
+	    slot->info = OHTABLE_MOVED;
+	    table->old_used--;
+	}
+	if (table->old_pos >= table->old_size) {
+	    if (table->old_used != 0)
+		msg_panic("ohtable_move: %ld entries left behind",
+			  (long) table->old_used);
+	    myfree((void *) table->old_data);
+	    table->old_data = 0;
+	    table->old_size = table->old_pos = 0;
+	}
+    }
+}
+
+/* ohtable_grow - start using a larger slot array */
+
+static void ohtable_grow(OHTABLE *table)
+{
+    if (table->old_data != 0)
+	ohtable_move(table, table->old_size);
+    table->old_data = table->data;
+    table->old_size = table->size;
+    table->old_used = table->used;
+    table->old_pos = 0;
+    table->size *= 2;
+    table->data = ohtable_alloc(table->size);
+}
+
+/* ohtable_enter - enter (key, value) pair */
+
+OHTABLE_INFO *ohtable_enter(OHTABLE *table, const char *key, void *value)
+{
+    OHTABLE_INFO *info;
+    size_t  len = strlen(key) + 1;
+
+    ohtable_move(table, OHTABLE_MOVE_STEP);
+    if (OHTABLE_FULL(table->used - table->old_used + 1, table->size))
+	ohtable_grow(table);
+    info = (OHTABLE_INFO *) mymalloc(sizeof(*info) + len);
+    info->key = (char *) (info + 1);
+    memcpy(info->key, key, len);
+    info->value = value;
+    ohtable_link(table->data, table->size, ohtable_hash(key), info);
+    table->used++;
+    return (info);
+}
+
+/* ohtable_locate - lookup entry */
+
+OHTABLE_INFO *ohtable_locate(OHTABLE *table, const char *key)
+{
+    size_t  hash;
+    ssize_t i;
+
+    if (table) {
+	hash = ohtable_hash(key);
+	if ((i = ohtable_probe(table->data, table->size, hash, key)) >= 0)
+	    return (table->data[i].info);
+	if (table->old_data != 0
+	    && (i = ohtable_probe(table->old_data, table->old_size,
+				  hash, key)) >= 0)
+	    return (table->old_data[i].info);
+    }
+    return (0);
+}
+
+/* ohtable_find - lookup value */
+
+void   *ohtable_find(OHTABLE *table, const char *key)
+{
+    OHTABLE_INFO *info;
+
+    return ((info = ohtable_locate(table, key)) != 0 ? info->value : 0);
+}
+
+/* ohtable_delete - delete one entry */
+
+void    ohtable_delete(OHTABLE *table, const char *key, void (*free_fn) (void *))
+{
+    OHTABLE_INFO *info;
+    size_t  hash;
+    ssize_t i;
+
+    if (table) {
+	ohtable_move(table, OHTABLE_MOVE_STEP);
+	hash = ohtable_hash(key);
+	if ((i = ohtable_probe(table->data, table->size, hash, key)) >= 0) {
+	    info = table->data[i].info;
+	    ohtable_unlink(table->data, table->size, i);
+	} else if (table->old_data != 0
+		   && (i = ohtable_probe(table->old_data, table->old_size,
+					 hash, key)) >= 0) {
+	    info = table->old_data[i].info;
+	    table->old_data[i].info = OHTABLE_MOVED;
+	    table->old_used--;
+	} else {
+	    msg_panic("ohtable_delete: unknown_key: \"%s\"", key);
+	}
+	table->used--;
+	if (free_fn && info->value)
+	    (*free_fn) (info->value);
+	myfree((void *) info);
+    }
+}
+
+/* ohtable_free - destroy hash table */
+
+void    ohtable_free(OHTABLE *table, void (*free_fn) (void *))
+{
+    OHTABLE_INFO **list;
+    OHTABLE_INFO **info;
+
+    if (table) {
+	list = ohtable_list(table);
+	for (info = list; *info; info++) {
+	    if (free_fn && info[0]->value)
+		(*free_fn) (info[0]->value);
+	    myfree((void *) *info);
+	}
+	myfree((void *) list);
+	myfree((void *) table->data);
+	if (table->old_data)
+	    myfree((void *) table->old_data);
+	if (table->seq_bucket)
+	    myfree((void *) table->seq_bucket);
+	myfree((void *) table);
+    }
+}
+
+/* ohtable_walk - iterate over hash table */
+
+void    ohtable_walk(OHTABLE *table, void (*action) (OHTABLE_INFO *, void *),
+		             void *ptr) {
+    OHTABLE_SLOT *slot;
+
+    if (table) {
+	for (slot = table->data; slot < table->data + table->size; slot++)
+	    if (slot->info != 0)
+		(*action) (slot->info, ptr);
+	if (table->old_data)
+	    for (slot = table->old_data + table->old_pos;
+		 slot < table->old_data + table->old_size; slot++)
+		if (slot->info != 0 && slot->info != OHTABLE_MOVED)
+		    (*action) (slot->info, ptr);
+    }
+}
+
+/* ohtable_list - list all table members */
+
+OHTABLE_INFO **ohtable_list(OHTABLE *table)
+{
+    OHTABLE_INFO **list;
+    OHTABLE_SLOT *slot;
+    ssize_t count = 0;
+
+    if (table != 0) {
+	list = (OHTABLE_INFO **) mymalloc(sizeof(*list) * (table->used + 1));
+	for (slot = table->data; slot < table->data + table->size; slot++)
+	    if (slot->info != 0)
+		list[count++] = slot->info;
+	if (table->old_data)
+	    for (slot = table->old_data + table->old_pos;
+		 slot < table->old_data + table->old_size; slot++)
+		if (slot->info != 0 && slot->info != OHTABLE_MOVED)
+		    list[count++] = slot->info;
+    } else {
+	list = (OHTABLE_INFO **) mymalloc(sizeof(*list));
+    }
+    list[count] = 0;
+    return (list);
+}
+
+/* ohtable_sequence - dict(3) compatibility iterator */
+
+OHTABLE_INFO *ohtable_sequence(OHTABLE *table, int how)
+{
+    if (table == 0)
+	return (0);
+
+    switch (how) {
+    case OHTABLE_SEQ_FIRST:			/* start new sequence */
+	if (table->seq_bucket)
+	    myfree((void *) table->seq_bucket);
+	table->seq_bucket = ohtable_list(table);
+	table->seq_element = table->seq_bucket;
+	return (*(table->seq_element)++);
+    case OHTABLE_SEQ_NEXT:			/* next element */
+	if (table->seq_element && *table->seq_element)
+	    return (*(table->seq_element)++);
+	/* FALLTHROUGH */
+    default:					/* terminate sequence */
+	if (table->seq_bucket) {
+	    myfree((void *) table->seq_bucket);
+	    table->seq_bucket = table->seq_element = 0;
+	}
+	return (0);
+    }
+}
+
+#ifdef TEST
+
+ /*
+  * Test program. Without arguments, perform a long sequence of random
+  * enter, delete and lookup operations on an ohtable and an htable, and
+  * verify that both give the same results. With "-b count", enter, find,
+  * miss and delete count keys in each type of table, and report the
+  * average time per operation and the slowest single enter operation.
+  */
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <msg_vstream.h>
+#include <vstream.h>
+#include <vstring.h>
+#include <myrand.h>
+#include <htable.h>
+
+#define TEST_KEYS	20000
+#define TEST_OPS	500000
+
+static void verify(void)
+{
+    HTABLE *ref = htable_create(0);
+    OHTABLE *table = ohtable_create(0);
+    VSTRING *key = vstring_alloc(20);
+    OHTABLE_INFO **list;
+    OHTABLE_INFO **info;
+    void   *ref_value;
+    void   *value;
+    ssize_t count;
+    int     n;
+    int     op;
+
+    mysrand(1);
+    for (n = 0; n < TEST_OPS; n++) {
+	vstring_sprintf(key, "key-%d", myrand() % TEST_KEYS);
+	ref_value = htable_find(ref, vstring_str(key));
+	value = ohtable_find(table, vstring_str(key));
+	if (ref_value != value)
+	    msg_fatal("%s: htable=%ld ohtable=%ld", vstring_str(key),
+		      (long) CAST_ANY_PTR_TO_INT(ref_value),
+		      (long) CAST_ANY_PTR_TO_INT(value));
+	op = myrand() % 3;
+	if (op == 0 && ref_value != 0) {
+	    htable_delete(ref, vstring_str(key), (void (*) (void *)) 0);
+	    ohtable_delete(table, vstring_str(key), (void (*) (void *)) 0);
+	} else if (op == 1 && ref_value == 0) {
+	    htable_enter(ref, vstring_str(key), CAST_INT_TO_VOID_PTR(n + 1));
+	    ohtable_enter(table, vstring_str(key), CAST_INT_TO_VOID_PTR(n + 1));
+	}
+	if (ref->used != table->used)
+	    msg_fatal("htable has %ld entries, ohtable has %ld",
+		      (long) ref->used, (long) table->used);
+    }
+    for (count = 0, op = OHTABLE_SEQ_FIRST; ohtable_sequence(table, op) != 0;
+	 count++, op = OHTABLE_SEQ_NEXT)
+	 /* void */ ;
+    if (count != table->used)
+	msg_fatal("%ld entries found, but %ld entries exist",
+		  (long) count, (long) table->used);
+    list = ohtable_list(table);
+    for (info = list; *info; info++) {
+	if (htable_find(ref, info[0]->key) != info[0]->value)
+	    msg_fatal("%s: bad value in list", info[0]->key);
+	ohtable_delete(table, info[0]->key, (void (*) (void *)) 0);
+    }
+    if (table->used != 0)
+	msg_fatal("%ld entries not deleted", (long) table->used);
+    myfree((void *) list);
+    vstream_printf("%d operations: ok\n", TEST_OPS);
+    htable_free(ref, (void (*) (void *)) 0);
+    ohtable_free(table, (void (*) (void *)) 0);
+    vstring_free(key);
+}
+
+static double elapsed(struct timeval *start)
+{
+    struct timeval now;
+
+    GETTIMEOFDAY(&now);
+    return ((now.tv_sec - start->tv_sec) * 1e6
+	    + (now.tv_usec - start->tv_usec));
+}
+
+ /*
+  * Call one hash table implementation through a common interface.
+  */
+typedef struct {
+    const char *name;
+    void   *(*create) (ssize_t);
+    void   *(*enter) (void *, const char *, void *);
+    void   *(*find) (void *, const char *);
+    void    (*delete) (void *, const char *, void (*) (void *));
+    void    (*free) (void *, void (*) (void *));
+} BENCH_TYPE;
+
+#define BENCH_FN(type, fn) ((type) (fn))
+
+static void bench(BENCH_TYPE *tp, char **keys, char **misses, int count)
+{
+    struct timeval start;
+    struct timeval op_start;
+    double  op_time;
+    double  worst = 0;
+    void   *table;
+    int     n;
+
+    table = tp->create(0);
+    GETTIMEOFDAY(&start);
+    for (n = 0; n < count; n++) {
+	GETTIMEOFDAY(&op_start);
+	tp->enter(table, keys[n], keys[n]);
+	if ((op_time = elapsed(&op_start)) > worst)
+	    worst = op_time;
+    }
+    vstream_printf("%-8s enter:  %.3f usec/op, slowest %.0f usec\n",
+		   tp->name, elapsed(&start) / count, worst);
+    GETTIMEOFDAY(&start);
+    for (n = 0; n < count; n++)
+	if (tp->find(table, keys[n]) != keys[n])
+	    msg_panic("%s: lookup failed for %s", tp->name, keys[n]);
+    vstream_printf("%-8s find:   %.3f usec/op\n",
+		   tp->name, elapsed(&start) / count);
+    GETTIMEOFDAY(&start);
+    for (n = 0; n < count; n++)
+	if (tp->find(table, misses[n]) != 0)
+	    msg_panic("%s: false match for %s", tp->name, misses[n]);
+    vstream_printf("%-8s miss:   %.3f usec/op\n",
+		   tp->name, elapsed(&start) / count);
+    GETTIMEOFDAY(&start);
+    for (n = 0; n < count; n++)
+	tp->delete(table, keys[n], (void (*) (void *)) 0);
+    vstream_printf("%-8s delete: %.3f usec/op\n",
+		   tp->name, elapsed(&start) / count);
+    tp->free(table, (void (*) (void *)) 0);
+    vstream_fflush(VSTREAM_OUT);
+}
+
+int     main(int argc, char **argv)
+{
+    static BENCH_TYPE types[] = {
+	{"htable",
+	    BENCH_FN(void *(*) (ssize_t), htable_create),
+	    BENCH_FN(void *(*) (void *, const char *, void *), htable_enter),
+	    BENCH_FN(void *(*) (void *, const char *), htable_find),
+	    BENCH_FN(void (*) (void *, const char *, void (*) (void *)),
+		     htable_delete),
+	BENCH_FN(void (*) (void *, void (*) (void *)), htable_free)},
+	{"ohtable",
+	    BENCH_FN(void *(*) (ssize_t), ohtable_create),
+	    BENCH_FN(void *(*) (void *, const char *, void *), ohtable_enter),
+	    BENCH_FN(void *(*) (void *, const char *), ohtable_find),
+	    BENCH_FN(void (*) (void *, const char *, void (*) (void *)),
+		     ohtable_delete),
+	BENCH_FN(void (*) (void *, void (*) (void *)), ohtable_free)},
+    };
+    VSTRING *buf = vstring_alloc(20);
+    char  **keys;
+    char  **misses;
+    int     count = 0;
+    int     n;
+    int     ch;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    while ((ch = GETOPT(argc, argv, "b:")) > 0) {
+	switch (ch) {
+	case 'b':
+	    if ((count = atoi(optarg)) <= 0)
+		msg_fatal("bad count: %s", optarg);
+	    break;
+	default:
+	    msg_fatal("usage: %s [-b count]", argv[0]);
+	}
+    }
+    if (count == 0) {
+	verify();
+    } else {
+	keys = (char **) mymalloc(sizeof(*keys) * count);
+	misses = (char **) mymalloc(sizeof(*misses) * count);
+	for (n = 0; n < count; n++) {
+	    vstring_sprintf(buf, "example%d.com", n);
+	    keys[n] = mystrdup(vstring_str(buf));
+	    vstring_sprintf(buf, "example%d.net", n);
+	    misses[n] = mystrdup(vstring_str(buf));
+	}
+	for (n = 0; n < sizeof(types) / sizeof(types[0]); n++)
+	    bench(types + n, keys, misses, count);
+	for (n = 0; n < count; n++) {
+	    myfree(keys[n]);
+	    myfree(misses[n]);
+	}
+	myfree((void *) keys);
+	myfree((void *) misses);
+    }
+    vstream_fflush(VSTREAM_OUT);
+    vstring_free(buf);
+    exit(0);
+}
+
+#endif
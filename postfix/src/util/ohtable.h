@@ -0,0 +1,66 @@
+#ifndef _OHTABLE_H_INCLUDED_
+#define _OHTABLE_H_INCLUDED_
+
+/*++
+/* NAME
+/*	ohtable 3h
+/* SUMMARY
+/*	open-addressing hash table manager
+/* SYNOPSIS
+/*	#include <ohtable.h>
+/* DESCRIPTION
+/* .nf
+
+ /* Structure of one hash table entry. */
+
+typedef struct OHTABLE_INFO {
+    char   *key;			/* lookup key */
+    void   *value;			/* associated value */
+} OHTABLE_INFO;
+
+ /* Structure of one hash table. */
+
+typedef struct OHTABLE {
+    ssize_t size;			/* length of slot array, power of 2 */
+    ssize_t used;			/* number of entries in table */
+    struct OHTABLE_SLOT *data;		/* slot array, auto-resized */
+    struct OHTABLE_SLOT *old_data;	/* slot array being drained */
+    ssize_t old_size;			/* length of old slot array */
+    ssize_t old_used;			/* entries left in old slot array */
+    ssize_t old_pos;			/* next old slot to move */
+    OHTABLE_INFO **seq_bucket;		/* current sequence list */
+    OHTABLE_INFO **seq_element;		/* current sequence element */
+} OHTABLE;
+
+extern OHTABLE *ohtable_create(ssize_t);
+extern OHTABLE_INFO *ohtable_enter(OHTABLE *, const char *, void *);
+extern OHTABLE_INFO *ohtable_locate(OHTABLE *, const char *);
+extern void *ohtable_find(OHTABLE *, const char *);
+extern void ohtable_delete(OHTABLE *, const char *, void (*) (void *));
+extern void ohtable_free(OHTABLE *, void (*) (void *));
+extern void ohtable_walk(OHTABLE *, void (*) (OHTABLE_INFO *, void *), void *);
+extern OHTABLE_INFO **ohtable_list(OHTABLE *);
+extern OHTABLE_INFO *ohtable_sequence(OHTABLE *, int);
+
+#define OHTABLE_SEQ_FIRST	0
+#define OHTABLE_SEQ_NEXT	1
+#define OHTABLE_SEQ_STOP	(-1)
+
+ /*
+  * Correct only when casting (char *) to (void *).
+  */
+#define OHTABLE_ACTION_FN_CAST(f) ((void *)(OHTABLE_INFO *, void *)) (f)
+#define OHTABLE_FREE_FN_CAST(f) ((void *)(void *)) (f)
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+#endif
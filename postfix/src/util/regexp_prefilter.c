@@ -0,0 +1,820 @@
+/*++
+/* NAME
+/*	regexp_prefilter 3
+/* SUMMARY
+/*	literal substring prefilter for regular expression tables
+/* SYNOPSIS
+/*	#include <regexp_prefilter.h>
+/*
+/*	int	regexp_prefilter_enable;
+/*
+/*	REGEXP_PREFILTER *regexp_prefilter_create()
+/*
+/*	int	regexp_prefilter_add(prefilter, pattern, flags)
+/*	REGEXP_PREFILTER *prefilter;
+/*	const char *pattern;
+/*	int	flags;
+/*
+/*	void	regexp_prefilter_execute(prefilter, text)
+/*	REGEXP_PREFILTER *prefilter;
+/*	const char *text;
+/*
+/*	int	REGEXP_PREFILTER_HIT(prefilter, id)
+/*	REGEXP_PREFILTER *prefilter;
+/*	int	id;
+/*
+/*	void	regexp_prefilter_free(prefilter)
+/*	REGEXP_PREFILTER *prefilter;
+/* LOW-LEVEL FUNCTIONS
+/*	ARGV	*regexp_prefilter_literals(argv, pattern, flags)
+/*	ARGV	*argv;
+/*	const char *pattern;
+/*	int	flags;
+/* DESCRIPTION
+/*	This module speeds up tables with many regular expressions,
+/*	such as header_checks or body_checks, by skipping rules
+/*	that cannot possibly match. For each pattern it finds literal
+/*	substrings that must be present in every string that the
+/*	pattern matches. The literals of all patterns are combined
+/*	into one Aho-Corasick keyword tree, so that a single pass
+/*	over the input text finds all literals that occur in it. A
+/*	rule whose literal does not occur in the text can be skipped
+/*	without running the regular expression engine. Because the
+/*	prefilter only ever skips rules that cannot match, the
+/*	caller's first-match order is preserved.
+/*
+/*	When a pattern has more than one required literal, the
+/*	prefilter uses the literal that is shared by the fewest
+/*	patterns, so that a common prefix such as "^Subject:" does
+/*	not defeat the filter. Literals are matched without regard
+/*	to case, so that one prefilter can serve case-sensitive and
+/*	case-insensitive patterns.
+/*
+/*	regexp_prefilter_enable (default: 1) controls whether the
+/*	dict_regexp(3) and dict_pcre(3) modules use a prefilter.
+/*
+/*	regexp_prefilter_create() creates an empty prefilter.
+/*
+/*	regexp_prefilter_add() extracts the required literals from
+/*	the specified pattern and adds them to the prefilter. The
+/*	result is an identifier for use with REGEXP_PREFILTER_HIT(),
+/*	or REGEXP_PREFILTER_NONE when the pattern has no usable
+/*	literal; such a pattern must always be evaluated. The flags
+/*	argument specifies the pattern syntax: REGEXP_PREFILTER_FLAG_POSIX
+/*	(POSIX extended regular expression) or REGEXP_PREFILTER_FLAG_PCRE.
+/*	Do not use this module for POSIX basic regular expressions,
+/*	or for PCRE patterns that are compiled with the extended
+/*	(whitespace-ignoring) option.
+/*
+/*	regexp_prefilter_execute() scans the specified text once,
+/*	and remembers which literals occur in it.
+/*
+/*	REGEXP_PREFILTER_HIT() returns zero when the pattern with
+/*	the specified identifier cannot match the text of the most
+/*	recent regexp_prefilter_execute() call.
+/*
+/*	regexp_prefilter_free() destroys the prefilter.
+/*
+/*	regexp_prefilter_literals() extracts the literal substrings
+/*	that must be present in every match of the specified pattern,
+/*	and stores them in lowercase form in the specified array.
+/*	The result is the array, or a null pointer when the pattern
+/*	has no usable literal. Extraction is conservative: literals
+/*	inside (...) are ignored, and a pattern with top-level
+/*	alternation has no literals.
+/* SEE ALSO
+/*	dict_regexp(3) POSIX regular expression table
+/*	dict_pcre(3) PCRE regular expression table
+/* DIAGNOSTICS
+/*	Fatal errors: out of memory.
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <vstring.h>
+#include <argv.h>
+#include <regexp_prefilter.h>
+
+/* Application-specific. */
+
+ /*
+  * One node in the keyword tree. The failure link points to the node for
+  * the longest proper suffix of this node's string that is also in the
+  * tree; the output link points to the longest such suffix that is a
+  * complete literal.
+  */
+typedef struct REGEXP_PREFILTER_NODE {
+    struct REGEXP_PREFILTER_NODE *child;	/* first child */
+    struct REGEXP_PREFILTER_NODE *sibling;	/* next child of parent */
+    struct REGEXP_PREFILTER_NODE *fail;	/* failure link */
+    struct REGEXP_PREFILTER_NODE *output;	/* output link */
+    int     id;				/* literal identifier or NONE */
+    unsigned char ch;			/* input character */
+} REGEXP_PREFILTER_NODE;
+
+ /*
+  * The required literals of one pattern.
+  */
+typedef struct REGEXP_PREFILTER_CAND {
+    int    *ids;			/* literal identifiers */
+    int    *lens;			/* literal lengths */
+    int     count;			/* number of literals */
+} REGEXP_PREFILTER_CAND;
+
+ /*
+  * Shorter literals occur in too many strings to be useful.
+  */
+#define REGEXP_PREFILTER_MIN_LEN	2
+
+int     regexp_prefilter_enable = 1;
+
+#define STR(x)	vstring_str(x)
+#define LEN(x)	VSTRING_LEN(x)
+
+/* regexp_prefilter_node_alloc - create keyword tree node */
+
+static REGEXP_PREFILTER_NODE *regexp_prefilter_node_alloc(int ch)
+{
+    REGEXP_PREFILTER_NODE *node;
+
+    node = (REGEXP_PREFILTER_NODE *) mymalloc(sizeof(*node));
+    node->child = node->sibling = node->fail = node->output = 0;
+    node->id = REGEXP_PREFILTER_NONE;
+    node->ch = ch;
+    return (node);
+}
+
+/* regexp_prefilter_node_free - destroy keyword subtree */
+
+static void regexp_prefilter_node_free(REGEXP_PREFILTER_NODE *node)
+{
+    REGEXP_PREFILTER_NODE *next;
+
+    for ( /* void */ ; node != 0; node = next) {
+	next = node->sibling;
+	regexp_prefilter_node_free(node->child);
+	myfree((void *) node);
+    }
+}
+
+/* regexp_prefilter_child - find child node for character */
+
+static REGEXP_PREFILTER_NODE *regexp_prefilter_child(REGEXP_PREFILTER_NODE *node,
+						             int ch)
+{
+    for (node = node->child; node != 0 && node->ch != ch; node = node->sibling)
+	 /* void */ ;
+    return (node);
+}
+
+/* regexp_prefilter_skip_bracket - skip [...] expression */
+
+static const char *regexp_prefilter_skip_bracket(const char *cp, int flags)
+{
+    char    close[3];
+
+    if (*cp == '^')
+	cp++;
+    if (*cp == ']')
+	cp++;
+    while (*cp != ']') {
+	if (*cp == 0)
+	    return (0);
+	if (*cp == '[' && (cp[1] == ':' || cp[1] == '.' || cp[1] == '=')) {
+	    close[0] = cp[1];
+	    close[1] = ']';
+	    close[2] = 0;
+	    if ((cp = strstr(cp + 2, close)) == 0)
+		return (0);
+	    cp += 2;
+	} else if (*cp == '\\' && (flags & REGEXP_PREFILTER_FLAG_PCRE)) {
+	    if (cp[1] == 0)
+		return (0);
+	    cp += 2;
+	} else {
+	    cp++;
+	}
+    }
+    return (cp + 1);
+}
+
+/* regexp_prefilter_skip_escape - skip arguments of PCRE \letter escape */
+
+static const char *regexp_prefilter_skip_escape(const char *cp, int ch)
+{
+    const char *end;
+    int     n;
+
+    /*
+     * Err on the side of skipping too much: a skipped character can only
+     * make a literal shorter, never wrong.
+     */
+    switch (ch) {
+    case 'c':
+	if (*cp == 0)
+	    return (0);
+	return (cp + 1);
+    case 'x':
+    case 'o':
+    case 'N':
+    case 'p':
+    case 'P':
+    case 'g':
+    case 'k':
+	if (*cp == '{' || *cp == '<' || *cp == '\'') {
+	    if ((end = strchr(cp + 1, *cp == '{' ? '}' :
+			      *cp == '<' ? '>' : '\'')) == 0)
+		return (0);
+	    return (end + 1);
+	}
+	if (ch == 'x') {
+	    for (n = 0; n < 2 && ISALNUM(*cp); n++)
+		cp++;
+	} else if (ch == 'p' || ch == 'P') {
+	    if (*cp == 0)
+		return (0);
+	    cp++;
+	} else if (ch == 'g') {
+	    if (*cp == '-' || *cp == '+')
+		cp++;
+	    while (ISDIGIT(*cp))
+		cp++;
+	}
+	return (cp);
+    default:
+	if (ISDIGIT(ch))
+	    while (ISDIGIT(*cp))
+		cp++;
+	return (cp);
+    }
+}
+
+/* regexp_prefilter_literals - extract required literals from pattern */
+
+ARGV   *regexp_prefilter_literals(ARGV *result, const char *pattern, int flags)
+{
+    static VSTRING *run;
+    const char *cp;
+    const char *opt;
+    int     depth = 0;
+    int     last_lit = 0;
+    int     ch;
+
+    /*
+     * The current run is a sequence of adjacent top-level literal
+     * characters. A character that is followed by a quantifier that allows
+     * zero repetitions is not required, and a quantifier ends the run
+     * because repetition breaks adjacency.
+     */
+#define ADD_LITERAL(ch) do { \
+	if (depth == 0) { \
+	    VSTRING_ADDCH(run, TOLOWER(ch)); \
+	    last_lit = 1; \
+	} \
+    } while (0)
+
+#define DROP_LITERAL() do { \
+	if (last_lit) \
+	    vstring_truncate(run, LEN(run) - 1); \
+    } while (0)
+
+#define END_RUN() do { \
+	if (LEN(run) >= REGEXP_PREFILTER_MIN_LEN) { \
+	    VSTRING_TERMINATE(run); \
+	    argv_add(result, STR(run), (char *) 0); \
+	} \
+	VSTRING_RESET(run); \
+	last_lit = 0; \
+    } while (0)
+
+    if (run == 0)
+	run = vstring_alloc(100);
+    VSTRING_RESET(run);
+    argv_truncate(result, 0);
+
+    /*
+     * Give up on PCRE \Q...\E quoting; it would take a full parser to know
+     * where the quoted text ends.
+     */
+    if ((flags & REGEXP_PREFILTER_FLAG_PCRE) && strstr(pattern, "\\Q") != 0)
+	return (0);
+
+    for (cp = pattern; (ch = *(unsigned char *) cp++) != 0; /* void */ ) {
+	switch (ch) {
+
+	    /*
+	     * An escaped non-alphanumerical character is literal, except for
+	     * the GNU word and buffer anchors. Everything else is an operator,
+	     * a character class, or a back reference.
+	     */
+	case '\\':
+	    if ((ch = *(unsigned char *) cp++) == 0)
+		return (0);
+	    if (ISASCII(ch) && !ISALNUM(ch)
+		&& ((flags & REGEXP_PREFILTER_FLAG_PCRE)
+		    || strchr("<>`'", ch) == 0)) {
+		ADD_LITERAL(ch);
+		break;
+	    }
+	    END_RUN();
+	    if ((flags & REGEXP_PREFILTER_FLAG_PCRE)
+		&& (cp = regexp_prefilter_skip_escape(cp, ch)) == 0)
+		return (0);
+	    break;
+
+	    /*
+	     * Character classes.
+	     */
+	case '[':
+	    END_RUN();
+	    if ((cp = regexp_prefilter_skip_bracket(cp, flags)) == 0)
+		return (0);
+	    break;
+
+	    /*
+	     * Ignore everything inside (...). Give up on PCRE inline options
+	     * that change the meaning of whitespace.
+	     */
+	case '(':
+	    END_RUN();
+	    if ((flags & REGEXP_PREFILTER_FLAG_PCRE) && *cp == '?')
+		for (opt = cp + 1; ISALPHA(*opt) || *opt == '-' || *opt == '^'; opt++)
+		    if (*opt == 'x')
+			return (0);
+	    depth++;
+	    break;
+	case ')':
+	    END_RUN();
+	    if (--depth < 0)
+		return (0);
+	    break;
+
+	    /*
+	     * With top-level alternation there is no required literal.
+	     */
+	case '|':
+	    if (depth == 0)
+		return (0);
+	    break;
+
+	    /*
+	     * Quantifiers.
+	     */
+	case '*':
+	case '?':
+	    DROP_LITERAL();
+	    END_RUN();
+	    break;
+	case '+':
+	    if (*cp == '*' || *cp == '?' || *cp == '{')
+		DROP_LITERAL();
+	    END_RUN();
+	    break;
+	case '{':
+	    DROP_LITERAL();
+	    END_RUN();
+	    if (ISDIGIT(*cp) || *cp == ',') {
+		if ((cp = strchr(cp, '}')) == 0)
+		    return (0);
+		cp++;
+	    }
+	    break;
+
+	    /*
+	     * Anchors and wildcards.
+	     */
+	case '.':
+	case '^':
+	case '$':
+	    END_RUN();
+	    break;
+
+	    /*
+	     * Non-ASCII characters may have case variants that differ in
+	     * length, so they are not used.
+	     */
+	default:
+	    if (ISASCII(ch))
+		ADD_LITERAL(ch);
+	    else
+		END_RUN();
+	    break;
+	}
+    }
+    END_RUN();
+    return (result->argc > 0 ? result : 0);
+}
+
+/* regexp_prefilter_create - create empty prefilter */
+
+REGEXP_PREFILTER *regexp_prefilter_create(void)
+{
+    REGEXP_PREFILTER *pf;
+
+    pf = (REGEXP_PREFILTER *) mymalloc(sizeof(*pf));
+    pf->generation = 0;
+    pf->hits = 0;
+    pf->choice = 0;
+    pf->literals = 0;
+    pf->patterns = 0;
+    pf->root = regexp_prefilter_node_alloc(0);
+    pf->start = (REGEXP_PREFILTER_NODE **)
+	mymalloc(sizeof(*pf->start) * (UCHAR_MAX + 1));
+    pf->nodes = 0;
+    pf->cand_size = 10;
+    pf->cand = (REGEXP_PREFILTER_CAND *)
+	mymalloc(sizeof(*pf->cand) * pf->cand_size);
+    pf->compiled = 0;
+    return (pf);
+}
+
+/* regexp_prefilter_enter - add literal to keyword tree */
+
+static int regexp_prefilter_enter(REGEXP_PREFILTER *pf, const char *literal)
+{
+    REGEXP_PREFILTER_NODE *node;
+    REGEXP_PREFILTER_NODE *next;
+    const unsigned char *cp;
+
+    for (node = pf->root, cp = (const unsigned char *) literal; *cp; cp++) {
+	if ((next = regexp_prefilter_child(node, *cp)) == 0) {
+	    next = regexp_prefilter_node_alloc(*cp);
+	    next->sibling = node->child;
+	    node->child = next;
+	    pf->nodes++;
+	}
+	node = next;
+    }
+    if (node == pf->root)
+	msg_panic("regexp_prefilter_enter: empty literal");
+    if (node->id == REGEXP_PREFILTER_NONE)
+	node->id = pf->literals++;
+    return (node->id);
+}
+
+/* regexp_prefilter_add - extract and add pattern literals */
+
+int     regexp_prefilter_add(REGEXP_PREFILTER *pf, const char *pattern,
+			             int flags)
+{
+    static ARGV *literals;
+    REGEXP_PREFILTER_CAND *cand;
+    int     n;
+
+    if (literals == 0)
+	literals = argv_alloc(10);
+    if (regexp_prefilter_literals(literals, pattern, flags) == 0)
+	return (REGEXP_PREFILTER_NONE);
+    if (pf->patterns >= pf->cand_size) {
+	pf->cand_size *= 2;
+	pf->cand = (REGEXP_PREFILTER_CAND *)
+	    myrealloc((void *) pf->cand, sizeof(*pf->cand) * pf->cand_size);
+    }
+    cand = pf->cand + pf->patterns;
+    cand->count = literals->argc;
+    cand->ids = (int *) mymalloc(sizeof(*cand->ids) * cand->count);
+    cand->lens = (int *) mymalloc(sizeof(*cand->lens) * cand->count);
+    for (n = 0; n < cand->count; n++) {
+	cand->ids[n] = regexp_prefilter_enter(pf, literals->argv[n]);
+	cand->lens[n] = strlen(literals->argv[n]);
+    }
+    pf->compiled = 0;
+    return (pf->patterns++);
+}
+
+/* regexp_prefilter_select - select one literal per pattern */
+
+static void regexp_prefilter_select(REGEXP_PREFILTER *pf)
+{
+    REGEXP_PREFILTER_CAND *cand;
+    int    *refs;
+    int     best;
+    int     n;
+
+    /*
+     * Prefer the literal that is required by the fewest patterns, and
+     * among those the longest one.
+     */
+    refs = (int *) mymalloc(sizeof(*refs) * (pf->literals ? pf->literals : 1));
+    memset((void *) refs, 0, sizeof(*refs) * (pf->literals ? pf->literals : 1));
+    for (cand = pf->cand; cand < pf->cand + pf->patterns; cand++)
+	for (n = 0; n < cand->count; n++)
+	    refs[cand->ids[n]]++;
+    if (pf->choice)
+	myfree((void *) pf->choice);
+    pf->choice = (int *) mymalloc(sizeof(*pf->choice)
+				  * (pf->patterns ? pf->patterns : 1));
+    for (cand = pf->cand; cand < pf->cand + pf->patterns; cand++) {
+	for (best = 0, n = 1; n < cand->count; n++)
+	    if (refs[cand->ids[n]] < refs[cand->ids[best]]
+		|| (refs[cand->ids[n]] == refs[cand->ids[best]]
+		    && cand->lens[n] > cand->lens[best]))
+		best = n;
+	pf->choice[cand - pf->cand] = cand->ids[best];
+    }
+    myfree((void *) refs);
+}
+
+/* regexp_prefilter_compile - prepare for lookups */
+
+static void regexp_prefilter_compile(REGEXP_PREFILTER *pf)
+{
+    REGEXP_PREFILTER_NODE *root = pf->root;
+    REGEXP_PREFILTER_NODE **queue;
+    REGEXP_PREFILTER_NODE *node;
+    REGEXP_PREFILTER_NODE *child;
+    REGEXP_PREFILTER_NODE *fail;
+    REGEXP_PREFILTER_NODE *next = 0;
+    int     head = 0;
+    int     tail = 0;
+    int     ch;
+
+    /*
+     * Breadth-first traversal, so that a node's failure link is known
+     * before it is needed for the node's children. Transitions from the
+     * root are kept in a table; a missing transition stays at the root.
+     */
+    queue = (REGEXP_PREFILTER_NODE **)
+	mymalloc(sizeof(*queue) * (pf->nodes ? pf->nodes : 1));
+    for (ch = 0; ch <= UCHAR_MAX; ch++)
+	pf->start[ch] = root;
+    for (child = root->child; child != 0; child = child->sibling) {
+	child->fail = root;
+	child->output = 0;
+	pf->start[child->ch] = child;
+	queue[tail++] = child;
+    }
+    while (head < tail) {
+	node = queue[head++];
+	for (child = node->child; child != 0; child = child->sibling) {
+	    for (fail = node->fail; fail != root
+		 && (next = regexp_prefilter_child(fail, child->ch)) == 0;
+		 fail = fail->fail)
+		 /* void */ ;
+	    if (fail == root)
+		next = pf->start[child->ch];
+	    child->fail = next;
+	    child->output = (next->id != REGEXP_PREFILTER_NONE ?
+			     next : next->output);
+	    queue[tail++] = child;
+	}
+    }
+    myfree((void *) queue);
+
+    /*
+     * (Re)initialize the literal selection and the lookup history.
+     */
+    regexp_prefilter_select(pf);
+    if (pf->hits)
+	myfree((void *) pf->hits);
+    pf->hits = (int *) mymalloc(sizeof(*pf->hits)
+				* (pf->literals ? pf->literals : 1));
+    memset((void *) pf->hits, 0,
+	   sizeof(*pf->hits) * (pf->literals ? pf->literals : 1));
+    pf->generation = 0;
+    pf->compiled = 1;
+}
+
+/* regexp_prefilter_execute - find all literals in text */
+
+void    regexp_prefilter_execute(REGEXP_PREFILTER *pf, const char *text)
+{
+    REGEXP_PREFILTER_NODE *root = pf->root;
+    REGEXP_PREFILTER_NODE *node;
+    REGEXP_PREFILTER_NODE *next = 0;
+    REGEXP_PREFILTER_NODE *out;
+    const unsigned char *cp;
+    int     ch;
+
+    if (pf->compiled == 0)
+	regexp_prefilter_compile(pf);
+
+    /*
+     * Instead of clearing the history before each lookup, bump the lookup
+     * generation number.
+     */
+    if (++pf->generation == INT_MAX) {
+	memset((void *) pf->hits, 0,
+	       sizeof(*pf->hits) * (pf->literals ? pf->literals : 1));
+	pf->generation = 1;
+    }
+
+    /*
+     * Once a literal is marked, so are all literals on its output chain.
+     */
+    for (node = root, cp = (const unsigned char *) text; *cp; cp++) {
+	ch = TOLOWER(*cp);
+	while (node != root && (next = regexp_prefilter_child(node, ch)) == 0)
+	    node = node->fail;
+	node = (node == root ? pf->start[ch] : next);
+	for (out = (node->id != REGEXP_PREFILTER_NONE ? node : node->output);
+	     out != 0 && pf->hits[out->id] != pf->generation;
+	     out = out->output)
+	    pf->hits[out->id] = pf->generation;
+    }
+}
+
+/* regexp_prefilter_free - destroy prefilter */
+
+void    regexp_prefilter_free(REGEXP_PREFILTER *pf)
+{
+    REGEXP_PREFILTER_CAND *cand;
+
+    regexp_prefilter_node_free(pf->root);
+    myfree((void *) pf->start);
+    for (cand = pf->cand; cand < pf->cand + pf->patterns; cand++) {
+	myfree((void *) cand->ids);
+	myfree((void *) cand->lens);
+    }
+    myfree((void *) pf->cand);
+    if (pf->choice)
+	myfree((void *) pf->choice);
+    if (pf->hits)
+	myfree((void *) pf->hits);
+    myfree((void *) pf);
+}
+
+#ifdef TEST
+
+ /*
+  * Test program. Read POSIX extended regular expressions from the named
+  * file, one per line, and report each pattern's literals. Then read text
+  * lines from stdin, and report the patterns that match. Each text is
+  * matched against every pattern, and a pattern that matches although
+  * the prefilter says it cannot is reported as an error. With "-b count",
+  * time count passes of first-match lookups over all texts, with and
+  * without the prefilter. With "-p", read PCRE patterns and report only
+  * their literals.
+  */
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <regex.h>
+#include <sys/time.h>
+#include <msg_vstream.h>
+#include <vstream.h>
+#include <vstring_vstream.h>
+
+typedef struct {
+    int     lineno;			/* pattern file line */
+    int     id;				/* prefilter identifier */
+    regex_t expr;			/* compiled pattern */
+} TEST_RULE;
+
+static double time_lookups(ARGV *texts, int count, TEST_RULE *rules,
+			           int nrules, REGEXP_PREFILTER *pf)
+{
+    struct timeval start;
+    struct timeval stop;
+    int     pass;
+    char  **cpp;
+    TEST_RULE *rp;
+
+    GETTIMEOFDAY(&start);
+    for (pass = 0; pass < count; pass++) {
+	for (cpp = texts->argv; *cpp; cpp++) {
+	    if (pf)
+		regexp_prefilter_execute(pf, *cpp);
+	    for (rp = rules; rp < rules + nrules; rp++) {
+		if (pf && rp->id != REGEXP_PREFILTER_NONE
+		    && !REGEXP_PREFILTER_HIT(pf, rp->id))
+		    continue;
+		if (regexec(&rp->expr, *cpp, 0, (regmatch_t *) 0, 0) == 0)
+		    break;
+	    }
+	}
+    }
+    GETTIMEOFDAY(&stop);
+    return (((stop.tv_sec - start.tv_sec) * 1e6
+	     + (stop.tv_usec - start.tv_usec))
+	    / ((double) count * (texts->argc ? texts->argc : 1)));
+}
+
+int     main(int argc, char **argv)
+{
+    REGEXP_PREFILTER *pf;
+    VSTRING *buf = vstring_alloc(100);
+    ARGV   *literals = argv_alloc(10);
+    ARGV   *texts = argv_alloc(100);
+    TEST_RULE *rules = 0;
+    TEST_RULE *rp;
+    VSTREAM *fp;
+    int     nrules = 0;
+    int     lineno = 0;
+    int     bench_count = 0;
+    int     flags = REGEXP_PREFILTER_FLAG_POSIX;
+    int     matched;
+    char  **cpp;
+    int     ch;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    while ((ch = GETOPT(argc, argv, "b:p")) > 0) {
+	switch (ch) {
+	case 'b':
+	    if ((bench_count = atoi(optarg)) <= 0)
+		msg_fatal("bad count: %s", optarg);
+	    break;
+	case 'p':
+	    flags = REGEXP_PREFILTER_FLAG_PCRE;
+	    break;
+	default:
+	    msg_fatal("usage: %s [-b count] [-p] pattern_file", argv[0]);
+	}
+    }
+    if (argc != optind + 1)
+	msg_fatal("usage: %s [-b count] [-p] pattern_file", argv[0]);
+
+    pf = regexp_prefilter_create();
+    if ((fp = vstream_fopen(argv[optind], O_RDONLY, 0)) == 0)
+	msg_fatal("open %s: %m", argv[optind]);
+    while (vstring_get_nonl(buf, fp) != VSTREAM_EOF) {
+	lineno++;
+	if (*vstring_str(buf) == 0 || *vstring_str(buf) == '#')
+	    continue;
+	if (bench_count == 0) {
+	    vstream_printf("line %d: %s ->", lineno, vstring_str(buf));
+	    if (regexp_prefilter_literals(literals, vstring_str(buf),
+					  flags) == 0)
+		vstream_printf(" no literal");
+	    else
+		for (cpp = literals->argv; *cpp; cpp++)
+		    vstream_printf(" \"%s\"", *cpp);
+	    vstream_printf("\n");
+	}
+	if ((flags & REGEXP_PREFILTER_FLAG_POSIX) == 0)
+	    continue;
+	rules = (TEST_RULE *) (rules == 0 ?
+			       mymalloc(sizeof(*rules)) :
+			       myrealloc((void *) rules,
+					 sizeof(*rules) * (nrules + 1)));
+	rp = rules + nrules;
+	if (regcomp(&rp->expr, vstring_str(buf),
+		    REG_EXTENDED | REG_ICASE | REG_NOSUB) != 0) {
+	    msg_warn("line %d: bad pattern: %s", lineno, vstring_str(buf));
+	    continue;
+	}
+	rp->lineno = lineno;
+	rp->id = regexp_prefilter_add(pf, vstring_str(buf), flags);
+	nrules++;
+    }
+    vstream_fclose(fp);
+
+    if (flags & REGEXP_PREFILTER_FLAG_POSIX) {
+	while (vstring_get_nonl(buf, VSTREAM_IN) != VSTREAM_EOF)
+	    if (*vstring_str(buf) != '#')
+		argv_add(texts, vstring_str(buf), (char *) 0);
+    }
+    if (bench_count > 0) {
+	vstream_printf("linear:    %.3f usec/lookup\n",
+		       time_lookups(texts, bench_count, rules, nrules,
+				    (REGEXP_PREFILTER *) 0));
+	vstream_printf("prefilter: %.3f usec/lookup\n",
+		       time_lookups(texts, bench_count, rules, nrules, pf));
+    } else {
+	for (cpp = texts->argv; *cpp; cpp++) {
+	    regexp_prefilter_execute(pf, *cpp);
+	    vstream_printf("%s:", *cpp);
+	    for (matched = 0, rp = rules; rp < rules + nrules; rp++) {
+		if (regexec(&rp->expr, *cpp, 0, (regmatch_t *) 0, 0) != 0)
+		    continue;
+		matched = 1;
+		vstream_printf(" %d", rp->lineno);
+		if (rp->id != REGEXP_PREFILTER_NONE
+		    && !REGEXP_PREFILTER_HIT(pf, rp->id))
+		    vstream_printf("(MISSED)");
+	    }
+	    vstream_printf("%s\n", matched ? "" : " not found");
+	}
+    }
+    vstream_fflush(VSTREAM_OUT);
+    for (rp = rules; rp < rules + nrules; rp++)
+	regfree(&rp->expr);
+    if (rules)
+	myfree((void *) rules);
+    regexp_prefilter_free(pf);
+    argv_free(literals);
+    argv_free(texts);
+    vstring_free(buf);
+    exit(0);
+}
+
+#endif
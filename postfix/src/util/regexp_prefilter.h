@@ -0,0 +1,63 @@
+#ifndef _REGEXP_PREFILTER_H_INCLUDED_
+#define _REGEXP_PREFILTER_H_INCLUDED_
+
+/*++
+/* NAME
+/*	regexp_prefilter 3h
+/* SUMMARY
+/*	literal substring prefilter for regular expression tables
+/* SYNOPSIS
+/*	#include <regexp_prefilter.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * Utility library.
+  */
+#include <argv.h>
+
+ /*
+  * External interface.
+  */
+typedef struct REGEXP_PREFILTER {
+    int     generation;			/* current lookup */
+    int    *hits;			/* per literal: last lookup seen */
+    int    *choice;			/* per pattern: selected literal */
+    int     literals;			/* number of distinct literals */
+    int     patterns;			/* number of patterns */
+    struct REGEXP_PREFILTER_NODE *root;	/* keyword tree */
+    struct REGEXP_PREFILTER_NODE **start;	/* transitions from root */
+    int     nodes;			/* non-root tree nodes */
+    struct REGEXP_PREFILTER_CAND *cand;	/* per pattern: candidates */
+    int     cand_size;			/* allocated candidate slots */
+    int     compiled;			/* lookup tables are up to date */
+} REGEXP_PREFILTER;
+
+#define REGEXP_PREFILTER_FLAG_POSIX	(1<<0)	/* POSIX extended syntax */
+#define REGEXP_PREFILTER_FLAG_PCRE	(1<<1)	/* PCRE syntax */
+
+#define REGEXP_PREFILTER_NONE	(-1)	/* pattern has no usable literal */
+
+extern REGEXP_PREFILTER *regexp_prefilter_create(void);
+extern ARGV *regexp_prefilter_literals(ARGV *, const char *, int);
+extern int regexp_prefilter_add(REGEXP_PREFILTER *, const char *, int);
+extern void regexp_prefilter_execute(REGEXP_PREFILTER *, const char *);
+extern void regexp_prefilter_free(REGEXP_PREFILTER *);
+
+#define REGEXP_PREFILTER_HIT(pf, id) \
+	((pf)->hits[(pf)->choice[id]] == (pf)->generation)
+
+extern int regexp_prefilter_enable;
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+#endif
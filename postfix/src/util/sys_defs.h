@@ -789,6 +789,10 @@ extern int initgroups(const char *, int);
 #else
 #define NO_SNPRINTF
 #endif
+#if HAVE_GLIBC_API_VERSION_SUPPORT(2, 14)
+#define HAS_SYNCFS				/* kernel 2.6.39 and later */
+#define SYNCFS_ERRORS_SINCE_LINUX 508	/* kernel 5.8 reports errors */
+#endif
 #ifndef NO_IPV6
 #define HAS_IPV6
 #if HAVE_GLIBC_API_VERSION_SUPPORT(2, 4)
@@ -0,0 +1,250 @@
+/*++
+/* NAME
+/*	ttl_cache 3
+/* SUMMARY
+/*	cache with per-entry time to live
+/* SYNOPSIS
+/*	#include <ttl_cache.h>
+/*
+/*	TTL_CACHE *ttl_cache_create(limit, free_fn)
+/*	ssize_t	limit;
+/*	void	(*free_fn)(void *value);
+/*
+/*	int	ttl_cache_find(cache, key, value)
+/*	TTL_CACHE *cache;
+/*	const char *key;
+/*	void	**value;
+/*
+/*	void	ttl_cache_enter(cache, key, value, ttl)
+/*	TTL_CACHE *cache;
+/*	const char *key;
+/*	void	*value;
+/*	int	ttl;
+/*
+/*	void	ttl_cache_free(cache)
+/*	TTL_CACHE *cache;
+/* DESCRIPTION
+/*	This module remembers recent results of an expensive
+/*	operation, such as a table lookup or a query to another
+/*	process. It is built on ctable(3): at most \fIlimit\fR
+/*	results are kept, and when the cache is full, the
+/*	least-recently used result is discarded first. Each result
+/*	expires a fixed time after it is saved; a result is not
+/*	refreshed when it is used, so that a change in the underlying
+/*	data takes effect after a bounded time.
+/*
+/*	ttl_cache_create() creates an empty cache. The free_fn
+/*	argument specifies a function that destroys a value that
+/*	was saved with ttl_cache_enter().
+/*
+/*	ttl_cache_find() looks up a result that has not expired.
+/*	When one is found, the result is non-zero, and the saved
+/*	value is stored via the \fIvalue\fR argument. The value may
+/*	be a null pointer, for example to remember that a lookup
+/*	key does not exist. The value remains owned by the cache,
+/*	and may be destroyed by the next ttl_cache_enter() call.
+/*	A result that is found becomes the most-recently used.
+/*	Otherwise, ttl_cache_find() does not change the cache; in
+/*	particular, a lookup of an unknown or expired key does not
+/*	push other results out of a full cache. Only
+/*	ttl_cache_enter() adds entries.
+/*
+/*	ttl_cache_enter() saves a value for \fIttl\fR seconds,
+/*	replacing any older value. The cache takes ownership of a
+/*	non-null value. When \fIttl\fR is not positive, the value
+/*	is destroyed and the cache is not changed.
+/*
+/*	ttl_cache_free() destroys a cache, including its contents.
+/* DIAGNOSTICS
+/*	Fatal errors: out of memory.
+/* SEE ALSO
+/*	ctable(3) cache manager
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <time.h>
+
+/* Utility library. */
+
+#include <mymalloc.h>
+#include <ctable.h>
+#include <ttl_cache.h>
+
+ /*
+  * A cache entry that was just created has expired already, and must be
+  * filled in.
+  */
+typedef struct {
+    time_t  expire;			/* time of expiration */
+    void   *value;			/* saved value or null */
+} TTL_CACHE_ENTRY;
+
+struct ttl_cache {
+    CTABLE *table;			/* LRU cache */
+    TTL_CACHE_FREE_FN free_fn;		/* value destructor */
+};
+
+/* ttl_cache_create_entry - create empty cache entry */
+
+static void *ttl_cache_create_entry(const char *unused_key, void *unused_context)
+{
+    TTL_CACHE_ENTRY *entry;
+
+    entry = (TTL_CACHE_ENTRY *) mymalloc(sizeof(*entry));
+    entry->expire = 0;
+    entry->value = 0;
+    return ((void *) entry);
+}
+
+/* ttl_cache_delete_entry - destroy cache entry */
+
+static void ttl_cache_delete_entry(void *ptr, void *context)
+{
+    TTL_CACHE *cache = (TTL_CACHE *) context;
+    TTL_CACHE_ENTRY *entry = (TTL_CACHE_ENTRY *) ptr;
+
+    if (entry->value)
+	cache->free_fn(entry->value);
+    myfree((void *) entry);
+}
+
+/* ttl_cache_create - create empty cache */
+
+TTL_CACHE *ttl_cache_create(ssize_t limit, TTL_CACHE_FREE_FN free_fn)
+{
+    TTL_CACHE *cache;
+
+    cache = (TTL_CACHE *) mymalloc(sizeof(*cache));
+    cache->free_fn = free_fn;
+    cache->table = ctable_create(limit, ttl_cache_create_entry,
+				 ttl_cache_delete_entry, (void *) cache);
+    return (cache);
+}
+
+/* ttl_cache_find - look up unexpired value */
+
+int     ttl_cache_find(TTL_CACHE *cache, const char *key, void **value)
+{
+    TTL_CACHE_ENTRY *entry;
+
+    /*
+     * Don't use ctable_locate() until we know that the result is usable.
+     * That function would create an entry for an unknown key, and that
+     * would push out the least-recently used result when the cache is full.
+     */
+    entry = (TTL_CACHE_ENTRY *) ctable_find(cache->table, key);
+    if (entry == 0 || entry->expire <= time((time_t *) 0))
+	return (0);
+    (void) ctable_locate(cache->table, key);	/* make most-recently used */
+    *value = entry->value;
+    return (1);
+}
+
+/* ttl_cache_enter - save value */
+
+void    ttl_cache_enter(TTL_CACHE *cache, const char *key, void *value,
+			        int ttl)
+{
+    TTL_CACHE_ENTRY *entry;
+
+    if (ttl <= 0) {
+	if (value)
+	    cache->free_fn(value);
+	return;
+    }
+    entry = (TTL_CACHE_ENTRY *) ctable_locate(cache->table, key);
+    if (entry->value)
+	cache->free_fn(entry->value);
+    entry->value = value;
+    entry->expire = time((time_t *) 0) + ttl;
+}
+
+/* ttl_cache_free - destroy cache */
+
+void    ttl_cache_free(TTL_CACHE *cache)
+{
+    ctable_free(cache->table);
+    myfree((void *) cache);
+}
+
+#ifdef TEST
+
+ /*
+  * Proof-of-concept test program. Read commands from stdin, and report
+  * what the cache remembers. A cache with room for five results:
+  * 
+  * enter key value ttl, enter key - ttl (remember that key does not exist)
+  * 
+  * find key
+  * 
+  * sleep seconds
+  */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vstream.h>
+#include <vstring.h>
+#include <vstring_vstream.h>
+#include <msg_vstream.h>
+#include <argv.h>
+#include <stringops.h>
+
+#define STR(x)	vstring_str(x)
+
+static void drop(void *value)
+{
+    myfree(value);
+}
+
+int     main(int unused_argc, char **argv)
+{
+    VSTRING *inbuf = vstring_alloc(100);
+    TTL_CACHE *cache;
+    ARGV   *args;
+    void   *value;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    cache = ttl_cache_create(5, drop);
+
+    while (vstring_get_nonl(inbuf, VSTREAM_IN) != VSTREAM_EOF) {
+	vstream_printf("> %s\n", STR(inbuf));
+	args = argv_split(STR(inbuf), CHARS_SPACE);
+	if (args->argc == 0 || *args->argv[0] == '#') {
+	     /* void */ ;
+	} else if (strcmp(args->argv[0], "enter") == 0 && args->argc == 4) {
+	    ttl_cache_enter(cache, args->argv[1],
+			    strcmp(args->argv[2], "-") == 0 ? (void *) 0 :
+			    (void *) mystrdup(args->argv[2]),
+			    atoi(args->argv[3]));
+	} else if (strcmp(args->argv[0], "find") == 0 && args->argc == 2) {
+	    if (ttl_cache_find(cache, args->argv[1], &value) == 0)
+		vstream_printf("%s: not cached\n", args->argv[1]);
+	    else
+		vstream_printf("%s: %s\n", args->argv[1],
+			       value ? (char *) value : "(not found)");
+	} else if (strcmp(args->argv[0], "sleep") == 0 && args->argc == 2) {
+	    sleep(atoi(args->argv[1]));
+	} else {
+	    vstream_printf("usage: enter key value|- ttl | find key"
+			   " | sleep seconds\n");
+	}
+	vstream_fflush(VSTREAM_OUT);
+	argv_free(args);
+    }
+    ttl_cache_free(cache);
+    vstring_free(inbuf);
+    return (0);
+}
+
+#endif
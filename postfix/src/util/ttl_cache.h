@@ -0,0 +1,37 @@
+#ifndef _TTL_CACHE_H_INCLUDED_
+#define _TTL_CACHE_H_INCLUDED_
+
+/*++
+/* NAME
+/*	ttl_cache 3h
+/* SUMMARY
+/*	cache with per-entry time to live
+/* SYNOPSIS
+/*	#include <ttl_cache.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * External interface. The structure of a cache is not visible to the
+  * caller.
+  */
+#define TTL_CACHE struct ttl_cache
+typedef void (*TTL_CACHE_FREE_FN) (void *);
+
+extern TTL_CACHE *ttl_cache_create(ssize_t, TTL_CACHE_FREE_FN);
+extern int ttl_cache_find(TTL_CACHE *, const char *, void **);
+extern void ttl_cache_enter(TTL_CACHE *, const char *, void *, int);
+extern void ttl_cache_free(TTL_CACHE *);
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/* AUTHOR(S)
+/*	Wietse Venema
+/*	IBM T.J. Watson Research
+/*	P.O. Box 704
+/*	Yorktown Heights, NY 10598, USA
+/*--*/
+
+#endif